@@ -0,0 +1,323 @@
+#define ORBIT_IMPLEMENTATION
+
+#include "common/orbit.h"
+#include "common/arena.h"
+#include "common/strmap.h"
+#include "common/ptrmap.h"
+#include "common/strbuilder.h"
+
+#include <time.h>
+
+/*
+    microbenchmarks for the containers everything else sits on.
+
+    every result is one line, "name\t  key       : value", the same shape
+    mars -timings uses, so mbuild bench records these too. "time" is in
+    seconds for the whole run, the other keys are:
+
+        probes      average displacement from the home slot, +1
+        maxprobe    worst displacement, +1
+        wasted      % of arena memory not handed out
+        reallocs    number of times the buffer was grown
+        copied      bytes moved by growing
+
+    everything is seeded, so apart from time the numbers are deterministic.
+*/
+
+#define MAP_CAPACITY (1 << 16)
+#define MAP_ROUNDS   16
+
+static double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+static void report_time(char* name, double seconds, size_t ops) {
+    printf("%s\t  time      : %fs (%.2f ns/op)\n", name, seconds, seconds * 1e9 / (double)ops);
+}
+
+static void report(char* name, char* key, double value) {
+    printf("%s\t  %-10s: %.3f\n", name, key, value);
+}
+
+static unsigned rng = 1;
+
+static unsigned next_random() {
+    rng = rng * 1103515245u + 12345u;
+    return (rng >> 16) & 0x7FFF;
+}
+
+// keys that look like identifiers, since that's what strmap mostly holds
+static string* make_string_keys(size_t count, char* prefix) {
+    string* keys = malloc(sizeof(string) * count);
+    for_urange(i, 0, count) {
+        keys[i] = strprintf("%s_%zu_%u", prefix, i, next_random());
+    }
+    return keys;
+}
+
+static void strmap_probe_stats(StrMap* sm, double* avg, double* max) {
+    size_t entries = 0, total = 0, worst = 0;
+    for_urange(i, 0, sm->cap) {
+        if (sm->hashes[i] == 0) continue;
+        size_t home = sm->hashes[i] & (sm->cap - 1);
+        size_t dist = (i + sm->cap - home) % sm->cap;
+        total += dist;
+        if (dist > worst) worst = dist;
+        entries++;
+    }
+    *avg = entries == 0 ? 0 : 1.0 + (double)total / (double)entries;
+    *max = 1.0 + (double)worst;
+}
+
+static void ptrmap_probe_stats(PtrMap* pm, double* avg, double* max) {
+    size_t entries = 0, total = 0, worst = 0;
+    for_urange(i, 0, pm->cap) {
+        if (pm->keys[i] == NULL) continue;
+        size_t home = hashfunc(pm->keys[i]) >> (64 - __builtin_ctzll(pm->cap));
+        size_t dist = (i + pm->cap - home) % pm->cap;
+        total += dist;
+        if (dist > worst) worst = dist;
+        entries++;
+    }
+    *avg = entries == 0 ? 0 : 1.0 + (double)total / (double)entries;
+    *max = 1.0 + (double)worst;
+}
+
+static void bench_strmap(int load_percent) {
+    size_t count = (size_t)MAP_CAPACITY * load_percent / 100;
+    string* keys = make_string_keys(count, "ident");
+    string* misses = make_string_keys(count, "other");
+
+    double put = 0, hit = 0, miss = 0, remove = 0;
+    double avg_probe = 0, max_probe = 0;
+    size_t found = 0;
+
+    for_range(round, 0, MAP_ROUNDS) {
+        StrMap sm;
+        strmap_init(&sm, MAP_CAPACITY);
+
+        double start = now();
+        for_urange(i, 0, count) strmap_put(&sm, keys[i], &keys[i]);
+        put += now() - start;
+
+        start = now();
+        for_urange(i, 0, count) found += strmap_get(&sm, keys[i]) != STRMAP_NOT_FOUND;
+        hit += now() - start;
+
+        start = now();
+        for_urange(i, 0, count) found += strmap_get(&sm, misses[i]) != STRMAP_NOT_FOUND;
+        miss += now() - start;
+
+        if (round == 0) strmap_probe_stats(&sm, &avg_probe, &max_probe);
+
+        start = now();
+        for_urange(i, 0, count) strmap_remove(&sm, keys[i]);
+        remove += now() - start;
+
+        strmap_destroy(&sm);
+    }
+
+    size_t ops = count * MAP_ROUNDS;
+    char name[64];
+    sprintf(name, "strmap.put@%d", load_percent);
+    report_time(name, put, ops);
+    sprintf(name, "strmap.hit@%d", load_percent);
+    report_time(name, hit, ops);
+    sprintf(name, "strmap.miss@%d", load_percent);
+    report_time(name, miss, ops);
+    sprintf(name, "strmap.remove@%d", load_percent);
+    report_time(name, remove, ops);
+    sprintf(name, "strmap@%d", load_percent);
+    report(name, "probes", avg_probe);
+    report(name, "maxprobe", max_probe);
+
+    // keep the lookups from being thrown away
+    if (found == 0) printf("strmap lost every key\n");
+
+    for_urange(i, 0, count) {
+        free(keys[i].raw);
+        free(misses[i].raw);
+    }
+    free(keys);
+    free(misses);
+}
+
+// the keys are mostly ir and ast node pointers, so use node sized strides.
+// they never get dereferenced, and a fixed base keeps probe counts the same
+// from run to run, which real heap addresses wouldn't
+typedef struct FakeNode {
+    u8 bytes[48];
+} FakeNode;
+
+#define FAKE_NODE_BASE ((FakeNode*)0x7f0000000000)
+
+static void bench_ptrmap(int load_percent) {
+    size_t count = (size_t)MAP_CAPACITY * load_percent / 100;
+    FakeNode* nodes = FAKE_NODE_BASE;
+    FakeNode* misses = nodes + count;
+
+    void** batch_keys = malloc(sizeof(void*) * count);
+    void** batch_vals = malloc(sizeof(void*) * count);
+    for_urange(i, 0, count) batch_keys[i] = &nodes[(i * 7919) % count]; // out of order
+
+    double put = 0, hit = 0, miss = 0, many = 0, remove = 0;
+    double avg_probe = 0, max_probe = 0;
+    size_t found = 0;
+
+    for_range(round, 0, MAP_ROUNDS) {
+        PtrMap pm;
+        ptrmap_init(&pm, MAP_CAPACITY);
+
+        double start = now();
+        for_urange(i, 0, count) ptrmap_put(&pm, &nodes[i], &nodes[i]);
+        put += now() - start;
+
+        start = now();
+        for_urange(i, 0, count) found += ptrmap_get(&pm, &nodes[i]) != PTRMAP_NOT_FOUND;
+        hit += now() - start;
+
+        start = now();
+        for_urange(i, 0, count) found += ptrmap_get(&pm, &misses[i]) != PTRMAP_NOT_FOUND;
+        miss += now() - start;
+
+        start = now();
+        ptrmap_get_many(&pm, batch_keys, batch_vals, count);
+        many += now() - start;
+        found += batch_vals[0] != PTRMAP_NOT_FOUND;
+
+        if (round == 0) ptrmap_probe_stats(&pm, &avg_probe, &max_probe);
+
+        start = now();
+        for_urange(i, 0, count) ptrmap_remove(&pm, &nodes[i]);
+        remove += now() - start;
+
+        ptrmap_destroy(&pm);
+    }
+
+    size_t ops = count * MAP_ROUNDS;
+    char name[64];
+    sprintf(name, "ptrmap.put@%d", load_percent);
+    report_time(name, put, ops);
+    sprintf(name, "ptrmap.hit@%d", load_percent);
+    report_time(name, hit, ops);
+    sprintf(name, "ptrmap.miss@%d", load_percent);
+    report_time(name, miss, ops);
+    sprintf(name, "ptrmap.get_many@%d", load_percent);
+    report_time(name, many, ops);
+    sprintf(name, "ptrmap.remove@%d", load_percent);
+    report_time(name, remove, ops);
+    sprintf(name, "ptrmap@%d", load_percent);
+    report(name, "probes", avg_probe);
+    report(name, "maxprobe", max_probe);
+
+    if (found == 0) printf("ptrmap lost every key\n");
+
+    free(batch_keys);
+    free(batch_vals);
+}
+
+#define ARENA_BLOCK (1 << 16)
+#define ARENA_BYTES (64 << 20)
+
+// max_size is the biggest allocation, anything past the block size goes down
+// the large allocation path. every workload asks for about ARENA_BYTES in total
+static void bench_arena(char* name, size_t max_size) {
+    size_t allocs = ARENA_BYTES / (8 + max_size / 2);
+    size_t* sizes = malloc(sizeof(size_t) * allocs);
+    size_t requested = 0;
+    for_urange(i, 0, allocs) {
+        sizes[i] = 8 + (next_random() % max_size);
+        requested += sizes[i];
+    }
+
+    Arena arena = arena_make(ARENA_BLOCK);
+    double start = now();
+    for_urange(i, 0, allocs) arena_alloc(&arena, sizes[i], 8);
+    double elapsed = now() - start;
+
+    char full_name[64];
+    sprintf(full_name, "arena.%s", name);
+    report_time(full_name, elapsed, allocs);
+    report(full_name, "wasted", 100.0 * (1.0 - (double)requested / (double)arena_reserved(&arena)));
+
+    // and again into the memory the first round left behind
+    arena_reset(&arena);
+    start = now();
+    for_urange(i, 0, allocs) arena_alloc(&arena, sizes[i], 8);
+    elapsed = now() - start;
+    sprintf(full_name, "arena.%s.reuse", name);
+    report_time(full_name, elapsed, allocs);
+    arena_delete(&arena);
+
+    // the same allocations through malloc, for comparison
+    void** ptrs = malloc(sizeof(void*) * allocs);
+    start = now();
+    for_urange(i, 0, allocs) ptrs[i] = malloc(sizes[i]);
+    elapsed = now() - start;
+    for_urange(i, 0, allocs) free(ptrs[i]);
+    sprintf(full_name, "malloc.%s", name);
+    report_time(full_name, elapsed, allocs);
+
+    free(ptrs);
+    free(sizes);
+}
+
+#define DA_APPENDS (1 << 22)
+
+typedef struct Wide {
+    u64 words[8];
+} Wide;
+
+da_typedef(u32);
+da_typedef(Wide);
+
+// da_append doubles, so count how often it grows and how much it moves
+#define bench_da(name, type, value) do {                              \
+    da(type) array;                                                   \
+    da_init(&array, 1);                                               \
+    size_t reallocs = 0, copied = 0, last_cap = array.cap;            \
+    double start = now();                                             \
+    for_urange(i, 0, DA_APPENDS) {                                    \
+        da_append(&array, value);                                     \
+        if (array.cap != last_cap) {                                  \
+            reallocs++;                                               \
+            copied += last_cap * sizeof(type);                        \
+            last_cap = array.cap;                                     \
+        }                                                             \
+    }                                                                 \
+    double elapsed = now() - start;                                   \
+    report_time(name, elapsed, DA_APPENDS);                           \
+    report(name, "reallocs", (double)reallocs);                       \
+    report(name, "copied", (double)copied);                           \
+    da_destroy(&array);                                               \
+} while (0)
+
+static void bench_strbuilder() {
+    char* words[] = {"fn ", "main", "(", ") ", "-> ", "int ", "{\n", "}\n"};
+    StringBuilder sb;
+    sb_init(&sb);
+    double start = now();
+    for_urange(i, 0, DA_APPENDS) sb_append_c(&sb, words[i % 8]);
+    double elapsed = now() - start;
+    report_time("sb.append", elapsed, DA_APPENDS);
+    sb_destroy(&sb);
+}
+
+int main(int argc, char** argv) {
+    int load_factors[] = {25, 50, 75, 90};
+    for_range(i, 0, 4) bench_strmap(load_factors[i]);
+    for_range(i, 0, 4) bench_ptrmap(load_factors[i]);
+
+    bench_arena("small", 56);
+    bench_arena("mixed", 1024);
+    bench_arena("large", ARENA_BLOCK / 4);
+    bench_arena("huge", ARENA_BLOCK * 2);
+
+    bench_da("da.append.u32", u32, (u32)i);
+    bench_da("da.append.wide", Wide, ((Wide){.words = {i}}));
+
+    bench_strbuilder();
+    return 0;
+}
@@ -0,0 +1,209 @@
+#define ORBIT_IMPLEMENTATION
+
+#include "iron/iron.h"
+#include "iron/codegen/x64/x64.h"
+
+/*
+    iron throughput benchmark.
+
+    builds a big synthetic module straight through the builder API, then runs
+    it through the standard passes, codegen and the binary emitter, timing
+    each stage. prints the timings the same way mars -timings does, so the
+    bench harness reads both the same way.
+
+    functions are a chain of blocks with a loop every few blocks, doing
+    random integer arithmetic on their parameters, a few stack objects and
+    the occasional call to an earlier function.
+*/
+
+typedef struct Config {
+    int funcs;
+    int blocks;
+    int insts;
+    int slots;
+    unsigned seed;
+} Config;
+
+static Config cfg = {
+    .funcs = 32,
+    .blocks = 16,
+    .insts = 16,
+    .slots = 4,
+    .seed = 1,
+};
+
+static unsigned rng;
+
+static unsigned next_random() {
+    rng = rng * 1103515245u + 12345u;
+    return (rng >> 16) & 0x7FFF;
+}
+
+static int pick(int n) {
+    return n <= 0 ? 0 : (int)(next_random() % (unsigned)n);
+}
+
+static FeIr* constant(FeFunction* f, FeBasicBlock* bb, i64 value) {
+    FeIrConst* c = (FeIrConst*)fe_append_ir(bb, fe_ir_const(f, FE_TYPE_I64));
+    c->i64 = value;
+    return (FeIr*)c;
+}
+
+static FeIr* binop(FeFunction* f, FeBasicBlock* bb, u8 kind, FeIr* lhs, FeIr* rhs) {
+    FeIr* ir = fe_append_ir(bb, fe_ir_binop(f, kind, lhs, rhs));
+    ir->type = (_FE_IR_CMP_START < kind && kind < _FE_IR_CMP_END) ? FE_TYPE_BOOL : FE_TYPE_I64;
+    return ir;
+}
+
+static FeFunction* gen_function(FeModule* m, int index, FeFunction** earlier) {
+    static const u8 ops[] = {FE_IR_ADD, FE_IR_SUB, FE_IR_IMUL, FE_IR_AND, FE_IR_OR, FE_IR_XOR};
+
+    char name[64];
+    int len = snprintf(name, sizeof(name), "fn%d", index);
+    FeSymbol* sym = fe_new_symbol(m, string_clone((string){.raw = name, .len = len}), FE_BIND_EXPORT);
+    FeFunction* f = fe_new_function(m, sym, FE_CCONV_SYSV);
+    fe_init_func_params(f, 2);
+    fe_add_func_param(f, FE_TYPE_I64);
+    fe_add_func_param(f, FE_TYPE_I64);
+    fe_init_func_returns(f, 1);
+    fe_add_func_return(f, FE_TYPE_I64);
+
+    FeStackObject** slots = fe_malloc(sizeof(FeStackObject*) * cfg.slots);
+    for_range(i, 0, cfg.slots) slots[i] = fe_new_stackobject(f, FE_TYPE_I64);
+
+    FeBasicBlock** blocks = fe_malloc(sizeof(FeBasicBlock*) * cfg.blocks);
+    for_range(i, 0, cfg.blocks) {
+        len = snprintf(name, sizeof(name), "b%d", (int)i);
+        blocks[i] = fe_new_basic_block(f, string_clone((string){.raw = name, .len = len}));
+    }
+
+    FeIr* params[2];
+    params[0] = fe_append_ir(blocks[0], fe_ir_param(f, 0));
+    params[1] = fe_append_ir(blocks[0], fe_ir_param(f, 1));
+    for_range(i, 0, cfg.slots) fe_append_ir(blocks[0], fe_ir_stack_store(f, slots[i], params[i % 2]));
+
+    FeIr** pool = fe_malloc(sizeof(FeIr*) * (cfg.insts + 4));
+    FeIr* last = params[0];
+    for_range(b, 0, cfg.blocks) {
+        FeBasicBlock* bb = blocks[b];
+
+        u32 pool_len = 0;
+        pool[pool_len++] = params[0];
+        pool[pool_len++] = params[1];
+        pool[pool_len++] = fe_append_ir(bb, fe_ir_stack_load(f, slots[pick(cfg.slots)]));
+
+        for_range(i, 0, cfg.insts) {
+            FeIr* lhs = pool[pick(pool_len)];
+            FeIr* value;
+            if (index > 0 && pick(16) == 0) {
+                FeIr* call = fe_append_ir(bb, fe_ir_call(f, earlier[pick(index)]));
+                fe_add_call_param(call, lhs);
+                fe_add_call_param(call, pool[pick(pool_len)]);
+                value = fe_append_ir(bb, fe_ir_retrieve(f, call, FE_TYPE_I64, 0));
+            } else if (pick(4) == 0) {
+                value = binop(f, bb, ops[pick(6)], lhs, constant(f, bb, pick(1000)));
+            } else {
+                value = binop(f, bb, ops[pick(6)], lhs, pool[pick(pool_len)]);
+            }
+            pool[pool_len++] = value;
+        }
+        last = pool[pool_len - 1];
+        fe_append_ir(bb, fe_ir_stack_store(f, slots[pick(cfg.slots)], last));
+
+        if (b + 1 == cfg.blocks) {
+            FeIrReturn* ret = (FeIrReturn*)fe_append_ir(bb, fe_ir_return(f));
+            ret->sources[0] = last;
+        } else if (b % 4 == 3) {
+            // loop back a couple of blocks
+            FeIr* cond = binop(f, bb, FE_IR_ILT, last, constant(f, bb, pick(1000)));
+            fe_append_ir(bb, fe_ir_branch(f, cond, blocks[b - 2], blocks[b + 1]));
+        } else {
+            fe_append_ir(bb, fe_ir_jump(f, blocks[b + 1]));
+        }
+    }
+
+    fe_free(pool);
+    fe_free(blocks);
+    fe_free(slots);
+    return f;
+}
+
+static struct timeval stage_begin;
+
+static void begin_stage() {
+    gettimeofday(&stage_begin, 0);
+}
+
+static void end_stage(char* name) {
+    struct timeval stage_end;
+    gettimeofday(&stage_end, 0);
+    long seconds = stage_end.tv_sec - stage_begin.tv_sec;
+    long microseconds = stage_end.tv_usec - stage_begin.tv_usec;
+    double elapsed = (double)seconds + (double)microseconds * 1e-6;
+    printf("%s\t  time      : %fs\n", name, elapsed);
+}
+
+static void usage() {
+    printf(
+        "usage: irongen [options]\n"
+        "\n"
+        "-funcs N       functions in the module (default 32)\n"
+        "-blocks N      basic blocks per function (default 16)\n"
+        "-insts N       instructions per block (default 16)\n"
+        "-slots N       stack objects per function (default 4)\n"
+        "-seed N        random seed (default 1)\n"
+    );
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 == argc) {
+            usage();
+            return 1;
+        }
+        int value = atoi(argv[i + 1]);
+        if (strcmp(argv[i], "-funcs") == 0) cfg.funcs = value;
+        else if (strcmp(argv[i], "-blocks") == 0) cfg.blocks = value;
+        else if (strcmp(argv[i], "-insts") == 0) cfg.insts = value;
+        else if (strcmp(argv[i], "-slots") == 0) cfg.slots = value;
+        else if (strcmp(argv[i], "-seed") == 0) cfg.seed = (unsigned)value;
+        else {
+            usage();
+            return 1;
+        }
+        i++;
+    }
+    if (cfg.funcs < 1) cfg.funcs = 1;
+    if (cfg.blocks < 1) cfg.blocks = 1;
+    if (cfg.slots < 1) cfg.slots = 1;
+    rng = cfg.seed;
+
+    begin_stage();
+    FeModule* m = fe_new_module(str("bench"));
+    FeFunction** functions = fe_malloc(sizeof(FeFunction*) * cfg.funcs);
+    for_range(i, 0, cfg.funcs) functions[i] = gen_function(m, i, functions);
+    end_stage("BUILD");
+
+    begin_stage();
+    fe_sched_module_pass(m, &fe_pass_verify);
+    fe_sched_module_pass(m, &fe_pass_tdce);
+    fe_run_all_passes(m, false);
+    end_stage("PASSES");
+
+    static FeX64Config config;
+    m->target.arch = &fe_arch_x64;
+    m->target.arch_config = &config;
+    m->target.system = FE_SYSTEM_LINUX;
+
+    begin_stage();
+    FeMachBuffer mb = fe_mach_codegen(m);
+    end_stage("CODEGEN");
+
+    begin_stage();
+    FeDataBuffer db = fe_db_new(4096);
+    fe_mach_emit_bin(&db, &mb);
+    end_stage("EMIT");
+
+    printf("code size : %zu bytes\n", (size_t)db.len);
+    return 0;
+}
@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/*
+    synthetic mars corpus generator for the compile-time benchmarks.
+
+    writes a main module made of N files with M functions each, plus a chain
+    of imported modules where every module calls into the next one. each file
+    gets a chain of structs that embed each other by value, so type checking
+    and layout have a deep graph to walk.
+
+    only emits things the checker currently understands. switches aren't
+    checked yet, so -switch is only useful with mars -stop:parse.
+
+    everything is derived from -seed, so a corpus is reproducible.
+*/
+
+typedef struct Config {
+    char* out;
+    int files;
+    int funcs;
+    int types;
+    int stmts;
+    int switch_cases;
+    int chain;
+    unsigned seed;
+} Config;
+
+static Config cfg = {
+    .files = 4,
+    .funcs = 64,
+    .types = 8,
+    .stmts = 16,
+    .switch_cases = 0,
+    .chain = 2,
+    .seed = 1,
+};
+
+static unsigned rng;
+
+static unsigned next_random() {
+    rng = rng * 1103515245u + 12345u;
+    return (rng >> 16) & 0x7FFF;
+}
+
+static int pick(int n) {
+    return n <= 0 ? 0 : (int)(next_random() % (unsigned)n);
+}
+
+// mkdir -p
+static void make_dirs(char* dir) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s", dir);
+    for (char* c = path + 1; *c != '\0'; c++) {
+        if (*c != '/') continue;
+        *c = '\0';
+        mkdir(path, 0755);
+        *c = '/';
+    }
+    mkdir(path, 0755);
+}
+
+static FILE* open_file(char* dir, char* name) {
+    char path[4096];
+    make_dirs(dir);
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE* f = fopen(path, "w");
+    if (f == NULL) {
+        fprintf(stderr, "marsgen: cannot write %s\n", path);
+        exit(1);
+    }
+    return f;
+}
+
+// a chain of structs, each one embedding the one before it
+static void gen_types(FILE* f, int file) {
+    for (int t = 0; t < cfg.types; t++) {
+        fprintf(f, "type S%d_%d = struct {\n", file, t);
+        fprintf(f, "    val: int,\n");
+        fprintf(f, "    small: u8,\n");
+        if (t > 0) fprintf(f, "    inner: S%d_%d,\n", file, t - 1);
+        fprintf(f, "    next: ^mut S%d_%d,\n", file, t);
+        fprintf(f, "};\n\n");
+    }
+}
+
+static void gen_expr(FILE* f, int depth) {
+    static const char* ops[] = {"+", "-", "*", "&", "|", "~"};
+    if (depth <= 0 || pick(3) == 0) {
+        switch (pick(3)) {
+        case 0: fprintf(f, "a"); break;
+        case 1: fprintf(f, "b"); break;
+        default: fprintf(f, "%d", pick(1000)); break;
+        }
+        return;
+    }
+    fprintf(f, "(");
+    gen_expr(f, depth - 1);
+    fprintf(f, " %s ", ops[pick(6)]);
+    gen_expr(f, depth - 1);
+    fprintf(f, ")");
+}
+
+static void gen_stmt(FILE* f, char* prefix, int file, int func, int s) {
+    switch (pick(6)) {
+    case 0:
+        fprintf(f, "    acc = acc + ");
+        gen_expr(f, 3);
+        fprintf(f, ";\n");
+        break;
+    case 1:
+        // the checker doesn't take else branches yet
+        fprintf(f, "    if acc > %d {\n", pick(1000));
+        fprintf(f, "        acc = acc - a;\n");
+        fprintf(f, "    }\n");
+        break;
+    case 2:
+        fprintf(f, "    for mut k%d = 0; k%d < b; k%d += 1; {\n", s, s, s);
+        fprintf(f, "        acc = acc + k%d;\n", s);
+        fprintf(f, "    }\n");
+        break;
+    case 3:
+        fprintf(f, "    while acc > %d {\n", 1000 + pick(1000));
+        fprintf(f, "        acc = acc / 2;\n");
+        fprintf(f, "    }\n");
+        break;
+    case 4:
+        // call an earlier function in this file, or the next module in the chain.
+        // the checker can't use a call inside an expression yet
+        if (func > 0) {
+            fprintf(f, "    acc = %s_%d_%d(acc, a, s);\n", prefix, file, pick(func));
+        } else if (cfg.chain > 0 && strcmp(prefix, "f") == 0) {
+            fprintf(f, "    acc = m0::g_0_%d(acc, b);\n", pick(cfg.funcs));
+        } else {
+            fprintf(f, "    acc = acc * 3;\n");
+        }
+        break;
+    default:
+        if (strcmp(prefix, "f") == 0) {
+            fprintf(f, "    s.val = s.val + acc;\n");
+            fprintf(f, "    acc = acc + cast(int) s.small;\n");
+        } else {
+            fprintf(f, "    acc = acc ~ %d;\n", pick(1000));
+        }
+        break;
+    }
+}
+
+static void gen_switch(FILE* f) {
+    fprintf(f, "    switch acc {\n");
+    for (int c = 0; c < cfg.switch_cases; c++) {
+        fprintf(f, "    case %d: acc = acc + %d;\n", c, pick(1000));
+    }
+    fprintf(f, "    case: acc = 0;\n");
+    fprintf(f, "    }\n");
+}
+
+// main module functions take (acc, a, s), chain module ones take (a, b)
+static void gen_main_file(int file) {
+    char name[64];
+    snprintf(name, sizeof(name), "file%d.mars", file);
+    FILE* f = open_file(cfg.out, name);
+
+    fprintf(f, "module bench;\n\n");
+    if (cfg.chain > 0) fprintf(f, "import m0 \"../m0\";\n\n");
+    gen_types(f, file);
+
+    for (int fn = 0; fn < cfg.funcs; fn++) {
+        fprintf(f, "fn f_%d_%d(a: int, b: int, s: ^mut S%d_%d) -> int {\n", file, fn, file, cfg.types - 1);
+        fprintf(f, "    mut acc: int = a;\n");
+        if (cfg.switch_cases > 0 && fn % 8 == 0) gen_switch(f);
+        for (int s = 0; s < cfg.stmts; s++) gen_stmt(f, "f", file, fn, s);
+        fprintf(f, "    return acc;\n");
+        fprintf(f, "}\n\n");
+    }
+    fclose(f);
+}
+
+static void gen_chain_module(int index) {
+    char dir[4096];
+    snprintf(dir, sizeof(dir), "%s/../m%d", cfg.out, index);
+    FILE* f = open_file(dir, "chain.mars");
+
+    fprintf(f, "module m%d;\n\n", index);
+    if (index + 1 < cfg.chain) fprintf(f, "import m%d \"../m%d\";\n\n", index + 1, index + 1);
+
+    for (int fn = 0; fn < cfg.funcs; fn++) {
+        fprintf(f, "fn g_0_%d(a: int, b: int) -> int {\n", fn);
+        fprintf(f, "    mut acc: int = a;\n");
+        if (index + 1 < cfg.chain) {
+            fprintf(f, "    acc = m%d::g_0_%d(b, a);\n", index + 1, pick(cfg.funcs));
+        }
+        for (int s = 0; s < cfg.stmts / 2; s++) {
+            fprintf(f, "    acc = acc + ");
+            gen_expr(f, 3);
+            fprintf(f, ";\n");
+        }
+        fprintf(f, "    return acc;\n");
+        fprintf(f, "}\n\n");
+    }
+    fclose(f);
+}
+
+static void usage() {
+    printf(
+        "usage: marsgen (directory) [options]\n"
+        "\n"
+        "writes the main module to (directory), and chain modules next to it.\n"
+        "\n"
+        "-files N       files in the main module (default 4)\n"
+        "-funcs N       functions per file (default 64)\n"
+        "-types N       depth of the struct chain in each file (default 8)\n"
+        "-stmts N       statements per function (default 16)\n"
+        "-switch N      cases in a switch every 8 functions (default 0)\n"
+        "-chain N       length of the import chain (default 2)\n"
+        "-seed N        random seed (default 1)\n"
+    );
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argv[1][0] == '-') {
+        usage();
+        return 1;
+    }
+    cfg.out = argv[1];
+
+    for (int i = 2; i < argc; i++) {
+        if (i + 1 == argc) {
+            fprintf(stderr, "marsgen: %s needs a value\n", argv[i]);
+            return 1;
+        }
+        int value = atoi(argv[i + 1]);
+        if (strcmp(argv[i], "-files") == 0) cfg.files = value;
+        else if (strcmp(argv[i], "-funcs") == 0) cfg.funcs = value;
+        else if (strcmp(argv[i], "-types") == 0) cfg.types = value;
+        else if (strcmp(argv[i], "-stmts") == 0) cfg.stmts = value;
+        else if (strcmp(argv[i], "-switch") == 0) cfg.switch_cases = value;
+        else if (strcmp(argv[i], "-chain") == 0) cfg.chain = value;
+        else if (strcmp(argv[i], "-seed") == 0) cfg.seed = (unsigned)value;
+        else {
+            fprintf(stderr, "marsgen: unknown option '%s'\n", argv[i]);
+            return 1;
+        }
+        i++;
+    }
+    if (cfg.files < 1) cfg.files = 1;
+    if (cfg.funcs < 1) cfg.funcs = 1;
+    if (cfg.types < 1) cfg.types = 1;
+
+    rng = cfg.seed;
+    for (int file = 0; file < cfg.files; file++) gen_main_file(file);
+    for (int m = 0; m < cfg.chain; m++) gen_chain_module(m);
+    return 0;
+}
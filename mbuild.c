@@ -4,10 +4,14 @@
 #include "src/common/orbit.h"
 #include "src/common/strmap.c"
 #include <time.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/ptrace.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <errno.h>
 
 /* 
-    TODO: ./mars-build iron-dynamic    build iron as a dynamic library 
-
     note: building iron as a static library requires the 'ar' utility,
     which may not be present on non-linux platforms.
 
@@ -77,7 +81,7 @@ char* cflags =
     " -Wno-maybe-uninitialized"
 ;
 char* lflags =
-    " -lm "
+    " -lm -pthread "
 ;
 
 typedef char* cstr;
@@ -102,7 +106,7 @@ BuildFile retrieve_file(char* path) {
         CRASH("stat error");
     }
 
-    f.last_modified = (Timespec){.tv_sec = statbuf.st_mtime};
+    f.last_modified = statbuf.st_mtim;
 
     return f;
 }
@@ -115,21 +119,27 @@ enum {
     BUILD_MODE_MARS,
     BUILD_MODE_IRON_EXE,
     BUILD_MODE_IRON_STATIC,
+    BUILD_MODE_IRON_DYNAMIC,
     BUILD_MODE_FORMAT,
+    BUILD_MODE_BENCH,
 };
 
 void print_usage() {
     printf(
         "./mbuild mars            build mars with iron\n"
         "./mbuild iron            build iron as a standalone application\n"
-        "./mbuild iron-static     build iron as a static library\n"
+        "./mbuild iron-static     build iron as a static library, libiron.a\n"
+        "./mbuild iron-dynamic    build iron as a dynamic library, libiron.so\n"
         "./mbuild format          use clang-format on the whole project. all flags are ignored\n"
+        "./mbuild bench           build mars and the benchmarks, run them and compare against bench/baseline.txt\n"
         "\n"
         "-opt [flags]            set optimization flags (default -O0)\n"
         "-clean                  delete the build folder OR force rebuild from scratch\n"
         "-release                sets -opt \"-O3 -flto\", removes debug info flags\n"
         "-cflags [flags]         add more flags for the c compiler\n"
         "-cc [cc]                specify a c compiler to use (default gcc)\n"
+        "-j [n]                  compile up to n files at once (default: core count, or make's jobserver)\n"
+        "-save-baseline          (bench) write the results to bench/baseline.txt instead of comparing\n"
     );
 }
 
@@ -211,6 +221,11 @@ void ensure_directory(string file) {
 da_typedef(string);
 
 bool should_rebuild_object(string object_path);
+int compile_objects(da(string)* sources, da(string)* objects, bool* needs_to_compile, int how_many);
+int run_benchmarks(string obj_list, bool save_baseline);
+
+// 0 means pick a default, see compile_objects
+int max_jobs = 0;
 
 StrMap file_data = {0};
 
@@ -247,6 +262,7 @@ int main(int argc, char** argv) {
     int build_mode = -1;
     bool clean_build = false;
     bool release_build = false;
+    bool save_baseline = false;
     if (argc <= 1) {
         print_usage();
         return 0;
@@ -268,6 +284,12 @@ int main(int argc, char** argv) {
             build_mode = BUILD_MODE_IRON_EXE;
         } else if (strcmp(arg, "iron-static") == 0) {
             build_mode = BUILD_MODE_IRON_STATIC;
+        } else if (strcmp(arg, "iron-dynamic") == 0) {
+            build_mode = BUILD_MODE_IRON_DYNAMIC;
+        } else if (strcmp(arg, "bench") == 0) {
+            build_mode = BUILD_MODE_BENCH;
+        } else if (strcmp(arg, "-save-baseline") == 0) {
+            save_baseline = true;
         } else if (strcmp(arg, "format") == 0) {
             build_mode = BUILD_MODE_FORMAT;
             break;
@@ -283,6 +305,13 @@ int main(int argc, char** argv) {
         } else if (strcmp(arg, "-cc") == 0) {
             cc = argv[i+1];
             i++;
+        } else if (strcmp(arg, "-j") == 0) {
+            if (i + 1 == argc || atoi(argv[i+1]) < 1) {
+                printf("-j needs a job count\n");
+                exit(-1);
+            }
+            max_jobs = atoi(argv[i+1]);
+            i++;
         } else if (strcmp(arg, "-cflags") == 0) {
             if (i + 1 == argc) {
                 printf("-cflags needs an argument list\n");
@@ -311,12 +340,20 @@ int main(int argc, char** argv) {
         opt = " -O0 ";
     }
 
+    // objects for the shared library have to be position independent,
+    // so they get their own build tree
+    char* build_dir = "build";
+    if (build_mode == BUILD_MODE_IRON_DYNAMIC) {
+        build_dir = "build/pic";
+        cflags = add_cstr(cflags, " -fPIC");
+    }
+
     da(cstr) source_folders = {0};
     da_init(&source_folders, 16);
 
     if (build_mode == BUILD_MODE_FORMAT) {
         add_source_collection(&source_folders, mars_sources, sizeof(mars_sources)/sizeof(mars_sources[0]));
-    } else if (build_mode == BUILD_MODE_MARS) {
+    } else if (build_mode == BUILD_MODE_MARS || build_mode == BUILD_MODE_BENCH) {
         add_source_collection(&source_folders, mars_sources, sizeof(mars_sources)/sizeof(mars_sources[0]));
     } else if (build_mode == BUILD_MODE_IRON_EXE) {
         da_append(&source_folders, realpath("src/iron/driver", NULL));
@@ -334,7 +371,6 @@ int main(int argc, char** argv) {
         return 0;
     }
 
-    da_typedef(string);
     da(string) files_to_compile = {0};
     da_init(&files_to_compile, 16);
 
@@ -364,11 +400,11 @@ int main(int argc, char** argv) {
             // printf("\t"str_fmt"\n", str_arg(subfiles[i].path));
             da_append(&files_to_compile, f.path);
 
-            string obj_path = string_clone(f.path);
-            // crazy shit but i cannot think of a situation where it would not work
-            obj_path.raw += strlen(saved_cwd)-1;
-            obj_path.len -= strlen(saved_cwd)-1;
-            memcpy(obj_path.raw, "build", 5); 
+            // src/x/y.c -> {build_dir}/x/y.o
+            string rel_path = f.path;
+            rel_path.raw += strlen(saved_cwd) + strlen("/src");
+            rel_path.len -= strlen(saved_cwd) + strlen("/src");
+            string obj_path = strprintf("%s"str_fmt, build_dir, str_arg(rel_path));
             obj_path.raw[obj_path.len-1] = 'o';
 
             da_append(&obj_paths, obj_path);
@@ -408,32 +444,8 @@ int main(int argc, char** argv) {
 
     // if (files_to_compile.len == 0) return 0;
 
-    int file_counter = 1;
-    for_range(i, 0, files_to_compile.len) {
-        if (!needs_to_compile[i]) continue;
-        string compile_path = files_to_compile.at[i];
-        string short_compile_path = compile_path;
-        short_compile_path.raw += strlen(saved_cwd)+1;
-        short_compile_path.len -= strlen(saved_cwd)+1;
-
-        ensure_directory(obj_paths.at[i]);
-
-        printf(STYLE_Reset"["STYLE_FG_Green"%d/%d"STYLE_Reset"] compiling "STYLE_Bold str_fmt STYLE_Reset"\n",
-            file_counter++, how_many_to_compile, str_arg(short_compile_path)
-        );
-
-        // we have to actually MAKE THE COMPILER COMMAND LMAO
-        // {cc} {source} -o {output} -MD {cflags}
-        
-        string compile_command = strprintf("%s -c "str_fmt" -o "str_fmt" -Isrc -MD %s %s",
-            cc, str_arg(compile_path), str_arg(obj_paths.at[i]), opt, cflags
-        );
-        int compile_return_code = system(clone_to_cstring(compile_command));
-        if (compile_return_code != 0) return compile_return_code;
-
-        // printstr(compile_command);
-        // printf("\n");
-    }
+    int compile_return_code = compile_objects(&files_to_compile, &obj_paths, needs_to_compile, how_many_to_compile);
+    if (compile_return_code != 0) return compile_return_code;
 
     string obj_list;
     for_range(i, 0, obj_paths.len) {
@@ -450,12 +462,13 @@ int main(int argc, char** argv) {
     }    
 
     switch (build_mode) {
+    case BUILD_MODE_BENCH:
     case BUILD_MODE_MARS: {
         if (!clean_build && how_many_to_compile == 0 && (fs_exists(str("mars")) || fs_exists(str("mars.exe")))) {
             break;
         }
-        string compile_command = strprintf("%s "str_fmt" -o mars %s %s",
-            cc, str_arg(obj_list), opt, cflags
+        string compile_command = strprintf("%s "str_fmt" -o mars %s %s %s",
+            cc, str_arg(obj_list), opt, cflags, lflags
         );
         int compile_return_code = system(clone_to_cstring(compile_command));
         if (compile_return_code != 0) return compile_return_code;
@@ -464,17 +477,39 @@ int main(int argc, char** argv) {
         if (!clean_build && how_many_to_compile == 0 && (fs_exists(str("iron")) || fs_exists(str("iron.exe")))) {
             break;
         }
-        string compile_command = strprintf("%s "str_fmt" -o iron %s %s",
-            cc, str_arg(obj_list), opt, cflags
+        string compile_command = strprintf("%s "str_fmt" -o iron %s %s %s",
+            cc, str_arg(obj_list), opt, cflags, lflags
         );
         int compile_return_code = system(clone_to_cstring(compile_command));
         if (compile_return_code != 0) return compile_return_code;
     } break;
-    case BUILD_MODE_IRON_STATIC:
-        TODO("iron static");
+    case BUILD_MODE_IRON_STATIC: {
+        if (!clean_build && how_many_to_compile == 0 && fs_exists(str("libiron.a"))) {
+            break;
+        }
+        // ar only adds to an existing archive, it never drops members
+        system("rm -f libiron.a");
+        string archive_command = strprintf("ar rcs libiron.a "str_fmt, str_arg(obj_list));
+        int archive_return_code = system(clone_to_cstring(archive_command));
+        if (archive_return_code != 0) return archive_return_code;
+    } break;
+    case BUILD_MODE_IRON_DYNAMIC: {
+        if (!clean_build && how_many_to_compile == 0 && fs_exists(str("libiron.so"))) {
+            break;
+        }
+        string link_command = strprintf("%s -shared "str_fmt" -o libiron.so %s %s %s",
+            cc, str_arg(obj_list), opt, cflags, lflags
+        );
+        int link_return_code = system(clone_to_cstring(link_command));
+        if (link_return_code != 0) return link_return_code;
+    } break;
     default:
         break;
     }
+
+    if (build_mode == BUILD_MODE_BENCH) {
+        return run_benchmarks(obj_list, save_baseline);
+    }
 }
 
 int stringchr(string s, char c) {
@@ -559,4 +594,527 @@ bool should_rebuild_object(string object_path) {
         }
     }
     return false;
-}
\ No newline at end of file
+}
+/*
+    parallel compilation.
+
+    every out of date source gets its own compiler process, up to max_jobs at
+    once. -j sets it, otherwise it's the core count. under make, a jobserver
+    in MAKEFLAGS takes over: we always get one job for free, and every job
+    past that needs a token read from the jobserver, which goes back when
+    the job is done. a make without a jobserver is a serial make, so that
+    means one job at a time.
+
+    each job's output goes to a log next to its object and gets printed in
+    one piece when the job finishes, so diagnostics from different files
+    never interleave. after a failure no new jobs start, but the running ones
+    finish and report, so one build shows every broken file it got to.
+*/
+
+typedef struct Jobserver {
+    int read_fd;  // -1 if there's no jobserver
+    int write_fd;
+} Jobserver;
+
+// the fds make hands down are shared with everyone else using the jobserver,
+// so they can't be made non-blocking. reopening through /proc gets a file
+// description of our own that can be
+static int open_nonblocking(char* path, int flags) {
+    return open(path, flags | O_NONBLOCK | O_CLOEXEC);
+}
+
+// MAKEFLAGS has "--jobserver-auth=R,W" (or "--jobserver-fds=R,W" from older
+// makes), or "--jobserver-auth=fifo:PATH" from make 4.4 on
+Jobserver find_jobserver(bool* under_make) {
+    Jobserver js = {-1, -1};
+    char* makeflags = getenv("MAKEFLAGS");
+    *under_make = makeflags != NULL;
+    if (makeflags == NULL) return js;
+
+    char* auth = NULL;
+    for (char* flag = strstr(makeflags, "--jobserver-"); flag != NULL; flag = strstr(flag + 1, "--jobserver-")) {
+        auth = flag; // the last one wins
+    }
+    if (auth == NULL) return js;
+    auth = strchr(auth, '=');
+    if (auth == NULL) return js;
+    auth++;
+
+    char path[PATH_MAX];
+    int r, w;
+    if (strncmp(auth, "fifo:", 5) == 0) {
+        int len = strcspn(auth + 5, " ");
+        snprintf(path, sizeof(path), "%.*s", len, auth + 5);
+        js.read_fd = open_nonblocking(path, O_RDONLY);
+        js.write_fd = open(path, O_WRONLY | O_CLOEXEC);
+    } else if (sscanf(auth, "%d,%d", &r, &w) == 2) {
+        // make closes these for commands it doesn't think are recursive,
+        // and then they might be anything by now
+        struct stat rs, ws;
+        if (fstat(r, &rs) != 0 || fstat(w, &ws) != 0 || !S_ISFIFO(rs.st_mode) || !S_ISFIFO(ws.st_mode)) {
+            printf(STYLE_FG_Yellow"mbuild: jobserver unavailable, prefix the rule with '+'"STYLE_Reset"\n");
+            return (Jobserver){-1, -1};
+        }
+        snprintf(path, sizeof(path), "/proc/self/fd/%d", r);
+        js.read_fd = open_nonblocking(path, O_RDONLY);
+        js.write_fd = w;
+    }
+    if (js.read_fd == -1 || js.write_fd == -1) return (Jobserver){-1, -1};
+    return js;
+}
+
+bool jobserver_take(Jobserver* js, char* token) {
+    return read(js->read_fd, token, 1) == 1;
+}
+
+void jobserver_give(Jobserver* js, char token) {
+    while (write(js->write_fd, &token, 1) == -1 && errno == EINTR);
+}
+
+typedef struct Job {
+    pid_t pid;
+    int index;     // into the source list
+    char* log_path;
+    bool has_token; // false for the free job
+    char token;
+} Job;
+
+int compile_objects(da(string)* sources, da(string)* objects, bool* needs_to_compile, int how_many) {
+    if (how_many == 0) return 0;
+
+    bool under_make = false;
+    Jobserver js = {-1, -1};
+    int jobs_limit = max_jobs;
+    if (jobs_limit == 0) {
+        js = find_jobserver(&under_make);
+        if (js.read_fd != -1) jobs_limit = how_many; // the tokens are the limit
+        else if (under_make) jobs_limit = 1;
+        else jobs_limit = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (jobs_limit < 1) jobs_limit = 1;
+
+    Job* jobs = malloc(sizeof(Job) * jobs_limit);
+    int running = 0;
+    int next = 0;
+    int finished = 0;
+    int first_failure = 0;
+    int failures = 0;
+
+    while (true) {
+        // start as many as we're allowed
+        bool waiting_for_token = false;
+        while (first_failure == 0 && running < jobs_limit) {
+            while (next < sources->len && !needs_to_compile[next]) next++;
+            if (next == sources->len) break;
+
+            Job job = {.index = next};
+            if (running != 0 && js.read_fd != -1) {
+                if (!jobserver_take(&js, &job.token)) {
+                    waiting_for_token = true;
+                    break;
+                }
+                job.has_token = true;
+            }
+
+            string compile_path = sources->at[next];
+            string obj_path = objects->at[next];
+            ensure_directory(obj_path);
+            job.log_path = clone_to_cstring(strprintf(str_fmt".log", str_arg(obj_path)));
+
+            // we have to actually MAKE THE COMPILER COMMAND LMAO
+            // {cc} {source} -o {output} -MD {cflags}
+            string compile_command = strprintf("exec %s -c "str_fmt" -o "str_fmt" -Isrc -MD %s %s",
+                cc, str_arg(compile_path), str_arg(obj_path), opt, cflags
+            );
+            fflush(stdout);
+            job.pid = fork();
+            if (job.pid == 0) {
+                if (freopen(job.log_path, "w", stdout) == NULL) exit(1);
+                dup2(fileno(stdout), fileno(stderr));
+                execl("/bin/sh", "sh", "-c", clone_to_cstring(compile_command), NULL);
+                exit(1);
+            }
+            if (job.pid < 0) {
+                printf("mbuild: fork failed\n");
+                if (job.has_token) jobserver_give(&js, job.token);
+                first_failure = 1;
+                break;
+            }
+            jobs[running++] = job;
+            next++;
+        }
+
+        if (running == 0) break;
+
+        // wait for a job. if there's work left but no token for it, keep
+        // an eye on the jobserver too
+        int status;
+        pid_t pid;
+        if (waiting_for_token) {
+            struct pollfd pfd = {.fd = js.read_fd, .events = POLLIN};
+            poll(&pfd, 1, 10);
+            pid = waitpid(-1, &status, WNOHANG);
+            if (pid <= 0) continue;
+        } else {
+            pid = waitpid(-1, &status, 0);
+            if (pid < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+        }
+
+        int j = 0;
+        while (j < running && jobs[j].pid != pid) j++;
+        if (j == running) continue; // not one of ours
+        Job job = jobs[j];
+        jobs[j] = jobs[--running];
+        if (job.has_token) jobserver_give(&js, job.token);
+
+        string compile_path = sources->at[job.index];
+        string short_compile_path = compile_path;
+        short_compile_path.raw += strlen(saved_cwd)+1;
+        short_compile_path.len -= strlen(saved_cwd)+1;
+
+        bool failed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+        printf(STYLE_Reset"[%s%d/%d"STYLE_Reset"] %s "STYLE_Bold str_fmt STYLE_Reset"\n",
+            failed ? STYLE_FG_Red : STYLE_FG_Green, ++finished, how_many,
+            failed ? "failed" : "compiled", str_arg(short_compile_path)
+        );
+
+        // the diagnostics, all in one go
+        FILE* log = fopen(job.log_path, "r");
+        if (log != NULL) {
+            char buf[4096];
+            size_t got;
+            while ((got = fread(buf, 1, sizeof(buf), log)) != 0) fwrite(buf, 1, got, stdout);
+            fclose(log);
+        }
+        remove(job.log_path);
+        free(job.log_path);
+
+        if (failed) {
+            failures++;
+            if (first_failure == 0) first_failure = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+        }
+    }
+
+    if (failures != 0) {
+        printf(STYLE_FG_Red STYLE_Bold"%d file%s failed to compile"STYLE_Reset"\n", failures, failures == 1 ? "" : "s");
+    }
+    free(jobs);
+    return first_failure;
+}
+
+/*
+    benchmark harness.
+
+    generates the synthetic corpora with bench/marsgen.c and runs mars over
+    them, then runs bench/irongen.c, which builds iron modules straight
+    through the builder API, and the container microbenchmarks in
+    bench/containers.c. for every run it records the wall time, the peak
+    RSS and the per-stage timings both programs print, and compares them
+    against bench/baseline.txt.
+
+    only compare numbers from the same build flags, the baseline records
+    the ones it was made with.
+*/
+
+typedef struct Benchmark {
+    char* name;
+    char* gen;     // marsgen arguments, NULL if the benchmark has no corpus
+    char* run;     // command, %s is the corpus directory
+} Benchmark;
+
+Benchmark benchmarks[] = {
+    // the checker doesn't scale past these yet
+    {"mars-small",  "-files 1 -funcs 16",              "./mars %s -timings -stop:check"},
+    {"mars-medium", "-files 2 -funcs 32",              "./mars %s -timings -stop:check"},
+    {"mars-deep",   "-files 1 -funcs 8 -types 16 -chain 8", "./mars %s -timings -stop:check"},
+    // switches aren't checked yet, so this one is lexing and parsing only
+    {"mars-switch", "-files 4 -funcs 64 -switch 256",  "./mars %s -timings -stop:parse"},
+    {"iron-small",  NULL,                              "build/bench/irongen -funcs 8"},
+    {"iron-medium", NULL,                              "build/bench/irongen -funcs 32"},
+    {"containers",  NULL,                              "build/bench/containers"},
+};
+
+#define MAX_METRICS 128
+
+// a benchmark result is a list of metrics, "wall" and "rss" and then one per stage
+typedef struct BenchResult {
+    char* name;
+    int len;
+    char* metrics[MAX_METRICS];
+    double values[MAX_METRICS];
+    bool is_time[MAX_METRICS]; // times get the noise floor, counts don't
+} BenchResult;
+
+// only count a regression once it's above this, and for times above the noise floor
+#define REGRESSION_THRESHOLD 0.10
+#define TIME_NOISE_FLOOR     0.02
+
+// every benchmark runs this many times, and the best of each metric is kept
+#define BENCH_RUNS 3
+
+void add_metric(BenchResult* r, char* metric, double value, bool is_time) {
+    for_range(i, 0, r->len) {
+        if (strcmp(r->metrics[i], metric) == 0) {
+            r->values[i] += value;
+            return;
+        }
+    }
+    if (r->len == MAX_METRICS) return;
+    r->metrics[r->len] = strdup(metric);
+    r->values[r->len] = value;
+    r->is_time[r->len] = is_time;
+    r->len++;
+}
+
+// fold another run of the same benchmark into r
+void keep_best(BenchResult* r, BenchResult* run) {
+    for_range(m, 0, run->len) {
+        bool found = false;
+        for_range(i, 0, r->len) {
+            if (strcmp(r->metrics[i], run->metrics[m]) != 0) continue;
+            if (run->values[m] < r->values[i]) r->values[i] = run->values[m];
+            found = true;
+            break;
+        }
+        if (!found) add_metric(r, run->metrics[m], run->values[m], run->is_time[m]);
+    }
+}
+
+// results look like "NAME\t  key       : value", possibly with styling.
+// "time" is recorded as just NAME, anything else as NAME.key
+void parse_stage_timings(BenchResult* r, char* log_path) {
+    FILE* f = fopen(log_path, "r");
+    if (f == NULL) return;
+
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        // strip escape codes
+        char clean[1024];
+        int len = 0;
+        for (char* c = line; *c != '\0'; c++) {
+            if (*c == '\x1b') {
+                while (*c != '\0' && *c != 'm') c++;
+                if (*c == '\0') break;
+                continue;
+            }
+            clean[len++] = *c;
+        }
+        clean[len] = '\0';
+
+        char stage[64], key[32];
+        double value;
+        if (sscanf(clean, "%63s %31s : %lf", stage, key, &value) != 3) continue;
+        if (strcmp(key, "time") == 0) {
+            add_metric(r, stage, value, true);
+        } else {
+            char metric[100];
+            sprintf(metric, "%s.%s", stage, key);
+            add_metric(r, metric, value, false);
+        }
+    }
+    fclose(f);
+}
+
+// peak RSS of a process that hasn't exited yet, in kilobytes
+double peak_rss(pid_t pid) {
+    char path[64];
+    sprintf(path, "/proc/%d/status", pid);
+    FILE* f = fopen(path, "r");
+    if (f == NULL) return 0;
+    char line[256];
+    double kb = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "VmHWM: %lf kB", &kb) == 1) break;
+    }
+    fclose(f);
+    return kb;
+}
+
+// run a command with its output going to log_path, timing it.
+// ru_maxrss carries over from the process we forked from, so the child gets
+// stopped right before it exits and its own high water mark is read instead.
+bool run_benchmark_command(BenchResult* r, char* command, char* log_path) {
+    Timespec start, end;
+    fflush(stdout);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (freopen(log_path, "w", stdout) == NULL) exit(1);
+        dup2(fileno(stdout), fileno(stderr));
+        ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+        // exec so the shell doesn't get measured instead
+        char* exec_command = add_cstr("exec ", command);
+        execl("/bin/sh", "sh", "-c", exec_command, NULL);
+        exit(1);
+    }
+
+    int status = 0;
+    double rss = 0;
+    struct rusage usage = {0};
+    while (wait4(pid, &status, 0, &usage) == pid && WIFSTOPPED(status)) {
+        int sig = WSTOPSIG(status);
+        if (sig == SIGTRAP && (status >> 16) == PTRACE_EVENT_EXIT) {
+            rss = peak_rss(pid);
+            sig = 0;
+        } else if (sig == SIGTRAP) {
+            // stopped on exec
+            ptrace(PTRACE_SETOPTIONS, pid, NULL, (void*)PTRACE_O_TRACEEXIT);
+            sig = 0;
+        }
+        ptrace(PTRACE_CONT, pid, NULL, (void*)(long)sig);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (rss == 0) rss = (double)usage.ru_maxrss;
+
+    add_metric(r, "wall", (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) * 1e-9, true);
+    add_metric(r, "rss", rss, false); // kilobytes
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// baseline lines are "benchmark metric value"
+bool baseline_value(FILE* baseline, char* name, char* metric, double* value) {
+    if (baseline == NULL) return false;
+    rewind(baseline);
+    char line[256], line_name[64], line_metric[64];
+    double line_value;
+    while (fgets(line, sizeof(line), baseline)) {
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%63s %63s %lf", line_name, line_metric, &line_value) != 3) continue;
+        if (strcmp(line_name, name) == 0 && strcmp(line_metric, metric) == 0) {
+            *value = line_value;
+            return true;
+        }
+    }
+    return false;
+}
+
+// the objects in obj_list under a folder, space separated
+string select_objects(string obj_list, char* prefix) {
+    string selected = string_alloc(obj_list.len);
+    selected.len = 0;
+    for (int i = 0; i < obj_list.len;) {
+        int end = i;
+        while (end < obj_list.len && obj_list.raw[end] != ' ') end++;
+        if (end - i > strlen(prefix) && strncmp(&obj_list.raw[i], prefix, strlen(prefix)) == 0) {
+            memcpy(selected.raw + selected.len, &obj_list.raw[i], end - i);
+            selected.len += end - i;
+            selected.raw[selected.len++] = ' ';
+        }
+        i = end + 1;
+    }
+    return selected;
+}
+
+int run_benchmarks(string obj_list, bool save_baseline) {
+    if (!fs_exists(constr("build/bench"))) {
+        mkdir("build/bench");
+    }
+
+    string common_objects = select_objects(obj_list, "build/common/");
+    string iron_objects = select_objects(obj_list, "build/iron/");
+
+    printf(STYLE_Reset"building benchmarks\n");
+    fflush(stdout);
+    string gen_command = strprintf("%s bench/marsgen.c -o build/bench/marsgen -O2", cc);
+    if (system(clone_to_cstring(gen_command)) != 0) return 1;
+    string irongen_command = strprintf("%s bench/irongen.c "str_fmt" "str_fmt" -o build/bench/irongen -Isrc %s %s %s",
+        cc, str_arg(common_objects), str_arg(iron_objects), opt, cflags, lflags
+    );
+    if (system(clone_to_cstring(irongen_command)) != 0) return 1;
+    string containers_command = strprintf("%s bench/containers.c "str_fmt" -o build/bench/containers -Isrc %s %s %s",
+        cc, str_arg(common_objects), opt, cflags, lflags
+    );
+    if (system(clone_to_cstring(containers_command)) != 0) return 1;
+
+    int bench_count = sizeof(benchmarks)/sizeof(benchmarks[0]);
+    BenchResult* results = malloc(sizeof(BenchResult) * bench_count);
+    memset(results, 0, sizeof(BenchResult) * bench_count);
+
+    for_range(i, 0, bench_count) {
+        Benchmark* b = &benchmarks[i];
+        BenchResult* r = &results[i];
+        r->name = b->name;
+
+        printf(STYLE_Reset"["STYLE_FG_Green"%d/%d"STYLE_Reset"] running "STYLE_Bold"%s"STYLE_Reset"\n",
+            (int)i + 1, bench_count, b->name
+        );
+
+        string corpus = strprintf("build/bench/%s/main", b->name);
+        if (b->gen != NULL) {
+            system(clone_to_cstring(strprintf("rm -rf build/bench/%s", b->name)));
+            string command = strprintf("build/bench/marsgen "str_fmt" %s", str_arg(corpus), b->gen);
+            if (system(clone_to_cstring(command)) != 0) return 1;
+        }
+
+        char* log_path = clone_to_cstring(strprintf("build/bench/%s.log", b->name));
+        char* command = clone_to_cstring(strprintf(b->run, clone_to_cstring(corpus)));
+        for_range(run_index, 0, BENCH_RUNS) {
+            BenchResult run = {0};
+            if (!run_benchmark_command(&run, command, log_path)) {
+                printf(STYLE_FG_Red STYLE_Bold"%s failed"STYLE_Reset", see %s\n", b->name, log_path);
+                return 1;
+            }
+            parse_stage_timings(&run, log_path);
+            keep_best(r, &run);
+        }
+    }
+
+    if (save_baseline) {
+        FILE* baseline = fopen("bench/baseline.txt", "w");
+        if (baseline == NULL) {
+            printf("cannot write bench/baseline.txt\n");
+            return 1;
+        }
+        fprintf(baseline, "# generated by ./mbuild bench -save-baseline\n");
+        fprintf(baseline, "# cc: %s, opt: %s\n", cc, opt);
+        for_range(i, 0, bench_count) {
+            for_range(m, 0, results[i].len) {
+                fprintf(baseline, "%s %s %f\n", results[i].name, results[i].metrics[m], results[i].values[m]);
+            }
+        }
+        fclose(baseline);
+        printf("saved bench/baseline.txt\n");
+        return 0;
+    }
+
+    FILE* baseline = fopen("bench/baseline.txt", "r");
+    if (baseline == NULL) {
+        printf("no bench/baseline.txt to compare against, run with -save-baseline to make one\n");
+    }
+
+    int regressions = 0;
+    printf("\n%-14s%-20s%14s%14s%10s\n", "benchmark", "metric", "baseline", "now", "change");
+    for_range(i, 0, bench_count) {
+        BenchResult* r = &results[i];
+        for_range(m, 0, r->len) {
+            double now = r->values[m];
+            double old;
+            if (!baseline_value(baseline, r->name, r->metrics[m], &old)) {
+                printf("%-14s%-20s%14s%14.3f%10s\n", r->name, r->metrics[m], "-", now, "");
+                continue;
+            }
+
+            double change = old == 0 ? 0 : (now - old) / old;
+            bool regressed = change > REGRESSION_THRESHOLD && (!r->is_time[m] || now - old > TIME_NOISE_FLOOR);
+            if (regressed) regressions++;
+
+            printf("%-14s%-20s%14.3f%14.3f", r->name, r->metrics[m], old, now);
+            printf("%s%+9.1f%%"STYLE_Reset"\n", regressed ? STYLE_FG_Red STYLE_Bold : "", change * 100);
+        }
+    }
+    if (baseline != NULL) fclose(baseline);
+
+    if (regressions != 0) {
+        printf("\n"STYLE_FG_Red STYLE_Bold"%d regression%s"STYLE_Reset" against bench/baseline.txt\n",
+            regressions, regressions == 1 ? "" : "s"
+        );
+        return 1;
+    }
+    return 0;
+}
@@ -2,35 +2,39 @@
 #include "common/arena.h"
 #include "common/alloc.h"
 
-_ArenaBlock arena_block_make(size_t size);
-void arena_block_delete(_ArenaBlock* a);
+_ArenaBlock arena_block_make(Arena* al, size_t size);
+void arena_block_delete(Arena* al, _ArenaBlock* a);
 void* arena_block_alloc(_ArenaBlock* a, size_t size, size_t align);
 
 typedef struct _ArenaBlock {
     void* raw;
-    u32 offset;
-    u32 size;
+    size_t offset;
+    size_t size;
 } _ArenaBlock;
 
-_ArenaBlock arena_block_make(size_t size) {
+// each new block is twice the size of the last one, up to this
+#define ARENA_MAX_BLOCK_SIZE ((size_t)1 << 20)
+
+// blocks have to come out zeroed
+_ArenaBlock arena_block_make(Arena* al, size_t size) {
     _ArenaBlock block;
-    block.raw = mars_alloc(size);
+    block.raw = al->alloc(size);
     if (block.raw == NULL) {
         CRASH("internal: arena block size %zu too big, can't allocate", size);
     }
-    block.size = (u32)size;
+    block.size = size;
     block.offset = 0;
     return block;
 }
 
-void arena_block_delete(_ArenaBlock* block) {
-    mars_free(block->raw);
+void arena_block_delete(Arena* al, _ArenaBlock* block) {
+    al->free(block->raw);
     *block = (_ArenaBlock){0};
 }
 
 void* arena_block_alloc(_ArenaBlock* block, size_t size, size_t align) {
-    u32 offset = block->offset;
-    u32 new_offset = align_forward(block->offset, align) + size;
+    size_t offset = block->offset;
+    size_t new_offset = align_forward(block->offset, align) + size;
     if (new_offset > block->size) {
         return NULL;
     }
@@ -39,11 +43,19 @@ void* arena_block_alloc(_ArenaBlock* block, size_t size, size_t align) {
 }
 
 Arena arena_make(size_t block_size) {
+    return arena_make_using(block_size, mars_alloc, mars_free);
+}
+
+Arena arena_make_using(size_t block_size, void* (*alloc)(size_t), void (*free)(void*)) {
     Arena al;
     da_init(&al.list, 1);
+    da_init(&al.large, 1);
+    al.top = 0;
     al.arena_size = block_size;
+    al.alloc = alloc;
+    al.free = free;
 
-    _ArenaBlock initial_arena = arena_block_make(al.arena_size);
+    _ArenaBlock initial_arena = arena_block_make(&al, al.arena_size);
     da_append(&al.list, initial_arena);
 
     return al;
@@ -51,24 +63,77 @@ Arena arena_make(size_t block_size) {
 
 void arena_delete(Arena* al) {
     for_urange(i, 0, (al->list.len)) {
-        arena_block_delete(&al->list.at[i]);
+        arena_block_delete(al, &al->list.at[i]);
+    }
+    for_urange(i, 0, (al->large.len)) {
+        arena_block_delete(al, &al->large.at[i]);
     }
     da_destroy(&al->list);
+    da_destroy(&al->large);
     *al = (Arena){0};
 }
 
 void* arena_alloc(Arena* al, size_t size, size_t align) {
     // attempt to allocate at the top arena_block;
-    void* attempt = arena_block_alloc(&al->list.at[al->list.len - 1], size, align);
+    void* attempt = arena_block_alloc(&al->list.at[al->top], size, align);
     if (attempt != NULL) return attempt; // yay!
 
-    // FUCK! we need to append another arena_block block
-    _ArenaBlock new_arena = arena_block_make(al->arena_size);
-    da_append(&al->list, new_arena);
+    // too big for any block, give it one of its own
+    if (size + align > al->arena_size) {
+        _ArenaBlock large = arena_block_make(al, size + align);
+        void* ptr = arena_block_alloc(&large, size, align);
+        da_append(&al->large, large);
+        return ptr;
+    }
+
+    // FUCK! we need another arena_block block. reuse one if there's one left over
+    al->top++;
+    if (al->top == al->list.len) {
+        size_t last_size = al->list.at[al->top - 1].size;
+        size_t block_size = max(al->arena_size, min(last_size * 2, ARENA_MAX_BLOCK_SIZE));
+        _ArenaBlock new_arena = arena_block_make(al, block_size);
+        da_append(&al->list, new_arena);
+    }
+    al->list.at[al->top].offset = 0;
+
+    // we're gonna try again. every block is at least arena_size, so this can't fail
+    return arena_block_alloc(&al->list.at[al->top], size, align);
+}
+
+ArenaMark arena_mark(Arena* al) {
+    return (ArenaMark){
+        .block = al->top,
+        .offset = al->list.at[al->top].offset,
+        .large = al->large.len,
+    };
+}
+
+// blocks are kept for reuse, large allocations are freed
+void arena_release(Arena* al, ArenaMark mark) {
+    al->top = mark.block;
+    al->list.at[al->top].offset = mark.offset;
+    while (al->large.len > mark.large) {
+        arena_block_delete(al, &al->large.at[al->large.len - 1]);
+        al->large.len--;
+    }
+}
+
+void arena_reset(Arena* al) {
+    arena_release(al, (ArenaMark){0});
+}
+
+size_t arena_used(Arena* al) {
+    size_t used = 0;
+    for_urange(i, 0, al->top + 1) used += al->list.at[i].offset;
+    for_urange(i, 0, al->large.len) used += al->large.at[i].offset;
+    return used;
+}
 
-    // we're gonna try again
-    attempt = arena_block_alloc(&al->list.at[al->list.len - 1], size, align);
-    return attempt; // this should ideally never be null
+size_t arena_reserved(Arena* al) {
+    size_t reserved = 0;
+    for_urange(i, 0, al->list.len) reserved += al->list.at[i].size;
+    for_urange(i, 0, al->large.len) reserved += al->large.at[i].size;
+    return reserved;
 }
 
 size_t align_forward(size_t ptr, size_t align) {
@@ -11,11 +11,38 @@ da_typedef(_ArenaBlock);
 
 typedef struct Arena {
     da(_ArenaBlock) list;
-    u32 arena_size;
+    // allocations too big for a block get their own, kept apart so they
+    // don't leave the rest of the current block unused
+    da(_ArenaBlock) large;
+    // the block currently being allocated from. blocks past it are
+    // left over from before a reset or release, and get reused
+    usize top;
+    size_t arena_size;
+    // where blocks come from. mars_alloc and mars_free unless
+    // the arena was made with arena_make_using
+    void* (*alloc)(size_t);
+    void (*free)(void*);
 } Arena;
 
+// a saved position in an arena, arena_release frees everything allocated since
+typedef struct ArenaMark {
+    usize block;
+    size_t offset;
+    usize large;
+} ArenaMark;
+
 Arena arena_make(size_t size);
+Arena arena_make_using(size_t size, void* (*alloc)(size_t), void (*free)(void*));
 void arena_delete(Arena* al);
 void* arena_alloc(Arena* al, size_t size, size_t align);
 
+// memory handed out again after a release or reset isn't zeroed
+ArenaMark arena_mark(Arena* al);
+void arena_release(Arena* al, ArenaMark mark);
+void arena_reset(Arena* al);
+
+// bytes handed out, and bytes held from the system
+size_t arena_used(Arena* al);
+size_t arena_reserved(Arena* al);
+
 size_t align_forward(size_t ptr, size_t align);
\ No newline at end of file
@@ -1,6 +1,17 @@
 #include "crash.h"
 #include "orbit.h"
 
+#ifndef __WIN32__
+_Thread_local sigjmp_buf* crash_recovery = NULL;
+#endif
+
+noreturn void crash_exit(int status) {
+#ifndef __WIN32__
+    if (crash_recovery != NULL) siglongjmp(*crash_recovery, status == 0 ? 1 : status);
+#endif
+    exit(status);
+}
+
 void crash(char* error, ...) {
     printf("INTERNAL COMPILER ERROR: ");
     va_list args;
@@ -36,7 +47,7 @@ void crash(char* error, ...) {
 
     free(strings); // this is partially unsafe?
 #endif
-    exit(-1); // lmao
+    crash_exit(-1); // lmao
 }
 
 #ifndef __WIN32__
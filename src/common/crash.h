@@ -4,9 +4,18 @@
 #    include <execinfo.h>
 #    include <signal.h>
 #    include <errno.h>
+#    include <setjmp.h>
 
 void signal_handler(int sig, siginfo_t* info, void* ucontext);
 void init_signal_handler();
+
+// if set, crashes and errors jump here instead of exiting. one per thread,
+// the compile server uses this to outlive a bad build, and checker threads to
+// hand their errors back to the main thread
+extern _Thread_local sigjmp_buf* crash_recovery;
 #endif
 
-void crash(char* error, ...);
\ No newline at end of file
+void crash(char* error, ...);
+
+// exit(status), unless something is waiting on crash_recovery
+_Noreturn void crash_exit(int status);
\ No newline at end of file
@@ -6,6 +6,13 @@
 // lean and mean w/ new functions
 // all the functions are now macros, inspired by mista zozin himself (https://github.com/tsoding)
 
+// what the macros allocate with. define these before including orbit to swap them out
+#ifndef da_malloc
+#    define da_malloc malloc
+#    define da_realloc realloc
+#    define da_free free
+#endif
+
 #define da(type) da_##type
 
 #define da_typedef(type) typedef struct da_##type { \
@@ -21,7 +28,7 @@
     if ((capacity) <= 0) c = 1; \
     (da_ptr)->len = 0; \
     (da_ptr)->cap = c; \
-    (da_ptr)->at = malloc(sizeof((da_ptr)->at[0]) * c); \
+    (da_ptr)->at = da_malloc(sizeof((da_ptr)->at[0]) * c); \
     if ((da_ptr)->at == NULL) { \
         printf("(%s:%d) da_init malloc failed for capacity %zu", (__FILE__), (__LINE__), c); \
         exit(1); \
@@ -31,7 +38,7 @@
 #define da_append(da_ptr, element) do { \
     if ((da_ptr)->len == (da_ptr)->cap) { \
         (da_ptr)->cap *= 2; \
-        (da_ptr)->at = realloc((da_ptr)->at, sizeof(*(da_ptr)->at) * (da_ptr)->cap); \
+        (da_ptr)->at = da_realloc((da_ptr)->at, sizeof(*(da_ptr)->at) * (da_ptr)->cap); \
         if ((da_ptr)->at == NULL) { \
             printf("(%s:%d) da_append realloc failed for capacity %zu", (__FILE__), (__LINE__), (da_ptr)->cap); \
             exit(1); \
@@ -43,7 +50,7 @@
 #define da_shrink(da_ptr) do { \
     if ((da_ptr)->len == (da_ptr)->cap) break; \
     (da_ptr)->cap = (da_ptr)->len; \
-    (da_ptr)->at = realloc((da_ptr)->at, sizeof((da_ptr)->at[0]) * (da_ptr)->cap); \
+    (da_ptr)->at = da_realloc((da_ptr)->at, sizeof((da_ptr)->at[0]) * (da_ptr)->cap); \
     if ((da_ptr)->at == NULL) { \
         printf("(%s:%d) da_init realloc failed for capacity %zu", (__FILE__), (__LINE__), (da_ptr)->cap); \
         exit(1); \
@@ -53,7 +60,7 @@
 #define da_reserve(da_ptr, num_slots) do { \
     if ((da_ptr)->len + num_slots >= (da_ptr)->cap) {\
         (da_ptr)->cap += (da_ptr)->len + num_slots; \
-        (da_ptr)->at = realloc((da_ptr)->at, sizeof(*(da_ptr)->at) * (da_ptr)->cap); \
+        (da_ptr)->at = da_realloc((da_ptr)->at, sizeof(*(da_ptr)->at) * (da_ptr)->cap); \
         if ((da_ptr)->at == NULL) { \
             printf("(%s:%d) da_reserve realloc failed for capacity %zu", (__FILE__), (__LINE__), (da_ptr)->cap); \
             exit(1); \
@@ -72,7 +79,7 @@
 
 #define da_destroy(da_ptr) do { \
     if ((da_ptr)->at == NULL) break; \
-    free((da_ptr)->at); \
+    da_free((da_ptr)->at); \
     (da_ptr)->at = NULL; \
     (da_ptr)->len = 0;\
     (da_ptr)->cap = 0;\
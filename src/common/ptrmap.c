@@ -1,23 +1,28 @@
 #include "common/ptrmap.h"
 
-#define MAX_SEARCH 30
+// grow once the map is 3/4 full
+#define MAX_LOAD(cap) ((cap) / 4 * 3)
 
+// keys looked up together by ptrmap_get_many
+#define GET_MANY_BATCH 16
+
+// fibonacci hashing: one multiply by 2^64/phi, and the home slot is the top
+// bits of the product. evenly spaced keys (like nodes out of an arena) come out
+// spread better than random. the low 4 bits are dropped first since they're
+// almost always zero, and leaving them in makes some strides clump up.
 size_t hashfunc(void* key) {
-    size_t hash = 5381;
-    size_t k = (size_t)key;
-    hash = ((hash << 5) + hash) + ((k >> 0) & 0xFF);
-    hash = ((hash << 5) + hash) + ((k >> 8) & 0xFF);
-    hash = ((hash << 5) + hash) + ((k >> 16) & 0xFF);
-    hash = ((hash << 5) + hash) + ((k >> 24) & 0xFF);
-    hash = ((hash << 5) + hash) + ((k >> 32) & 0xFF);
-    hash = ((hash << 5) + hash) + ((k >> 40) & 0xFF);
-    hash = ((hash << 5) + hash) + ((k >> 48) & 0xFF);
-    hash = ((hash << 5) + hash) + ((k >> 56) & 0xFF);
-    return hash;
+    return (size_t)(((u64)key >> 4) * 11400714819323198485ull);
 }
 
+#define home_slot(hm, key) (hashfunc(key) >> (64 - __builtin_ctzll((hm)->cap)))
+
+// how far the entry in slot i is from where it wants to be
+#define probe_distance(hm, i) (((i) - home_slot(hm, (hm)->keys[i])) & ((hm)->cap - 1))
+
 void ptrmap_init(PtrMap* hm, size_t capacity) {
-    hm->cap = capacity;
+    hm->cap = 8;
+    while (hm->cap < capacity) hm->cap *= 2;
+    hm->len = 0;
     hm->vals = mars_alloc(sizeof(hm->vals[0]) * hm->cap);
     hm->keys = mars_alloc(sizeof(hm->keys[0]) * hm->cap);
 }
@@ -28,88 +33,127 @@ void ptrmap_destroy(PtrMap* hm) {
     *hm = (PtrMap){0};
 }
 
-void ptrmap_put(PtrMap* hm, void* key, void* val) {
-    if (!key) return;
-    size_t hash_index = hashfunc(key) % hm->cap;
-
-    // mars_free slot
-    if (hm->keys[hash_index] == NULL || hm->keys[hash_index] == key) {
-        hm->keys[hash_index] = key;
-        hm->vals[hash_index] = val;
-        return;
-    }
-
-    // search for nearby mars_free slot
-    for_urange(index, 1, min(MAX_SEARCH, hm->cap)) {
-        size_t i = (index + hash_index) % hm->cap;
-        if ((hm->keys[i] == NULL) || hm->keys[hash_index] == key) {
+static void insert(PtrMap* hm, void* key, void* val) {
+    size_t mask = hm->cap - 1;
+    size_t i = home_slot(hm, key);
+    size_t dist = 0;
+    while (true) {
+        if (hm->keys[i] == NULL) {
             hm->keys[i] = key;
+            hm->vals[i] = val;
+            hm->len++;
+            return;
+        }
+        if (hm->keys[i] == key) {
             hm->vals[i] = val;
             return;
         }
+
+        // take the slot from anything closer to home than we are,
+        // and carry on inserting what was there
+        size_t existing = probe_distance(hm, i);
+        if (existing < dist) {
+            void* tmp_key = hm->keys[i];
+            void* tmp_val = hm->vals[i];
+            hm->keys[i] = key;
+            hm->vals[i] = val;
+            key = tmp_key;
+            val = tmp_val;
+            dist = existing;
+        }
+
+        i = (i + 1) & mask;
+        dist++;
     }
+}
 
-    // we gotta resize
+static void grow(PtrMap* hm) {
     PtrMap new_hm;
     ptrmap_init(&new_hm, hm->cap * 2);
 
-    // copy all the old entries into the new hasptrmap
-    for (size_t i = 0; i < hm->cap; i++) {
+    for_urange(i, 0, hm->cap) {
         if (hm->keys[i] == NULL) continue;
-        ptrmap_put(&new_hm, hm->keys[i], hm->vals[i]);
+        insert(&new_hm, hm->keys[i], hm->vals[i]);
     }
-    ptrmap_put(&new_hm, key, val);
 
-    // destroy old map
-    mars_free(hm->keys);
-    mars_free(hm->vals);
+    ptrmap_destroy(hm);
     *hm = new_hm;
 }
 
-void* ptrmap_get(PtrMap* hm, void* key) {
-    if (!key) return PTRMAP_NOT_FOUND;
-    size_t hash_index = hashfunc(key) % hm->cap;
-
-    // key found in first slot
-    if (hm->keys[hash_index] == key) {
-        return hm->vals[hash_index];
-    }
+void ptrmap_put(PtrMap* hm, void* key, void* val) {
+    if (!key) return;
+    if (hm->len + 1 > MAX_LOAD(hm->cap)) grow(hm);
+    insert(hm, key, val);
+}
 
-    // linear search next slots
-    for_urange(index, 1, min(MAX_SEARCH, hm->cap)) {
-        size_t i = (index + hash_index) % hm->cap;
-        if (hm->keys[i] == NULL) return PTRMAP_NOT_FOUND;
-        if (hm->keys[i] == key) return hm->vals[i];
+// slot index of key, or -1. i is the key's home slot
+static isize find_from(PtrMap* hm, void* key, size_t i) {
+    size_t mask = hm->cap - 1;
+    size_t dist = 0;
+    while (true) {
+        if (hm->keys[i] == key) return i;
+        if (hm->keys[i] == NULL) return -1;
+        // anything we'd have found is closer to home than this
+        if (probe_distance(hm, i) < dist) return -1;
+
+        i = (i + 1) & mask;
+        dist++;
     }
-
-    return PTRMAP_NOT_FOUND;
 }
 
-void ptrmap_remove(PtrMap* hm, void* key) {
-    if (!key) return;
+static isize find(PtrMap* hm, void* key) {
+    return find_from(hm, key, home_slot(hm, key));
+}
 
-    size_t hash_index = hashfunc(key) % hm->cap;
+void* ptrmap_get(PtrMap* hm, void* key) {
+    if (!key) return PTRMAP_NOT_FOUND;
+    isize i = find(hm, key);
+    if (i == -1) return PTRMAP_NOT_FOUND;
+    return hm->vals[i];
+}
 
-    // key found in first slot
-    if (hm->keys[hash_index] == key) {
-        hm->keys[hash_index] = NULL;
-        hm->vals[hash_index] = NULL;
-        return;
+// look up count keys at once, writing the results to vals. the home slots of
+// a whole batch get worked out and prefetched first, so the cache misses
+// overlap instead of happening one after another.
+void ptrmap_get_many(PtrMap* hm, void** keys, void** vals, size_t count) {
+    size_t slots[GET_MANY_BATCH];
+    for (size_t base = 0; base < count; base += GET_MANY_BATCH) {
+        size_t batch = min(GET_MANY_BATCH, count - base);
+        for_urange(j, 0, batch) {
+            slots[j] = home_slot(hm, keys[base + j]);
+            __builtin_prefetch(&hm->keys[slots[j]]);
+            __builtin_prefetch(&hm->vals[slots[j]]);
+        }
+        for_urange(j, 0, batch) {
+            void* key = keys[base + j];
+            isize i = key == NULL ? -1 : find_from(hm, key, slots[j]);
+            vals[base + j] = i == -1 ? PTRMAP_NOT_FOUND : hm->vals[i];
+        }
     }
+}
 
-    // linear search next slots
-    for_urange(index, 1, min(MAX_SEARCH, hm->cap)) {
-        size_t i = (index + hash_index) % hm->cap;
-        if (hm->keys[i] == NULL) return;
-        if (hm->keys[hash_index] == key) {
-            hm->keys[hash_index] = NULL;
-            hm->vals[hash_index] = NULL;
-            return;
-        }
+void ptrmap_remove(PtrMap* hm, void* key) {
+    if (!key) return;
+    isize found = find(hm, key);
+    if (found == -1) return;
+
+    // shift the following entries back instead of leaving a tombstone
+    size_t mask = hm->cap - 1;
+    size_t i = found;
+    size_t next = (i + 1) & mask;
+    while (hm->keys[next] != NULL && probe_distance(hm, next) != 0) {
+        hm->keys[i] = hm->keys[next];
+        hm->vals[i] = hm->vals[next];
+        i = next;
+        next = (next + 1) & mask;
     }
+    hm->keys[i] = NULL;
+    hm->vals[i] = NULL;
+    hm->len--;
 }
 
 void ptrmap_reset(PtrMap* hm) {
     memset(hm->vals, 0, sizeof(hm->vals[0]) * hm->cap);
     memset(hm->keys, 0, sizeof(hm->keys[0]) * hm->cap);
-}
\ No newline at end of file
+    hm->len = 0;
+}
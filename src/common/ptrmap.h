@@ -2,6 +2,9 @@
 #define PTRMAP_H
 
 // ptrmap associates a void* with another void*.
+// robin hood hashing with backward-shift deletion, same as strmap. hashing
+// a pointer is as cheap as loading a cached hash, so nothing is cached, and
+// a NULL key marks an empty slot.
 
 #include "common/orbit.h"
 #include "common/alloc.h"
@@ -9,7 +12,8 @@
 typedef struct PtrMap {
     void** keys;
     void** vals;
-    size_t cap; // capacity
+    size_t cap; // capacity, always a power of two
+    size_t len; // number of entries
 } PtrMap;
 
 #define PTRMAP_NOT_FOUND ((void*)0xDEADBEEFDEADBEEF)
@@ -21,4 +25,5 @@ void ptrmap_reset(PtrMap* hm);
 void ptrmap_destroy(PtrMap* hm);
 void ptrmap_put(PtrMap* hm, void* key, void* val);
 void ptrmap_remove(PtrMap* hm, void* key);
-void* ptrmap_get(PtrMap* hm, void* key);
\ No newline at end of file
+void* ptrmap_get(PtrMap* hm, void* key);
+void ptrmap_get_many(PtrMap* hm, void** keys, void** vals, size_t count);
@@ -1,8 +1,9 @@
 #include "common/strmap.h"
 
-#define MAX_SEARCH 30
+// grow once the map is 3/4 full
+#define MAX_LOAD(cap) ((cap) / 4 * 3)
 
-static u64 FNV_1a(string key) {
+u64 FNV_1a(string key) {
     const u64 FNV_OFFSET = 14695981039346656037ull;
     const u64 FNV_PRIME = 1099511628211ull;
 
@@ -14,102 +15,142 @@ static u64 FNV_1a(string key) {
     return hash;
 }
 
+// 0 means empty, so real hashes never are
+static u64 strmap_hash(string key) {
+    u64 hash = FNV_1a(key);
+    return hash == 0 ? 1 : hash;
+}
+
+// how far the entry in slot i is from where it wants to be
+#define probe_distance(hm, i) (((i) - ((hm)->hashes[i] & ((hm)->cap - 1))) & ((hm)->cap - 1))
+
 void strmap_init(StrMap* hm, size_t capacity) {
-    hm->cap = capacity;
+    hm->cap = 8;
+    while (hm->cap < capacity) hm->cap *= 2;
+    hm->len = 0;
     hm->vals = malloc(sizeof(hm->vals[0]) * hm->cap);
     hm->keys = malloc(sizeof(hm->keys[0]) * hm->cap);
+    hm->hashes = malloc(sizeof(hm->hashes[0]) * hm->cap);
     memset(hm->vals, 0, sizeof(hm->vals[0]) * hm->cap);
     memset(hm->keys, 0, sizeof(hm->keys[0]) * hm->cap);
+    memset(hm->hashes, 0, sizeof(hm->hashes[0]) * hm->cap);
 }
 
 void strmap_destroy(StrMap* hm) {
     if (hm->keys) free(hm->keys);
     if (hm->vals) free(hm->vals);
+    if (hm->hashes) free(hm->hashes);
     *hm = (StrMap){0};
 }
 
-void strmap_put(StrMap* hm, string key, void* val) {
-    if (hm == NULL) return;
-    if (is_null_str(key)) return;
-    size_t hash_index = FNV_1a(key) % hm->cap;
-
-    // free slot
-    if (hm->keys[hash_index].raw == NULL || string_eq(hm->keys[hash_index], key)) {
-        hm->keys[hash_index] = key;
-        hm->vals[hash_index] = val;
-        return;
-    }
-
-    // search for nearby free slot
-    for_urange(index, 1, min(MAX_SEARCH, hm->cap)) {
-        size_t i = (index + hash_index) % hm->cap;
-        if ((hm->keys[i].raw == NULL) || string_eq(hm->keys[i], key)) {
+static void insert_hashed(StrMap* hm, u64 hash, string key, void* val) {
+    size_t mask = hm->cap - 1;
+    size_t i = hash & mask;
+    size_t dist = 0;
+    while (true) {
+        if (hm->hashes[i] == 0) {
+            hm->hashes[i] = hash;
             hm->keys[i] = key;
             hm->vals[i] = val;
+            hm->len++;
             return;
         }
+        if (hm->hashes[i] == hash && string_eq(hm->keys[i], key)) {
+            hm->vals[i] = val;
+            return;
+        }
+
+        // take the slot from anything closer to home than we are,
+        // and carry on inserting what was there
+        size_t existing = probe_distance(hm, i);
+        if (existing < dist) {
+            u64 tmp_hash = hm->hashes[i];
+            string tmp_key = hm->keys[i];
+            void* tmp_val = hm->vals[i];
+            hm->hashes[i] = hash;
+            hm->keys[i] = key;
+            hm->vals[i] = val;
+            hash = tmp_hash;
+            key = tmp_key;
+            val = tmp_val;
+            dist = existing;
+        }
+
+        i = (i + 1) & mask;
+        dist++;
     }
+}
 
-    // we gotta resize
+static void grow(StrMap* hm) {
     StrMap new_hm;
     strmap_init(&new_hm, hm->cap * 2);
 
-    // copy all the old entries into the new hashmap
-    for (size_t i = 0; i < hm->cap; i++) {
-        if (hm->keys[i].raw == NULL) continue;
-        strmap_put(&new_hm, hm->keys[i], hm->vals[i]);
+    // hashes are cached, so nothing gets rehashed
+    for_urange(i, 0, hm->cap) {
+        if (hm->hashes[i] == 0) continue;
+        insert_hashed(&new_hm, hm->hashes[i], hm->keys[i], hm->vals[i]);
     }
-    strmap_put(&new_hm, key, val);
 
-    // destroy old map
-    free(hm->keys);
-    free(hm->vals);
+    strmap_destroy(hm);
     *hm = new_hm;
 }
 
-void* strmap_get(StrMap* hm, string key) {
-    if (!key.raw) return STRMAP_NOT_FOUND;
-    size_t hash_index = FNV_1a(key) % hm->cap;
-
-    // key found in first slot
-    if (string_eq(hm->keys[hash_index], key)) {
-        return hm->vals[hash_index];
-    }
+void strmap_put(StrMap* hm, string key, void* val) {
+    if (hm == NULL) return;
+    if (is_null_str(key)) return;
+    if (hm->len + 1 > MAX_LOAD(hm->cap)) grow(hm);
+    insert_hashed(hm, strmap_hash(key), key, val);
+}
 
-    // linear search next slots
-    for_urange(index, 1, min(MAX_SEARCH, hm->cap)) {
-        size_t i = (index + hash_index) % hm->cap;
-        if (hm->keys[i].raw == NULL) return STRMAP_NOT_FOUND;
-        if (string_eq(hm->keys[i], key)) return hm->vals[i];
+// slot index of key, or -1
+static isize find(StrMap* hm, string key) {
+    u64 hash = strmap_hash(key);
+    size_t mask = hm->cap - 1;
+    size_t i = hash & mask;
+    size_t dist = 0;
+    while (true) {
+        if (hm->hashes[i] == 0) return -1;
+        // anything we'd have found is closer to home than this
+        if (probe_distance(hm, i) < dist) return -1;
+        if (hm->hashes[i] == hash && string_eq(hm->keys[i], key)) return i;
+
+        i = (i + 1) & mask;
+        dist++;
     }
+}
 
-    return STRMAP_NOT_FOUND;
+void* strmap_get(StrMap* hm, string key) {
+    if (!key.raw) return STRMAP_NOT_FOUND;
+    isize i = find(hm, key);
+    if (i == -1) return STRMAP_NOT_FOUND;
+    return hm->vals[i];
 }
 
 void strmap_remove(StrMap* hm, string key) {
     if (!key.raw) return;
-    size_t hash_index = FNV_1a(key) % hm->cap;
-
-    // key found in first slot
-    if (string_eq(hm->keys[hash_index], key)) {
-        hm->keys[hash_index] = NULL_STR;
-        hm->vals[hash_index] = NULL;
-        return;
-    }
-
-    // linear search next slots
-    for_urange(index, 1, min(MAX_SEARCH, hm->cap)) {
-        size_t i = (index + hash_index) % hm->cap;
-        if (hm->keys[i].raw == NULL) return;
-        if (string_eq(hm->keys[i], key)) {
-            hm->keys[hash_index] = NULL_STR;
-            hm->vals[hash_index] = NULL;
-            return;
-        }
+    isize found = find(hm, key);
+    if (found == -1) return;
+
+    // shift the following entries back instead of leaving a tombstone
+    size_t mask = hm->cap - 1;
+    size_t i = found;
+    size_t next = (i + 1) & mask;
+    while (hm->hashes[next] != 0 && probe_distance(hm, next) != 0) {
+        hm->hashes[i] = hm->hashes[next];
+        hm->keys[i] = hm->keys[next];
+        hm->vals[i] = hm->vals[next];
+        i = next;
+        next = (next + 1) & mask;
     }
+    hm->hashes[i] = 0;
+    hm->keys[i] = NULL_STR;
+    hm->vals[i] = NULL;
+    hm->len--;
 }
 
 void strmap_reset(StrMap* hm) {
     memset(hm->vals, 0, sizeof(hm->vals[0]) * hm->cap);
     memset(hm->keys, 0, sizeof(hm->keys[0]) * hm->cap);
-}
\ No newline at end of file
+    memset(hm->hashes, 0, sizeof(hm->hashes[0]) * hm->cap);
+    hm->len = 0;
+}
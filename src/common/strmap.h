@@ -3,18 +3,24 @@
 #include "common/orbit.h"
 
 // strmap associates a string value with a void*.
+// robin hood hashing with backward-shift deletion. hashes are cached
+// next to the keys, a hash of 0 marks an empty slot.
 
 typedef struct StrMap {
     string* keys;
     void** vals;
-    size_t cap; // capacity
+    u64* hashes;
+    size_t cap; // capacity, always a power of two
+    size_t len; // number of entries
 } StrMap;
 
 #define STRMAP_NOT_FOUND ((void*)0xDEADBEEF)
 
+u64 FNV_1a(string key);
+
 void strmap_init(StrMap* sm, size_t capacity);
 void strmap_reset(StrMap* sm);
 void strmap_destroy(StrMap* sm);
 void strmap_put(StrMap* sm, string key, void* val);
 void strmap_remove(StrMap* sm, string key);
-void* strmap_get(StrMap* sm, string key);
\ No newline at end of file
+void* strmap_get(StrMap* sm, string key);
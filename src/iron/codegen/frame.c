@@ -0,0 +1,199 @@
+#include "mach.h"
+#include "common/ptrmap.h"
+
+/*
+    frame layout runs after regalloc, once every spill slot exists.
+
+    each slot a function references gets a live range, from its first reference
+    to its last, stretched over any loop it overlaps (the value might have to
+    survive the trip around the back edge). slots whose address escapes are live
+    for the whole function.
+
+    slots are sorted by alignment, biggest first, so laying them out back to back
+    never needs padding. they are then packed greedily into cells: a slot goes into
+    the first cell that is big enough and whose occupants are never live at the
+    same time as it, otherwise it gets a new cell.
+*/
+
+typedef struct SlotRange {
+    u32 slot;
+    u32 from; // inclusive
+    u32 to;   // exclusive
+    u32 cell;
+    u32 next; // next range in the same cell, or UINT32_MAX
+} SlotRange;
+
+typedef struct BackEdge {
+    u32 target; // position of the label jumped to
+    u32 source; // one past the jump
+} BackEdge;
+
+typedef struct FrameCell {
+    u32 size;
+    u16 align;
+    i32 offset;
+    u32 first; // first range in this cell
+} FrameCell;
+
+da_typedef(SlotRange);
+da_typedef(BackEdge);
+da_typedef(FrameCell);
+
+static PtrMap slot_ranges;     // slot index -> index into ranges
+static PtrMap label_positions; // FeMachLocalLabel* -> position in the buffer
+static FeMachBuffer* sorting_buf;
+
+static int compare_slot_ranges(const void* a, const void* b) {
+    const FeMachStackSlot* x = &sorting_buf->slots.at[((const SlotRange*)a)->slot];
+    const FeMachStackSlot* y = &sorting_buf->slots.at[((const SlotRange*)b)->slot];
+    if (x->align != y->align) return x->align > y->align ? -1 : 1;
+    if (x->size != y->size) return x->size > y->size ? -1 : 1;
+    return (int)((const SlotRange*)a)->from - (int)((const SlotRange*)b)->from;
+}
+
+static bool slot_ranges_overlap(SlotRange* x, SlotRange* y) {
+    return x->from < y->to && y->from < x->to;
+}
+
+// find the live ranges of every slot referenced between begin and end
+static void find_slot_ranges(FeMachBuffer* buf, u32 begin, u32 end, da(SlotRange)* ranges) {
+    const FeMachInstTemplate* templates = buf->target.inst_templates;
+
+    for_range(here, begin, end) {
+        FeMach* elem = buf->buf.at[here];
+        if (elem->kind == FE_MACH_LABEL_LOCAL) {
+            ptrmap_put(&label_positions, elem, (void*)(u64)here);
+            continue;
+        }
+        if (elem->kind != FE_MACH_INST) continue;
+
+        FeMachInst* inst = (FeMachInst*)elem;
+        for_range(i, 0, templates[inst->template].imms_len) {
+            FeMachImmediate* imm = &buf->immediates.at[inst->imms + i];
+            if (imm->kind != FE_MACH_IMM_SLOT) continue;
+
+            void* index = ptrmap_get(&slot_ranges, (void*)(u64)imm->slot.index);
+            if (index != PTRMAP_NOT_FOUND) {
+                ranges->at[(u64)index].to = here + 1;
+                continue;
+            }
+            SlotRange range = {.slot = imm->slot.index, .from = here, .to = here + 1};
+            if (buf->slots.at[range.slot].escapes) {
+                range.from = begin;
+                range.to = end;
+            }
+            ptrmap_put(&slot_ranges, (void*)(u64)range.slot, (void*)(u64)ranges->len);
+            da_append(ranges, range);
+        }
+    }
+
+    // collect back edges, now that every label has a position
+    da(BackEdge) back_edges;
+    da_init(&back_edges, 8);
+    for_range(here, begin, end - 1) {
+        u8 kind = buf->buf.at[here]->kind;
+        if (kind != FE_MACH_CFG_JUMP && kind != FE_MACH_CFG_BRANCH) continue;
+        if (buf->buf.at[here + 1]->kind != FE_MACH_INST) continue;
+
+        FeMachInst* jump = (FeMachInst*)buf->buf.at[here + 1];
+        for_range(i, 0, templates[jump->template].imms_len) {
+            FeMachImmediate* imm = &buf->immediates.at[jump->imms + i];
+            if (imm->kind != FE_MACH_IMM_LABEL) continue;
+            void* target = ptrmap_get(&label_positions, imm->label);
+            if (target == PTRMAP_NOT_FOUND || (u64)target > here) continue;
+            BackEdge edge = {.target = (u64)target, .source = here + 2};
+            da_append(&back_edges, edge);
+        }
+    }
+
+    // stretch ranges over the loops they touch, until nothing changes
+    // (a stretched range can start touching an outer loop)
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for_range(r, 0, ranges->len) {
+            SlotRange* range = &ranges->at[r];
+            foreach (BackEdge edge, back_edges) {
+                if (range->from >= edge.source || edge.target >= range->to) continue;
+                if (range->from > edge.target) {
+                    range->from = edge.target;
+                    changed = true;
+                }
+                if (range->to < edge.source) {
+                    range->to = edge.source;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    da_destroy(&back_edges);
+}
+
+// lay out the stack slots referenced between buf[begin] and buf[end], assigning
+// each one an offset from the bottom of the locals area. returns the size of the
+// area and writes its alignment to *align.
+u32 fe_mach_layout_frame(FeMachBuffer* buf, u32 begin, u32 end, u16* align) {
+    if (slot_ranges.keys == NULL) ptrmap_init(&slot_ranges, 64);
+    if (label_positions.keys == NULL) ptrmap_init(&label_positions, 64);
+    ptrmap_reset(&slot_ranges);
+    ptrmap_reset(&label_positions);
+
+    *align = 1;
+    if (buf->slots.len == 0) return 0;
+
+    da(SlotRange) ranges;
+    da_init(&ranges, 16);
+    find_slot_ranges(buf, begin, end, &ranges);
+
+    sorting_buf = buf;
+    qsort(ranges.at, ranges.len, sizeof(SlotRange), compare_slot_ranges);
+
+    da(FrameCell) cells;
+    da_init(&cells, 16);
+    for_range(r, 0, ranges.len) {
+        SlotRange* range = &ranges.at[r];
+        FeMachStackSlot* slot = &buf->slots.at[range->slot];
+
+        // every existing cell is at least as aligned as this slot
+        range->cell = UINT32_MAX;
+        for_range(c, 0, cells.len) {
+            FrameCell* cell = &cells.at[c];
+            if (cell->size < slot->size) continue;
+            bool overlaps = false;
+            for (u32 other = cell->first; other != UINT32_MAX; other = ranges.at[other].next) {
+                if (slot_ranges_overlap(range, &ranges.at[other])) {
+                    overlaps = true;
+                    break;
+                }
+            }
+            if (overlaps) continue;
+            range->cell = c;
+            range->next = cell->first;
+            cell->first = r;
+            break;
+        }
+        if (range->cell == UINT32_MAX) {
+            FrameCell cell = {.size = slot->size, .align = slot->align, .first = r};
+            range->cell = cells.len;
+            range->next = UINT32_MAX;
+            da_append(&cells, cell);
+        }
+    }
+
+    u32 size = 0;
+    for_range(c, 0, cells.len) {
+        FrameCell* cell = &cells.at[c];
+        size = align_forward(size, cell->align);
+        cell->offset = size;
+        size += cell->size;
+        *align = max(*align, cell->align);
+    }
+    foreach (SlotRange range, ranges) {
+        buf->slots.at[range.slot].offset = cells.at[range.cell].offset;
+    }
+
+    da_destroy(&cells);
+    da_destroy(&ranges);
+    return size;
+}
@@ -22,6 +22,9 @@ static size_t mach_sizes[] = {
     [FE_MACH_LIFETIME_END] = sizeof(FeMachLifetimePoint),
 
     [FE_MACH_CFG_BEGIN] = sizeof(FeMach),
+    [FE_MACH_CFG_JUMP] = sizeof(FeMach),
+    [FE_MACH_CFG_BRANCH] = sizeof(FeMach),
+    [FE_MACH_CFG_TARGET] = sizeof(FeMach),
     [FE_MACH_CFG_END] = sizeof(FeMach),
 
     [FE_MACH_LABEL_LOCAL] = sizeof(FeMachLocalLabel),
@@ -76,11 +79,11 @@ FeMachInst* fe_mach_new_inst(FeMachBuffer* buf, u16 template_index) {
 }
 
 bool fe_mach_is_vreg_use(FeMachBuffer* buf, u16 template_index, u8 index) {
-    return (buf->target.inst_templates[template_index].defs & (1ull << index)) != 0;
+    return (buf->target.inst_templates[template_index].uses & (1ull << index)) != 0;
 }
 
 bool fe_mach_is_vreg_def(FeMachBuffer* buf, u16 template_index, u8 index) {
-    return (buf->target.inst_templates[template_index].uses & (1ull << index)) != 0;
+    return (buf->target.inst_templates[template_index].defs & (1ull << index)) != 0;
 }
 
 FeMachImmediate* fe_mach_get_immediate(FeMachBuffer* buf, FeMachImmediateList list, u32 index) {
@@ -89,7 +92,29 @@ FeMachImmediate* fe_mach_get_immediate(FeMachBuffer* buf, FeMachImmediateList li
     return &buf->immediates.at[imm_index];
 }
 
+void fe_mach_set_immediate(FeMachBuffer* buf, FeMachInst* inst, u8 index, u8 kind, u64 value) {
+    FeMachImmediate* imm = &buf->immediates.at[inst->imms + index];
+    imm->kind = kind;
+    imm->d64 = value;
+}
+
+void fe_mach_set_slot_immediate(FeMachBuffer* buf, FeMachInst* inst, u8 index, u32 slot, i32 offset) {
+    FeMachImmediate* imm = &buf->immediates.at[inst->imms + index];
+    imm->kind = FE_MACH_IMM_SLOT;
+    imm->slot.index = slot;
+    imm->slot.offset = offset;
+}
+
+u32 fe_mach_new_stack_slot(FeMachBuffer* buf, u32 size, u16 align) {
+    FeMachStackSlot slot = {0};
+    slot.size = size;
+    slot.align = align;
+    da_append(&buf->slots, slot);
+    return buf->slots.len - 1;
+}
+
 FeMachBuffer fe_mach_codegen(FeModule* m) {
+    fe_charge_module(m);
     if (m->target.arch == NULL) FE_FATAL(m, "target arch not set");
     if (m->target.system == 0) FE_FATAL(m, "target system not set");
 
@@ -101,6 +126,11 @@ void fe_mach_emit_text(FeDataBuffer* db, FeMachBuffer* mb) {
     mb->target.arch->emit_text(db, mb);
 }
 
+void fe_mach_emit_bin(FeDataBuffer* db, FeMachBuffer* mb) {
+    if (mb->target.arch->emit_bin == NULL) CRASH("arch '%s' has no binary encoder", mb->target.arch->name);
+    mb->target.arch->emit_bin(db, mb);
+}
+
 u32 fe_mach_new_vreg(FeMachBuffer* buf, u8 regclass) {
     FeMachVReg vreg = {0};
     vreg.class = regclass;
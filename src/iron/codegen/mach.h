@@ -10,6 +10,9 @@ typedef struct FeMachSymbol FeMachSymbol;
 typedef struct FeMach FeMach;
 typedef struct FeMachInst FeMachInst;
 typedef struct FeMachInstTemplate FeMachInstTemplate;
+typedef struct FeMachLocalLabel FeMachLocalLabel;
+typedef struct FeMachReloc FeMachReloc;
+typedef struct FeMachStackSlot FeMachStackSlot;
 
 typedef u32 FeMachVregList;
 typedef u32 FeMachImmediateList; // index to first immediate
@@ -17,6 +20,8 @@ typedef u32 FeMachImmediateList; // index to first immediate
 da_typedef(FeMachVReg);
 da_typedef(u32);
 da_typedef(FeMachImmediate);
+da_typedef(FeMachReloc);
+da_typedef(FeMachStackSlot);
 
 typedef struct FeMachBuffer {
 
@@ -43,6 +48,11 @@ typedef struct FeMachBuffer {
     da(FeMachVReg) vregs;
     da(u32) vreg_lists;
     da(FeMachImmediate) immediates;
+    da(FeMachReloc) relocs; // filled out by emit_bin
+    da(FeMachStackSlot) slots;
+
+    // real registers regalloc must never hand out, as a bitmask per regclass
+    u64 reserved[8];
 
     Arena buf_alloca;
 } FeMachBuffer;
@@ -137,7 +147,13 @@ typedef struct FeMachInst {
 
 enum {
     FE_MACH_IMM_CONST = 1,
-    // FE_MACH_IMM_SYMBOL,
+    FE_MACH_IMM_SYMBOL, // d32 is an index into the symtab
+    FE_MACH_IMM_LABEL,  // points to a local label, may be appended later
+
+    // these are only known once regalloc is done and the frame is laid out,
+    // at which point they get replaced with FE_MACH_IMM_CONST.
+    FE_MACH_IMM_SLOT,       // frame offset of slot.index, plus slot.offset
+    FE_MACH_IMM_FRAME_SIZE, // size of the function's frame, plus d64
 };
 
 typedef struct FeMachImmediate {
@@ -147,9 +163,24 @@ typedef struct FeMachImmediate {
         u32 d32;
         u16 d16;
         u8 d8;
+        FeMachLocalLabel* label;
+        struct {
+            u32 index;
+            i32 offset;
+        } slot;
     };
 } FeMachImmediate;
 
+// a piece of a function's stack frame. stack objects and spilled vregs
+// each get one, and frame layout decides where it goes. slots that are
+// never live at the same time can end up sharing memory.
+typedef struct FeMachStackSlot {
+    u32 size;
+    u16 align;
+    bool escapes : 1; // its address is taken, so it lives for the whole function
+    i32 offset;       // filled out by frame layout
+} FeMachStackSlot;
+
 // template for a machine instruction.
 // machine instructions can have a maximum of 16 registers (counting def and use)
 typedef struct FeMachInstTemplate {
@@ -158,9 +189,22 @@ typedef struct FeMachInstTemplate {
     u16 uses; // uses bitmask
     u8 regs_len;
     u8 imms_len;
+    u8 cost; // rough latency in cycles
     bool side_effects : 1;
 } FeMachInstTemplate;
 
+enum {
+    FE_MACH_RELOC_REL32 = 1, // 32-bit pc-relative, relative to the end of the field
+};
+
+// a reference from emitted code to a symbol, to be resolved by whatever
+// packages the code into an object or executable.
+typedef struct FeMachReloc {
+    u64 offset; // offset of the field in the code
+    u32 symbol_index;
+    u8 kind;
+} FeMachReloc;
+
 typedef struct FeMachSymbol {
     char* name;
     u16 name_len;
@@ -171,6 +215,7 @@ typedef struct FeMachSymbol {
 
 FeMachBuffer fe_mach_codegen(FeModule* m);
 void fe_mach_emit_text(FeDataBuffer* db, FeMachBuffer* mb);
+void fe_mach_emit_bin(FeDataBuffer* db, FeMachBuffer* mb);
 
 FeType fe_mach_type_of_native_int(u16 arch);
 FeType fe_mach_type_of_native_float(u16 arch);
@@ -186,5 +231,13 @@ FeMach* fe_mach_append(FeMachBuffer* buf, FeMach* inst);
 u32 fe_mach_new_vreg(FeMachBuffer* buf, u8 regclass);
 u32 fe_mach_get_vreg(FeMachBuffer* buf, FeMachInst* inst, u8 index);
 void fe_mach_set_vreg(FeMachBuffer* buf, FeMachInst* inst, u8 index, u32 vreg);
+bool fe_mach_is_vreg_use(FeMachBuffer* buf, u16 template_index, u8 index);
+bool fe_mach_is_vreg_def(FeMachBuffer* buf, u16 template_index, u8 index);
+FeMachImmediate* fe_mach_get_immediate(FeMachBuffer* buf, FeMachImmediateList list, u32 index);
+void fe_mach_set_immediate(FeMachBuffer* buf, FeMachInst* inst, u8 index, u8 kind, u64 value);
+void fe_mach_set_slot_immediate(FeMachBuffer* buf, FeMachInst* inst, u8 index, u32 slot, i32 offset);
+
+u32 fe_mach_new_stack_slot(FeMachBuffer* buf, u32 size, u16 align);
+u32 fe_mach_layout_frame(FeMachBuffer* buf, u32 begin, u32 end, u16* align);
 
 void fe_mach_regalloc(FeMachBuffer* buf);
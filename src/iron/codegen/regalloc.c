@@ -1,5 +1,6 @@
 #include "mach.h"
 #include "x64/x64.h"
+#include "common/ptrmap.h"
 
 /*
     the liveness analyzer assumes well-formed programs.
@@ -10,6 +11,15 @@
 
     I could design a more complicated analyzer that detects this, but the overhead is kinda horrendous
 
+    liveness is done per function. the function is split into blocks at the CFG markers,
+    live-in/live-out sets are solved with the usual backwards dataflow, and then each block
+    contributes its own live ranges. a vreg that lives across a loop just ends up with more
+    than one range.
+
+    when a vreg can't get a register, the longest lived candidate is spilled to a stack slot
+    and allocation starts over. the spilled vreg is replaced by short-lived temporaries around
+    each of its uses and defs, which are never spilled themselves.
+
 */
 
 typedef struct LiveRange {
@@ -38,9 +48,10 @@ typedef struct LifetimeSet {
 
 } LifetimeSet;
 
-static u32 total_range_count = 0;
-static LifetimeSet* lifetimes;
-static LiveRange* pending;
+// everything here is per thread, and the arrays come out of scratch memory
+static _Thread_local u32 total_range_count = 0;
+static _Thread_local LifetimeSet* lifetimes;
+static _Thread_local LiveRange* pending;
 
 static LiveRange range_from_set(LifetimeSet* lts, u32 index) {
     if (lts->cap == 0)
@@ -78,90 +89,246 @@ static LiveRange* get_range_ptr(LifetimeSet* lts, u32 index) {
     else return &lts->at[index];
 }
 
+// vregs with a range that is still open in the current block
+static _Thread_local struct {
+    u32* at;
+    u32 len;
+    u32 cap;
+} open_vregs;
+
 static void add_lifetime_point(u32 here, u32 vreg_index, bool is_def, bool is_use) {
     // printf("%d: %s for vreg %d\n", here, !is_use ? "def" : "use", vreg_index);
 
     LiveRange* pending_range = &pending[vreg_index];
 
     if (is_use) {
-        // if its a use, extend the pending live range from here
+        // if its a use, extend the pending live range to here.
+        // a use that is also a def keeps the register busy through this instruction
         if (pending_range->from == 0) CRASH("vreg use before def");
-        pending_range->to = here;
+        pending_range->to = max(pending_range->to, here + is_def);
     } else if (is_def) {
-        // if its a def, push the current pending live range and start a new one
-        // only push current range if the most recent def has actually been used
-        if (pending_range->to != 0) add_range(&lifetimes[vreg_index], pending[vreg_index]);
-        pending[vreg_index].from = here;
-        pending[vreg_index].to = here;
+        // if its a def, push the current pending live range and start a new one.
+        // a def always occupies its register for at least this instruction, even if it's never used
+        if (pending_range->from != 0) add_range(&lifetimes[vreg_index], *pending_range);
+        else da_append(&open_vregs, vreg_index);
+        pending_range->from = here;
+        pending_range->to = here + 1;
     } else CRASH("vreg not def or use");
 }
 
-static void liveness_analysis(FeMachBuffer* buf) {
-    // assume a single basic block at the moment
-    // i know, i know
-    // i need to figure out how lifetime traces work for an entire function
+typedef struct MachBlock {
+    u32 start; // index of the first element
+    u32 end;   // exclusive
+    u32 succs[2];
+    u8 succs_len;
+
+    // bitsets over vregs
+    u64* uses; // used before being defined in this block
+    u64* defs;
+    u64* live_in;
+    u64* live_out;
+} MachBlock;
+
+da_typedef(MachBlock);
+
+#define bit_get(set, i) (((set)[(i) / 64] >> ((i) % 64)) & 1)
+#define bit_set(set, i) ((set)[(i) / 64] |= 1ull << ((i) % 64))
+
+static _Thread_local PtrMap label_blocks; // FeMachLocalLabel* -> block index
+
+// call f(vreg, is_def, is_use) for every vreg an element touches
+#define for_vreg_points(buf, elem, f)                                                    \
+    do {                                                                                 \
+        switch ((elem)->kind) {                                                          \
+        case FE_MACH_INST: {                                                             \
+            FeMachInst* inst = (FeMachInst*)(elem);                                      \
+            const FeMachInstTemplate templ = (buf)->target.inst_templates[inst->template]; \
+            for_range(r, 0, templ.regs_len) {                                            \
+                u32 vreg_index = (buf)->vreg_lists.at[inst->regs + r];                   \
+                if (vreg_index == 0) continue; /* unused operand, like a missing index */ \
+                f(vreg_index, (templ.defs & (1ull << r)) != 0, (templ.uses & (1ull << r)) != 0); \
+            }                                                                            \
+            break;                                                                       \
+        }                                                                                \
+        case FE_MACH_LIFETIME_BEGIN:                                                     \
+            f(((FeMachLifetimePoint*)(elem))->vreg, true, false);                        \
+            break;                                                                       \
+        case FE_MACH_LIFETIME_END:                                                       \
+            f(((FeMachLifetimePoint*)(elem))->vreg, false, true);                        \
+            break;                                                                       \
+        default:                                                                         \
+            break;                                                                       \
+        }                                                                                \
+    } while (0)
+
+// split the function between begin and end into blocks, and find their successors
+static void find_blocks(FeMachBuffer* buf, u32 begin, u32 end, da(MachBlock)* blocks) {
+    if (label_blocks.keys == NULL) ptrmap_init(&label_blocks, 64);
+    ptrmap_reset(&label_blocks);
+
+    // blocks start at jump targets and end right after a jump or branch.
+    // a label with no CFG_TARGET (like the entry block's, after the prologue) also starts one
+    MachBlock block = {.start = begin + 1};
+    da(u32) terminators; // index of each block's jump, or 0
+    da_init(&terminators, 16);
+    for_range(here, begin + 1, end) {
+        FeMach* elem = buf->buf.at[here];
+        bool starts_block = elem->kind == FE_MACH_CFG_TARGET ||
+                            (elem->kind == FE_MACH_LABEL_LOCAL && buf->buf.at[here - 1]->kind != FE_MACH_CFG_TARGET);
+        if (starts_block && here != block.start) {
+            block.end = here;
+            da_append(blocks, block);
+            da_append(&terminators, 0);
+            block.start = here;
+        }
+        if (elem->kind == FE_MACH_LABEL_LOCAL) {
+            ptrmap_put(&label_blocks, elem, (void*)(u64)blocks->len);
+        }
+        if ((elem->kind == FE_MACH_CFG_JUMP || elem->kind == FE_MACH_CFG_BRANCH) && here + 1 < end) {
+            block.end = here + 2;
+            da_append(blocks, block);
+            da_append(&terminators, here);
+            block.start = here + 2;
+            here++;
+        }
+    }
+    if (block.start < end) {
+        block.end = end;
+        da_append(blocks, block);
+        da_append(&terminators, 0);
+    }
 
-    lifetimes = fe_malloc(sizeof(LifetimeSet) * buf->vreg_lists.len);
-    for_range(i, 0, buf->vreg_lists.len) lifetimes[i].vreg = i;
-    pending = fe_malloc(sizeof(LiveRange) * buf->vreg_lists.len);
+    for_range(b, 0, blocks->len) {
+        MachBlock* block = &blocks->at[b];
+        u32 term = terminators.at[b];
+        u8 kind = term != 0 ? buf->buf.at[term]->kind : FE_MACH_NONE;
+
+        if (kind == FE_MACH_CFG_JUMP || kind == FE_MACH_CFG_BRANCH) {
+            FeMachInst* jump = (FeMachInst*)buf->buf.at[term + 1];
+            const FeMachInstTemplate templ = buf->target.inst_templates[jump->template];
+            for_range(i, 0, templ.imms_len) {
+                FeMachImmediate* imm = &buf->immediates.at[jump->imms + i];
+                if (imm->kind != FE_MACH_IMM_LABEL) continue;
+                void* target = ptrmap_get(&label_blocks, imm->label);
+                if (target == PTRMAP_NOT_FOUND) CRASH("jump to label outside of function");
+                block->succs[block->succs_len++] = (u32)(u64)target;
+            }
+        }
+        // a jump with no label (like a return) has no successors
+        if (kind != FE_MACH_CFG_JUMP && b + 1 < blocks->len) {
+            block->succs[block->succs_len++] = b + 1;
+        }
+    }
 
-    bool regalloc_enabled = false;
-    for_range(here, 0, buf->buf.len) {
-        FeMach* elem = buf->buf.at[here];
+    da_destroy(&terminators);
+}
 
-        if (!regalloc_enabled && elem->kind != FE_MACH_CFG_BEGIN)
-            continue;
+static void function_liveness(FeMachBuffer* buf, u32 begin, u32 end) {
+    da(MachBlock) blocks;
+    da_init(&blocks, 16);
+    find_blocks(buf, begin, end, &blocks);
+
+    ArenaMark mark = arena_mark(fe_scratch());
+    u32 words = (buf->vregs.len + 63) / 64;
+    u64* sets = arena_alloc(fe_scratch(), sizeof(u64) * words * 4 * blocks.len, alignof(u64));
+    memset(sets, 0, sizeof(u64) * words * 4 * blocks.len);
+    for_range(b, 0, blocks.len) {
+        MachBlock* block = &blocks.at[b];
+        block->uses = &sets[words * (4 * b + 0)];
+        block->defs = &sets[words * (4 * b + 1)];
+        block->live_in = &sets[words * (4 * b + 2)];
+        block->live_out = &sets[words * (4 * b + 3)];
+
+#define local_point(vreg, is_def, is_use)                                       \
+    do {                                                                        \
+        if ((is_use) && !bit_get(block->defs, vreg)) bit_set(block->uses, vreg); \
+        if (is_def) bit_set(block->defs, vreg);                                 \
+    } while (0)
+        for_range(here, block->start, block->end) {
+            for_vreg_points(buf, buf->buf.at[here], local_point);
+        }
+#undef local_point
+    }
 
-        switch (elem->kind) {
-        case FE_MACH_CFG_BEGIN:
-            regalloc_enabled = true;
-            break;
-        case FE_MACH_CFG_END:
-            // push pending ranges
-            for_range(r, 0, buf->vregs.len) {
-                if (pending[r].to != 0) {
-                    add_range(&lifetimes[r], pending[r]);
-                }
+    // live_out = union of successors' live_in
+    // live_in = uses | (live_out & ~defs)
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (i64 b = blocks.len - 1; b >= 0; b--) {
+            MachBlock* block = &blocks.at[b];
+            for_range(w, 0, words) {
+                u64 out = 0;
+                for_range(s, 0, block->succs_len) out |= blocks.at[block->succs[s]].live_in[w];
+                u64 in = block->uses[w] | (out & ~block->defs[w]);
+                if (out != block->live_out[w] || in != block->live_in[w]) changed = true;
+                block->live_out[w] = out;
+                block->live_in[w] = in;
             }
-            regalloc_enabled = false;
-            break;
-        case FE_MACH_CFG_BRANCH:
-        case FE_MACH_CFG_JUMP:
-        case FE_MACH_CFG_TARGET:
-            TODO("complex cfgs not handled yet");
-            break;
-        case FE_MACH_INST: {
-            FeMachInst* inst = (FeMachInst*)elem;
-            const FeMachInstTemplate templ = buf->target.inst_templates[inst->template];
-            u32 vreg_0 = inst->regs;
-            for_range(r, 0, templ.regs_len) {
-                u32 vreg_index = buf->vreg_lists.at[vreg_0 + r];
-                bool is_def = (templ.defs & (1ull << r)) != 0;
-                bool is_use = (templ.uses & (1ull << r)) != 0;
-                add_lifetime_point(here, vreg_index, is_def, is_use);
+        }
+    }
+
+    // build live ranges block by block
+    foreach (MachBlock block, blocks) {
+        for_range(w, 0, words) {
+            for (u64 bits = block.live_in[w]; bits != 0; bits &= bits - 1) {
+                u32 vreg = w * 64 + __builtin_ctzll(bits);
+                pending[vreg].from = block.start;
+                pending[vreg].to = block.start;
+                da_append(&open_vregs, vreg);
             }
-            break;
-	}
-        case FE_MACH_LIFETIME_BEGIN: {
-            FeMachLifetimePoint* ltp = (FeMachLifetimePoint*)elem;
-            add_lifetime_point(here, ltp->vreg, true, false);
-            break;
-	}
-        case FE_MACH_LIFETIME_END: {
-            FeMachLifetimePoint* ltp = (FeMachLifetimePoint*)elem;
-            add_lifetime_point(here, ltp->vreg, false, true);
-            break;
-	}
-        default:
-            break;
         }
+
+        for_range(here, block.start, block.end) {
+#define point(vreg, is_def, is_use) add_lifetime_point(here, vreg, is_def, is_use)
+            for_vreg_points(buf, buf->buf.at[here], point);
+#undef point
+        }
+
+        for_range(w, 0, words) {
+            for (u64 bits = block.live_out[w]; bits != 0; bits &= bits - 1) {
+                u32 vreg = w * 64 + __builtin_ctzll(bits);
+                pending[vreg].to = block.end;
+            }
+        }
+        for_range(i, 0, open_vregs.len) {
+            u32 vreg = open_vregs.at[i];
+            if (pending[vreg].to > pending[vreg].from) add_range(&lifetimes[vreg], pending[vreg]);
+            pending[vreg] = (LiveRange){0};
+        }
+        open_vregs.len = 0;
+    }
+
+    arena_release(fe_scratch(), mark);
+    da_destroy(&blocks);
+}
+
+static void liveness_analysis(FeMachBuffer* buf) {
+    lifetimes = arena_alloc(fe_scratch(), sizeof(LifetimeSet) * buf->vregs.len, alignof(LifetimeSet));
+    memset(lifetimes, 0, sizeof(LifetimeSet) * buf->vregs.len);
+    for_range(i, 0, buf->vregs.len) lifetimes[i].vreg = i;
+    pending = arena_alloc(fe_scratch(), sizeof(LiveRange) * buf->vregs.len, alignof(LiveRange));
+    memset(pending, 0, sizeof(LiveRange) * buf->vregs.len);
+    if (open_vregs.at == NULL) da_init(&open_vregs, 64);
+
+    for_range(here, 0, buf->buf.len) {
+        if (buf->buf.at[here]->kind != FE_MACH_CFG_BEGIN) continue;
+        u32 end = here;
+        while (end < buf->buf.len && buf->buf.at[end]->kind != FE_MACH_CFG_END) end++;
+        function_liveness(buf, here, end);
+        here = end;
     }
+}
 
-    fe_free(pending);
+static void free_lifetimes(FeMachBuffer* buf) {
+    for_range(i, 0, buf->vregs.len) {
+        if (lifetimes[i].cap != 0) fe_free(lifetimes[i].at);
+        if (lifetimes[i].interference.at != NULL) fe_free(lifetimes[i].interference.at);
+    }
 }
 
 static void conflict_edge(u32 x, u32 y) {
-    printf("v%d and v%d conflict\n", x, y);
+    // printf("v%d and v%d conflict\n", x, y);
     LifetimeSet* x_set = &lifetimes[x];
     LifetimeSet* y_set = &lifetimes[y];
 
@@ -174,9 +341,16 @@ static void conflict_edge(u32 x, u32 y) {
 
 #define ranges_interfere(xptr, yptr) ((xptr->from < yptr->to && yptr->from < xptr->to))
 
+static int compare_ranges(const void* a, const void* b) {
+    const LiveRange* x = *(const LiveRange**)a;
+    const LiveRange* y = *(const LiveRange**)b;
+    if (x->from != y->from) return x->from < y->from ? -1 : 1;
+    return 0;
+}
+
 static void build_conflict_graph(FeMachBuffer* buf) {
 
-    LiveRange** sorted_ranges = fe_malloc(sizeof(LiveRange*) * total_range_count);
+    LiveRange** sorted_ranges = arena_alloc(fe_scratch(), sizeof(LiveRange*) * total_range_count, alignof(LiveRange*));
 
     // copy ranges in and sort
     {
@@ -187,19 +361,11 @@ static void build_conflict_graph(FeMachBuffer* buf) {
             }
         }
 
-        for_range(i, 0, len) {
-            LiveRange* x = sorted_ranges[i];
-            u32 j = i;
-            while (j > 0 && sorted_ranges[j - 1]->from > x->from) {
-                sorted_ranges[j] = sorted_ranges[j - 1];
-                j--;
-            }
-            sorted_ranges[j] = x;
-        }
+        qsort(sorted_ranges, len, sizeof(LiveRange*), compare_ranges);
 
-        for_range(i, 0, len) {
-            printf("% 2d [%d, %d)\n", sorted_ranges[i]->vreg, sorted_ranges[i]->from, sorted_ranges[i]->to);
-        }
+        // for_range(i, 0, len) {
+        //     printf("% 2d [%d, %d)\n", sorted_ranges[i]->vreg, sorted_ranges[i]->from, sorted_ranges[i]->to);
+        // }
     }
 
     // active range set
@@ -227,7 +393,7 @@ static void build_conflict_graph(FeMachBuffer* buf) {
         // see if current range interferes with active ones
         for_range(j, 0, active_ranges.len) {
             LiveRange* maybe_interferes = active_ranges.at[j];
-            if (ranges_interfere(maybe_interferes, new)) {
+            if (maybe_interferes->vreg != new->vreg && ranges_interfere(maybe_interferes, new)) {
                 conflict_edge(maybe_interferes->vreg, new->vreg);
             }
         }
@@ -235,13 +401,55 @@ static void build_conflict_graph(FeMachBuffer* buf) {
         // add this range to the active ranges
         da_append(&active_ranges, new);
     }
+
+    da_destroy(&active_ranges);
 }
 
-static u8 real_max(FeArchInfo* arch, u8 regclass) {
+static u8 real_max(const FeArchInfo* arch, u8 regclass) {
     return arch->regclasses.at[regclass].len;
 }
 
-static void assign_concrete(FeMachBuffer* buf) {
+// vregs at or past this index are spill temporaries, which can't be spilled again
+static _Thread_local u32 first_spill_temp;
+// whether each vreg came in with a real register already
+static _Thread_local bool* precolored;
+
+static u32 range_length(LifetimeSet* lts) {
+    u32 length = 0;
+    for_range(i, 0, lts->len) {
+        LiveRange range = get_range(lts, i);
+        length += range.to - range.from;
+    }
+    return length;
+}
+
+// pick a vreg to spill so that vreg can get a register.
+// the one that lives the longest frees up a register for the most code.
+static u32 choose_spill(FeMachBuffer* buf, u32 vreg) {
+    u32 victim = 0;
+    u32 victim_length = 0;
+
+    LifetimeSet* lts = &lifetimes[vreg];
+    for_range(i, -1, (i64)lts->interference.len) {
+        u32 candidate = i == -1 ? vreg : lts->interference.at[i]->vreg;
+        if (candidate >= first_spill_temp || precolored[candidate]) continue;
+        // only vregs that are actually holding a register are worth spilling
+        if (candidate != vreg && buf->vregs.at[candidate].real == 0) continue;
+        if (buf->vregs.at[candidate].class != buf->vregs.at[vreg].class) continue;
+
+        u32 length = range_length(&lifetimes[candidate]);
+        if (length > victim_length) {
+            victim = candidate;
+            victim_length = length;
+        }
+    }
+
+    if (victim == 0) CRASH("cannot select a real register");
+    return victim;
+}
+
+// returns a vreg that has to be spilled, or 0 if everything got a register
+static u32 assign_concrete(FeMachBuffer* buf) {
     // shitty ish graph colorer
 
     // remember to skip the null vreg
@@ -256,30 +464,124 @@ static void assign_concrete(FeMachBuffer* buf) {
         // this shit already assigned
         if (reg->real != 0) continue;
 
+        // never referenced by anything
+        if (lts->len == 0) continue;
+
+        // collect the real registers of everything already assigned that interferes
+        u8 len = real_max(buf->target.arch, reg->class);
+        u64 taken = buf->reserved[reg->class];
+        foreach (LifetimeSet* maybe_interferes, lts->interference) {
+            FeMachVReg* maybe_reg = &buf->vregs.at[maybe_interferes->vreg];
+            if (maybe_reg->real != 0 && maybe_reg->class == reg->class) taken |= 1ull << maybe_reg->real;
+        }
+
         // if theres a hint, check if that interferes with anything already assigned
-        if (reg->hint != 0) {
-            bool interferes = false;
-            foreach (LifetimeSet* maybe_interferes, lts->interference) {
-                FeMachVReg* maybe_reg = &buf->vregs.at[maybe_interferes->vreg];
-                if (maybe_reg->real == reg->hint) {
-                    interferes = true;
-                    break;
-                }
-            }
-            if (!interferes) {
-                reg->real = reg->hint;
-                continue;
-            }
-            CRASH("cannot select a real register");
+        if (reg->hint != 0 && (taken & (1ull << reg->hint)) == 0) {
+            reg->real = reg->hint;
+            continue;
         }
 
         // look through and see if we can put a real reg to these bitches
+        for_range(real, 1, len) {
+            if ((taken & (1ull << real)) != 0) continue;
+            reg->real = real;
+            break;
+        }
+
+        if (reg->real == 0) return choose_spill(buf, r);
     }
+    return 0;
+}
+
+// replace vreg with a fresh temporary at every instruction that touches it,
+// reloading it from a stack slot before uses and storing it back after defs.
+static void spill_vreg(FeMachBuffer* buf, u32 vreg) {
+    const FeArchInfo* arch = buf->target.arch;
+    FeMachVReg spilled = buf->vregs.at[vreg];
+    u8 size = arch->regclasses.at[spilled.class].spill_size;
+    if (arch->spill == NULL || arch->reload == NULL || size == 0) {
+        CRASH("arch '%s' cannot spill registers", arch->name);
+    }
+    u32 slot = fe_mach_new_stack_slot(buf, size, size);
+
+    struct {
+        FeMach** at;
+        u64 len;
+        u64 cap;
+    } rewritten;
+    da_init(&rewritten, buf->buf.len + 64);
+
+    for_range(here, 0, buf->buf.len) {
+        FeMach* elem = buf->buf.at[here];
+        if ((elem->kind == FE_MACH_LIFETIME_BEGIN || elem->kind == FE_MACH_LIFETIME_END) && ((FeMachLifetimePoint*)elem)->vreg == vreg) {
+            CRASH("cannot spill a vreg with an artificial lifetime");
+        }
+        if (elem->kind != FE_MACH_INST) {
+            da_append(&rewritten, elem);
+            continue;
+        }
+
+        FeMachInst* inst = (FeMachInst*)elem;
+        const FeMachInstTemplate templ = buf->target.inst_templates[inst->template];
+        bool is_use = false;
+        bool is_def = false;
+        for_range(r, 0, templ.regs_len) {
+            if (buf->vreg_lists.at[inst->regs + r] != vreg) continue;
+            is_use |= (templ.uses & (1ull << r)) != 0;
+            is_def |= (templ.defs & (1ull << r)) != 0;
+        }
+        if (!is_use && !is_def) {
+            da_append(&rewritten, elem);
+            continue;
+        }
+
+        u32 temp = fe_mach_new_vreg(buf, spilled.class);
+        buf->vregs.at[temp].hint = spilled.hint;
+        for_range(r, 0, templ.regs_len) {
+            if (buf->vreg_lists.at[inst->regs + r] == vreg) buf->vreg_lists.at[inst->regs + r] = temp;
+        }
+
+        if (is_use) {
+            // a CFG marker has to stay right in front of its instruction
+            FeMach* marker = NULL;
+            u8 last = rewritten.len != 0 ? rewritten.at[rewritten.len - 1]->kind : FE_MACH_NONE;
+            if (last == FE_MACH_CFG_JUMP || last == FE_MACH_CFG_BRANCH) marker = da_pop(&rewritten);
+            da_append(&rewritten, (FeMach*)arch->reload(buf, temp, slot));
+            if (marker != NULL) da_append(&rewritten, marker);
+        }
+        da_append(&rewritten, elem);
+        if (is_def) da_append(&rewritten, (FeMach*)arch->spill(buf, temp, slot));
+    }
+
+    fe_free(buf->buf.at);
+    buf->buf.at = rewritten.at;
+    buf->buf.len = rewritten.len;
+    buf->buf.cap = rewritten.cap;
 }
 
 void fe_mach_regalloc(FeMachBuffer* buf) {
-    total_range_count = 0;
-    liveness_analysis(buf);
-    build_conflict_graph(buf);
-    assign_concrete(buf);
+    ArenaMark mark = arena_mark(fe_scratch());
+    first_spill_temp = buf->vregs.len;
+    precolored = arena_alloc(fe_scratch(), sizeof(bool) * buf->vregs.len, alignof(bool));
+    for_range(r, 0, buf->vregs.len) precolored[r] = buf->vregs.at[r].real != 0;
+
+    while (true) {
+        // every round starts from nothing, so its scratch memory goes back at the end
+        ArenaMark round = arena_mark(fe_scratch());
+        total_range_count = 0;
+        liveness_analysis(buf);
+        build_conflict_graph(buf);
+        u32 spill = assign_concrete(buf);
+        free_lifetimes(buf);
+        arena_release(fe_scratch(), round);
+        if (spill == 0) break;
+
+        // start over with the spilled vreg out of the picture
+        spill_vreg(buf, spill);
+        for_range(r, 1, buf->vregs.len) {
+            if (r >= first_spill_temp || !precolored[r]) buf->vregs.at[r].real = 0;
+        }
+    }
+
+    arena_release(fe_scratch(), mark);
 }
@@ -2,6 +2,12 @@
 #include "iron/codegen/x64/x64.h"
 #include "common/ptrmap.h"
 
+#define FE_FATAL(m, msg) fe_push_report(m, (FeReport){                            \
+                                               .function_of_origin = __func__,    \
+                                               .message = (msg),                  \
+                                               .severity = FE_REP_SEVERITY_FATAL, \
+                                           })
+
 // ir -> x64 mach ir
 
 PtrMap irsym2machsym;
@@ -28,8 +34,48 @@ static void gen_symtab(FeModule* m, FeMachBuffer* mb) {
 
 PtrMap ir2vreg;
 
+// per-function isel state
+static struct {
+    FeFunction* fn;
+    const struct X64Cconv* cconv;
+    u32 block;         // index of the block currently being selected
+    u32 sp;            // vreg pinned to rsp, shared by every function (and spill code)
+    u32 fp;            // vreg pinned to rbp, if keeping a frame pointer
+    u32 outgoing_size; // bytes at the bottom of the frame for outgoing stack arguments
+    bool makes_calls;
+    bool frame_pointer;
+    bool has_floats; // calls only need to clobber xmm registers if something lives in one
+
+    // vregs holding the incoming values of callee-saved registers
+    u32 saved[6];
+    u8 saved_len;
+} cg;
+
+PtrMap stack_slots;     // FeStackObject* -> stack slot
+PtrMap ptrcall_returns; // FeIrPtrCall* -> PtrCallReturns*
+
+// pointer calls don't know their return types, so they're
+// collected from the retrieves that read them
+typedef struct PtrCallReturns {
+    u16 len;
+    FeType* types; // returns that are never retrieved are i64
+} PtrCallReturns;
+
+// what frame layout needs to know about each function, in codegen order.
+// the frame can only be laid out once regalloc has added its spill slots.
+typedef struct X64Frame {
+    u32 outgoing_size;
+    bool makes_calls;
+    bool frame_pointer;
+} X64Frame;
+
+da_typedef(X64Frame);
+static da(X64Frame) frames;
+
+// ir2vreg entries also remember which block defined them,
+// so isel knows when it is safe to clobber a value in place.
 static void put_ir_vreg(FeIr* inst, u32 vreg) {
-    ptrmap_put(&ir2vreg, inst, (void*)(u64)vreg);
+    ptrmap_put(&ir2vreg, inst, (void*)((u64)cg.block << 32 | vreg));
 }
 
 static u32 get_ir_vreg(FeIr* inst) {
@@ -38,10 +84,25 @@ static u32 get_ir_vreg(FeIr* inst) {
 }
 
 static bool does_ir_have_vreg(FeIr* inst) {
-    return ptrmap_get(&ir2vreg, inst) == PTRMAP_NOT_FOUND;
+    return ptrmap_get(&ir2vreg, inst) != PTRMAP_NOT_FOUND;
+}
+
+static bool is_ir_local(FeIr* inst) {
+    void* r = ptrmap_get(&ir2vreg, inst);
+    return r != PTRMAP_NOT_FOUND && (u32)((u64)r >> 32) == cg.block;
 }
 
-static const u8 mars_cconv_paramregs[] = {
+// a calling convention, as far as isel is concerned
+typedef struct X64Cconv {
+    const u8* params;
+    u8 params_len;
+    const u8* returns;
+    u8 returns_len;
+    u8 sse_params_len; // xmm0 onwards
+    u8 sse_returns_len;
+} X64Cconv;
+
+static const u8 sysv_paramregs[] = {
     FE_X64_GPR_RDI,
     FE_X64_GPR_RSI,
     FE_X64_GPR_RDX,
@@ -50,7 +111,12 @@ static const u8 mars_cconv_paramregs[] = {
     FE_X64_GPR_R9,
 };
 
-static const u8 mars_cconv_returnregs[] = {
+static const u8 sysv_returnregs[] = {
+    FE_X64_GPR_RAX,
+    FE_X64_GPR_RDX,
+};
+
+static const u8 mars_returnregs[] = {
     FE_X64_GPR_R9,
     FE_X64_GPR_R8,
     FE_X64_GPR_RCX,
@@ -59,147 +125,1552 @@ static const u8 mars_cconv_returnregs[] = {
     FE_X64_GPR_RDI,
 };
 
-#define new_inst(b, kind) (FeMachInst*)fe_mach_append(buf, (FeMach*)fe_mach_new_inst(buf, kind))
+static const X64Cconv sysv_cconv = {
+    .params = sysv_paramregs,
+    .params_len = sizeof(sysv_paramregs),
+    .returns = sysv_returnregs,
+    .returns_len = sizeof(sysv_returnregs),
+    .sse_params_len = 8,
+    .sse_returns_len = 2,
+};
+
+// mars passes parameters like sysv, but returns up to six values
+static const X64Cconv mars_cconv = {
+    .params = sysv_paramregs,
+    .params_len = sizeof(sysv_paramregs),
+    .returns = mars_returnregs,
+    .returns_len = sizeof(mars_returnregs),
+    .sse_params_len = 8,
+    .sse_returns_len = 8,
+};
+
+// sysv and mars agree on which registers survive a call
+static const u8 caller_saved_regs[] = {
+    FE_X64_GPR_RAX,
+    FE_X64_GPR_RCX,
+    FE_X64_GPR_RDX,
+    FE_X64_GPR_RSI,
+    FE_X64_GPR_RDI,
+    FE_X64_GPR_R8,
+    FE_X64_GPR_R9,
+    FE_X64_GPR_R10,
+    FE_X64_GPR_R11,
+};
 
-static FeIr* emit_prologue(FeMachBuffer* buf, FeFunction* fn, FeIr* ir) {
-    u32* callconv_vregs = fe_malloc(sizeof(u32) * fn->params.len);
-    switch (fn->cconv) {
+static const u8 callee_saved_regs[] = {
+    FE_X64_GPR_RBX,
+    FE_X64_GPR_RBP,
+    FE_X64_GPR_R12,
+    FE_X64_GPR_R13,
+    FE_X64_GPR_R14,
+    FE_X64_GPR_R15,
+};
+
+static const X64Cconv* get_cconv(FeModule* m, u8 cconv) {
+    switch (cconv) {
     case FE_CCONV_MARS:
-        assert(fn->params.len <= 6); // preparation passes should have made this never fail
-        for (FeIrParam* pv = (FeIrParam*)ir; pv->base.kind == FE_IR_PARAM; pv = (FeIrParam*)pv->base.next) {
-            // create the vreg for the callconv register
-            u32 cconv_vreg = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
-            callconv_vregs[pv->index] = cconv_vreg;
-            buf->vregs.at[cconv_vreg].real = mars_cconv_paramregs[pv->index];
-            // begin its lifetime
-            fe_mach_append(buf, fe_mach_new_lifetime_begin(buf, cconv_vreg));
-        }
-        for (FeIrParam* pv = (FeIrParam*)ir; pv->base.kind == FE_IR_PARAM; pv = (FeIrParam*)pv->base.next) {
-            // create the mov
-            FeMachInst* mov = new_inst(buf, FE_X64_INST_MOV_RR_64);
-            fe_mach_set_vreg(buf, mov, 1, callconv_vregs[pv->index]);
-
-            u32 mov_out = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
-            buf->vregs.at[mov_out].hint = mars_cconv_paramregs[pv->index];
-            fe_mach_set_vreg(buf, mov, 0, mov_out);
-            put_ir_vreg((FeIr*)pv, mov_out);
-            ir = (FeIr*)pv;
-        }
+        return &mars_cconv;
+    case FE_CCONV_SYSV:
+        return &sysv_cconv;
+    case FE_CCONV_CDECL:
+        if (m->target.system != FE_SYSTEM_WINDOWS) return &sysv_cconv;
+        TODO("windows x64 cconv");
         break;
     default:
-        TODO("non-mars cconvs not supported yet");
+        TODO("cconv %d not supported yet", cconv);
+    }
+    return NULL;
+}
+
+// where a parameter or return value is passed
+typedef struct ArgLocation {
+    u8 gpr;    // FE_X64_GPR_*, or 0
+    u8 xmm;    // xmm register + 1, or 0
+    u32 stack; // offset into the stack argument area, if in neither
+} ArgLocation;
+
+// assign locations to parameters of the given types, in order.
+// returns the size of the stack argument area.
+static u32 classify_params(const X64Cconv* cc, FeType* types, u16 len, ArgLocation* locs) {
+    u8 gprs = 0;
+    u8 xmms = 0;
+    u32 stack = 0;
+    for_range(i, 0, len) {
+        locs[i] = (ArgLocation){0};
+        if (fe_type_is_float(types[i])) {
+            if (xmms < cc->sse_params_len) {
+                locs[i].xmm = ++xmms;
+                continue;
+            }
+        } else if (fe_type_is_scalar(types[i])) {
+            if (gprs < cc->params_len) {
+                locs[i].gpr = cc->params[gprs++];
+                continue;
+            }
+        } else {
+            TODO("aggregate parameters");
+        }
+        // every stack argument takes up an eightbyte
+        locs[i].stack = stack;
+        stack += 8;
+    }
+    return stack;
+}
+
+// return values have to fit in registers
+static void classify_returns(FeModule* m, const X64Cconv* cc, FeType* types, u16 len, ArgLocation* locs) {
+    u8 gprs = 0;
+    u8 xmms = 0;
+    for_range(i, 0, len) {
+        locs[i] = (ArgLocation){0};
+        if (fe_type_is_float(types[i])) {
+            if (xmms == cc->sse_returns_len) FE_FATAL(m, "too many return values for calling convention");
+            locs[i].xmm = ++xmms;
+        } else if (fe_type_is_scalar(types[i])) {
+            if (gprs == cc->returns_len) FE_FATAL(m, "too many return values for calling convention");
+            locs[i].gpr = cc->returns[gprs++];
+        } else {
+            TODO("aggregate returns");
+        }
+    }
+}
+
+#define new_inst(b, kind) (FeMachInst*)fe_mach_append(buf, (FeMach*)fe_mach_new_inst(buf, kind))
+
+// 0 for 8-bit, 1 for 16-bit, 2 for 32-bit, 3 for 64-bit.
+// add this to the 8-bit variant of an instruction to get the right width.
+static u8 width_of(FeType t) {
+    switch (t) {
+    case FE_TYPE_BOOL:
+    case FE_TYPE_I8: return 0;
+    case FE_TYPE_I16: return 1;
+    case FE_TYPE_I32: return 2;
+    case FE_TYPE_PTR:
+    case FE_TYPE_I64: return 3;
+    default:
+        TODO("non-integer type %d in isel", t);
+    }
+    return 0;
+}
+
+// 0 for f32, 1 for f64.
+// add this to the ss variant of an sse instruction to get the right one.
+static u8 sse_width_of(FeType t) {
+    switch (t) {
+    case FE_TYPE_F32: return 0;
+    case FE_TYPE_F64: return 1;
+    default:
+        TODO("float type %d in isel", t);
+    }
+    return 0;
+}
+
+// floats live in xmm registers, everything else in gprs
+static u8 regclass_of(FeType t) {
+    return fe_type_is_float(t) ? FE_X64_REGCLASS_XMM : FE_X64_REGCLASS_GPR;
+}
+
+static u16 mov_rr_for(FeType t) {
+    if (fe_type_is_float(t)) return FE_X64_INST_MOVAPS_RR;
+    return width_of(t) == 3 ? FE_X64_INST_MOV_RR_64 : FE_X64_INST_MOV_RR_32;
+}
+
+static u32 new_pinned_vreg(FeMachBuffer* buf, u8 real) {
+    u32 vreg = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+    buf->vregs.at[vreg].real = real;
+    return vreg;
+}
+
+// a vreg pinned to the register a parameter or return value is passed in
+static u32 new_pinned_arg(FeMachBuffer* buf, ArgLocation loc) {
+    if (loc.xmm == 0) return new_pinned_vreg(buf, loc.gpr);
+    u32 vreg = fe_mach_new_vreg(buf, FE_X64_REGCLASS_XMM);
+    buf->vregs.at[vreg].real = FE_X64_XMM0 + loc.xmm - 1;
+    return vreg;
+}
+
+static u16 mov_arg_for(ArgLocation loc) {
+    return loc.xmm != 0 ? FE_X64_INST_MOVAPS_RR : FE_X64_INST_MOV_RR_64;
+}
+
+static FeMachInst* inst_rr(FeMachBuffer* buf, u16 kind, u32 r0, u32 r1) {
+    FeMachInst* inst = new_inst(buf, kind);
+    fe_mach_set_vreg(buf, inst, 0, r0);
+    fe_mach_set_vreg(buf, inst, 1, r1);
+    return inst;
+}
+
+static FeMachInst* inst_ri(FeMachBuffer* buf, u16 kind, u32 r0, i64 imm) {
+    FeMachInst* inst = new_inst(buf, kind);
+    fe_mach_set_vreg(buf, inst, 0, r0);
+    fe_mach_set_immediate(buf, inst, 0, FE_MACH_IMM_CONST, (u64)imm);
+    return inst;
+}
+
+static i64 const_value(FeIrConst* c) {
+    switch (c->base.type) {
+    case FE_TYPE_BOOL: return c->bool;
+    case FE_TYPE_I8: return c->i8;
+    case FE_TYPE_I16: return c->i16;
+    case FE_TYPE_I32: return c->i32;
+    case FE_TYPE_PTR:
+    case FE_TYPE_I64: return c->i64;
+    default:
+        TODO("non-integer constants");
+    }
+    return 0;
+}
+
+// raw bits of a float constant
+static u64 float_bits(FeIrConst* c) {
+    if (sse_width_of(c->base.type) == 1) {
+        u64 bits;
+        memcpy(&bits, &c->f64, sizeof(bits));
+        return bits;
+    }
+    u32 bits;
+    memcpy(&bits, &c->f32, sizeof(bits));
+    return bits;
+}
+
+static bool fits_simm32(i64 value) {
+    return value == (i64)(i32)value;
+}
+
+// can ir be encoded as the immediate operand of a t-sized instruction?
+static bool is_imm_operand(FeIr* ir, FeType t) {
+    if (ir->kind != FE_IR_CONST || fe_type_is_float(ir->type)) return false;
+    // every instruction up to 32 bits takes a full-width immediate,
+    // 64-bit instructions only take sign-extended 32-bit immediates
+    return width_of(t) != 3 || fits_simm32(const_value((FeIrConst*)ir));
+}
+
+// cheap, pure instructions are never selected where they appear.
+// instead, they're folded into their users or rematerialized at each use.
+static bool is_remat(FeIr* ir) {
+    switch (ir->kind) {
+    case FE_IR_CONST:
+    case FE_IR_STACK_ADDR:
+    case FE_IR_FIELD_PTR:
+    case FE_IR_INDEX_PTR:
+    case FE_IR_LOAD_SYMBOL:
+        return true;
+    default:
+        return false;
+    }
+}
+
+typedef struct X64Address {
+    u32 base;
+    u32 index; // null vreg if not present
+    u8 scale;
+    i64 disp;
+    u32 slot; // stack slot disp is relative to, if any
+} X64Address;
+
+static u32 value_vreg(FeMachBuffer* buf, FeIr* ir);
+
+// sse has no immediates, so float constants are moved in through a gpr
+static u32 xmm_from_bits(FeMachBuffer* buf, FeType t, u64 bits) {
+    u32 temp = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+    u32 vreg = fe_mach_new_vreg(buf, FE_X64_REGCLASS_XMM);
+    if (sse_width_of(t) == 1) {
+        inst_ri(buf, FE_X64_INST_MOV_RI_64, temp, (i64)bits);
+        inst_rr(buf, FE_X64_INST_MOVQ_XR_64, vreg, temp);
+    } else {
+        inst_ri(buf, FE_X64_INST_MOV_RI_32, temp, (u32)bits);
+        inst_rr(buf, FE_X64_INST_MOVD_XR_32, vreg, temp);
+    }
+    return vreg;
+}
+
+// sign-extend an index to 64 bits
+static u32 index_vreg(FeMachBuffer* buf, FeIr* index) {
+    u32 source = value_vreg(buf, index);
+    u16 ext;
+    switch (width_of(index->type)) {
+    case 0: ext = FE_X64_INST_MOVSX_64_8; break;
+    case 1: ext = FE_X64_INST_MOVSX_64_16; break;
+    case 2: ext = FE_X64_INST_MOVSXD_64_32; break;
+    default: return source;
+    }
+    u32 extended = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+    inst_rr(buf, ext, extended, source);
+    return extended;
+}
+
+static u32 stack_slot(FeStackObject* obj) {
+    return (u32)(u64)ptrmap_get(&stack_slots, obj);
+}
+
+// fold chains of stack_addr/field_ptr/index_ptr into a single
+// [base + index * scale + disp] addressing mode.
+static void fold_address(FeMachBuffer* buf, FeIr* ptr, X64Address* addr) {
+    switch (ptr->kind) {
+    case FE_IR_STACK_ADDR: {
+        FeIrStackAddr* stack_addr = (FeIrStackAddr*)ptr;
+        addr->base = cg.sp;
+        addr->slot = stack_slot(stack_addr->object);
+        return;
+    }
+    case FE_IR_FIELD_PTR: {
+        FeIrFieldPtr* field_ptr = (FeIrFieldPtr*)ptr;
+        addr->disp += fe_type_field_offset(cg.fn->mod, field_ptr->record, field_ptr->index);
+        fold_address(buf, field_ptr->source, addr);
+        return;
+    }
+    case FE_IR_INDEX_PTR: {
+        FeIrIndexPtr* index_ptr = (FeIrIndexPtr*)ptr;
+        FeAggregateType* array = fe_type_get_structure(cg.fn->mod, index_ptr->array);
+        u64 elem_size = fe_type_size(cg.fn->mod, array->array.sub);
+
+        if (index_ptr->index->kind == FE_IR_CONST) {
+            addr->disp += const_value((FeIrConst*)index_ptr->index) * (i64)elem_size;
+            fold_address(buf, index_ptr->source, addr);
+            return;
+        }
+        if (addr->index != 0) {
+            // index slot already taken, compute this address separately
+            break;
+        }
+
+        u32 index = index_vreg(buf, index_ptr->index);
+        if (elem_size == 1 || elem_size == 2 || elem_size == 4 || elem_size == 8) {
+            addr->index = index;
+            addr->scale = elem_size;
+        } else {
+            u32 scaled = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+            FeMachInst* imul = inst_rr(buf, FE_X64_INST_IMUL_RRI_64, scaled, index);
+            fe_mach_set_immediate(buf, imul, 0, FE_MACH_IMM_CONST, elem_size);
+            addr->index = scaled;
+            addr->scale = 1;
+        }
+        fold_address(buf, index_ptr->source, addr);
+        return;
+    }
+    default:
         break;
     }
-    fe_free(callconv_vregs);
-    return ir;
+    addr->base = value_vreg(buf, ptr);
 }
 
-static FeIr* emit_epilogue(FeMachBuffer* buf, FeFunction* fn, FeIr* ir) {
-    u32* callconv_vregs = fe_malloc(sizeof(u32) * fn->returns.len);
+// memory operands take up two registers and two immediates
+static void set_address(FeMachBuffer* buf, FeMachInst* inst, u8 reg, u8 imm, X64Address addr) {
+    fe_mach_set_vreg(buf, inst, reg, addr.base);
+    fe_mach_set_vreg(buf, inst, reg + 1, addr.index);
+    fe_mach_set_immediate(buf, inst, imm, FE_MACH_IMM_CONST, addr.scale);
+    if (addr.slot != 0) {
+        fe_mach_set_slot_immediate(buf, inst, imm + 1, addr.slot, (i32)addr.disp);
+    } else {
+        fe_mach_set_immediate(buf, inst, imm + 1, FE_MACH_IMM_CONST, (u64)addr.disp);
+    }
+}
 
-    FeIrReturn* ret = (FeIrReturn*)ir;
-    for_range(i, 0, ret->len) {
-        // create the vreg for the callconv register
-        u32 cconv_vreg = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
-        callconv_vregs[i] = cconv_vreg;
-        buf->vregs.at[cconv_vreg].real = mars_cconv_returnregs[i];
+static X64Address select_address(FeMachBuffer* buf, FeIr* ptr) {
+    X64Address addr = {.scale = 1};
+    fold_address(buf, ptr, &addr);
+    if (fits_simm32(addr.disp)) return addr;
+
+    // too far for a displacement, add it in a register instead
+    i64 disp = addr.disp;
+    addr.disp = 0;
+    if (addr.slot != 0) buf->slots.at[addr.slot].escapes = true;
+    u32 sum = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+    FeMachInst* lea = new_inst(buf, FE_X64_INST_LEA_64);
+    fe_mach_set_vreg(buf, lea, 0, sum);
+    set_address(buf, lea, 1, 0, addr);
+    u32 offset = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+    inst_ri(buf, FE_X64_INST_MOV_RI_64, offset, disp);
+    inst_rr(buf, FE_X64_INST_ADD_RR_64, sum, offset);
+    return (X64Address){.base = sum, .scale = 1};
+}
+
+static X64Address stack_address(FeStackObject* obj) {
+    return (X64Address){
+        .base = cg.sp,
+        .scale = 1,
+        .slot = stack_slot(obj),
+    };
+}
+
+// get a vreg holding the value of ir.
+// rematerializable values always get a fresh vreg.
+static u32 value_vreg(FeMachBuffer* buf, FeIr* ir) {
+    switch (ir->kind) {
+    case FE_IR_CONST: {
+        if (fe_type_is_float(ir->type)) return xmm_from_bits(buf, ir->type, float_bits((FeIrConst*)ir));
+        u32 vreg = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+        i64 value = const_value((FeIrConst*)ir);
+        if (width_of(ir->type) == 3) {
+            inst_ri(buf, FE_X64_INST_MOV_RI_64, vreg, value);
+        } else {
+            inst_ri(buf, FE_X64_INST_MOV_RI_32, vreg, (u32)value);
+        }
+        return vreg;
+    }
+    case FE_IR_STACK_ADDR:
+    case FE_IR_FIELD_PTR:
+    case FE_IR_INDEX_PTR: {
+        X64Address addr = select_address(buf, ir);
+        // once the address is out, the slot can't share memory with anything
+        if (addr.slot != 0) buf->slots.at[addr.slot].escapes = true;
+        u32 vreg = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+        FeMachInst* lea = new_inst(buf, FE_X64_INST_LEA_64);
+        fe_mach_set_vreg(buf, lea, 0, vreg);
+        set_address(buf, lea, 1, 0, addr);
+        return vreg;
+    }
+    case FE_IR_LOAD_SYMBOL: {
+        FeIrLoadSymbol* load_sym = (FeIrLoadSymbol*)ir;
+        u32 vreg = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+        FeMachInst* lea = new_inst(buf, FE_X64_INST_LEA_RIP_64);
+        fe_mach_set_vreg(buf, lea, 0, vreg);
+        fe_mach_set_immediate(buf, lea, 0, FE_MACH_IMM_SYMBOL, mach_symbol(load_sym->sym));
+        return vreg;
+    }
+    default: {
+        u32 vreg = get_ir_vreg(ir);
+        if (vreg == 0) CRASH("ir kind %d has no vreg", ir->kind);
+        return vreg;
+    }
+    }
+}
+
+// get a vreg that an x64 two-address instruction can overwrite with its result.
+// the source vreg is reused if this is its only use and it was defined in the
+// same block (otherwise a loop could see the clobbered value).
+static u32 two_address_dest(FeMachBuffer* buf, FeIr* source) {
+    if (is_remat(source)) return value_vreg(buf, source);
+    if (source->flags == 1 && is_ir_local(source)) return get_ir_vreg(source);
+
+    u32 dest = fe_mach_new_vreg(buf, regclass_of(source->type));
+    inst_rr(buf, mov_rr_for(source->type), dest, value_vreg(buf, source));
+    return dest;
+}
+
+static bool is_commutative(u16 kind) {
+    switch (kind) {
+    case FE_IR_ADD:
+    case FE_IR_IMUL:
+    case FE_IR_UMUL:
+    case FE_IR_AND:
+    case FE_IR_OR:
+    case FE_IR_XOR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static u32 gen_alu(FeMachBuffer* buf, FeIrBinop* binop, u16 rr_8, u16 ri_8) {
+    FeIr* lhs = binop->lhs;
+    FeIr* rhs = binop->rhs;
+    FeType t = binop->base.type;
+    if (is_commutative(binop->base.kind) && is_imm_operand(lhs, t) && !is_imm_operand(rhs, t)) {
+        FeIr* temp = lhs;
+        lhs = rhs;
+        rhs = temp;
+    }
+
+    u32 dest = two_address_dest(buf, lhs);
+    if (is_imm_operand(rhs, t)) {
+        inst_ri(buf, ri_8 + width_of(t), dest, const_value((FeIrConst*)rhs));
+    } else {
+        inst_rr(buf, rr_8 + width_of(t), dest, value_vreg(buf, rhs));
+    }
+    return dest;
+}
+
+static u32 gen_sse_arith(FeMachBuffer* buf, FeIrBinop* binop, u16 ss) {
+    u32 dest = two_address_dest(buf, binop->lhs);
+    inst_rr(buf, ss + sse_width_of(binop->base.type), dest, value_vreg(buf, binop->rhs));
+    return dest;
+}
+
+static u8 cost_of(u16 template) {
+    return fe_x64_inst_templates[template].cost;
+}
+
+static bool is_pow2(i64 x) {
+    return x > 0 && (x & (x - 1)) == 0;
+}
+
+static u32 gen_mul(FeMachBuffer* buf, FeIrBinop* binop) {
+    FeIr* lhs = binop->lhs;
+    FeIr* rhs = binop->rhs;
+    FeType t = binop->base.type;
+    // there's no 8-bit two-operand imul, but the low bits come out the same at 32
+    u8 width = max(width_of(t), 1) - 1;
+    if (is_imm_operand(lhs, t) && !is_imm_operand(rhs, t)) {
+        FeIr* temp = lhs;
+        lhs = rhs;
+        rhs = temp;
+    }
+
+    if (is_imm_operand(rhs, t)) {
+        i64 value = const_value((FeIrConst*)rhs);
+        if (is_pow2(value) && cost_of(FE_X64_INST_SHL_RI_8 + width_of(t)) < cost_of(FE_X64_INST_IMUL_RRI_16 + width)) {
+            u32 dest = two_address_dest(buf, lhs);
+            inst_ri(buf, FE_X64_INST_SHL_RI_8 + width_of(t), dest, __builtin_ctzll(value));
+            return dest;
+        }
+        u32 dest = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+        FeMachInst* imul = inst_rr(buf, FE_X64_INST_IMUL_RRI_16 + width, dest, value_vreg(buf, lhs));
+        fe_mach_set_immediate(buf, imul, 0, FE_MACH_IMM_CONST, value);
+        return dest;
+    }
+    u32 dest = two_address_dest(buf, lhs);
+    inst_rr(buf, FE_X64_INST_IMUL_RR_16 + width, dest, value_vreg(buf, rhs));
+    return dest;
+}
+
+static u32 gen_shift(FeMachBuffer* buf, FeIrBinop* binop, u16 rc_8, u16 ri_8) {
+    FeType t = binop->base.type;
+    u32 dest = two_address_dest(buf, binop->lhs);
+    if (binop->rhs->kind == FE_IR_CONST) {
+        i64 mask = width_of(t) == 3 ? 63 : 31;
+        inst_ri(buf, ri_8 + width_of(t), dest, const_value((FeIrConst*)binop->rhs) & mask);
+    } else {
+        u32 count = new_pinned_vreg(buf, FE_X64_GPR_RCX);
+        inst_rr(buf, FE_X64_INST_MOV_RR_32, count, value_vreg(buf, binop->rhs));
+        inst_rr(buf, rc_8 + width_of(t), dest, count);
+    }
+    return dest;
+}
+
+// widen an 8/16-bit value to 32 bits
+static u16 widen_to_32(FeType t, bool sign) {
+    switch (width_of(t)) {
+    case 0: return sign ? FE_X64_INST_MOVSX_32_8 : FE_X64_INST_MOVZX_32_8;
+    case 1: return sign ? FE_X64_INST_MOVSX_32_16 : FE_X64_INST_MOVZX_32_16;
+    case 2: return FE_X64_INST_MOV_RR_32;
+    default: return FE_X64_INST_MOV_RR_64;
+    }
+}
+
+static u32 gen_div(FeMachBuffer* buf, FeIrBinop* binop) {
+    FeType t = binop->base.type;
+    bool sign = binop->base.kind == FE_IR_IDIV || binop->base.kind == FE_IR_IMOD;
+    bool is_mod = binop->base.kind == FE_IR_IMOD || binop->base.kind == FE_IR_UMOD;
+    bool is_64 = width_of(t) == 3;
+
+    u32 rax = new_pinned_vreg(buf, FE_X64_GPR_RAX);
+    u32 rdx = new_pinned_vreg(buf, FE_X64_GPR_RDX);
+
+    inst_rr(buf, widen_to_32(t, sign), rax, value_vreg(buf, binop->lhs));
+
+    u32 divisor = value_vreg(buf, binop->rhs);
+    if (width_of(t) < 2) {
+        u32 widened = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+        inst_rr(buf, widen_to_32(t, sign), widened, divisor);
+        divisor = widened;
+    }
+
+    if (sign) {
+        inst_rr(buf, is_64 ? FE_X64_INST_CQO : FE_X64_INST_CDQ, rdx, rax);
+    } else {
+        inst_ri(buf, FE_X64_INST_MOV_RI_32, rdx, 0);
+    }
+
+    u16 div;
+    if (sign) div = is_64 ? FE_X64_INST_IDIV_R_64 : FE_X64_INST_IDIV_R_32;
+    else div = is_64 ? FE_X64_INST_DIV_R_64 : FE_X64_INST_DIV_R_32;
+    FeMachInst* minst = new_inst(buf, div);
+    fe_mach_set_vreg(buf, minst, 0, rax);
+    fe_mach_set_vreg(buf, minst, 1, rdx);
+    fe_mach_set_vreg(buf, minst, 2, divisor);
+
+    u32 dest = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+    inst_rr(buf, mov_rr_for(t), dest, is_mod ? rdx : rax);
+    return dest;
+}
+
+static u8 cond_code(u16 kind) {
+    switch (kind) {
+    case FE_IR_ULT: return FE_X64_CC_B;
+    case FE_IR_UGT: return FE_X64_CC_A;
+    case FE_IR_ULE: return FE_X64_CC_BE;
+    case FE_IR_UGE: return FE_X64_CC_AE;
+    case FE_IR_ILT: return FE_X64_CC_L;
+    case FE_IR_IGT: return FE_X64_CC_G;
+    case FE_IR_ILE: return FE_X64_CC_LE;
+    case FE_IR_IGE: return FE_X64_CC_GE;
+    case FE_IR_EQ: return FE_X64_CC_E;
+    case FE_IR_NE: return FE_X64_CC_NE;
+    default: UNREACHABLE;
+    }
+}
+
+// condition code for the same comparison with its operands swapped
+static u8 cond_code_swapped(u8 cc) {
+    switch (cc) {
+    case FE_X64_CC_L: return FE_X64_CC_G;
+    case FE_X64_CC_G: return FE_X64_CC_L;
+    case FE_X64_CC_LE: return FE_X64_CC_GE;
+    case FE_X64_CC_GE: return FE_X64_CC_LE;
+    case FE_X64_CC_B: return FE_X64_CC_A;
+    case FE_X64_CC_A: return FE_X64_CC_B;
+    case FE_X64_CC_BE: return FE_X64_CC_AE;
+    case FE_X64_CC_AE: return FE_X64_CC_BE;
+    default: return cc;
+    }
+}
+
+static bool is_compare(FeIr* ir) {
+    return _FE_IR_CMP_START < ir->kind && ir->kind < _FE_IR_CMP_END;
+}
+
+static bool is_float_compare(FeIr* ir) {
+    return is_compare(ir) && fe_type_is_float(((FeIrBinop*)ir)->lhs->type);
+}
+
+// ucomis sets the flags like an unsigned compare, and sets ZF, PF and CF all at
+// once if either side is a NaN. a < b is selected as b > a, so that NaNs come out
+// false without looking at PF. == and != still need PF, see gen_basic_block.
+static u8 gen_float_compare(FeMachBuffer* buf, FeIrBinop* cmp) {
+    FeIr* lhs = cmp->lhs;
+    FeIr* rhs = cmp->rhs;
+    u8 cc;
+    switch (cmp->base.kind) {
+    case FE_IR_ULT:
+    case FE_IR_ILT: lhs = cmp->rhs; rhs = cmp->lhs; cc = FE_X64_CC_A; break;
+    case FE_IR_ULE:
+    case FE_IR_ILE: lhs = cmp->rhs; rhs = cmp->lhs; cc = FE_X64_CC_AE; break;
+    case FE_IR_UGT:
+    case FE_IR_IGT: cc = FE_X64_CC_A; break;
+    case FE_IR_UGE:
+    case FE_IR_IGE: cc = FE_X64_CC_AE; break;
+    case FE_IR_EQ: cc = FE_X64_CC_E; break;
+    case FE_IR_NE: cc = FE_X64_CC_NE; break;
+    default: UNREACHABLE;
+    }
+    inst_rr(buf, FE_X64_INST_UCOMISS_RR + sse_width_of(lhs->type), value_vreg(buf, lhs), value_vreg(buf, rhs));
+    return cc;
+}
+
+// emit a cmp and return the condition code that is set if the comparison is true
+static u8 gen_compare(FeMachBuffer* buf, FeIrBinop* cmp) {
+    FeIr* lhs = cmp->lhs;
+    FeIr* rhs = cmp->rhs;
+    FeType t = lhs->type;
+    if (fe_type_is_float(t)) return gen_float_compare(buf, cmp);
+    u8 cc = cond_code(cmp->base.kind);
+    if (is_imm_operand(lhs, t) && !is_imm_operand(rhs, t)) {
+        FeIr* temp = lhs;
+        lhs = rhs;
+        rhs = temp;
+        cc = cond_code_swapped(cc);
+    }
+
+    if (is_imm_operand(rhs, t)) {
+        inst_ri(buf, FE_X64_INST_CMP_RI_8 + width_of(t), value_vreg(buf, lhs), const_value((FeIrConst*)rhs));
+    } else {
+        inst_rr(buf, FE_X64_INST_CMP_RR_8 + width_of(t), value_vreg(buf, lhs), value_vreg(buf, rhs));
+    }
+    return cc;
+}
+
+// can this comparison be selected at the branch that uses it, as a cmp + jcc?
+// only phi movs may sit between the two, and they must not overwrite the operands.
+static bool is_fused_with_branch(FeIr* cmp) {
+    if (cmp->flags != 1) return false;
+    // float equality takes two conditions, which a single jcc can't check
+    if (is_float_compare(cmp) && (cmp->kind == FE_IR_EQ || cmp->kind == FE_IR_NE)) return false;
+    FeIrBinop* binop = (FeIrBinop*)cmp;
+    FeIr* ir = cmp->next;
+    for (; ir->kind == FE_IR_MOV; ir = ir->next) {
+        FeIrMov* mov = (FeIrMov*)ir;
+        if (mov->source->kind == FE_IR_INDEX_PTR) return false; // may need an imul
+        u32 dest = get_ir_vreg(ir);
+        if (dest != 0 && (dest == get_ir_vreg(binop->lhs) || dest == get_ir_vreg(binop->rhs))) return false;
+    }
+    return ir->kind == FE_IR_BRANCH && ((FeIrBranch*)ir)->cond == cmp;
+}
+
+static u32 gen_convert(FeMachBuffer* buf, FeIrUnop* unop) {
+    FeType to = unop->base.type;
+    FeType from = unop->source->type;
+    u32 source = value_vreg(buf, unop->source);
+    u32 dest = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+
+    u16 kind = mov_rr_for(to);
+    if (width_of(from) < width_of(to)) {
+        if (unop->base.kind == FE_IR_SIGNEXT) {
+            if (width_of(to) == 3) {
+                switch (width_of(from)) {
+                case 0: kind = FE_X64_INST_MOVSX_64_8; break;
+                case 1: kind = FE_X64_INST_MOVSX_64_16; break;
+                case 2: kind = FE_X64_INST_MOVSXD_64_32; break;
+                }
+            } else {
+                kind = widen_to_32(from, true);
+            }
+        } else if (unop->base.kind == FE_IR_ZEROEXT) {
+            // 32-bit operations zero the upper half of 64-bit registers
+            kind = widen_to_32(from, false);
+        }
+    }
+    inst_rr(buf, kind, dest, source);
+    return dest;
+}
 
-        // generate the mov
-        FeMachInst* mov = new_inst(buf, FE_X64_INST_MOV_RR_64);
-        fe_mach_set_vreg(buf, mov, 1, get_ir_vreg(ret->sources[i]));
-        fe_mach_set_vreg(buf, mov, 0, cconv_vreg);
+// cvtsi2s* only converts signed integers. values with the top bit set are
+// halved first (keeping the lowest bit, so they still round right) and the
+// result is doubled again. this picks both with masks instead of a branch.
+static u32 gen_u64_to_float(FeMachBuffer* buf, FeType to, u32 source, u32 dest) {
+    u32 big = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+    inst_rr(buf, FE_X64_INST_MOV_RR_64, big, source);
+    inst_ri(buf, FE_X64_INST_SAR_RI_64, big, 63);
+
+    u32 half = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+    u32 low = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+    inst_rr(buf, FE_X64_INST_MOV_RR_64, half, source);
+    inst_ri(buf, FE_X64_INST_SHR_RI_64, half, 1);
+    inst_rr(buf, FE_X64_INST_MOV_RR_64, low, source);
+    inst_ri(buf, FE_X64_INST_AND_RI_64, low, 1);
+    inst_rr(buf, FE_X64_INST_OR_RR_64, half, low);
+
+    // half = big ? half : source
+    inst_rr(buf, FE_X64_INST_XOR_RR_64, half, source);
+    inst_rr(buf, FE_X64_INST_AND_RR_64, half, big);
+    inst_rr(buf, FE_X64_INST_XOR_RR_64, half, source);
+    inst_rr(buf, FE_X64_INST_CVTSI2SS_64 + 2 * sse_width_of(to), dest, half);
+
+    // multiply by 2.0 or 1.0, built by bumping the exponent of 1.0
+    bool f64 = sse_width_of(to) == 1;
+    u32 scale = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+    u32 one = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+    inst_ri(buf, FE_X64_INST_MOV_RI_64, scale, f64 ? 1ll << 52 : 1ll << 23);
+    inst_rr(buf, FE_X64_INST_AND_RR_64, scale, big);
+    inst_ri(buf, FE_X64_INST_MOV_RI_64, one, f64 ? 0x3FF0000000000000ll : 0x3F800000ll);
+    inst_rr(buf, FE_X64_INST_ADD_RR_64, scale, one);
+    u32 factor = fe_mach_new_vreg(buf, FE_X64_REGCLASS_XMM);
+    inst_rr(buf, f64 ? FE_X64_INST_MOVQ_XR_64 : FE_X64_INST_MOVD_XR_32, factor, scale);
+    inst_rr(buf, FE_X64_INST_MULSS_RR + sse_width_of(to), dest, factor);
+    return dest;
+}
+
+// conversions with a float on either side.
+// trunc goes from f64 to f32, or from a float to an integer (rounding toward zero).
+// signext and zeroext go from f32 to f64, or from a signed or unsigned integer to a float.
+// bitcast keeps the bits as they are.
+static u32 gen_float_convert(FeMachBuffer* buf, FeIrUnop* unop) {
+    FeType to = unop->base.type;
+    FeType from = unop->source->type;
+    u32 source = value_vreg(buf, unop->source);
+    u32 dest = fe_mach_new_vreg(buf, regclass_of(to));
+
+    if (unop->base.kind == FE_IR_BITCAST) {
+        if (fe_type_size(cg.fn->mod, to) != fe_type_size(cg.fn->mod, from)) {
+            FE_FATAL(cg.fn->mod, "bitcast between types of different sizes");
+        }
+        u16 kind;
+        if (fe_type_is_float(to) && fe_type_is_float(from)) kind = FE_X64_INST_MOVAPS_RR;
+        else if (fe_type_is_float(to)) kind = sse_width_of(to) == 1 ? FE_X64_INST_MOVQ_XR_64 : FE_X64_INST_MOVD_XR_32;
+        else kind = sse_width_of(from) == 1 ? FE_X64_INST_MOVQ_RX_64 : FE_X64_INST_MOVD_RX_32;
+        inst_rr(buf, kind, dest, source);
+        return dest;
+    }
+
+    if (fe_type_is_float(to) && fe_type_is_float(from)) {
+        if (to == from) inst_rr(buf, FE_X64_INST_MOVAPS_RR, dest, source);
+        else inst_rr(buf, sse_width_of(to) == 1 ? FE_X64_INST_CVTSS2SD : FE_X64_INST_CVTSD2SS, dest, source);
+        return dest;
+    }
+
+    if (fe_type_is_float(from)) {
+        // always convert to 64 bits, so unsigned 32-bit values above INT32_MAX come out right
+        inst_rr(buf, FE_X64_INST_CVTTSS2SI_64 + 2 * sse_width_of(from), dest, source);
+        return dest;
+    }
+
+    // cvtsi2s* only takes 32 or 64-bit signed integers
+    bool is_64 = width_of(from) == 3;
+    if (unop->base.kind == FE_IR_ZEROEXT) {
+        if (is_64) return gen_u64_to_float(buf, to, source, dest);
+        // zero extended to 64 bits, it can't be negative
+        u32 wide = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+        inst_rr(buf, widen_to_32(from, false), wide, source);
+        source = wide;
+        is_64 = true;
+    } else if (width_of(from) < 2) {
+        u32 wide = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+        inst_rr(buf, widen_to_32(from, true), wide, source);
+        source = wide;
+    }
+    inst_rr(buf, FE_X64_INST_CVTSI2SS_32 + 2 * sse_width_of(to) + is_64, dest, source);
+    return dest;
+}
+
+static u16 load_for(FeType t) {
+    switch (width_of(t)) {
+    case 0: return FE_X64_INST_MOVZX_RM_32_8;
+    case 1: return FE_X64_INST_MOVZX_RM_32_16;
+    case 2: return FE_X64_INST_MOV_RM_32;
+    default: return FE_X64_INST_MOV_RM_64;
+    }
+}
+
+static u32 gen_load(FeMachBuffer* buf, FeType t, X64Address addr) {
+    u32 dest = fe_mach_new_vreg(buf, regclass_of(t));
+    u16 kind = fe_type_is_float(t) ? FE_X64_INST_MOVSS_RM + sse_width_of(t) : load_for(t);
+    FeMachInst* load = new_inst(buf, kind);
+    fe_mach_set_vreg(buf, load, 0, dest);
+    set_address(buf, load, 1, 0, addr);
+    return dest;
+}
+
+static void gen_store(FeMachBuffer* buf, FeIr* value, X64Address addr) {
+    FeType t = value->type;
+    if (fe_type_is_float(t)) {
+        u32 source = value_vreg(buf, value);
+        FeMachInst* store = new_inst(buf, FE_X64_INST_MOVSS_MR + sse_width_of(t));
+        set_address(buf, store, 0, 0, addr);
+        fe_mach_set_vreg(buf, store, 2, source);
+    } else if (is_imm_operand(value, t)) {
+        FeMachInst* store = new_inst(buf, FE_X64_INST_MOV_MI_8 + width_of(t));
+        set_address(buf, store, 0, 0, addr);
+        fe_mach_set_immediate(buf, store, 2, FE_MACH_IMM_CONST, const_value((FeIrConst*)value));
+    } else {
+        u32 source = value_vreg(buf, value);
+        FeMachInst* store = new_inst(buf, FE_X64_INST_MOV_MR_8 + width_of(t));
+        set_address(buf, store, 0, 0, addr);
+        fe_mach_set_vreg(buf, store, 2, source);
+    }
+}
+
+static FeMachLocalLabel* block_label(FeBasicBlock* bb) {
+    return (FeMachLocalLabel*)bb->flags;
+}
+
+static void gen_jump(FeMachBuffer* buf, FeBasicBlock* dest) {
+    fe_mach_append(buf, fe_mach_new(buf, FE_MACH_CFG_JUMP));
+    FeMachInst* jmp = new_inst(buf, FE_X64_INST_JMP);
+    fe_mach_set_immediate(buf, jmp, 0, FE_MACH_IMM_LABEL, (u64)block_label(dest));
+}
+
+static void gen_branch(FeMachBuffer* buf, FeIrBranch* branch) {
+    FeIr* cond = branch->cond;
+    u8 cc;
+    if (is_compare(cond) && is_fused_with_branch(cond)) {
+        cc = gen_compare(buf, (FeIrBinop*)cond);
+    } else if (cond->kind == FE_IR_CONST) {
+        gen_jump(buf, const_value((FeIrConst*)cond) ? branch->if_true : branch->if_false);
+        return;
+    } else {
+        u32 vreg = value_vreg(buf, cond);
+        inst_rr(buf, FE_X64_INST_TEST_RR_8, vreg, vreg);
+        cc = FE_X64_CC_NE;
+    }
+
+    fe_mach_append(buf, fe_mach_new(buf, FE_MACH_CFG_BRANCH));
+    FeMachInst* jcc = new_inst(buf, FE_X64_INST_JCC);
+    fe_mach_set_immediate(buf, jcc, 0, FE_MACH_IMM_CONST, cc);
+    fe_mach_set_immediate(buf, jcc, 1, FE_MACH_IMM_LABEL, (u64)block_label(branch->if_true));
+    gen_jump(buf, branch->if_false);
+}
+
+// types of a call's parameters and returns, for classification
+static const X64Cconv* call_signature(FeIr* ir, FeType** params, FeType** returns, u16* returns_len) {
+    FeIrCall* call = (FeIrCall*)ir;
+    *params = fe_malloc(sizeof(FeType) * call->len);
+    for_range(i, 0, call->len) (*params)[i] = call->params[i]->type;
+
+    if (ir->kind == FE_IR_CALL) {
+        *returns_len = call->source->returns.len;
+        *returns = fe_malloc(sizeof(FeType) * *returns_len);
+        for_range(i, 0, *returns_len) (*returns)[i] = call->source->returns.at[i]->type;
+        return get_cconv(cg.fn->mod, call->source->cconv);
+    }
+
+    PtrCallReturns* rets = ptrmap_get(&ptrcall_returns, ir);
+    *returns_len = rets == PTRMAP_NOT_FOUND ? 0 : rets->len;
+    *returns = fe_malloc(sizeof(FeType) * *returns_len);
+    for_range(i, 0, *returns_len) (*returns)[i] = rets->types[i];
+    return get_cconv(cg.fn->mod, ((FeIrPtrCall*)ir)->callconv);
+}
+
+// size of the stack argument area a call needs
+static u32 call_stack_size(FeIr* ir) {
+    FeIrCall* call = (FeIrCall*)ir;
+    FeType* params;
+    FeType* returns;
+    u16 returns_len;
+    const X64Cconv* cc = call_signature(ir, &params, &returns, &returns_len);
+
+    ArgLocation* locs = fe_malloc(sizeof(ArgLocation) * call->len);
+    u32 size = classify_params(cc, params, call->len, locs);
+    fe_free(locs);
+    fe_free(params);
+    fe_free(returns);
+    return size;
+}
+
+// selects both FE_IR_CALL and FE_IR_PTR_CALL
+static void gen_call(FeMachBuffer* buf, FeIr* ir) {
+    FeIrCall* call = (FeIrCall*)ir;
+    FeType* param_types;
+    FeType* return_types;
+    u16 returns_len;
+    const X64Cconv* cc = call_signature(ir, &param_types, &return_types, &returns_len);
+
+    ArgLocation* params = fe_malloc(sizeof(ArgLocation) * call->len);
+    ArgLocation* returns = fe_malloc(sizeof(ArgLocation) * returns_len);
+    classify_params(cc, param_types, call->len, params);
+    classify_returns(cg.fn->mod, cc, return_types, returns_len, returns);
+
+    u32 target = 0;
+    if (ir->kind == FE_IR_PTR_CALL) target = value_vreg(buf, ((FeIrPtrCall*)ir)->source);
+
+    // results get consecutive vregs, so retrieves can find them by index
+    u32 results = buf->vregs.len;
+    for_range(i, 0, returns_len) fe_mach_new_vreg(buf, regclass_of(return_types[i]));
+
+    // stack arguments go at the bottom of our frame, where the callee expects them
+    for_range(i, 0, call->len) {
+        if (params[i].gpr != 0 || params[i].xmm != 0) continue;
+        X64Address addr = {.base = cg.sp, .scale = 1, .disp = params[i].stack};
+        gen_store(buf, call->params[i], addr);
+    }
+
+    // look every argument up at once, anything without a vreg goes through value_vreg
+    void** arg_vregs = fe_malloc(sizeof(void*) * call->len);
+    ptrmap_get_many(&ir2vreg, (void**)call->params, arg_vregs, call->len);
+
+    u32* param_vregs = fe_malloc(sizeof(u32) * call->len);
+    for_range(i, 0, call->len) {
+        param_vregs[i] = 0;
+        if (params[i].gpr == 0 && params[i].xmm == 0) continue;
+        param_vregs[i] = new_pinned_arg(buf, params[i]);
+        bool found = arg_vregs[i] != PTRMAP_NOT_FOUND && !is_remat(call->params[i]);
+        u32 source = found ? (u32)(u64)arg_vregs[i] : value_vreg(buf, call->params[i]);
+        inst_rr(buf, mov_arg_for(params[i]), param_vregs[i], source);
+    }
+    fe_free(arg_vregs);
+
+    // keep every other caller-saved register occupied across the call
+    u32 clobbers[sizeof(caller_saved_regs) + _FE_X64_XMM_COUNT];
+    u32 clobbers_len = 0;
+    for_range(i, 0, sizeof(caller_saved_regs)) {
+        bool is_param = false;
+        for_range(p, 0, call->len) {
+            if (params[p].gpr == caller_saved_regs[i]) is_param = true;
+        }
+        if (is_param) continue;
+        clobbers[clobbers_len] = new_pinned_vreg(buf, caller_saved_regs[i]);
+        fe_mach_append(buf, fe_mach_new_lifetime_begin(buf, clobbers[clobbers_len]));
+        clobbers_len++;
+    }
+    // none of the xmm registers survive a call
+    if (cg.has_floats) for_range(real, FE_X64_XMM0, _FE_X64_XMM_COUNT) {
+        ArgLocation xmm = {.xmm = real - FE_X64_XMM0 + 1};
+        bool is_param = false;
+        for_range(p, 0, call->len) {
+            if (params[p].xmm == xmm.xmm) is_param = true;
+        }
+        if (is_param) continue;
+        clobbers[clobbers_len] = new_pinned_arg(buf, xmm);
+        fe_mach_append(buf, fe_mach_new_lifetime_begin(buf, clobbers[clobbers_len]));
+        clobbers_len++;
+    }
+
+    if (ir->kind == FE_IR_CALL) {
+        FeMachInst* minst = new_inst(buf, FE_X64_INST_CALL);
+        fe_mach_set_immediate(buf, minst, 0, FE_MACH_IMM_SYMBOL, mach_symbol(call->source->sym));
+    } else {
+        FeMachInst* minst = new_inst(buf, FE_X64_INST_CALL_R);
+        fe_mach_set_vreg(buf, minst, 0, target);
+    }
+
+    for_range(i, 0, call->len) {
+        if (param_vregs[i] == 0) continue;
+        fe_mach_append(buf, fe_mach_new_lifetime_end(buf, param_vregs[i]));
+    }
+    for_range(i, 0, clobbers_len) {
+        fe_mach_append(buf, fe_mach_new_lifetime_end(buf, clobbers[i]));
+    }
+
+    for_range(i, 0, returns_len) {
+        u32 cconv_vreg = new_pinned_arg(buf, returns[i]);
+        fe_mach_append(buf, fe_mach_new_lifetime_begin(buf, cconv_vreg));
+        inst_rr(buf, mov_arg_for(returns[i]), results + i, cconv_vreg);
+    }
+
+    put_ir_vreg(ir, results);
+
+    fe_free(param_vregs);
+    fe_free(params);
+    fe_free(returns);
+    fe_free(param_types);
+    fe_free(return_types);
+}
+
+// set up the frame, copy callee-saved registers out of the way and move the
+// parameters out of their cconv locations. emitted once, before the entry block.
+static void emit_prologue(FeMachBuffer* buf, FeFunction* fn) {
+    FeIrParam** param_irs = fe_malloc(sizeof(FeIrParam*) * fn->params.len);
+    FeType* types = fe_malloc(sizeof(FeType) * fn->params.len);
+    ArgLocation* locs = fe_malloc(sizeof(ArgLocation) * fn->params.len);
+    u32* cconv_vregs = fe_malloc(sizeof(u32) * fn->params.len);
+    u32 saved_real[sizeof(callee_saved_regs)];
+
+    for_range(i, 0, fn->params.len) {
+        param_irs[i] = NULL;
+        types[i] = fn->params.at[i]->type;
+    }
+    for_fe_ir(ir, *fn->blocks.at[0]) {
+        if (ir->kind == FE_IR_PARAM) param_irs[((FeIrParam*)ir)->index] = (FeIrParam*)ir;
+    }
+    classify_params(cg.cconv, types, fn->params.len, locs);
+
+    // everything live on entry begins its lifetime before any code,
+    // so nothing gets allocated on top of it
+    fe_mach_append(buf, fe_mach_new_lifetime_begin(buf, cg.sp));
+    if (cg.frame_pointer) {
+        cg.fp = new_pinned_vreg(buf, FE_X64_GPR_RBP);
+        fe_mach_append(buf, fe_mach_new_lifetime_begin(buf, cg.fp));
+    }
+    for_range(i, 0, fn->params.len) {
+        cconv_vregs[i] = 0;
+        if (param_irs[i] == NULL) continue;
+        if (locs[i].gpr == 0 && locs[i].xmm == 0) continue;
+        cconv_vregs[i] = new_pinned_arg(buf, locs[i]);
+        fe_mach_append(buf, fe_mach_new_lifetime_begin(buf, cconv_vregs[i]));
     }
+    cg.saved_len = 0;
+    for_range(i, 0, sizeof(callee_saved_regs)) {
+        if (cg.frame_pointer && callee_saved_regs[i] == FE_X64_GPR_RBP) continue;
+        saved_real[cg.saved_len] = new_pinned_vreg(buf, callee_saved_regs[i]);
+        fe_mach_append(buf, fe_mach_new_lifetime_begin(buf, saved_real[cg.saved_len]));
+        cg.saved_len++;
+    }
+
+    if (cg.frame_pointer) {
+        fe_mach_set_vreg(buf, new_inst(buf, FE_X64_INST_PUSH_R), 0, cg.fp);
+        inst_rr(buf, FE_X64_INST_MOV_RR_64, cg.fp, cg.sp);
+    }
+    // the frame size isn't known until regalloc is done, and this
+    // gets removed by frame layout if it turns out to be zero
+    FeMachInst* sub = inst_ri(buf, FE_X64_INST_SUB_RI_64, cg.sp, 0);
+    fe_mach_set_immediate(buf, sub, 0, FE_MACH_IMM_FRAME_SIZE, 0);
+
+    // callee-saved registers are kept in vregs that live until every return.
+    // they're hinted to stay where they are, so when a register is left alone
+    // the copies are reduced away and cost nothing.
+    for_range(i, 0, cg.saved_len) {
+        u8 real = buf->vregs.at[saved_real[i]].real;
+        cg.saved[i] = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+        buf->vregs.at[cg.saved[i]].hint = real;
+        inst_rr(buf, FE_X64_INST_MOV_RR_64, cg.saved[i], saved_real[i]);
+    }
+
+    for_range(i, 0, fn->params.len) {
+        if (param_irs[i] == NULL) continue;
+        u32 param = fe_mach_new_vreg(buf, regclass_of(types[i]));
+        if (cconv_vregs[i] != 0) {
+            buf->vregs.at[param].hint = buf->vregs.at[cconv_vregs[i]].real;
+            inst_rr(buf, mov_arg_for(locs[i]), param, cconv_vregs[i]);
+        } else {
+            // stack arguments sit above the frame, the return address (and saved rbp)
+            X64Address addr = {.base = cg.sp, .scale = 1};
+            u16 kind = fe_type_is_float(types[i]) ? FE_X64_INST_MOVSS_RM + sse_width_of(types[i]) : FE_X64_INST_MOV_RM_64;
+            FeMachInst* load = new_inst(buf, kind);
+            fe_mach_set_vreg(buf, load, 0, param);
+            set_address(buf, load, 1, 0, addr);
+            u64 above = 8 + (cg.frame_pointer ? 8 : 0) + locs[i].stack;
+            fe_mach_set_immediate(buf, load, 1, FE_MACH_IMM_FRAME_SIZE, above);
+        }
+        put_ir_vreg((FeIr*)param_irs[i], param);
+    }
+
+    fe_free(param_irs);
+    fe_free(types);
+    fe_free(locs);
+    fe_free(cconv_vregs);
+}
+
+static void emit_epilogue(FeMachBuffer* buf, FeFunction* fn, FeIrReturn* ret) {
+    FeType* types = fe_malloc(sizeof(FeType) * ret->len);
+    ArgLocation* locs = fe_malloc(sizeof(ArgLocation) * ret->len);
+    u32* cconv_vregs = fe_malloc(sizeof(u32) * ret->len);
+    u32 restored[sizeof(callee_saved_regs)];
+
+    for_range(i, 0, ret->len) types[i] = fn->returns.at[i]->type;
+    classify_returns(fn->mod, cg.cconv, types, ret->len, locs);
 
     for_range(i, 0, ret->len) {
-        // generate the lifetime endpoints
-        fe_mach_append(buf, fe_mach_new_lifetime_end(buf, callconv_vregs[i]));
+        cconv_vregs[i] = new_pinned_arg(buf, locs[i]);
+        inst_rr(buf, mov_arg_for(locs[i]), cconv_vregs[i], value_vreg(buf, ret->sources[i]));
+    }
+    for_range(i, 0, cg.saved_len) {
+        restored[i] = new_pinned_vreg(buf, buf->vregs.at[cg.saved[i]].hint);
+        inst_rr(buf, FE_X64_INST_MOV_RR_64, restored[i], cg.saved[i]);
     }
 
-    fe_free(callconv_vregs);
-    return ir;
+    FeMachInst* add = inst_ri(buf, FE_X64_INST_ADD_RI_64, cg.sp, 0);
+    fe_mach_set_immediate(buf, add, 0, FE_MACH_IMM_FRAME_SIZE, 0);
+    if (cg.frame_pointer) fe_mach_set_vreg(buf, new_inst(buf, FE_X64_INST_POP_R), 0, cg.fp);
+
+    for_range(i, 0, ret->len) {
+        fe_mach_append(buf, fe_mach_new_lifetime_end(buf, cconv_vregs[i]));
+    }
+    for_range(i, 0, cg.saved_len) {
+        fe_mach_append(buf, fe_mach_new_lifetime_end(buf, restored[i]));
+    }
+    if (cg.frame_pointer) fe_mach_append(buf, fe_mach_new_lifetime_end(buf, cg.fp));
+    fe_mach_append(buf, fe_mach_new_lifetime_end(buf, cg.sp));
+    fe_mach_append(buf, fe_mach_new(buf, FE_MACH_CFG_JUMP));
+    new_inst(buf, FE_X64_INST_RET);
+
+    fe_free(types);
+    fe_free(locs);
+    fe_free(cconv_vregs);
+}
+
+static u32 gen_setcc(FeMachBuffer* buf, u8 cc) {
+    u32 dest = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
+    FeMachInst* setcc = new_inst(buf, FE_X64_INST_SETCC);
+    fe_mach_set_vreg(buf, setcc, 0, dest);
+    fe_mach_set_immediate(buf, setcc, 0, FE_MACH_IMM_CONST, cc);
+    return dest;
 }
 
 static void gen_basic_block(FeMachBuffer* buf, FeBasicBlock* bb) {
     // generate block label
-    FeMachLocalLabel* block_label = (FeMachLocalLabel*)fe_mach_append(buf, fe_mach_new(buf, FE_MACH_LABEL_LOCAL));
-    block_label->name = bb->name;
+    if (bb != bb->function->blocks.at[0]) {
+        fe_mach_append(buf, fe_mach_new(buf, FE_MACH_CFG_TARGET));
+    }
+    fe_mach_append(buf, (FeMach*)block_label(bb));
 
-    FeMachInst* minst;
     for_fe_ir(ir, *bb) switch (ir->kind) {
     case FE_IR_PARAM:
-        ir = emit_prologue(buf, bb->function, ir);
-        break;
+        break; // already lowered by the prologue
     case FE_IR_RETURN:
-        ir = emit_epilogue(buf, bb->function, ir);
-        new_inst(buf, FE_X64_INST_RET);
-        break;
-    case FE_IR_ADD: {
-        FeIrBinop* binop = (FeIrBinop*)ir;
-        // insert a mov to move the first operand into the lhs
-        u32 lhs_vreg;
-        if (binop->lhs->flags != 1) {
-            lhs_vreg = fe_mach_new_vreg(buf, FE_X64_REGCLASS_GPR);
-            FeMachInst* mov = new_inst(buf, FE_X64_INST_MOV_RR_64);
-            fe_mach_set_vreg(buf, mov, 0, lhs_vreg);
-            fe_mach_set_vreg(buf, mov, 1, get_ir_vreg(binop->lhs));
+        emit_epilogue(buf, bb->function, (FeIrReturn*)ir);
+        break;
+
+    // folded into users or rematerialized at each use
+    case FE_IR_CONST:
+    case FE_IR_STACK_ADDR:
+    case FE_IR_FIELD_PTR:
+    case FE_IR_INDEX_PTR:
+    case FE_IR_LOAD_SYMBOL:
+        break;
+
+    case FE_IR_ADD:
+        put_ir_vreg(ir, gen_alu(buf, (FeIrBinop*)ir, FE_X64_INST_ADD_RR_8, FE_X64_INST_ADD_RI_8));
+        break;
+    case FE_IR_SUB:
+        put_ir_vreg(ir, gen_alu(buf, (FeIrBinop*)ir, FE_X64_INST_SUB_RR_8, FE_X64_INST_SUB_RI_8));
+        break;
+    case FE_IR_AND:
+        put_ir_vreg(ir, gen_alu(buf, (FeIrBinop*)ir, FE_X64_INST_AND_RR_8, FE_X64_INST_AND_RI_8));
+        break;
+    case FE_IR_OR:
+        put_ir_vreg(ir, gen_alu(buf, (FeIrBinop*)ir, FE_X64_INST_OR_RR_8, FE_X64_INST_OR_RI_8));
+        break;
+    case FE_IR_XOR:
+        put_ir_vreg(ir, gen_alu(buf, (FeIrBinop*)ir, FE_X64_INST_XOR_RR_8, FE_X64_INST_XOR_RI_8));
+        break;
+    case FE_IR_IMUL:
+    case FE_IR_UMUL: // the low half of the product doesn't depend on signedness
+        put_ir_vreg(ir, gen_mul(buf, (FeIrBinop*)ir));
+        break;
+    case FE_IR_IDIV:
+    case FE_IR_UDIV:
+    case FE_IR_IMOD:
+    case FE_IR_UMOD:
+        put_ir_vreg(ir, gen_div(buf, (FeIrBinop*)ir));
+        break;
+    case FE_IR_SHL:
+        put_ir_vreg(ir, gen_shift(buf, (FeIrBinop*)ir, FE_X64_INST_SHL_RC_8, FE_X64_INST_SHL_RI_8));
+        break;
+    case FE_IR_LSR:
+        put_ir_vreg(ir, gen_shift(buf, (FeIrBinop*)ir, FE_X64_INST_SHR_RC_8, FE_X64_INST_SHR_RI_8));
+        break;
+    case FE_IR_ASR:
+        put_ir_vreg(ir, gen_shift(buf, (FeIrBinop*)ir, FE_X64_INST_SAR_RC_8, FE_X64_INST_SAR_RI_8));
+        break;
+
+    case FE_IR_ULT:
+    case FE_IR_UGT:
+    case FE_IR_ULE:
+    case FE_IR_UGE:
+    case FE_IR_ILT:
+    case FE_IR_IGT:
+    case FE_IR_ILE:
+    case FE_IR_IGE:
+    case FE_IR_EQ:
+    case FE_IR_NE: {
+        // selected later as part of a cmp + jcc
+        if (is_fused_with_branch(ir)) break;
+
+        u8 cc = gen_compare(buf, (FeIrBinop*)ir);
+        u32 dest = gen_setcc(buf, cc);
+        // NaNs compare unordered, which == has to reject and != has to accept
+        if (is_float_compare(ir) && ir->kind == FE_IR_EQ) {
+            inst_rr(buf, FE_X64_INST_AND_RR_8, dest, gen_setcc(buf, FE_X64_CC_NP));
+        } else if (is_float_compare(ir) && ir->kind == FE_IR_NE) {
+            inst_rr(buf, FE_X64_INST_OR_RR_8, dest, gen_setcc(buf, FE_X64_CC_P));
+        }
+        put_ir_vreg(ir, dest);
+        break;
+    }
+
+    case FE_IR_NOT: {
+        FeIrUnop* unop = (FeIrUnop*)ir;
+        u32 dest = two_address_dest(buf, unop->source);
+        // bools only use their lowest bit
+        if (ir->type == FE_TYPE_BOOL) inst_ri(buf, FE_X64_INST_XOR_RI_8, dest, 1);
+        else fe_mach_set_vreg(buf, new_inst(buf, FE_X64_INST_NOT_R_8 + width_of(ir->type)), 0, dest);
+        put_ir_vreg(ir, dest);
+        break;
+    }
+    case FE_IR_NEG: {
+        FeIrUnop* unop = (FeIrUnop*)ir;
+        u32 dest = two_address_dest(buf, unop->source);
+        if (fe_type_is_float(ir->type)) {
+            // flip the sign bit
+            u64 sign = sse_width_of(ir->type) == 1 ? 1ull << 63 : 1ull << 31;
+            inst_rr(buf, FE_X64_INST_XORPS_RR, dest, xmm_from_bits(buf, ir->type, sign));
+        } else {
+            fe_mach_set_vreg(buf, new_inst(buf, FE_X64_INST_NEG_R_8 + width_of(ir->type)), 0, dest);
+        }
+        put_ir_vreg(ir, dest);
+        break;
+    }
+    case FE_IR_BITCAST:
+    case FE_IR_TRUNC:
+    case FE_IR_SIGNEXT:
+    case FE_IR_ZEROEXT:
+        if (fe_type_is_float(ir->type) || fe_type_is_float(((FeIrUnop*)ir)->source->type)) {
+            put_ir_vreg(ir, gen_float_convert(buf, (FeIrUnop*)ir));
         } else {
-            lhs_vreg = get_ir_vreg(binop->lhs);
+            put_ir_vreg(ir, gen_convert(buf, (FeIrUnop*)ir));
         }
+        break;
 
-        switch (ir->type) {
-        case FE_TYPE_I64: minst = new_inst(buf, FE_X64_INST_ADD_RR_64); break;
-        default: TODO("");
+    case FE_IR_LOAD:
+    case FE_IR_VOL_LOAD: {
+        FeIrLoad* load = (FeIrLoad*)ir;
+        put_ir_vreg(ir, gen_load(buf, ir->type, select_address(buf, load->location)));
+        break;
+    }
+    case FE_IR_STACK_LOAD: {
+        FeIrStackLoad* load = (FeIrStackLoad*)ir;
+        put_ir_vreg(ir, gen_load(buf, ir->type, stack_address(load->location)));
+        break;
+    }
+    case FE_IR_STORE:
+    case FE_IR_VOL_STORE: {
+        FeIrStore* store = (FeIrStore*)ir;
+        gen_store(buf, store->value, select_address(buf, store->location));
+        break;
+    }
+    case FE_IR_STACK_STORE: {
+        FeIrStackStore* store = (FeIrStackStore*)ir;
+        gen_store(buf, store->value, stack_address(store->location));
+        break;
+    }
+
+    case FE_IR_MOV: {
+        FeIrMov* mov = (FeIrMov*)ir;
+        // movs feeding a phi already have the phi's copy vreg
+        u32 dest = get_ir_vreg(ir);
+        if (dest == 0) {
+            dest = fe_mach_new_vreg(buf, regclass_of(ir->type));
+            put_ir_vreg(ir, dest);
+        }
+        if (mov->source->kind == FE_IR_CONST && !fe_type_is_float(ir->type)) {
+            i64 value = const_value((FeIrConst*)mov->source);
+            if (width_of(ir->type) == 3) inst_ri(buf, FE_X64_INST_MOV_RI_64, dest, value);
+            else inst_ri(buf, FE_X64_INST_MOV_RI_32, dest, (u32)value);
+        } else {
+            inst_rr(buf, mov_rr_for(ir->type), dest, value_vreg(buf, mov->source));
         }
+        break;
+    }
+    case FE_IR_PHI: {
+        // every source's mov wrote the copy vreg on the way in
+        FeIrPhi* phi = (FeIrPhi*)ir;
+        inst_rr(buf, mov_rr_for(ir->type), get_ir_vreg(ir), get_ir_vreg(phi->sources[0]));
+        break;
+    }
 
-        fe_mach_set_vreg(buf, minst, 0, lhs_vreg);
-        fe_mach_set_vreg(buf, minst, 1, get_ir_vreg(binop->rhs));
-        put_ir_vreg(ir, lhs_vreg);
+    case FE_IR_JUMP:
+        gen_jump(buf, ((FeIrJump*)ir)->dest);
+        break;
+    case FE_IR_BRANCH:
+        gen_branch(buf, (FeIrBranch*)ir);
+        break;
+
+    case FE_IR_CALL:
+    case FE_IR_PTR_CALL:
+        gen_call(buf, ir);
+        break;
+    case FE_IR_RETRIEVE: {
+        FeIrRetrieve* retrieve = (FeIrRetrieve*)ir;
+        put_ir_vreg(ir, get_ir_vreg(retrieve->call) + retrieve->index);
         break;
     }
+
+    case FE_IR_FADD:
+        put_ir_vreg(ir, gen_sse_arith(buf, (FeIrBinop*)ir, FE_X64_INST_ADDSS_RR));
+        break;
+    case FE_IR_FSUB:
+        put_ir_vreg(ir, gen_sse_arith(buf, (FeIrBinop*)ir, FE_X64_INST_SUBSS_RR));
+        break;
+    case FE_IR_FMUL:
+        put_ir_vreg(ir, gen_sse_arith(buf, (FeIrBinop*)ir, FE_X64_INST_MULSS_RR));
+        break;
+    case FE_IR_FDIV:
+        put_ir_vreg(ir, gen_sse_arith(buf, (FeIrBinop*)ir, FE_X64_INST_DIVSS_RR));
+        break;
+    case FE_IR_GET_FIELD:
+    case FE_IR_SET_FIELD:
+    case FE_IR_GET_INDEX:
+    case FE_IR_SET_INDEX:
+        TODO("aggregate values in registers");
+        break;
+    case FE_IR_ASM_BLOCK:
+        TODO("asm blocks");
+        break;
     default:
         TODO("unhandled ir");
     }
 }
 
+static void note_ptrcall_return(FeIrRetrieve* retrieve) {
+    PtrCallReturns* rets = ptrmap_get(&ptrcall_returns, retrieve->call);
+    if (rets == PTRMAP_NOT_FOUND) {
+        rets = arena_alloc(fe_scratch(), sizeof(PtrCallReturns), alignof(PtrCallReturns));
+        *rets = (PtrCallReturns){0};
+        ptrmap_put(&ptrcall_returns, retrieve->call, rets);
+    }
+    if (retrieve->index >= rets->len) {
+        u16 len = retrieve->index + 1;
+        FeType* types = arena_alloc(fe_scratch(), sizeof(FeType) * len, alignof(FeType));
+        for_range(i, 0, len) types[i] = i < rets->len ? rets->types[i] : FE_TYPE_I64;
+        rets->types = types;
+        rets->len = len;
+    }
+    rets->types[retrieve->index] = retrieve->base.type;
+}
+
+// give phis (and the movs feeding them) their vregs, create block labels
+// and stack slots, and size the outgoing argument area.
+static void prepare_function(FeMachBuffer* buf, FeFunction* fn) {
+    FeX64Config* config = buf->target.arch_config;
+
+    cg.fn = fn;
+    cg.cconv = get_cconv(fn->mod, fn->cconv);
+    cg.frame_pointer = config != NULL && config->frame_pointer;
+    cg.makes_calls = false;
+    cg.has_floats = false;
+    cg.outgoing_size = 0;
+
+    foreach (FeBasicBlock* bb, fn->blocks) {
+        FeMachLocalLabel* label = (FeMachLocalLabel*)fe_mach_new(buf, FE_MACH_LABEL_LOCAL);
+        label->name = bb->name;
+        bb->flags = (u64)label;
+    }
+
+    foreach (FeBasicBlock* bb, fn->blocks) {
+        cg.block = count;
+        for_fe_ir(ir, *bb) {
+            FeStackObject* obj = NULL;
+            if (fe_type_is_float(ir->type)) cg.has_floats = true;
+            switch (ir->kind) {
+            case FE_IR_PHI: {
+                // the movs at the end of each predecessor write a copy vreg,
+                // which the phi reads at the top of its block. writing the phi
+                // directly would clobber it while it's still live (in loops),
+                // or while another phi's mov still needs it (swaps).
+                FeIrPhi* phi = (FeIrPhi*)ir;
+                put_ir_vreg(ir, fe_mach_new_vreg(buf, regclass_of(ir->type)));
+                u32 copy = fe_mach_new_vreg(buf, regclass_of(ir->type));
+                for_range(i, 0, phi->len) put_ir_vreg(phi->sources[i], copy);
+                break;
+            }
+            case FE_IR_STACK_ADDR: obj = ((FeIrStackAddr*)ir)->object; break;
+            case FE_IR_STACK_LOAD: obj = ((FeIrStackLoad*)ir)->location; break;
+            case FE_IR_STACK_STORE: obj = ((FeIrStackStore*)ir)->location; break;
+            case FE_IR_CALL:
+            case FE_IR_PTR_CALL:
+                cg.makes_calls = true;
+                break;
+            case FE_IR_RETRIEVE: {
+                FeIrRetrieve* retrieve = (FeIrRetrieve*)ir;
+                if (retrieve->call->kind == FE_IR_PTR_CALL) note_ptrcall_return(retrieve);
+                break;
+            }
+            default:
+                break;
+            }
+
+            if (obj != NULL && ptrmap_get(&stack_slots, obj) == PTRMAP_NOT_FOUND) {
+                u32 slot = fe_mach_new_stack_slot(buf, fe_type_size(fn->mod, obj->t), fe_type_align(fn->mod, obj->t));
+                ptrmap_put(&stack_slots, obj, (void*)(u64)slot);
+            }
+        }
+    }
+
+    // stack arguments for calls need the space at the very bottom of the frame.
+    // the retrieve pass above has to be done first, for pointer call signatures.
+    if (cg.makes_calls) foreach (FeBasicBlock* bb, fn->blocks) {
+        for_fe_ir(ir, *bb) {
+            if (ir->kind != FE_IR_CALL && ir->kind != FE_IR_PTR_CALL) continue;
+            cg.outgoing_size = max(cg.outgoing_size, call_stack_size(ir));
+        }
+    }
+    cg.outgoing_size = align_forward(cg.outgoing_size, 16);
+
+    X64Frame frame = {
+        .outgoing_size = cg.outgoing_size,
+        .makes_calls = cg.makes_calls,
+        .frame_pointer = cg.frame_pointer,
+    };
+    da_append(&frames, frame);
+}
+
 static void gen_function(FeMachBuffer* buf, FeFunction* fn) {
 
-    // init ir2vreg ptrmap
+    // init ptrmaps
     if (ir2vreg.keys == NULL) ptrmap_init(&ir2vreg, 512);
+    if (stack_slots.keys == NULL) ptrmap_init(&stack_slots, 64);
+    if (ptrcall_returns.keys == NULL) ptrmap_init(&ptrcall_returns, 16);
     ptrmap_reset(&ir2vreg);
+    ptrmap_reset(&stack_slots);
+    ptrmap_reset(&ptrcall_returns);
+    ArenaMark mark = arena_mark(fe_scratch());
+
+    prepare_function(buf, fn);
 
     // generate function header
     FeMachGlobalLabel* head_label = (FeMachGlobalLabel*)fe_mach_append(buf, fe_mach_new(buf, FE_MACH_LABEL_GLOBAL));
     head_label->symbol_index = mach_symbol(fn->sym);
     fe_mach_append(buf, fe_mach_new(buf, FE_MACH_CFG_BEGIN));
 
+    cg.block = 0;
+    emit_prologue(buf, fn);
+
     foreach (FeBasicBlock* bb, fn->blocks) {
+        cg.block = count;
         gen_basic_block(buf, bb);
     }
 
     fe_mach_append(buf, fe_mach_new(buf, FE_MACH_CFG_END));
+    arena_release(fe_scratch(), mark);
+}
+
+// regalloc hooks, see FeArchInfo
+FeMachInst* fe_x64_spill(FeMachBuffer* buf, u32 vreg, u32 slot) {
+    bool xmm = buf->vregs.at[vreg].class == FE_X64_REGCLASS_XMM;
+    FeMachInst* store = fe_mach_new_inst(buf, xmm ? FE_X64_INST_MOVSD_MR : FE_X64_INST_MOV_MR_64);
+    set_address(buf, store, 0, 0, (X64Address){.base = cg.sp, .scale = 1, .slot = slot});
+    fe_mach_set_vreg(buf, store, 2, vreg);
+    return store;
 }
 
-static FeMachVReg* get_vreg(FeMachBuffer* buf, FeMachInst* inst, u32 i) {
-    return &buf->vregs.at[buf->vreg_lists.at[inst->regs + i]];
+FeMachInst* fe_x64_reload(FeMachBuffer* buf, u32 vreg, u32 slot) {
+    bool xmm = buf->vregs.at[vreg].class == FE_X64_REGCLASS_XMM;
+    FeMachInst* load = fe_mach_new_inst(buf, xmm ? FE_X64_INST_MOVSD_RM : FE_X64_INST_MOV_RM_64);
+    fe_mach_set_vreg(buf, load, 0, vreg);
+    set_address(buf, load, 1, 0, (X64Address){.base = cg.sp, .scale = 1, .slot = slot});
+    return load;
 }
 
-static void mov_reduce(FeMachBuffer* buf) {
-    for_range(i, 0, buf->buf.len) {
-        if (buf->buf.at[i]->kind != FE_MACH_INST)
-            continue;
-        FeMachInst* inst = (FeMachInst*)buf->buf.at[i];
-        if (inst->template != FE_X64_INST_MOV_RR_64)
-            continue;
+// lay out the frame of the function between begin and end, and resolve
+// the slot and frame size immediates that were waiting on it.
+static void layout_frame(FeMachBuffer* buf, X64Frame* frame, u32 begin, u32 end) {
+    FeX64Config* config = buf->target.arch_config;
+
+    u16 locals_align;
+    u32 locals_size = fe_mach_layout_frame(buf, begin, end, &locals_align);
+    if (locals_align > 16) TODO("stack objects aligned past 16 bytes");
+
+    u32 frame_size = 0;
+    i32 locals_base; // offset of the locals from rsp
+
+    // leaf functions can keep their locals in the 128 bytes below rsp
+    // and skip adjusting it, where the system promises not to touch them
+    bool red_zone = buf->target.system == FE_SYSTEM_LINUX && !(config != NULL && config->no_red_zone);
+    if (red_zone && !frame->makes_calls && locals_size != 0 && locals_size <= 128 && locals_align <= 8) {
+        locals_base = -(i32)align_forward(locals_size, 8);
+    } else {
+        // keep rsp 16-byte aligned at call sites
+        u32 pushed = frame->frame_pointer ? 16 : 8; // return address and saved rbp
+        u32 total = frame->outgoing_size + locals_size;
+        locals_base = frame->outgoing_size;
+        if (total != 0 || frame->makes_calls) {
+            frame_size = align_forward(total + pushed, 16) - pushed;
+        }
+    }
 
-        u8 real0 = get_vreg(buf, inst, 0)->real;
-        if (real0 != 0 && real0 == get_vreg(buf, inst, 1)->real) {
-            inst->base.kind = FE_MACH_NONE;
+    for_range(here, begin, end) {
+        if (buf->buf.at[here]->kind != FE_MACH_INST) continue;
+        FeMachInst* inst = (FeMachInst*)buf->buf.at[here];
+        for_range(i, 0, buf->target.inst_templates[inst->template].imms_len) {
+            FeMachImmediate* imm = &buf->immediates.at[inst->imms + i];
+            switch (imm->kind) {
+            case FE_MACH_IMM_SLOT: {
+                i64 disp = locals_base + buf->slots.at[imm->slot.index].offset + imm->slot.offset;
+                if (!fits_simm32(disp)) TODO("displacement out of range");
+                imm->kind = FE_MACH_IMM_CONST;
+                imm->d64 = (u64)disp;
+                break;
+            }
+            case FE_MACH_IMM_FRAME_SIZE:
+                imm->kind = FE_MACH_IMM_CONST;
+                imm->d64 += frame_size;
+                // the rsp adjustments in the prologue and epilogue
+                if (frame_size == 0 && (inst->template == FE_X64_INST_SUB_RI_64 || inst->template == FE_X64_INST_ADD_RI_64)) {
+                    inst->base.kind = FE_MACH_NONE;
+                }
+                break;
+            default:
+                break;
+            }
+        }
+    }
+}
+
+static void layout_frames(FeMachBuffer* buf) {
+    u32 function = 0;
+    for_range(begin, 0, buf->buf.len) {
+        if (buf->buf.at[begin]->kind != FE_MACH_CFG_BEGIN) continue;
+        u32 end = begin;
+        while (buf->buf.at[end]->kind != FE_MACH_CFG_END) end++;
+        layout_frame(buf, &frames.at[function++], begin, end);
+        begin = end;
+    }
+}
+
+// sse has no remainder instruction, so fmods become calls to libm.
+// tdce cleans up the fmods themselves afterwards.
+static void lower_float_remainders(FeModule* mod) {
+    for_range(i, 0, mod->functions_len) {
+        FeFunction* fn = mod->functions[i];
+        foreach (FeBasicBlock* bb, fn->blocks) {
+            for_fe_ir(ir, *bb) {
+                if (ir->kind != FE_IR_FMOD) continue;
+                FeIrBinop* fmod = (FeIrBinop*)ir;
+                string name = sse_width_of(ir->type) == 1 ? str("fmod") : str("fmodf");
+                FeSymbol* sym = fe_find_or_new_symbol(mod, name, FE_BIND_IMPORT);
+                FeIr* target = fe_insert_ir_before(fe_ir_load_symbol(fn, FE_TYPE_PTR, sym), ir);
+                FeIr* call = fe_insert_ir_before(fe_ir_ptr_call(fn, target, FE_CCONV_CDECL, 2), ir);
+                fe_add_call_param(call, fmod->lhs);
+                fe_add_call_param(call, fmod->rhs);
+                FeIr* result = fe_insert_ir_before(fe_ir_retrieve(fn, call, ir->type, 0), ir);
+                fe_rewrite_ir_uses(fn, ir, result);
+            }
         }
     }
 }
 
 FeMachBuffer fe_x64_codegen(FeModule* mod) {
     mod->pass_queue.len = 0; // clear pass queue
+    lower_float_remainders(mod);
 
     // run preparation passes
     fe_sched_module_pass(mod, &fe_pass_moviphi);
@@ -216,11 +1687,23 @@ FeMachBuffer fe_x64_codegen(FeModule* mod) {
 
     da_init(&mb.buf, 256);
     da_init(&mb.immediates, 128);
+    da_init(&mb.relocs, 16);
     da_init(&mb.symtab, mod->symtab.len);
     da_init(&mb.vregs, 512);
     fe_mach_new_vreg(&mb, FE_X64_REGCLASS_UNKNOWN); // add null register
     da_init(&mb.vreg_lists, 512);
-    mb.buf_alloca = arena_make(1024);
+    da_init(&mb.slots, 16);
+    da_append(&mb.slots, (FeMachStackSlot){0}); // add null slot
+    mb.buf_alloca = fe_arena_make(1024);
+
+    FeX64Config* config = mod->target.arch_config;
+    mb.reserved[FE_X64_REGCLASS_GPR] = 1ull << FE_X64_GPR_RSP;
+    if (config != NULL && config->frame_pointer) mb.reserved[FE_X64_REGCLASS_GPR] |= 1ull << FE_X64_GPR_RBP;
+
+    // every function shares one rsp vreg, so spill code can use it too
+    cg.sp = new_pinned_vreg(&mb, FE_X64_GPR_RSP);
+    if (frames.at == NULL) da_init(&frames, 16);
+    frames.len = 0;
 
     gen_symtab(mod, &mb);
 
@@ -240,9 +1723,10 @@ FeMachBuffer fe_x64_codegen(FeModule* mod) {
     printf("register allocation!\n");
     printf("live ranges:\n");
     fe_mach_regalloc(&mb);
+    layout_frames(&mb);
 
-    printf("reducing redundant movs...\n");
-    mov_reduce(&mb);
+    printf("peephole optimizing...\n");
+    fe_x64_peephole(&mb);
 
     // printf("final code generation!\n");
 
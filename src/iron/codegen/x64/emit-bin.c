@@ -0,0 +1,404 @@
+#include "iron/codegen/mach.h"
+#include "iron/codegen/x64/x64.h"
+#include "common/ptrmap.h"
+
+// hardware numbers of each register
+static const u8 gpr_encoding[_FE_X64_GPR_COUNT] = {
+    [FE_X64_GPR_RAX] = 0,
+    [FE_X64_GPR_RCX] = 1,
+    [FE_X64_GPR_RDX] = 2,
+    [FE_X64_GPR_RBX] = 3,
+    [FE_X64_GPR_RSP] = 4,
+    [FE_X64_GPR_RBP] = 5,
+    [FE_X64_GPR_RSI] = 6,
+    [FE_X64_GPR_RDI] = 7,
+    [FE_X64_GPR_R8] = 8,
+    [FE_X64_GPR_R9] = 9,
+    [FE_X64_GPR_R10] = 10,
+    [FE_X64_GPR_R11] = 11,
+    [FE_X64_GPR_R12] = 12,
+    [FE_X64_GPR_R13] = 13,
+    [FE_X64_GPR_R14] = 14,
+    [FE_X64_GPR_R15] = 15,
+};
+
+typedef struct InstEncoding {
+    u8 form;
+    u8 width;
+    u8 ext;
+    u32 op;
+} InstEncoding;
+
+static const InstEncoding encodings[_FE_X64_INST_COUNT] = {
+#define INST(name, width, regs_len, defs, uses, imms_len, side_effects, cost, text, enc, op8, op, ext) \
+    [FE_X64_INST_##name] = {FE_X64_ENC_##enc, width, ext, width == 8 ? op8 : op},
+    FE_X64_INSTS
+#undef INST
+};
+
+typedef struct LabelFixup {
+    u64 offset;
+    FeMachLocalLabel* label;
+} LabelFixup;
+
+da_typedef(LabelFixup);
+
+static PtrMap label_offsets;
+static da(LabelFixup) fixups;
+
+// [base + index * scale + disp], as hardware register numbers
+typedef struct X64Memory {
+    u8 base;
+    u8 index;
+    bool has_index;
+    u8 scale;
+    i32 disp;
+} X64Memory;
+
+#define vr_index(reglist, index) buf->vreg_lists.at[(reglist) + (index)]
+#define imm_index(immlist, index) buf->immediates.at[(immlist) + (index)]
+
+static bool fits_i8(i64 x) {
+    return x >= INT8_MIN && x <= INT8_MAX;
+}
+
+static u8 gpr(FeMachBuffer* buf, u32 vreg) {
+    FeMachVReg reg = buf->vregs.at[vreg];
+    if (reg.real == 0) CRASH("v%u was not allocated a register", vreg);
+    return gpr_encoding[reg.real];
+}
+
+// hardware number of a gpr or an xmm register
+static u8 any_reg(FeMachBuffer* buf, u32 vreg) {
+    FeMachVReg reg = buf->vregs.at[vreg];
+    if (reg.class != FE_X64_REGCLASS_XMM) return gpr(buf, vreg);
+    if (reg.real == 0) CRASH("v%u was not allocated a register", vreg);
+    return reg.real - FE_X64_XMM0;
+}
+
+static i64 const_imm(FeMachBuffer* buf, FeMachInst* i, u8 index) {
+    FeMachImmediate imm = imm_index(i->imms, index);
+    if (imm.kind != FE_MACH_IMM_CONST) CRASH("expected constant immediate");
+    return (i64)imm.d64;
+}
+
+static X64Memory get_memory(FeMachBuffer* buf, FeMachInst* i, u8 reg, u8 imm) {
+    X64Memory mem = {0};
+    mem.base = gpr(buf, vr_index(i->regs, reg));
+    u32 index = vr_index(i->regs, reg + 1);
+    if (index != 0) {
+        mem.has_index = true;
+        mem.index = gpr(buf, index);
+        if (mem.index == 4) CRASH("rsp cannot be an index register");
+    }
+    mem.scale = const_imm(buf, i, imm);
+    mem.disp = const_imm(buf, i, imm + 1);
+    return mem;
+}
+
+// 0x66 for 16-bit operands, then a REX prefix if anything needs one.
+// byte_regs forces a REX prefix so that 8-bit regs 4-7 are spl, bpl, sil, dil
+static void write_prefixes(FeDataBuffer* db, u8 width, u8 reg, u8 index, u8 rm, bool byte_regs) {
+    if (width == 16) fe_db_write_8(db, 0x66);
+    u8 rex = 0x40;
+    if (width == 64) rex |= 0b1000;
+    if (reg & 8) rex |= 0b0100;
+    if (index & 8) rex |= 0b0010;
+    if (rm & 8) rex |= 0b0001;
+    if (rex != 0x40 || byte_regs) fe_db_write_8(db, rex);
+}
+
+static bool needs_byte_rex(u8 reg) {
+    return reg >= 4 && reg <= 7;
+}
+
+// sse opcodes carry their mandatory prefix in the top byte, it goes before REX
+static void write_sse_prefix(FeDataBuffer* db, u32 op) {
+    if (op > 0xFFFF) fe_db_write_8(db, op >> 16);
+}
+
+// multi-byte opcodes are stored most significant byte first
+static void write_opcode(FeDataBuffer* db, u32 op) {
+    if (op > 0xFFFF) fe_db_write_8(db, op >> 16);
+    if (op > 0xFF) fe_db_write_8(db, op >> 8);
+    fe_db_write_8(db, op);
+}
+
+static void write_modrm(FeDataBuffer* db, u8 mod, u8 reg, u8 rm) {
+    fe_db_write_8(db, (mod << 6) | ((reg & 7) << 3) | (rm & 7));
+}
+
+static void write_memory(FeDataBuffer* db, u8 reg, X64Memory mem) {
+    u8 mod;
+    // [rbp] and [r13] can only be encoded with a displacement
+    if (mem.disp == 0 && (mem.base & 7) != 5) mod = 0b00;
+    else if (fits_i8(mem.disp)) mod = 0b01;
+    else mod = 0b10;
+
+    // [rsp] and [r12] can only be encoded with a SIB byte
+    bool sib = mem.has_index || (mem.base & 7) == 4;
+    write_modrm(db, mod, reg, sib ? 0b100 : mem.base);
+    if (sib) {
+        u8 scale = 0;
+        switch (mem.scale) {
+        case 1: scale = 0; break;
+        case 2: scale = 1; break;
+        case 4: scale = 2; break;
+        case 8: scale = 3; break;
+        default: CRASH("invalid scale %d", mem.scale);
+        }
+        u8 index = mem.has_index ? mem.index : 0b100; // 0b100 is no index
+        fe_db_write_8(db, (scale << 6) | ((index & 7) << 3) | (mem.base & 7));
+    }
+
+    if (mod == 0b01) fe_db_write_8(db, (u8)mem.disp);
+    if (mod == 0b10) fe_db_write_32(db, (u32)mem.disp);
+}
+
+static void write_imm(FeDataBuffer* db, u8 width, i64 value) {
+    switch (width) {
+    case 8: fe_db_write_8(db, (u8)value); break;
+    case 16: fe_db_write_16(db, (u16)value); break;
+    default: fe_db_write_32(db, (u32)value); break; // 64-bit ops take sign-extended imm32s
+    }
+}
+
+// write a rel32 to a label or symbol
+static void write_rel32(FeDataBuffer* db, FeMachBuffer* buf, FeMachImmediate imm) {
+    switch (imm.kind) {
+    case FE_MACH_IMM_LABEL: {
+        LabelFixup fixup = {.offset = db->len, .label = imm.label};
+        da_append(&fixups, fixup);
+        break;
+    }
+    case FE_MACH_IMM_SYMBOL: {
+        FeMachReloc reloc = {.offset = db->len, .symbol_index = imm.d32, .kind = FE_MACH_RELOC_REL32};
+        da_append(&buf->relocs, reloc);
+        break;
+    }
+    default:
+        CRASH("expected label or symbol immediate");
+    }
+    fe_db_write_32(db, 0);
+}
+
+// hardware condition codes, added to the jcc/setcc opcodes
+static const u8 cc_encoding[_FE_X64_CC_COUNT] = {
+    [FE_X64_CC_E] = 0x4,
+    [FE_X64_CC_NE] = 0x5,
+    [FE_X64_CC_L] = 0xC,
+    [FE_X64_CC_LE] = 0xE,
+    [FE_X64_CC_G] = 0xF,
+    [FE_X64_CC_GE] = 0xD,
+    [FE_X64_CC_B] = 0x2,
+    [FE_X64_CC_BE] = 0x6,
+    [FE_X64_CC_A] = 0x7,
+    [FE_X64_CC_AE] = 0x3,
+    [FE_X64_CC_P] = 0xA,
+    [FE_X64_CC_NP] = 0xB,
+};
+
+static void encode_inst(FeDataBuffer* db, FeMachBuffer* buf, FeMachInst* i) {
+    InstEncoding enc = encodings[i->template];
+    bool byte = enc.width == 8;
+
+    switch (enc.form) {
+    case FE_X64_ENC_NONE:
+        write_prefixes(db, enc.width, 0, 0, 0, false);
+        write_opcode(db, enc.op);
+        break;
+    case FE_X64_ENC_RM_R: {
+        u8 rm = gpr(buf, vr_index(i->regs, 0));
+        u8 reg = gpr(buf, vr_index(i->regs, 1));
+        write_prefixes(db, enc.width, reg, 0, rm, byte && (needs_byte_rex(reg) || needs_byte_rex(rm)));
+        write_opcode(db, enc.op);
+        write_modrm(db, 0b11, reg, rm);
+        break;
+    }
+    case FE_X64_ENC_R_RM:
+    case FE_X64_ENC_R_RM8:
+    case FE_X64_ENC_R_RM_I: {
+        u8 reg = gpr(buf, vr_index(i->regs, 0));
+        u8 rm = gpr(buf, vr_index(i->regs, 1));
+        bool byte_rm = enc.form == FE_X64_ENC_R_RM8 && needs_byte_rex(rm);
+        write_prefixes(db, enc.width, reg, 0, rm, byte_rm);
+        if (enc.form != FE_X64_ENC_R_RM_I) {
+            write_opcode(db, enc.op);
+            write_modrm(db, 0b11, reg, rm);
+            break;
+        }
+        // imul has a short form for 8-bit immediates
+        i64 imm = const_imm(buf, i, 0);
+        write_opcode(db, fits_i8(imm) ? 0x6B : enc.op);
+        write_modrm(db, 0b11, reg, rm);
+        write_imm(db, fits_i8(imm) ? 8 : enc.width, imm);
+        break;
+    }
+    case FE_X64_ENC_RM:
+    case FE_X64_ENC_RM_IB:
+    case FE_X64_ENC_DIV: {
+        u8 rm = gpr(buf, vr_index(i->regs, enc.form == FE_X64_ENC_DIV ? 2 : 0));
+        write_prefixes(db, enc.width, 0, 0, rm, byte && needs_byte_rex(rm));
+        write_opcode(db, enc.op);
+        write_modrm(db, 0b11, enc.ext, rm);
+        if (enc.form == FE_X64_ENC_RM_IB) write_imm(db, 8, const_imm(buf, i, 0));
+        break;
+    }
+    case FE_X64_ENC_RM_I: {
+        u8 rm = gpr(buf, vr_index(i->regs, 0));
+        i64 imm = const_imm(buf, i, 0);
+        write_prefixes(db, enc.width, 0, 0, rm, byte && needs_byte_rex(rm));
+        // group 1 ops have a short form for sign-extended 8-bit immediates
+        bool short_imm = !byte && enc.op == 0x81 && fits_i8(imm);
+        write_opcode(db, short_imm ? 0x83 : enc.op);
+        write_modrm(db, 0b11, enc.ext, rm);
+        write_imm(db, short_imm ? 8 : enc.width, imm);
+        break;
+    }
+    case FE_X64_ENC_O: {
+        u8 reg = gpr(buf, vr_index(i->regs, 0));
+        write_prefixes(db, 0, 0, 0, reg, false);
+        fe_db_write_8(db, enc.op + (reg & 7));
+        break;
+    }
+    case FE_X64_ENC_OI: {
+        u8 reg = gpr(buf, vr_index(i->regs, 0));
+        i64 imm = const_imm(buf, i, 0);
+        if (enc.width == 64 && (u64)imm > UINT32_MAX) {
+            if (imm >= INT32_MIN && imm <= INT32_MAX) {
+                // mov r/m64, simm32
+                write_prefixes(db, 64, 0, 0, reg, false);
+                fe_db_write_8(db, 0xC7);
+                write_modrm(db, 0b11, 0, reg);
+                fe_db_write_32(db, (u32)imm);
+            } else {
+                write_prefixes(db, 64, 0, 0, reg, false);
+                fe_db_write_8(db, enc.op + (reg & 7));
+                fe_db_write_64(db, (u64)imm);
+            }
+            break;
+        }
+        // writing a 32-bit register zeroes the top half anyway
+        write_prefixes(db, 32, 0, 0, reg, false);
+        fe_db_write_8(db, enc.op + (reg & 7));
+        fe_db_write_32(db, (u32)imm);
+        break;
+    }
+    case FE_X64_ENC_R_M: {
+        u8 reg = gpr(buf, vr_index(i->regs, 0));
+        X64Memory mem = get_memory(buf, i, 1, 0);
+        write_prefixes(db, enc.width, reg, mem.index, mem.base, false);
+        write_opcode(db, enc.op);
+        write_memory(db, reg, mem);
+        break;
+    }
+    case FE_X64_ENC_M_R: {
+        X64Memory mem = get_memory(buf, i, 0, 0);
+        u8 reg = gpr(buf, vr_index(i->regs, 2));
+        write_prefixes(db, enc.width, reg, mem.index, mem.base, byte && needs_byte_rex(reg));
+        write_opcode(db, enc.op);
+        write_memory(db, reg, mem);
+        break;
+    }
+    case FE_X64_ENC_M_I: {
+        X64Memory mem = get_memory(buf, i, 0, 0);
+        write_prefixes(db, enc.width, 0, mem.index, mem.base, false);
+        write_opcode(db, enc.op);
+        write_memory(db, enc.ext, mem);
+        write_imm(db, enc.width, const_imm(buf, i, 2));
+        break;
+    }
+    case FE_X64_ENC_R_RIP: {
+        u8 reg = gpr(buf, vr_index(i->regs, 0));
+        write_prefixes(db, enc.width, reg, 0, 0, false);
+        write_opcode(db, enc.op);
+        write_modrm(db, 0b00, reg, 0b101);
+        write_rel32(db, buf, imm_index(i->imms, 0));
+        break;
+    }
+    case FE_X64_ENC_REL32:
+        write_opcode(db, enc.op);
+        write_rel32(db, buf, imm_index(i->imms, 0));
+        break;
+    case FE_X64_ENC_JCC:
+        write_opcode(db, enc.op + cc_encoding[const_imm(buf, i, 0)]);
+        write_rel32(db, buf, imm_index(i->imms, 1));
+        break;
+    case FE_X64_ENC_SETCC: {
+        u8 rm = gpr(buf, vr_index(i->regs, 0));
+        write_prefixes(db, 0, 0, 0, rm, needs_byte_rex(rm));
+        write_opcode(db, enc.op + cc_encoding[const_imm(buf, i, 0)]);
+        write_modrm(db, 0b11, 0, rm);
+        break;
+    }
+    case FE_X64_ENC_SSE_R_RM:
+    case FE_X64_ENC_SSE_RM_R: {
+        bool r_rm = enc.form == FE_X64_ENC_SSE_R_RM;
+        u8 reg = any_reg(buf, vr_index(i->regs, r_rm ? 0 : 1));
+        u8 rm = any_reg(buf, vr_index(i->regs, r_rm ? 1 : 0));
+        write_sse_prefix(db, enc.op);
+        write_prefixes(db, enc.width, reg, 0, rm, false);
+        write_opcode(db, enc.op & 0xFFFF);
+        write_modrm(db, 0b11, reg, rm);
+        break;
+    }
+    case FE_X64_ENC_SSE_R_M: {
+        u8 reg = any_reg(buf, vr_index(i->regs, 0));
+        X64Memory mem = get_memory(buf, i, 1, 0);
+        write_sse_prefix(db, enc.op);
+        write_prefixes(db, enc.width, reg, mem.index, mem.base, false);
+        write_opcode(db, enc.op & 0xFFFF);
+        write_memory(db, reg, mem);
+        break;
+    }
+    case FE_X64_ENC_SSE_M_R: {
+        X64Memory mem = get_memory(buf, i, 0, 0);
+        u8 reg = any_reg(buf, vr_index(i->regs, 2));
+        write_sse_prefix(db, enc.op);
+        write_prefixes(db, enc.width, reg, mem.index, mem.base, false);
+        write_opcode(db, enc.op & 0xFFFF);
+        write_memory(db, reg, mem);
+        break;
+    }
+    default:
+        CRASH("no encoding for inst %d", i->template);
+    }
+}
+
+void fe_x64_emit_bin(FeDataBuffer* db, FeMachBuffer* buf) {
+    if (label_offsets.keys == NULL) ptrmap_init(&label_offsets, 64);
+    ptrmap_reset(&label_offsets);
+    da_init(&fixups, 64);
+
+    for_range(i, 0, buf->buf.len) {
+        FeMach* m = buf->buf.at[i];
+        switch (m->kind) {
+        case FE_MACH_LABEL_LOCAL:
+            ptrmap_put(&label_offsets, m, (void*)(u64)db->len);
+            break;
+        case FE_MACH_INST:
+            encode_inst(db, buf, (FeMachInst*)m);
+            break;
+        case FE_MACH_DATA_ZERO:
+        case FE_MACH_DATA_FILL:
+        case FE_MACH_DATA_D8:
+        case FE_MACH_DATA_D16:
+        case FE_MACH_DATA_D32:
+        case FE_MACH_DATA_D64:
+        case FE_MACH_DATA_BYTESTREAM:
+            TODO("data in binary output");
+            break;
+        default:
+            break;
+        }
+    }
+
+    // patch local jumps now that every label has a position
+    foreach (LabelFixup fixup, fixups) {
+        void* target = ptrmap_get(&label_offsets, fixup.label);
+        if (target == PTRMAP_NOT_FOUND) CRASH("jump to label that was never placed");
+        i64 rel = (i64)(u64)target - (i64)(fixup.offset + 4);
+        fe_db_overwrite_32(db, fixup.offset, (u32)(i32)rel);
+    }
+    da_destroy(&fixups);
+}
@@ -14,8 +14,8 @@ static const char* gpr_names[_FE_X64_GPR_COUNT][_GPR_LEVEL_MAX] = {
     [FE_X64_GPR_RBX] = {"rbx", "ebx", "bx", "bl"},
     [FE_X64_GPR_RCX] = {"rcx", "ecx", "cx", "cl"},
     [FE_X64_GPR_RDX] = {"rdx", "edx", "dx", "dl"},
-    [FE_X64_GPR_RSI] = {"rsi", "esi", "si", "sl"},
-    [FE_X64_GPR_RDI] = {"rdi", "edi", "di", "dl"},
+    [FE_X64_GPR_RSI] = {"rsi", "esi", "si", "sil"},
+    [FE_X64_GPR_RDI] = {"rdi", "edi", "di", "dil"},
     [FE_X64_GPR_RBP] = {"rbp", "ebp", "bp", "bpl"},
     [FE_X64_GPR_RSP] = {"rsp", "esp", "sp", "spl"},
     [FE_X64_GPR_R8] = {"r8", "r8d", "r8w", "r8b"},
@@ -36,6 +36,10 @@ static void emit_register(FeDataBuffer* db, FeMachBuffer* buf, u32 vreg, u8 bits
     FeMachVReg reg = buf->vregs.at[vreg];
     if (reg.real == 0) { // still virtual
         fe_db_write_format(db, "v%u", vreg);
+        if (reg.class == FE_X64_REGCLASS_XMM) {
+            fe_db_write_8(db, 'x');
+            return;
+        }
         switch (bits) {
         case GPR_64: fe_db_write_8(db, 'q'); break;
         case GPR_32: fe_db_write_8(db, 'd'); break;
@@ -48,6 +52,9 @@ static void emit_register(FeDataBuffer* db, FeMachBuffer* buf, u32 vreg, u8 bits
         case FE_X64_REGCLASS_GPR:
             fe_db_write_cstring(db, gpr_names[reg.real][bits]);
             break;
+        case FE_X64_REGCLASS_XMM:
+            fe_db_write_format(db, "xmm%d", reg.real - FE_X64_XMM0);
+            break;
         default:
             fe_db_write_format(db, "?regclass_%d", reg.class);
             break;
@@ -55,40 +62,129 @@ static void emit_register(FeDataBuffer* db, FeMachBuffer* buf, u32 vreg, u8 bits
     }
 }
 
-#define vr_index(reglist, index) buf->vreg_lists.at[reglist + index]
+static const char* cc_names[_FE_X64_CC_COUNT] = {
+    [FE_X64_CC_E] = "e",
+    [FE_X64_CC_NE] = "ne",
+    [FE_X64_CC_L] = "l",
+    [FE_X64_CC_LE] = "le",
+    [FE_X64_CC_G] = "g",
+    [FE_X64_CC_GE] = "ge",
+    [FE_X64_CC_B] = "b",
+    [FE_X64_CC_BE] = "be",
+    [FE_X64_CC_A] = "a",
+    [FE_X64_CC_AE] = "ae",
+    [FE_X64_CC_P] = "p",
+    [FE_X64_CC_NP] = "np",
+};
 
-static void emit_inst(FeDataBuffer* db, FeMachBuffer* buf, FeMach* m) {
-    FeMachInst* i = (FeMachInst*)m;
-    const FeMachInstTemplate* templ = &buf->target.inst_templates[i->template];
-
-    switch (i->template) {
-    case FE_X64_INST_ADD_RR_64:
-        // add r1, r2
-        fe_db_write_cstring(db, "add ");
-        emit_register(db, buf, vr_index(i->regs, 0), GPR_64);
-        fe_db_write_cstring(db, ", ");
-        emit_register(db, buf, vr_index(i->regs, 1), GPR_64);
+static const char* mem_size_names[_GPR_LEVEL_MAX] = {
+    [GPR_64] = "qword",
+    [GPR_32] = "dword",
+    [GPR_16] = "word",
+    [GPR_8] = "byte",
+};
+
+#define vr_index(reglist, index) buf->vreg_lists.at[(reglist) + (index)]
+#define imm_index(immlist, index) buf->immediates.at[(immlist) + (index)]
+
+static const char* inst_text[_FE_X64_INST_COUNT] = {
+#define INST(name, width, regs_len, defs, uses, imms_len, side_effects, cost, text, ...) [FE_X64_INST_##name] = text,
+    FE_X64_INSTS
+#undef INST
+};
+
+static const u8 inst_level[_FE_X64_INST_COUNT] = {
+#define INST(name, width, ...) [FE_X64_INST_##name] = width == 8 ? GPR_8 : width == 16 ? GPR_16 : width == 32 ? GPR_32 : GPR_64,
+    FE_X64_INSTS
+#undef INST
+};
+
+static void emit_offset(FeDataBuffer* db, i64 offset) {
+    if (offset > 0) fe_db_write_format(db, " + %lld", (long long)offset);
+    if (offset < 0) fe_db_write_format(db, " - %lld", (long long)-offset);
+}
+
+static void emit_immediate(FeDataBuffer* db, FeMachBuffer* buf, FeMachImmediate imm) {
+    switch (imm.kind) {
+    case FE_MACH_IMM_CONST:
+        fe_db_write_format(db, "%lld", (long long)(i64)imm.d64);
         break;
-    case FE_X64_INST_MOV_RR_64:
-        // mov r1, r2
-        fe_db_write_cstring(db, "mov ");
-        emit_register(db, buf, vr_index(i->regs, 0), GPR_64);
-        fe_db_write_cstring(db, ", ");
-        emit_register(db, buf, vr_index(i->regs, 1), GPR_64);
+    case FE_MACH_IMM_SYMBOL: {
+        FeMachSymbol sym = buf->symtab.at[imm.d32];
+        fe_db_write_bytes(db, sym.name, sym.name_len);
         break;
-    case FE_X64_INST_LEA_RR_64:
-        // lea r1, [r2 + r3]
-        fe_db_write_cstring(db, "lea");
-        emit_register(db, buf, vr_index(i->regs, 0), GPR_64);
-        fe_db_write_cstring(db, ", [");
-        emit_register(db, buf, vr_index(i->regs, 1), GPR_64);
-        fe_db_write_cstring(db, " + ");
-        emit_register(db, buf, vr_index(i->regs, 2), GPR_64);
-        fe_db_write_cstring(db, "]");
+    }
+    case FE_MACH_IMM_LABEL:
+        fe_db_write_8(db, '.');
+        fe_db_write_string(db, imm.label->name);
+        break;
+    // not resolved until the frame is laid out
+    case FE_MACH_IMM_SLOT:
+        fe_db_write_format(db, "slot%u", imm.slot.index);
+        emit_offset(db, imm.slot.offset);
         break;
-    case FE_X64_INST_RET:
-        fe_db_write_cstring(db, "ret");
+    case FE_MACH_IMM_FRAME_SIZE:
+        fe_db_write_cstring(db, "frame");
+        emit_offset(db, (i64)imm.d64);
         break;
+    default:
+        fe_db_write_cstring(db, "?imm");
+        break;
+    }
+}
+
+// [base + index * scale + disp]
+static void emit_memory(FeDataBuffer* db, FeMachBuffer* buf, FeMachInst* i, u8 reg, u8 imm) {
+    u32 index = vr_index(i->regs, reg + 1);
+    i64 scale = (i64)imm_index(i->imms, imm).d64;
+    FeMachImmediate disp = imm_index(i->imms, imm + 1);
+
+    fe_db_write_8(db, '[');
+    emit_register(db, buf, vr_index(i->regs, reg), GPR_64);
+    if (index != 0) {
+        fe_db_write_cstring(db, " + ");
+        emit_register(db, buf, index, GPR_64);
+        if (scale != 1) fe_db_write_format(db, "*%lld", (long long)scale);
+    }
+    if (disp.kind == FE_MACH_IMM_CONST) {
+        emit_offset(db, (i64)disp.d64);
+    } else {
+        fe_db_write_cstring(db, " + ");
+        emit_immediate(db, buf, disp);
+    }
+    fe_db_write_8(db, ']');
+}
+
+// expand the instruction's syntax template, see FE_X64_INSTS
+static void emit_inst(FeDataBuffer* db, FeMachBuffer* buf, FeMach* m) {
+    FeMachInst* i = (FeMachInst*)m;
+    const char* text = inst_text[i->template];
+    u8 level = inst_level[i->template];
+
+    if (text == NULL) {
+        fe_db_write_format(db, "?inst_%d", i->template);
+        return;
+    }
+
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c != '%') {
+            fe_db_write_8(db, *c);
+            continue;
+        }
+        c++;
+        switch (*c) {
+        case 'r': c++; emit_register(db, buf, vr_index(i->regs, *c - '0'), level); break;
+        case 'q': c++; emit_register(db, buf, vr_index(i->regs, *c - '0'), GPR_64); break;
+        case 'd': c++; emit_register(db, buf, vr_index(i->regs, *c - '0'), GPR_32); break;
+        case 'w': c++; emit_register(db, buf, vr_index(i->regs, *c - '0'), GPR_16); break;
+        case 'b': c++; emit_register(db, buf, vr_index(i->regs, *c - '0'), GPR_8); break;
+        case 'i': c++; emit_immediate(db, buf, imm_index(i->imms, *c - '0')); break;
+        case 'c': c++; fe_db_write_cstring(db, cc_names[imm_index(i->imms, *c - '0').d64]); break;
+        case 'm': c += 2; emit_memory(db, buf, i, c[-1] - '0', c[0] - '0'); break;
+        case 's': fe_db_write_cstring(db, mem_size_names[level]); break;
+        default:
+            CRASH("bad syntax template for inst %d", i->template);
+        }
     }
 }
 
@@ -2,34 +2,23 @@
 
 FeMachBuffer fe_x64_codegen(FeModule* mod);
 void fe_x64_emit_text(FeDataBuffer* db, FeMachBuffer* machbuf);
-
-#define INSTDEF(code) \
-    }                 \
-    , [code] = {.template_index = code,
+void fe_x64_emit_bin(FeDataBuffer* db, FeMachBuffer* machbuf);
+FeMachInst* fe_x64_spill(FeMachBuffer* buf, u32 vreg, u32 slot);
+FeMachInst* fe_x64_reload(FeMachBuffer* buf, u32 vreg, u32 slot);
 
 const FeMachInstTemplate fe_x64_inst_templates[_FE_X64_INST_COUNT] = {
-    {
-        INSTDEF(FE_X64_INST_MOV_RR_64)
-            .regs_len = 2,
-        .defs = 0b00000001, // first register
-        .uses = 0b00000010, // second register
-        .imms_len = 0,
-        INSTDEF(FE_X64_INST_ADD_RR_64)
-            .regs_len = 2,
-        .defs = 0b00000001,
-        .uses = 0b00000011, // first register is a def and a use
-        .imms_len = 0,
-        INSTDEF(FE_X64_INST_LEA_RR_64)
-            .regs_len = 3,
-        .defs = 0b00000001,
-        .uses = 0b00000110,
-        .imms_len = 0,
-        INSTDEF(FE_X64_INST_RET)
-            .regs_len = 0,
-        .defs = 0b00000000,
-        .uses = 0b00000000,
-        .imms_len = 0,
-    }
+#define INST(name, width, _regs_len, _defs, _uses, _imms_len, _side_effects, _cost, ...) \
+    [FE_X64_INST_##name] = {                                                           \
+        .template_index = FE_X64_INST_##name,                                          \
+        .regs_len = _regs_len,                                                         \
+        .defs = _defs,                                                                 \
+        .uses = _uses,                                                                 \
+        .imms_len = _imms_len,                                                         \
+        .side_effects = _side_effects,                                                 \
+        .cost = _cost,                                                                 \
+    },
+    FE_X64_INSTS
+#undef INST
 };
 
 static const FeArchRegclass regclasses[] = {
@@ -37,6 +26,12 @@ static const FeArchRegclass regclasses[] = {
     [FE_X64_REGCLASS_GPR] = {
         .id = FE_X64_REGCLASS_GPR,
         .len = _FE_X64_GPR_COUNT,
+        .spill_size = 8,
+    },
+    [FE_X64_REGCLASS_XMM] = {
+        .id = FE_X64_REGCLASS_XMM,
+        .len = _FE_X64_XMM_COUNT,
+        .spill_size = 8, // only scalars live in xmm registers
     },
 };
 
@@ -45,6 +40,10 @@ const FeArchInfo fe_arch_x64 = {
 
     .cg = fe_x64_codegen,
     .emit_text = fe_x64_emit_text,
+    .emit_bin = fe_x64_emit_bin,
+
+    .spill = fe_x64_spill,
+    .reload = fe_x64_reload,
 
     .native_int = FE_TYPE_I64,
     .native_float = FE_TYPE_F64,
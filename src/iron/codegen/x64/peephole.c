@@ -0,0 +1,535 @@
+#include "x64.h"
+
+/*
+    post-regalloc peephole optimizer.
+
+    runs after frame layout, when every vreg has a real register and every
+    immediate is a constant, so instructions can be compared by what they
+    actually do. each rule starts at one instruction and optionally needs a
+    specific instruction right after it (only dead elements, lifetime points
+    and CFG markers may sit between the two). the rewrites are in the table
+    below, and the whole thing runs until nothing changes.
+
+    flags aren't tracked as registers, so there's a small table of what each
+    instruction does to them. isel never keeps flags live across blocks, so
+    they're always dead at a label.
+*/
+
+#define I(name) FE_X64_INST_##name
+
+enum {
+    FLAGS_NONE,
+    FLAGS_READ,  // needs the flags from an earlier instruction
+    FLAGS_WRITE, // sets every flag a later instruction could read
+    FLAGS_MAYBE, // might change some flags (shifts by zero don't)
+};
+
+#define FLAGS_W(name, effect) \
+    [I(name##_8)] = effect, [I(name##_16)] = effect, [I(name##_32)] = effect, [I(name##_64)] = effect
+
+static const u8 flag_effects[_FE_X64_INST_COUNT] = {
+    FLAGS_W(ADD_RR, FLAGS_WRITE),
+    FLAGS_W(ADD_RI, FLAGS_WRITE),
+    FLAGS_W(SUB_RR, FLAGS_WRITE),
+    FLAGS_W(SUB_RI, FLAGS_WRITE),
+    FLAGS_W(AND_RR, FLAGS_WRITE),
+    FLAGS_W(AND_RI, FLAGS_WRITE),
+    FLAGS_W(OR_RR, FLAGS_WRITE),
+    FLAGS_W(OR_RI, FLAGS_WRITE),
+    FLAGS_W(XOR_RR, FLAGS_WRITE),
+    FLAGS_W(XOR_RI, FLAGS_WRITE),
+    FLAGS_W(CMP_RR, FLAGS_WRITE),
+    FLAGS_W(CMP_RI, FLAGS_WRITE),
+    FLAGS_W(TEST_RR, FLAGS_WRITE),
+    FLAGS_W(NEG_R, FLAGS_WRITE),
+    FLAGS_W(SHL_RC, FLAGS_MAYBE),
+    FLAGS_W(SHL_RI, FLAGS_MAYBE),
+    FLAGS_W(SHR_RC, FLAGS_MAYBE),
+    FLAGS_W(SHR_RI, FLAGS_MAYBE),
+    FLAGS_W(SAR_RC, FLAGS_MAYBE),
+    FLAGS_W(SAR_RI, FLAGS_MAYBE),
+
+    [I(IMUL_RR_16)] = FLAGS_WRITE,
+    [I(IMUL_RR_32)] = FLAGS_WRITE,
+    [I(IMUL_RR_64)] = FLAGS_WRITE,
+    [I(IMUL_RRI_16)] = FLAGS_WRITE,
+    [I(IMUL_RRI_32)] = FLAGS_WRITE,
+    [I(IMUL_RRI_64)] = FLAGS_WRITE,
+    [I(DIV_R_32)] = FLAGS_WRITE, // undefined afterwards, so nothing can read them
+    [I(DIV_R_64)] = FLAGS_WRITE,
+    [I(IDIV_R_32)] = FLAGS_WRITE,
+    [I(IDIV_R_64)] = FLAGS_WRITE,
+    [I(UCOMISS_RR)] = FLAGS_WRITE,
+    [I(UCOMISD_RR)] = FLAGS_WRITE,
+    [I(CALL)] = FLAGS_WRITE,
+    [I(CALL_R)] = FLAGS_WRITE,
+
+    [I(SETCC)] = FLAGS_READ,
+    [I(JCC)] = FLAGS_READ,
+};
+
+typedef struct PeepholeRule PeepholeRule;
+
+// a and b are positions in the buffer, b is 0 if the rule doesn't need a second instruction.
+// returns whether anything was rewritten.
+typedef bool (*PeepholeRewrite)(FeMachBuffer* buf, const PeepholeRule* rule, u64 a, u64 b);
+
+typedef struct PeepholeRule {
+    u16 first;  // template of the instruction the rule starts at
+    u16 second; // template of the instruction right after it, or 0 for any
+    u16 with;   // template the rewrite produces, if it needs one
+    PeepholeRewrite rewrite;
+} PeepholeRule;
+
+static FeMachInst* inst_at(FeMachBuffer* buf, u64 i) {
+    return (FeMachInst*)buf->buf.at[i];
+}
+
+static u8 real_of(FeMachBuffer* buf, FeMachInst* inst, u8 i) {
+    return buf->vregs.at[fe_mach_get_vreg(buf, inst, i)].real;
+}
+
+static FeMachImmediate* imm_of(FeMachBuffer* buf, FeMachInst* inst, u8 i) {
+    return &buf->immediates.at[inst->imms + i];
+}
+
+static bool is_const(FeMachBuffer* buf, FeMachInst* inst, u8 i, u64 value) {
+    FeMachImmediate* imm = imm_of(buf, inst, i);
+    return imm->kind == FE_MACH_IMM_CONST && imm->d64 == value;
+}
+
+// replace the element at i with a fresh instruction
+static FeMachInst* replace(FeMachBuffer* buf, u64 i, u16 template) {
+    FeMachInst* inst = fe_mach_new_inst(buf, template);
+    buf->buf.at[i] = &inst->base;
+    return inst;
+}
+
+// delete the element at i, along with the CFG marker in front of it if it's a jump
+static void delete(FeMachBuffer* buf, u64 i) {
+    buf->buf.at[i]->kind = FE_MACH_NONE;
+    u8 before = i != 0 ? buf->buf.at[i - 1]->kind : FE_MACH_NONE;
+    if (before == FE_MACH_CFG_JUMP || before == FE_MACH_CFG_BRANCH) {
+        buf->buf.at[i - 1]->kind = FE_MACH_NONE;
+    }
+}
+
+static bool is_transparent(u8 kind) {
+    switch (kind) {
+    case FE_MACH_NONE:
+    case FE_MACH_LIFETIME_BEGIN:
+    case FE_MACH_LIFETIME_END:
+    case FE_MACH_CFG_JUMP:
+    case FE_MACH_CFG_BRANCH:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// position of the next instruction after i in the same block, or 0
+static u64 next_inst(FeMachBuffer* buf, u64 i) {
+    for_range(j, i + 1, buf->buf.len) {
+        u8 kind = buf->buf.at[j]->kind;
+        if (kind == FE_MACH_INST) return j;
+        if (!is_transparent(kind)) return 0;
+    }
+    return 0;
+}
+
+static bool flags_live_after(FeMachBuffer* buf, u64 i) {
+    for_range(j, i + 1, buf->buf.len) {
+        u8 kind = buf->buf.at[j]->kind;
+        if (kind != FE_MACH_INST) {
+            if (is_transparent(kind)) continue;
+            return false;
+        }
+        u16 template = inst_at(buf, j)->template;
+        if (template == I(JMP) || template == I(RET)) return false;
+        switch (flag_effects[template]) {
+        case FLAGS_READ: return true;
+        case FLAGS_WRITE: return false;
+        }
+    }
+    return false;
+}
+
+static bool defines_real(FeMachBuffer* buf, FeMachInst* inst, u8 real) {
+    const FeMachInstTemplate* templ = &buf->target.inst_templates[inst->template];
+    for_range(i, 0, templ->regs_len) {
+        if (fe_mach_is_vreg_def(buf, inst->template, i) && real_of(buf, inst, i) == real) return true;
+    }
+    return false;
+}
+
+// does control fall from i straight into label?
+static bool falls_into(FeMachBuffer* buf, u64 i, FeMachLocalLabel* label) {
+    for_range(j, i + 1, buf->buf.len) {
+        FeMach* elem = buf->buf.at[j];
+        if (elem == &label->base) return true;
+        switch (elem->kind) {
+        case FE_MACH_NONE:
+        case FE_MACH_LIFETIME_BEGIN:
+        case FE_MACH_LIFETIME_END:
+        case FE_MACH_CFG_TARGET:
+        case FE_MACH_LABEL_LOCAL:
+            continue;
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+// memory operands are [base, index] registers and [scale, disp] immediates.
+// stores have theirs first, loads after the destination.
+static bool is_store(u16 template) {
+    return (I(MOV_MR_8) <= template && template <= I(MOV_MR_64)) ||
+           (I(MOV_MI_8) <= template && template <= I(MOV_MI_64));
+}
+
+static bool same_address(FeMachBuffer* buf, FeMachInst* x, FeMachInst* y) {
+    u8 xr = is_store(x->template) ? 0 : 1;
+    u8 yr = is_store(y->template) ? 0 : 1;
+    return real_of(buf, x, xr) == real_of(buf, y, yr) &&
+           real_of(buf, x, xr + 1) == real_of(buf, y, yr + 1) &&
+           imm_of(buf, x, 0)->kind == FE_MACH_IMM_CONST &&
+           imm_of(buf, y, 0)->kind == FE_MACH_IMM_CONST &&
+           imm_of(buf, x, 1)->kind == FE_MACH_IMM_CONST &&
+           imm_of(buf, y, 1)->kind == FE_MACH_IMM_CONST &&
+           imm_of(buf, x, 0)->d64 == imm_of(buf, y, 0)->d64 &&
+           imm_of(buf, x, 1)->d64 == imm_of(buf, y, 1)->d64;
+}
+
+// does a load write one of the registers its own address is made of?
+static bool load_clobbers_address(FeMachBuffer* buf, FeMachInst* load) {
+    u8 dest = real_of(buf, load, 0);
+    return dest == real_of(buf, load, 1) || dest == real_of(buf, load, 2);
+}
+
+// mov r, r
+// (32-bit self moves stay, they zero the upper half)
+static bool self_move(FeMachBuffer* buf, const PeepholeRule* rule, u64 a, u64 b) {
+    FeMachInst* mov = inst_at(buf, a);
+    u8 dest = real_of(buf, mov, 0);
+    if (dest == 0 || dest != real_of(buf, mov, 1)) return false;
+    delete(buf, a);
+    return true;
+}
+
+// mov r, 0  ->  xor r32, r32
+static bool zero_idiom(FeMachBuffer* buf, const PeepholeRule* rule, u64 a, u64 b) {
+    FeMachInst* mov = inst_at(buf, a);
+    if (!is_const(buf, mov, 0, 0) || flags_live_after(buf, a)) return false;
+    u32 vreg = fe_mach_get_vreg(buf, mov, 0);
+    FeMachInst* zero = replace(buf, a, rule->with);
+    fe_mach_set_vreg(buf, zero, 0, vreg);
+    fe_mach_set_vreg(buf, zero, 1, vreg);
+    return true;
+}
+
+// cmp r, 0  ->  test r, r
+static bool compare_zero(FeMachBuffer* buf, const PeepholeRule* rule, u64 a, u64 b) {
+    FeMachInst* cmp = inst_at(buf, a);
+    if (!is_const(buf, cmp, 0, 0)) return false;
+    u32 vreg = fe_mach_get_vreg(buf, cmp, 0);
+    FeMachInst* test = replace(buf, a, rule->with);
+    fe_mach_set_vreg(buf, test, 0, vreg);
+    fe_mach_set_vreg(buf, test, 1, vreg);
+    return true;
+}
+
+// a comparison nothing branches on
+static bool dead_compare(FeMachBuffer* buf, const PeepholeRule* rule, u64 a, u64 b) {
+    if (flags_live_after(buf, a)) return false;
+    delete(buf, a);
+    return true;
+}
+
+// move a comparison down so it sits right before its jcc, where the two can
+// macro-fuse. only instructions that leave the flags and the comparison's
+// registers alone (phi movs, mostly) can be moved over.
+static bool sink_compare(FeMachBuffer* buf, const PeepholeRule* rule, u64 a, u64 b) {
+    FeMachInst* cmp = inst_at(buf, a);
+    const FeMachInstTemplate* templ = &buf->target.inst_templates[cmp->template];
+
+    u64 jcc = 0;
+    u32 crossed = 0;
+    for_range(j, a + 1, buf->buf.len) {
+        FeMach* elem = buf->buf.at[j];
+        if (elem->kind == FE_MACH_CFG_BRANCH) {
+            if (j + 1 < buf->buf.len && buf->buf.at[j + 1]->kind == FE_MACH_INST &&
+                inst_at(buf, j + 1)->template == I(JCC)) {
+                jcc = j;
+            }
+            break;
+        }
+        if (elem->kind != FE_MACH_INST) {
+            if (is_transparent(elem->kind)) continue;
+            break;
+        }
+        FeMachInst* inst = (FeMachInst*)elem;
+        if (flag_effects[inst->template] != FLAGS_NONE) break;
+        if (buf->target.inst_templates[inst->template].side_effects) break;
+        bool clobbers = false;
+        for_range(r, 0, templ->regs_len) {
+            if (defines_real(buf, inst, real_of(buf, cmp, r))) clobbers = true;
+        }
+        if (clobbers) break;
+        crossed++;
+    }
+    if (jcc == 0 || crossed == 0) return false;
+
+    FeMach* moved = buf->buf.at[a];
+    for_range(j, a, jcc - 1) buf->buf.at[j] = buf->buf.at[j + 1];
+    buf->buf.at[jcc - 1] = moved;
+    return true;
+}
+
+// mov [m], r1; mov r2, [m]  ->  mov [m], r1; mov r2, r1
+static bool forward_store(FeMachBuffer* buf, const PeepholeRule* rule, u64 a, u64 b) {
+    FeMachInst* store = inst_at(buf, a);
+    FeMachInst* load = inst_at(buf, b);
+    if (!same_address(buf, store, load)) return false;
+    u32 dest = fe_mach_get_vreg(buf, load, 0);
+    u32 source = fe_mach_get_vreg(buf, store, 2);
+    FeMachInst* mov = replace(buf, b, rule->with);
+    fe_mach_set_vreg(buf, mov, 0, dest);
+    fe_mach_set_vreg(buf, mov, 1, source);
+    return true;
+}
+
+// mov r1, [m]; mov r2, [m]  ->  mov r1, [m]; mov r2, r1
+static bool forward_load(FeMachBuffer* buf, const PeepholeRule* rule, u64 a, u64 b) {
+    FeMachInst* first = inst_at(buf, a);
+    FeMachInst* second = inst_at(buf, b);
+    if (load_clobbers_address(buf, first) || !same_address(buf, first, second)) return false;
+    u32 dest = fe_mach_get_vreg(buf, second, 0);
+    u32 source = fe_mach_get_vreg(buf, first, 0);
+    FeMachInst* mov = replace(buf, b, rule->with);
+    fe_mach_set_vreg(buf, mov, 0, dest);
+    fe_mach_set_vreg(buf, mov, 1, source);
+    return true;
+}
+
+// mov r, [m]; mov [m], r  ->  mov r, [m]
+static bool store_back(FeMachBuffer* buf, const PeepholeRule* rule, u64 a, u64 b) {
+    FeMachInst* load = inst_at(buf, a);
+    FeMachInst* store = inst_at(buf, b);
+    if (load_clobbers_address(buf, load) || !same_address(buf, load, store)) return false;
+    if (real_of(buf, load, 0) != real_of(buf, store, 2)) return false;
+    delete(buf, b);
+    return true;
+}
+
+// mov [m], x; mov [m], y  ->  mov [m], y
+static bool overwritten_store(FeMachBuffer* buf, const PeepholeRule* rule, u64 a, u64 b) {
+    if (!same_address(buf, inst_at(buf, a), inst_at(buf, b))) return false;
+    delete(buf, a);
+    return true;
+}
+
+// mov r0, r1; add r0, r2   ->  lea r0, [r1 + r2]
+// mov r0, r1; add r0, imm  ->  lea r0, [r1 + imm]
+// mov r0, r1; sub r0, imm  ->  lea r0, [r1 - imm]
+static bool mov_add_to_lea(FeMachBuffer* buf, const PeepholeRule* rule, u64 a, u64 b) {
+    FeMachInst* mov = inst_at(buf, a);
+    FeMachInst* add = inst_at(buf, b);
+    u8 dest = real_of(buf, mov, 0);
+    if (dest == 0 || real_of(buf, add, 0) != dest || real_of(buf, mov, 1) == dest) return false;
+    if (flags_live_after(buf, b)) return false;
+
+    u32 base = fe_mach_get_vreg(buf, mov, 1);
+    u32 index = 0;
+    i64 disp = 0;
+    if (add->template == I(ADD_RR_64)) {
+        index = fe_mach_get_vreg(buf, add, 1);
+        // add r0, r0 adds the moved value to itself
+        if (buf->vregs.at[index].real == dest) index = base;
+        // rsp can't be an index
+        if (buf->vregs.at[index].real == FE_X64_GPR_RSP) {
+            u32 temp = index;
+            index = base;
+            base = temp;
+        }
+        if (buf->vregs.at[index].real == FE_X64_GPR_RSP) return false;
+    } else {
+        FeMachImmediate* imm = imm_of(buf, add, 0);
+        if (imm->kind != FE_MACH_IMM_CONST) return false;
+        disp = (i32)imm->d64;
+        if (add->template == I(SUB_RI_64)) {
+            if (disp == INT32_MIN) return false;
+            disp = -disp;
+        }
+    }
+
+    u32 vreg = fe_mach_get_vreg(buf, mov, 0);
+    FeMachInst* lea = replace(buf, a, rule->with);
+    fe_mach_set_vreg(buf, lea, 0, vreg);
+    fe_mach_set_vreg(buf, lea, 1, base);
+    fe_mach_set_vreg(buf, lea, 2, index);
+    fe_mach_set_immediate(buf, lea, 0, FE_MACH_IMM_CONST, 1);
+    fe_mach_set_immediate(buf, lea, 1, FE_MACH_IMM_CONST, (u64)disp);
+    delete(buf, b);
+    return true;
+}
+
+// jmp .next  ->  nothing
+static bool jump_to_next(FeMachBuffer* buf, const PeepholeRule* rule, u64 a, u64 b) {
+    FeMachImmediate* target = imm_of(buf, inst_at(buf, a), 0);
+    if (target->kind != FE_MACH_IMM_LABEL || !falls_into(buf, a, target->label)) return false;
+    delete(buf, a);
+    return true;
+}
+
+// jcc .next  ->  nothing
+static bool branch_to_next(FeMachBuffer* buf, const PeepholeRule* rule, u64 a, u64 b) {
+    FeMachImmediate* target = imm_of(buf, inst_at(buf, a), 1);
+    if (target->kind != FE_MACH_IMM_LABEL || !falls_into(buf, a, target->label)) return false;
+    delete(buf, a);
+    return true;
+}
+
+static u8 cond_code_inverted(u8 cc) {
+    switch (cc) {
+    case FE_X64_CC_E: return FE_X64_CC_NE;
+    case FE_X64_CC_NE: return FE_X64_CC_E;
+    case FE_X64_CC_L: return FE_X64_CC_GE;
+    case FE_X64_CC_GE: return FE_X64_CC_L;
+    case FE_X64_CC_LE: return FE_X64_CC_G;
+    case FE_X64_CC_G: return FE_X64_CC_LE;
+    case FE_X64_CC_B: return FE_X64_CC_AE;
+    case FE_X64_CC_AE: return FE_X64_CC_B;
+    case FE_X64_CC_BE: return FE_X64_CC_A;
+    case FE_X64_CC_A: return FE_X64_CC_BE;
+    case FE_X64_CC_P: return FE_X64_CC_NP;
+    case FE_X64_CC_NP: return FE_X64_CC_P;
+    default: UNREACHABLE;
+    }
+}
+
+// jcc .next; jmp .other  ->  jncc .other
+static bool branch_over_jump(FeMachBuffer* buf, const PeepholeRule* rule, u64 a, u64 b) {
+    FeMachInst* jcc = inst_at(buf, a);
+    FeMachInst* jmp = inst_at(buf, b);
+    FeMachImmediate* taken = imm_of(buf, jcc, 1);
+    FeMachImmediate* other = imm_of(buf, jmp, 0);
+    if (taken->kind != FE_MACH_IMM_LABEL || other->kind != FE_MACH_IMM_LABEL) return false;
+    if (!falls_into(buf, b, taken->label)) return false;
+
+    FeMachImmediate* cc = imm_of(buf, jcc, 0);
+    cc->d64 = cond_code_inverted(cc->d64);
+    taken->label = other->label;
+    delete(buf, b);
+    return true;
+}
+
+#define RULE(first, second, with, rewrite) {I(first), I(second), I(with), rewrite},
+#define RULE_W(first, second, with, rewrite) \
+    RULE(first##_8, second, with, rewrite)   \
+    RULE(first##_16, second, with, rewrite)  \
+    RULE(first##_32, second, with, rewrite)  \
+    RULE(first##_64, second, with, rewrite)
+#define RULE_WW(first, second, with, rewrite)         \
+    RULE(first##_8, second##_8, with, rewrite)        \
+    RULE(first##_16, second##_16, with, rewrite)      \
+    RULE(first##_32, second##_32, with, rewrite)      \
+    RULE(first##_64, second##_64, with, rewrite)
+
+static const PeepholeRule rules[] = {
+    // moves
+    RULE(MOV_RR_64, UNKNOWN, UNKNOWN, self_move)
+    RULE(MOVAPS_RR, UNKNOWN, UNKNOWN, self_move)
+    RULE(MOV_RI_32, UNKNOWN, XOR_RR_32, zero_idiom)
+    RULE(MOV_RI_64, UNKNOWN, XOR_RR_32, zero_idiom)
+
+    // redundant loads and stores
+    RULE(MOV_MR_8, MOVZX_RM_32_8, MOVZX_32_8, forward_store)
+    RULE(MOV_MR_16, MOVZX_RM_32_16, MOVZX_32_16, forward_store)
+    RULE(MOV_MR_32, MOV_RM_32, MOV_RR_32, forward_store)
+    RULE(MOV_MR_64, MOV_RM_64, MOV_RR_64, forward_store)
+    RULE(MOVZX_RM_32_8, MOVZX_RM_32_8, MOV_RR_32, forward_load)
+    RULE(MOVZX_RM_32_16, MOVZX_RM_32_16, MOV_RR_32, forward_load)
+    RULE(MOV_RM_32, MOV_RM_32, MOV_RR_32, forward_load)
+    RULE(MOV_RM_64, MOV_RM_64, MOV_RR_64, forward_load)
+    RULE(MOVZX_RM_32_8, MOV_MR_8, UNKNOWN, store_back)
+    RULE(MOVZX_RM_32_16, MOV_MR_16, UNKNOWN, store_back)
+    RULE(MOV_RM_32, MOV_MR_32, UNKNOWN, store_back)
+    RULE(MOV_RM_64, MOV_MR_64, UNKNOWN, store_back)
+    RULE_WW(MOV_MR, MOV_MR, UNKNOWN, overwritten_store)
+    RULE_WW(MOV_MR, MOV_MI, UNKNOWN, overwritten_store)
+    RULE_WW(MOV_MI, MOV_MR, UNKNOWN, overwritten_store)
+    RULE_WW(MOV_MI, MOV_MI, UNKNOWN, overwritten_store)
+
+    // address arithmetic
+    RULE(MOV_RR_64, ADD_RR_64, LEA_64, mov_add_to_lea)
+    RULE(MOV_RR_64, ADD_RI_64, LEA_64, mov_add_to_lea)
+    RULE(MOV_RR_64, SUB_RI_64, LEA_64, mov_add_to_lea)
+
+    // comparisons
+    RULE_W(CMP_RR, UNKNOWN, UNKNOWN, dead_compare)
+    RULE_W(CMP_RI, UNKNOWN, UNKNOWN, dead_compare)
+    RULE_W(TEST_RR, UNKNOWN, UNKNOWN, dead_compare)
+    RULE(UCOMISS_RR, UNKNOWN, UNKNOWN, dead_compare)
+    RULE(UCOMISD_RR, UNKNOWN, UNKNOWN, dead_compare)
+    RULE(CMP_RI_8, UNKNOWN, TEST_RR_8, compare_zero)
+    RULE(CMP_RI_16, UNKNOWN, TEST_RR_16, compare_zero)
+    RULE(CMP_RI_32, UNKNOWN, TEST_RR_32, compare_zero)
+    RULE(CMP_RI_64, UNKNOWN, TEST_RR_64, compare_zero)
+    RULE_W(CMP_RR, UNKNOWN, UNKNOWN, sink_compare)
+    RULE_W(CMP_RI, UNKNOWN, UNKNOWN, sink_compare)
+    RULE_W(TEST_RR, UNKNOWN, UNKNOWN, sink_compare)
+    RULE(UCOMISS_RR, UNKNOWN, UNKNOWN, sink_compare)
+    RULE(UCOMISD_RR, UNKNOWN, UNKNOWN, sink_compare)
+
+    // jumps
+    RULE(JMP, UNKNOWN, UNKNOWN, jump_to_next)
+    RULE(JCC, UNKNOWN, UNKNOWN, branch_to_next)
+    RULE(JCC, JMP, UNKNOWN, branch_over_jump)
+};
+
+#undef RULE
+#undef RULE_W
+#undef RULE_WW
+
+// rules sorted by their first template, rules for template t are
+// rule_order[rule_start[t]] up to rule_order[rule_start[t + 1]]
+static u16 rule_order[sizeof(rules) / sizeof(rules[0])];
+static u16 rule_start[_FE_X64_INST_COUNT + 1];
+
+static void index_rules() {
+    if (rule_start[_FE_X64_INST_COUNT] != 0) return;
+
+    for_range(r, 0, sizeof(rules) / sizeof(rules[0])) rule_start[rules[r].first + 1]++;
+    for_range(t, 0, _FE_X64_INST_COUNT) rule_start[t + 1] += rule_start[t];
+
+    u16 filled[_FE_X64_INST_COUNT] = {0};
+    for_range(r, 0, sizeof(rules) / sizeof(rules[0])) {
+        u16 t = rules[r].first;
+        rule_order[rule_start[t] + filled[t]++] = r;
+    }
+}
+
+void fe_x64_peephole(FeMachBuffer* buf) {
+    index_rules();
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for_range(i, 0, buf->buf.len) {
+            if (buf->buf.at[i]->kind != FE_MACH_INST) continue;
+            u16 template = inst_at(buf, i)->template;
+            u64 next = next_inst(buf, i);
+            u16 next_template = next != 0 ? inst_at(buf, next)->template : FE_X64_INST_UNKNOWN;
+
+            for_range(r, rule_start[template], rule_start[template + 1]) {
+                const PeepholeRule* rule = &rules[rule_order[r]];
+                if (rule->second != FE_X64_INST_UNKNOWN && rule->second != next_template) continue;
+                if (rule->rewrite(buf, rule, i, next)) {
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+}
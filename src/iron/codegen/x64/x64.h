@@ -5,6 +5,7 @@
 enum {
     FE_X64_REGCLASS_UNKNOWN = 0,
     FE_X64_REGCLASS_GPR,
+    FE_X64_REGCLASS_XMM,
 };
 
 enum {
@@ -30,19 +31,258 @@ enum {
     _FE_X64_GPR_COUNT,
 };
 
+enum {
+    FE_X64_XMM_UNKNOWN = 0,
+
+    FE_X64_XMM0, // only the low 32 or 64 bits are used, for scalar floats
+    FE_X64_XMM1,
+    FE_X64_XMM2,
+    FE_X64_XMM3,
+    FE_X64_XMM4,
+    FE_X64_XMM5,
+    FE_X64_XMM6,
+    FE_X64_XMM7,
+    FE_X64_XMM8,
+    FE_X64_XMM9,
+    FE_X64_XMM10,
+    FE_X64_XMM11,
+    FE_X64_XMM12,
+    FE_X64_XMM13,
+    FE_X64_XMM14,
+    FE_X64_XMM15,
+
+    _FE_X64_XMM_COUNT,
+};
+
+// x64 machine description.
+// every instruction template is described exactly once here. the template
+// enum, the template array, the text syntax and the binary encodings are
+// all generated from this table, so adding an instruction is one line.
+//
+// INST(name, width, regs_len, defs, uses, imms_len, side_effects, cost, text, enc, op8, op, ext)
+//
+//  width   operand size in bits, 0 if the instruction doesn't have one
+//  cost    rough latency in cycles, used by isel to pick between equivalent sequences
+//  text    syntax template for the text emitter:
+//              %rN         register N at the instruction's width
+//              %qN %dN     register N as 64 or 32-bit
+//              %wN %bN     register N as 16 or 8-bit
+//              %iN         immediate N
+//              %cN         condition code in immediate N
+//              %mNM        memory operand from registers N, N+1 and immediates M, M+1
+//              %s          size keyword for the instruction's width (byte, word, ...)
+//  enc     encoding form, see FE_X64_ENC_*
+//  op8     opcode for the 8-bit variant (ignored unless width is 8)
+//  op      opcode, multi-byte opcodes are written most significant byte first
+//  ext     opcode extension in ModRM.reg, for forms that need one
+//
+// INST_W defines the 8, 16, 32 and 64-bit variants of an instruction at once.
+// width variants are always laid out 8, 16, 32, 64 so that isel can select
+// one by offsetting from the smallest variant.
+//
+// memory operands are always [base + index * scale + disp]. base and index
+// are registers (index may be the null vreg), scale and disp are immediates.
+//
+// sse instructions keep their mandatory prefix (66, F2, F3) in the top byte of
+// op, since it has to go before REX. their width is the size of their general
+// purpose operand (it decides REX.W), 0 if they only touch xmm registers.
+// ss and sd variants are always laid out next to each other, ss first.
+#define FE_X64_INSTS \
+    /*     name            width regs defs   uses   imms side  cost text                     enc         op8   op      ext */ \
+    INST(  MOV_RR_32,      32,   2,   0b01,  0b10,  0,   false, 1, "mov %r0, %r1",           RM_R,       0x00, 0x89,   0) \
+    INST(  MOV_RR_64,      64,   2,   0b01,  0b10,  0,   false, 1, "mov %r0, %r1",           RM_R,       0x00, 0x89,   0) \
+    INST(  MOV_RI_32,      32,   1,   0b1,   0b0,   1,   false, 1, "mov %r0, %i0",           OI,         0x00, 0xB8,   0) \
+    INST(  MOV_RI_64,      64,   1,   0b1,   0b0,   1,   false, 1, "mov %r0, %i0",           OI,         0x00, 0xB8,   0) \
+                                                                                                                         \
+    /* two-address arithmetic, the first register is a def and a use */                                                  \
+    INST_W(ADD_RR,               2,   0b01,  0b11,  0,   false, 1, "add %r0, %r1",           RM_R,       0x00, 0x01,   0) \
+    INST_W(ADD_RI,               1,   0b1,   0b1,   1,   false, 1, "add %r0, %i0",           RM_I,       0x80, 0x81,   0) \
+    INST_W(SUB_RR,               2,   0b01,  0b11,  0,   false, 1, "sub %r0, %r1",           RM_R,       0x28, 0x29,   0) \
+    INST_W(SUB_RI,               1,   0b1,   0b1,   1,   false, 1, "sub %r0, %i0",           RM_I,       0x80, 0x81,   5) \
+    INST_W(AND_RR,               2,   0b01,  0b11,  0,   false, 1, "and %r0, %r1",           RM_R,       0x20, 0x21,   0) \
+    INST_W(AND_RI,               1,   0b1,   0b1,   1,   false, 1, "and %r0, %i0",           RM_I,       0x80, 0x81,   4) \
+    INST_W(OR_RR,                2,   0b01,  0b11,  0,   false, 1, "or %r0, %r1",            RM_R,       0x08, 0x09,   0) \
+    INST_W(OR_RI,                1,   0b1,   0b1,   1,   false, 1, "or %r0, %i0",            RM_I,       0x80, 0x81,   1) \
+    INST_W(XOR_RR,               2,   0b01,  0b11,  0,   false, 1, "xor %r0, %r1",           RM_R,       0x30, 0x31,   0) \
+    INST_W(XOR_RI,               1,   0b1,   0b1,   1,   false, 1, "xor %r0, %i0",           RM_I,       0x80, 0x81,   6) \
+                                                                                                                         \
+    /* there is no two-operand 8-bit imul, isel widens to 32 */                                                          \
+    INST(  IMUL_RR_16,     16,   2,   0b01,  0b11,  0,   false, 3, "imul %r0, %r1",          R_RM,       0x00, 0x0FAF, 0) \
+    INST(  IMUL_RR_32,     32,   2,   0b01,  0b11,  0,   false, 3, "imul %r0, %r1",          R_RM,       0x00, 0x0FAF, 0) \
+    INST(  IMUL_RR_64,     64,   2,   0b01,  0b11,  0,   false, 3, "imul %r0, %r1",          R_RM,       0x00, 0x0FAF, 0) \
+    INST(  IMUL_RRI_16,    16,   2,   0b01,  0b10,  1,   false, 3, "imul %r0, %r1, %i0",     R_RM_I,     0x00, 0x69,   0) \
+    INST(  IMUL_RRI_32,    32,   2,   0b01,  0b10,  1,   false, 3, "imul %r0, %r1, %i0",     R_RM_I,     0x00, 0x69,   0) \
+    INST(  IMUL_RRI_64,    64,   2,   0b01,  0b10,  1,   false, 3, "imul %r0, %r1, %i0",     R_RM_I,     0x00, 0x69,   0) \
+                                                                                                                         \
+    /* comparisons only define flags, which are not tracked as registers */                                              \
+    INST_W(CMP_RR,               2,   0b00,  0b11,  0,   false, 1, "cmp %r0, %r1",           RM_R,       0x38, 0x39,   0) \
+    INST_W(CMP_RI,               1,   0b0,   0b1,   1,   false, 1, "cmp %r0, %i0",           RM_I,       0x80, 0x81,   7) \
+    INST_W(TEST_RR,              2,   0b00,  0b11,  0,   false, 1, "test %r0, %r1",          RM_R,       0x84, 0x85,   0) \
+                                                                                                                         \
+    /* variable shifts take their count in a vreg pinned to rcx */                                                       \
+    INST_W(SHL_RC,               2,   0b01,  0b11,  0,   false, 2, "shl %r0, %b1",           RM,         0xD2, 0xD3,   4) \
+    INST_W(SHL_RI,               1,   0b1,   0b1,   1,   false, 1, "shl %r0, %i0",           RM_IB,      0xC0, 0xC1,   4) \
+    INST_W(SHR_RC,               2,   0b01,  0b11,  0,   false, 2, "shr %r0, %b1",           RM,         0xD2, 0xD3,   5) \
+    INST_W(SHR_RI,               1,   0b1,   0b1,   1,   false, 1, "shr %r0, %i0",           RM_IB,      0xC0, 0xC1,   5) \
+    INST_W(SAR_RC,               2,   0b01,  0b11,  0,   false, 2, "sar %r0, %b1",           RM,         0xD2, 0xD3,   7) \
+    INST_W(SAR_RI,               1,   0b1,   0b1,   1,   false, 1, "sar %r0, %i0",           RM_IB,      0xC0, 0xC1,   7) \
+                                                                                                                         \
+    INST_W(NOT_R,                1,   0b1,   0b1,   0,   false, 1, "not %r0",                RM,         0xF6, 0xF7,   2) \
+    INST_W(NEG_R,                1,   0b1,   0b1,   0,   false, 1, "neg %r0",                RM,         0xF6, 0xF7,   3) \
+                                                                                                                         \
+    /* 8 and 16-bit division is widened to 32 by isel. */                                                                \
+    /* the first two registers are pinned to rax and rdx */                                                              \
+    INST(  DIV_R_32,       32,   3,   0b011, 0b111, 0,   false, 26, "div %r2",               DIV,        0x00, 0xF7,   6) \
+    INST(  DIV_R_64,       64,   3,   0b011, 0b111, 0,   false, 40, "div %r2",               DIV,        0x00, 0xF7,   6) \
+    INST(  IDIV_R_32,      32,   3,   0b011, 0b111, 0,   false, 26, "idiv %r2",              DIV,        0x00, 0xF7,   7) \
+    INST(  IDIV_R_64,      64,   3,   0b011, 0b111, 0,   false, 40, "idiv %r2",              DIV,        0x00, 0xF7,   7) \
+    INST(  CDQ,            32,   2,   0b01,  0b10,  0,   false, 1, "cdq",                    NONE,       0x00, 0x99,   0) \
+    INST(  CQO,            64,   2,   0b01,  0b10,  0,   false, 1, "cqo",                    NONE,       0x00, 0x99,   0) \
+                                                                                                                         \
+    INST(  SETCC,          8,    1,   0b1,   0b0,   1,   false, 1, "set%c0 %r0",             SETCC,      0x0F90, 0x00, 0) \
+                                                                                                                         \
+    INST(  MOVZX_32_8,     32,   2,   0b01,  0b10,  0,   false, 1, "movzx %r0, %b1",         R_RM8,      0x00, 0x0FB6, 0) \
+    INST(  MOVZX_32_16,    32,   2,   0b01,  0b10,  0,   false, 1, "movzx %r0, %w1",         R_RM,       0x00, 0x0FB7, 0) \
+    INST(  MOVSX_32_8,     32,   2,   0b01,  0b10,  0,   false, 1, "movsx %r0, %b1",         R_RM8,      0x00, 0x0FBE, 0) \
+    INST(  MOVSX_32_16,    32,   2,   0b01,  0b10,  0,   false, 1, "movsx %r0, %w1",         R_RM,       0x00, 0x0FBF, 0) \
+    INST(  MOVSX_64_8,     64,   2,   0b01,  0b10,  0,   false, 1, "movsx %r0, %b1",         R_RM8,      0x00, 0x0FBE, 0) \
+    INST(  MOVSX_64_16,    64,   2,   0b01,  0b10,  0,   false, 1, "movsx %r0, %w1",         R_RM,       0x00, 0x0FBF, 0) \
+    INST(  MOVSXD_64_32,   64,   2,   0b01,  0b10,  0,   false, 1, "movsxd %r0, %d1",        R_RM,       0x00, 0x63,   0) \
+                                                                                                                         \
+    INST(  LEA_64,         64,   3,   0b001, 0b110, 2,   false, 1, "lea %r0, %m10",          R_M,        0x00, 0x8D,   0) \
+    INST(  LEA_RIP_64,     64,   1,   0b1,   0b0,   1,   false, 1, "lea %r0, [rip + %i0]",   R_RIP,      0x00, 0x8D,   0) \
+                                                                                                                         \
+    INST(  MOV_RM_32,      32,   3,   0b001, 0b110, 2,   false, 4, "mov %r0, %m10",          R_M,        0x00, 0x8B,   0) \
+    INST(  MOV_RM_64,      64,   3,   0b001, 0b110, 2,   false, 4, "mov %r0, %m10",          R_M,        0x00, 0x8B,   0) \
+    INST(  MOVZX_RM_32_8,  32,   3,   0b001, 0b110, 2,   false, 4, "movzx %r0, byte %m10",   R_M,        0x00, 0x0FB6, 0) \
+    INST(  MOVZX_RM_32_16, 32,   3,   0b001, 0b110, 2,   false, 4, "movzx %r0, word %m10",   R_M,        0x00, 0x0FB7, 0) \
+                                                                                                                         \
+    /* stores: registers [base, index, value], immediates [scale, disp, value] */                                        \
+    INST_W(MOV_MR,               3,   0b000, 0b111, 2,   true,  1, "mov %m00, %r2",          M_R,        0x88, 0x89,   0) \
+    INST_W(MOV_MI,               2,   0b00,  0b11,  3,   true,  1, "mov %s %m00, %i2",       M_I,        0xC6, 0xC7,   0) \
+                                                                                                                         \
+    /* only used for the frame pointer, which isel keeps out of regalloc's way */                                         \
+    INST(  PUSH_R,         0,    1,   0b0,   0b1,   0,   true,  1, "push %q0",               O,          0x00, 0x50,   0) \
+    INST(  POP_R,          0,    1,   0b1,   0b0,   0,   true,  1, "pop %q0",                O,          0x00, 0x58,   0) \
+                                                                                                                         \
+    INST(  JMP,            0,    0,   0b0,   0b0,   1,   true,  1, "jmp %i0",                REL32,      0x00, 0xE9,   0) \
+    INST(  JCC,            0,    0,   0b0,   0b0,   2,   true,  1, "j%c0 %i1",               JCC,        0x00, 0x0F80, 0) \
+    INST(  CALL,           0,    0,   0b0,   0b0,   1,   true,  3, "call %i0",               REL32,      0x00, 0xE8,   0) \
+    INST(  CALL_R,         0,    1,   0b0,   0b1,   0,   true,  3, "call %q0",               RM,         0x00, 0xFF,   2) \
+    INST(  RET,            0,    0,   0b0,   0b0,   0,   true,  1, "ret",                    NONE,       0x00, 0xC3,   0) \
+                                                                                                                           \
+    /* scalar sse, see above */                                                                                            \
+    INST(  MOVAPS_RR,      0,    2,   0b01,  0b10,  0,   false, 1, "movaps %r0, %r1",        SSE_R_RM,   0x00, 0x0F28,   0) \
+    INST(  MOVSS_RM,       0,    3,   0b001, 0b110, 2,   false, 4, "movss %r0, %m10",        SSE_R_M,    0x00, 0xF30F10, 0) \
+    INST(  MOVSD_RM,       0,    3,   0b001, 0b110, 2,   false, 4, "movsd %r0, %m10",        SSE_R_M,    0x00, 0xF20F10, 0) \
+    INST(  MOVSS_MR,       0,    3,   0b000, 0b111, 2,   true,  1, "movss %m00, %r2",        SSE_M_R,    0x00, 0xF30F11, 0) \
+    INST(  MOVSD_MR,       0,    3,   0b000, 0b111, 2,   true,  1, "movsd %m00, %r2",        SSE_M_R,    0x00, 0xF20F11, 0) \
+    INST(  ADDSS_RR,       0,    2,   0b01,  0b11,  0,   false, 4, "addss %r0, %r1",         SSE_R_RM,   0x00, 0xF30F58, 0) \
+    INST(  ADDSD_RR,       0,    2,   0b01,  0b11,  0,   false, 4, "addsd %r0, %r1",         SSE_R_RM,   0x00, 0xF20F58, 0) \
+    INST(  SUBSS_RR,       0,    2,   0b01,  0b11,  0,   false, 4, "subss %r0, %r1",         SSE_R_RM,   0x00, 0xF30F5C, 0) \
+    INST(  SUBSD_RR,       0,    2,   0b01,  0b11,  0,   false, 4, "subsd %r0, %r1",         SSE_R_RM,   0x00, 0xF20F5C, 0) \
+    INST(  MULSS_RR,       0,    2,   0b01,  0b11,  0,   false, 4, "mulss %r0, %r1",         SSE_R_RM,   0x00, 0xF30F59, 0) \
+    INST(  MULSD_RR,       0,    2,   0b01,  0b11,  0,   false, 4, "mulsd %r0, %r1",         SSE_R_RM,   0x00, 0xF20F59, 0) \
+    INST(  DIVSS_RR,       0,    2,   0b01,  0b11,  0,   false, 11, "divss %r0, %r1",        SSE_R_RM,   0x00, 0xF30F5E, 0) \
+    INST(  DIVSD_RR,       0,    2,   0b01,  0b11,  0,   false, 14, "divsd %r0, %r1",        SSE_R_RM,   0x00, 0xF20F5E, 0) \
+    INST(  XORPS_RR,       0,    2,   0b01,  0b11,  0,   false, 1, "xorps %r0, %r1",         SSE_R_RM,   0x00, 0x0F57,   0) \
+    INST(  UCOMISS_RR,     0,    2,   0b00,  0b11,  0,   false, 2, "ucomiss %r0, %r1",       SSE_R_RM,   0x00, 0x0F2E,   0) \
+    INST(  UCOMISD_RR,     0,    2,   0b00,  0b11,  0,   false, 2, "ucomisd %r0, %r1",       SSE_R_RM,   0x00, 0x660F2E, 0) \
+    INST(  CVTSS2SD,       0,    2,   0b01,  0b10,  0,   false, 4, "cvtss2sd %r0, %r1",      SSE_R_RM,   0x00, 0xF30F5A, 0) \
+    INST(  CVTSD2SS,       0,    2,   0b01,  0b10,  0,   false, 4, "cvtsd2ss %r0, %r1",      SSE_R_RM,   0x00, 0xF20F5A, 0) \
+                                                                                                                           \
+    /* conversions to and from general purpose registers, at the gpr's width */                                            \
+    INST(  CVTSI2SS_32,    32,   2,   0b01,  0b10,  0,   false, 4, "cvtsi2ss %r0, %r1",      SSE_R_RM,   0x00, 0xF30F2A, 0) \
+    INST(  CVTSI2SS_64,    64,   2,   0b01,  0b10,  0,   false, 4, "cvtsi2ss %r0, %r1",      SSE_R_RM,   0x00, 0xF30F2A, 0) \
+    INST(  CVTSI2SD_32,    32,   2,   0b01,  0b10,  0,   false, 4, "cvtsi2sd %r0, %r1",      SSE_R_RM,   0x00, 0xF20F2A, 0) \
+    INST(  CVTSI2SD_64,    64,   2,   0b01,  0b10,  0,   false, 4, "cvtsi2sd %r0, %r1",      SSE_R_RM,   0x00, 0xF20F2A, 0) \
+    INST(  CVTTSS2SI_32,   32,   2,   0b01,  0b10,  0,   false, 6, "cvttss2si %r0, %r1",     SSE_R_RM,   0x00, 0xF30F2C, 0) \
+    INST(  CVTTSS2SI_64,   64,   2,   0b01,  0b10,  0,   false, 6, "cvttss2si %r0, %r1",     SSE_R_RM,   0x00, 0xF30F2C, 0) \
+    INST(  CVTTSD2SI_32,   32,   2,   0b01,  0b10,  0,   false, 6, "cvttsd2si %r0, %r1",     SSE_R_RM,   0x00, 0xF20F2C, 0) \
+    INST(  CVTTSD2SI_64,   64,   2,   0b01,  0b10,  0,   false, 6, "cvttsd2si %r0, %r1",     SSE_R_RM,   0x00, 0xF20F2C, 0) \
+    INST(  MOVD_XR_32,     32,   2,   0b01,  0b10,  0,   false, 2, "movd %r0, %r1",          SSE_R_RM,   0x00, 0x660F6E, 0) \
+    INST(  MOVQ_XR_64,     64,   2,   0b01,  0b10,  0,   false, 2, "movq %r0, %r1",          SSE_R_RM,   0x00, 0x660F6E, 0) \
+    INST(  MOVD_RX_32,     32,   2,   0b01,  0b10,  0,   false, 2, "movd %r0, %r1",          SSE_RM_R,   0x00, 0x660F7E, 0) \
+    INST(  MOVQ_RX_64,     64,   2,   0b01,  0b10,  0,   false, 2, "movq %r0, %r1",          SSE_RM_R,   0x00, 0x660F7E, 0)
+
+#define INST_W(name, ...)                                                                                                  \
+    INST(name##_8, 8, __VA_ARGS__)       \
+    INST(name##_16, 16, __VA_ARGS__)     \
+    INST(name##_32, 32, __VA_ARGS__)     \
+    INST(name##_64, 64, __VA_ARGS__)
+
 enum {
     FE_X64_INST_UNKNOWN = 0,
 
-    FE_X64_INST_MOV_RR_64, // mov def, use
-    FE_X64_INST_ADD_RR_64, // add def/use, use
-    FE_X64_INST_LEA_RR_64, // lea def, [use + use]
-    FE_X64_INST_RET,       // ret
+#define INST(name, ...) FE_X64_INST_##name,
+    FE_X64_INSTS
+#undef INST
 
     _FE_X64_INST_COUNT,
 };
 
+// how an instruction's operands are laid out in its encoding.
+// reg0 is the first register of the instruction, and so on.
+enum {
+    FE_X64_ENC_NONE,   // opcode only
+    FE_X64_ENC_RM_R,   // ModRM.rm = reg0, ModRM.reg = reg1
+    FE_X64_ENC_R_RM,   // ModRM.reg = reg0, ModRM.rm = reg1
+    FE_X64_ENC_R_RM8,  // R_RM, but reg1 is an 8-bit register
+    FE_X64_ENC_R_RM_I, // R_RM followed by an immediate of the instruction's width
+    FE_X64_ENC_RM,     // ModRM.rm = reg0, ModRM.reg = ext
+    FE_X64_ENC_RM_I,   // RM followed by an immediate of the instruction's width
+    FE_X64_ENC_RM_IB,  // RM followed by an 8-bit immediate
+    FE_X64_ENC_DIV,    // ModRM.rm = reg2, ModRM.reg = ext
+    FE_X64_ENC_O,      // opcode + reg0
+    FE_X64_ENC_OI,     // opcode + reg0, immediate of the instruction's width
+    FE_X64_ENC_R_M,    // ModRM.reg = reg0, memory operand from reg1 and imm0
+    FE_X64_ENC_M_R,    // memory operand from reg0 and imm0, ModRM.reg = reg2
+    FE_X64_ENC_M_I,    // memory operand from reg0 and imm0, ModRM.reg = ext, imm2
+    FE_X64_ENC_R_RIP,  // ModRM.reg = reg0, [rip + symbol in imm0]
+    FE_X64_ENC_REL32,  // rel32 to a label or symbol in imm0
+    FE_X64_ENC_JCC,    // opcode + cc in imm0, rel32 to a label in imm1
+    FE_X64_ENC_SETCC,  // opcode + cc in imm0, ModRM.rm = reg0
+
+    // sse forms write the mandatory prefix first, registers may be gprs or xmms
+    FE_X64_ENC_SSE_R_RM, // ModRM.reg = reg0, ModRM.rm = reg1
+    FE_X64_ENC_SSE_RM_R, // ModRM.rm = reg0, ModRM.reg = reg1
+    FE_X64_ENC_SSE_R_M,  // ModRM.reg = reg0, memory operand from reg1 and imm0
+    FE_X64_ENC_SSE_M_R,  // memory operand from reg0 and imm0, ModRM.reg = reg2
+};
+
+// condition codes, used as the immediate of SETCC and JCC
+enum {
+    FE_X64_CC_E,
+    FE_X64_CC_NE,
+    FE_X64_CC_L,
+    FE_X64_CC_LE,
+    FE_X64_CC_G,
+    FE_X64_CC_GE,
+    FE_X64_CC_B,
+    FE_X64_CC_BE,
+    FE_X64_CC_A,
+    FE_X64_CC_AE,
+    FE_X64_CC_P, // only after ucomis, set if either operand was a NaN
+    FE_X64_CC_NP,
+
+    _FE_X64_CC_COUNT,
+};
+
 extern const FeMachInstTemplate fe_x64_inst_templates[_FE_X64_INST_COUNT];
 
+// post-regalloc cleanup, see peephole.c
+void fe_x64_peephole(FeMachBuffer* buf);
+
+// x64 codegen options, passed in through FeModule.target.arch_config.
+// a NULL arch_config uses the defaults (all false).
+typedef struct FeX64Config {
+    // keep rbp as a frame pointer instead of handing it to regalloc
+    bool frame_pointer;
+    // never use the 128 bytes below rsp, even where the system allows it.
+    // kernel code needs this, since interrupts write below rsp.
+    bool no_red_zone;
+} FeX64Config;
+
 // x64-specific instructions
 enum {
     _FE_IR_X64_START = _FE_IR_ARCH_SPECIFIC_START,
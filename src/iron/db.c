@@ -78,21 +78,21 @@ size_t fe_db_write_8(FeDataBuffer* buf, u8 data) {
 size_t fe_db_write_16(FeDataBuffer* buf, u16 data) {
     fe_db_reserve(buf, sizeof(data));
     memcpy(buf->at + buf->len, &data, sizeof(data));
-    buf->len = +sizeof(data);
+    buf->len += sizeof(data);
     return sizeof(data);
 }
 
 size_t fe_db_write_32(FeDataBuffer* buf, u32 data) {
     fe_db_reserve(buf, sizeof(data));
     memcpy(buf->at + buf->len, &data, sizeof(data));
-    buf->len = +sizeof(data);
+    buf->len += sizeof(data);
     return sizeof(data);
 }
 
 size_t fe_db_write_64(FeDataBuffer* buf, u64 data) {
     fe_db_reserve(buf, sizeof(data));
     memcpy(buf->at + buf->len, &data, sizeof(data));
-    buf->len = +sizeof(data);
+    buf->len += sizeof(data);
     return sizeof(data);
 }
 
@@ -118,12 +118,37 @@ size_t fe_db_insert_32(FeDataBuffer* buf, size_t at, u32 data);
 size_t fe_db_insert_64(FeDataBuffer* buf, size_t at, u64 data);
 
 // overwrite data at a certain point, growing the buffer if needed
-size_t fe_db_overwrite_string(FeDataBuffer* buf, size_t at, string s);
-size_t fe_db_overwrite_bytes(FeDataBuffer* buf, size_t at, void* ptr, size_t len);
-size_t fe_db_overwrite_cstring(FeDataBuffer* buf, size_t at, char* s);
-size_t fe_db_overwrite_8(FeDataBuffer* buf, size_t at, u8 data);
-size_t fe_db_overwrite_16(FeDataBuffer* buf, size_t at, u16 data);
-size_t fe_db_overwrite_32(FeDataBuffer* buf, size_t at, u32 data);
-size_t fe_db_overwrite_64(FeDataBuffer* buf, size_t at, u64 data);
+size_t fe_db_overwrite_bytes(FeDataBuffer* buf, size_t at, void* ptr, size_t len) {
+    if (at + len > buf->len) {
+        fe_db_reserve(buf, at + len - buf->len);
+        buf->len = at + len;
+    }
+    memcpy(buf->at + at, ptr, len);
+    return len;
+}
+
+size_t fe_db_overwrite_string(FeDataBuffer* buf, size_t at, string s) {
+    return fe_db_overwrite_bytes(buf, at, s.raw, s.len);
+}
+
+size_t fe_db_overwrite_cstring(FeDataBuffer* buf, size_t at, char* s) {
+    return fe_db_overwrite_bytes(buf, at, s, strlen(s));
+}
+
+size_t fe_db_overwrite_8(FeDataBuffer* buf, size_t at, u8 data) {
+    return fe_db_overwrite_bytes(buf, at, &data, sizeof(data));
+}
+
+size_t fe_db_overwrite_16(FeDataBuffer* buf, size_t at, u16 data) {
+    return fe_db_overwrite_bytes(buf, at, &data, sizeof(data));
+}
+
+size_t fe_db_overwrite_32(FeDataBuffer* buf, size_t at, u32 data) {
+    return fe_db_overwrite_bytes(buf, at, &data, sizeof(data));
+}
+
+size_t fe_db_overwrite_64(FeDataBuffer* buf, size_t at, u64 data) {
+    return fe_db_overwrite_bytes(buf, at, &data, sizeof(data));
+}
 
 // TODO add read functions
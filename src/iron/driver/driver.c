@@ -5,7 +5,13 @@
 // application frontend for iron. this is not included when
 // building iron as a library or as part of mars.
 
-int main() {
+int main(int argc, char** argv) {
+
+    if (argc > 1 && strcmp(argv[1], "test") == 0) {
+        fe_selftest();
+        printf("all tests passed\n");
+        return 0;
+    }
 
     FeModule* m = fe_new_module(str("cfg"));
 
@@ -53,7 +53,7 @@ static string normalized_identifier(FeModule* m, void* entity, string name) {
     }
 
     if (is_normal) {
-        string* permanent_string = malloc(sizeof(string));
+        string* permanent_string = fe_malloc(sizeof(string));
         *permanent_string = name;
         ptrmap_put(&sym2ident, entity, permanent_string);
         return name;
@@ -27,7 +27,7 @@ FeModule* fe_read_module(string text) {
     da_append(&tokens, t);
 
     Parser p = {
-        .node_alloca = arena_make(1000 * sizeof(Ast)),
+        .node_alloca = fe_arena_make(1000 * sizeof(Ast)),
         .tokens = tokens.at,
         .tokens_len = tokens.len,
         .index = 0,
@@ -10,22 +10,26 @@
 
 // if (sym == NULL), create new symbol with no name
 FeFunction* fe_new_function(FeModule* mod, FeSymbol* sym, u8 cconv) {
+    fe_charge_module(mod);
     FeFunction* fn = fe_malloc(sizeof(FeFunction));
 
-    fn->sym = sym ? sym : fe_new_symbol(mod, NULL_STR, FE_BIND_EXPORT);
-    if (!sym) fn->sym->name = strprintf("symbol_%016llx", fn->sym);
+    // named after the function, so the symbol goes into the index with its real name
+    fn->sym = sym ? sym : fe_new_symbol(mod, strprintf("symbol_%016llx", fn), FE_BIND_EXPORT);
     fn->sym->is_function = true;
     fn->sym->function = fn;
     fn->cconv = cconv;
     fn->cfg_up_to_date = false;
-    fn->alloca = arena_make(FE_FN_ALLOCA_BLOCK_SIZE);
+    fn->alloca = fe_arena_make(FE_FN_ALLOCA_BLOCK_SIZE);
     fn->params.at = NULL;
     fn->returns.at = NULL;
     fn->mod = mod;
     da_init(&fn->blocks, 1);
     da_init(&fn->stack, 1);
 
-    mod->functions = mars_realloc(mod->functions, sizeof(*mod->functions) * (mod->functions_len + 1));
+    if (mod->functions_len == mod->functions_cap) {
+        mod->functions_cap = mod->functions_cap ? mod->functions_cap * 2 : 8;
+        mod->functions = fe_realloc(mod->functions, sizeof(*mod->functions) * mod->functions_cap);
+    }
     mod->functions[mod->functions_len++] = fn;
     return fn;
 }
@@ -46,7 +50,7 @@ static char* cstrprintf(char* fmt, ...) {
     memset(buf, 0, sizeof(buf));
 
     vsprintf(buf, fmt, varargs);
-    char* out = malloc(strlen(buf) + 1);
+    char* out = fe_malloc(strlen(buf) + 1);
     strcpy(out, buf);
     return out;
 }
@@ -66,7 +70,7 @@ FeFunctionItem* fe_add_func_param(FeFunction* f, FeType t) {
         fe_init_func_params(f, 4);
     }
     if (f->params.len == f->params.cap) {
-        f->params.at = mars_realloc(f->params.at, f->params.cap * 2);
+        f->params.at = fe_realloc(f->params.at, sizeof(f->params.at[0]) * f->params.cap * 2);
         f->params.cap *= 2;
     }
     FeFunctionItem* p = fe_malloc(sizeof(*p));
@@ -76,10 +80,10 @@ FeFunctionItem* fe_add_func_param(FeFunction* f, FeType t) {
 }
 FeFunctionItem* fe_add_func_return(FeFunction* f, FeType t) {
     if (f->returns.at == NULL) {
-        fe_init_func_params(f, 4);
+        fe_init_func_returns(f, 4);
     }
     if (f->returns.len == f->returns.cap) {
-        f->returns.at = mars_realloc(f->returns.at, f->returns.cap * 2);
+        f->returns.at = fe_realloc(f->returns.at, sizeof(f->returns.at[0]) * f->returns.cap * 2);
         f->returns.cap *= 2;
     }
     FeFunctionItem* r = fe_malloc(sizeof(*r));
@@ -89,12 +93,16 @@ FeFunctionItem* fe_add_func_return(FeFunction* f, FeType t) {
 }
 
 FeData* fe_new_data(FeModule* mod, FeSymbol* sym, bool read_only) {
+    fe_charge_module(mod);
     FeData* data = fe_malloc(sizeof(FeData));
 
     data->sym = sym;
     data->read_only = read_only;
 
-    mod->datas = mars_realloc(mod->datas, sizeof(*mod->datas) * (mod->datas_len + 1));
+    if (mod->datas_len == mod->datas_cap) {
+        mod->datas_cap = mod->datas_cap ? mod->datas_cap * 2 : 8;
+        mod->datas = fe_realloc(mod->datas, sizeof(*mod->datas) * mod->datas_cap);
+    }
     mod->datas[mod->datas_len++] = data;
     return data;
 }
@@ -118,13 +126,49 @@ void fe_set_data_numeric(FeData* data, u64 content, u8 kind) {
     data->kind = kind;
 }
 
+u64 FNV_1a(string key); // defined in common/strmap.c
+
+// the slot name is in, or the empty slot it would go in
+static u32 symbol_slot(FeModule* mod, string name) {
+    u32 mask = mod->symtab.index_cap - 1;
+    u32 i = FNV_1a(name) & mask;
+    while (mod->symtab.index[i] != NULL && !string_eq(mod->symtab.index[i]->name, name)) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static void index_symbol(FeModule* mod, FeSymbol* sym) {
+    if (is_null_str(sym->name)) return;
+
+    // keep it at most half full
+    if ((mod->symtab.index_len + 1) * 2 > mod->symtab.index_cap) {
+        FeSymbol** old = mod->symtab.index;
+        u32 old_cap = mod->symtab.index_cap;
+        mod->symtab.index_cap = old_cap ? old_cap * 2 : 64;
+        mod->symtab.index = fe_malloc(sizeof(FeSymbol*) * mod->symtab.index_cap);
+        memset(mod->symtab.index, 0, sizeof(FeSymbol*) * mod->symtab.index_cap);
+        for_urange(i, 0, old_cap) {
+            if (old[i] != NULL) mod->symtab.index[symbol_slot(mod, old[i]->name)] = old[i];
+        }
+        fe_free(old);
+    }
+
+    u32 slot = symbol_slot(mod, sym->name);
+    if (mod->symtab.index[slot] != NULL) return; // a symbol by that name already exists
+    mod->symtab.index[slot] = sym;
+    mod->symtab.index_len++;
+}
+
 // WARNING: does NOT check if a symbol already exists
 FeSymbol* fe_new_symbol(FeModule* mod, string name, u8 binding) {
+    fe_charge_module(mod);
     FeSymbol* sym = fe_malloc(sizeof(FeSymbol));
     sym->name = name;
     sym->binding = binding;
 
     da_append(&mod->symtab, sym);
+    index_symbol(mod, sym);
     return sym;
 }
 
@@ -133,14 +177,11 @@ FeSymbol* fe_find_or_new_symbol(FeModule* mod, string name, u8 binding) {
     return sym ? sym : fe_new_symbol(mod, name, binding);
 }
 
-// returns NULL if the symbol cannot be found
+// returns NULL if the symbol cannot be found.
+// with more than one symbol by that name, it's the first one made
 FeSymbol* fe_find_symbol(FeModule* mod, string name) {
-    for_urange(i, 0, mod->symtab.len) {
-        if (string_eq(mod->symtab.at[i]->name, name)) {
-            return mod->symtab.at[i];
-        }
-    }
-    return NULL;
+    if (mod->symtab.index_cap == 0 || is_null_str(name)) return NULL;
+    return mod->symtab.index[symbol_slot(mod, name)];
 }
 
 FeBasicBlock* fe_new_basic_block(FeFunction* fn, string name) {
@@ -156,16 +197,28 @@ FeBasicBlock* fe_new_basic_block(FeFunction* fn, string name) {
     bb->start = (FeIr*)bk;
     bb->end = (FeIr*)bk;
 
+    bb->index = fn->blocks.len;
     da_append(&fn->blocks, bb);
     return bb;
 }
 
-u32 fe_bb_index(FeFunction* fn, FeBasicBlock* bb) {
-    for_urange(i, 0, fn->blocks.len) {
-        if (fn->blocks.at[i] != bb) continue;
-        return i;
+// takes bb out of its function, the blocks after it move up one
+void fe_remove_basic_block(FeBasicBlock* bb) {
+    FeFunction* fn = bb->function;
+    u32 index = fe_bb_index(fn, bb);
+    if (index == UINT32_MAX) CRASH("basic block is not in its function");
+
+    da_remove_at(&fn->blocks, index);
+    for_urange(i, index, fn->blocks.len) {
+        fn->blocks.at[i]->index = i;
     }
-    return UINT32_MAX;
+    bb->index = UINT32_MAX;
+    fn->cfg_up_to_date = false;
+}
+
+u32 fe_bb_index(FeFunction* fn, FeBasicBlock* bb) {
+    if (bb->function != fn || bb->index >= fn->blocks.len || fn->blocks.at[bb->index] != bb) return UINT32_MAX;
+    return bb->index;
 }
 
 FeIr* fe_append_ir(FeBasicBlock* bb, FeIr* inst) {
@@ -244,6 +297,14 @@ const size_t fe_inst_sizes[] = {
     [FE_IR_UMUL] = sizeof(FeIrBinop),
     [FE_IR_IDIV] = sizeof(FeIrBinop),
     [FE_IR_UDIV] = sizeof(FeIrBinop),
+    [FE_IR_IMOD] = sizeof(FeIrBinop),
+    [FE_IR_UMOD] = sizeof(FeIrBinop),
+
+    [FE_IR_FADD] = sizeof(FeIrBinop),
+    [FE_IR_FSUB] = sizeof(FeIrBinop),
+    [FE_IR_FMUL] = sizeof(FeIrBinop),
+    [FE_IR_FDIV] = sizeof(FeIrBinop),
+    [FE_IR_FMOD] = sizeof(FeIrBinop),
 
     [FE_IR_AND] = sizeof(FeIrBinop),
     [FE_IR_OR] = sizeof(FeIrBinop),
@@ -294,6 +355,9 @@ const size_t fe_inst_sizes[] = {
     [FE_IR_PARAM] = sizeof(FeIrParam),
 
     [FE_IR_RETURN] = sizeof(FeIrReturn),
+    [FE_IR_CALL] = sizeof(FeIrCall),
+    [FE_IR_PTR_CALL] = sizeof(FeIrPtrCall),
+    [FE_IR_RETRIEVE] = sizeof(FeIrRetrieve),
 };
 
 FeIr* fe_ir_binop(FeFunction* f, u16 type, FeIr* lhs, FeIr* rhs) {
@@ -339,15 +403,30 @@ FeIr* fe_ir_stackaddr(FeFunction* f, FeStackObject* obj) {
     return (FeIr*)ir;
 }
 
-FeIr* fe_ir_field_ptr(FeFunction* f, u32 index, FeIr* source) {
+FeIr* fe_ir_field_ptr(FeFunction* f, FeType record, u32 index, FeIr* source) {
     FeIrFieldPtr* ir = (FeIrFieldPtr*)fe_ir(f, FE_IR_FIELD_PTR);
+    FeAggregateType* agg = fe_type_get_structure(f->mod, record);
+    if (agg == NULL || agg->kind != FE_TYPE_RECORD) {
+        FE_FATAL(f->mod, "field_ptr must point to a record");
+    }
+    ir->base.type = FE_TYPE_PTR;
+    ir->record = record;
     ir->index = index;
     ir->source = source;
     return (FeIr*)ir;
 }
 
-FeIr* fe_ir_index_ptr(FeFunction* f, FeIr* index, FeIr* source) {
+FeIr* fe_ir_index_ptr(FeFunction* f, FeType array, FeIr* index, FeIr* source) {
     FeIrIndexPtr* ir = (FeIrIndexPtr*)fe_ir(f, FE_IR_INDEX_PTR);
+    FeAggregateType* agg = fe_type_get_structure(f->mod, array);
+    if (agg == NULL || agg->kind != FE_TYPE_ARRAY) {
+        FE_FATAL(f->mod, "index_ptr must point to an array");
+    }
+    if (!fe_type_is_integer(index->type)) {
+        FE_FATAL(f->mod, "index_ptr index must be an integer");
+    }
+    ir->base.type = FE_TYPE_PTR;
+    ir->array = array;
     ir->index = index;
     ir->source = source;
     return (FeIr*)ir;
@@ -406,6 +485,7 @@ FeIr* fe_ir_const(FeFunction* f, FeType type) {
 
 FeIr* fe_ir_load_symbol(FeFunction* f, FeType type, FeSymbol* symbol) {
     FeIrLoadSymbol* ir = (FeIrLoadSymbol*)fe_ir(f, FE_IR_LOAD_SYMBOL);
+    ir->base.type = type;
     ir->sym = symbol;
     if (!fe_type_is_scalar(type)) {
         FE_FATAL(f->mod, "cannot load symbol into non-scalar type");
@@ -495,7 +575,7 @@ FeIr* fe_ir_call(FeFunction* f, FeFunction* callee) {
 }
 
 FeIr* fe_ir_ptr_call(FeFunction* f, FeIr* callee_ptr, u16 callconv, usize paramlen) {
-    FeIrPtrCall* call = (FeIrPtrCall*)fe_ir(f, FE_IR_CALL);
+    FeIrPtrCall* call = (FeIrPtrCall*)fe_ir(f, FE_IR_PTR_CALL);
     call->source = callee_ptr;
     call->cap = paramlen;
     call->callconv = callconv;
@@ -552,6 +632,21 @@ bool fe_is_ir_terminator(FeIr* inst) {
 
 // remove inst from its basic block
 FeIr* fe_remove_ir(FeIr* inst) {
+    // retarget the bookends if inst is the first or last instruction.
+    if (inst->prev->kind == FE_IR_BOOKEND && inst->next->kind == FE_IR_BOOKEND) {
+        // inst is the only instruction, the block goes back to just the bookend
+        FeIrBookend* bookend = (FeIrBookend*)inst->prev;
+        bookend->bb->start = (FeIr*)bookend;
+        bookend->bb->end = (FeIr*)bookend;
+        bookend->bb->function->cfg_up_to_date = false;
+    } else if (inst->prev->kind == FE_IR_BOOKEND) {
+        FeIrBookend* bookend = (FeIrBookend*)inst->prev;
+        bookend->bb->start = inst->next;
+    } else if (inst->next->kind == FE_IR_BOOKEND) {
+        FeIrBookend* bookend = (FeIrBookend*)inst->next;
+        bookend->bb->end = inst->prev;
+        bookend->bb->function->cfg_up_to_date = false;
+    }
     inst->prev->next = inst->next;
     inst->next->prev = inst->prev;
     return inst;
@@ -586,6 +681,13 @@ void fe_rewrite_uses_in_inst(FeIr* inst, FeIr* source, FeIr* dest) {
     case FE_IR_UMUL:
     case FE_IR_IDIV:
     case FE_IR_UDIV:
+    case FE_IR_IMOD:
+    case FE_IR_UMOD:
+    case FE_IR_FADD:
+    case FE_IR_FSUB:
+    case FE_IR_FMUL:
+    case FE_IR_FDIV:
+    case FE_IR_FMOD:
     case FE_IR_AND:
     case FE_IR_OR:
     case FE_IR_XOR:
@@ -607,6 +709,45 @@ void fe_rewrite_uses_in_inst(FeIr* inst, FeIr* source, FeIr* dest) {
         rewrite_if_eq(binop->rhs, source, dest);
         break;
     }
+    case FE_IR_NOT:
+    case FE_IR_NEG:
+    case FE_IR_BITCAST:
+    case FE_IR_TRUNC:
+    case FE_IR_SIGNEXT:
+    case FE_IR_ZEROEXT: {
+        FeIrUnop* unop = (FeIrUnop*)inst;
+        rewrite_if_eq(unop->source, source, dest);
+        break;
+    }
+    case FE_IR_MOV: {
+        FeIrMov* mov = (FeIrMov*)inst;
+        rewrite_if_eq(mov->source, source, dest);
+        break;
+    }
+    case FE_IR_FIELD_PTR: {
+        FeIrFieldPtr* field_ptr = (FeIrFieldPtr*)inst;
+        rewrite_if_eq(field_ptr->source, source, dest);
+        break;
+    }
+    case FE_IR_INDEX_PTR: {
+        FeIrIndexPtr* index_ptr = (FeIrIndexPtr*)inst;
+        rewrite_if_eq(index_ptr->source, source, dest);
+        rewrite_if_eq(index_ptr->index, source, dest);
+        break;
+    }
+    case FE_IR_LOAD:
+    case FE_IR_VOL_LOAD: {
+        FeIrLoad* load = (FeIrLoad*)inst;
+        rewrite_if_eq(load->location, source, dest);
+        break;
+    }
+    case FE_IR_STORE:
+    case FE_IR_VOL_STORE: {
+        FeIrStore* store = (FeIrStore*)inst;
+        rewrite_if_eq(store->location, source, dest);
+        rewrite_if_eq(store->value, source, dest);
+        break;
+    }
     case FE_IR_STACK_STORE: {
         FeIrStackStore* stack_store = (FeIrStackStore*)inst;
         rewrite_if_eq(stack_store->value, source, dest);
@@ -631,10 +772,27 @@ void fe_rewrite_uses_in_inst(FeIr* inst, FeIr* source, FeIr* dest) {
         }
         break;
     }
+    case FE_IR_PTR_CALL: {
+        FeIrPtrCall* ptrcall = (FeIrPtrCall*)inst;
+        rewrite_if_eq(ptrcall->source, source, dest);
+    } // fallthrough
+    case FE_IR_CALL: {
+        FeIrCall* call = (FeIrCall*)inst;
+        for_range(i, 0, call->len) {
+            rewrite_if_eq(call->params[i], source, dest);
+        }
+        break;
+    }
+    case FE_IR_RETRIEVE: {
+        FeIrRetrieve* retrieve = (FeIrRetrieve*)inst;
+        rewrite_if_eq(retrieve->call, source, dest);
+        break;
+    }
     case FE_IR_PARAM:
     case FE_IR_STACK_ADDR:
     case FE_IR_STACK_LOAD:
     case FE_IR_CONST:
+    case FE_IR_LOAD_SYMBOL:
     case FE_IR_JUMP:
         break; // no inputs
     default:
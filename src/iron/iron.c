@@ -3,8 +3,11 @@
 
 void fe_typegraph_init(FeModule* m);
 FeModule* fe_new_module(string name) {
+    // the module itself isn't charged to anyone, it has to exist first
+    fe_charge_module(NULL);
     FeModule* mod = fe_malloc(sizeof(*mod));
     *mod = (FeModule){0};
+    fe_charge_module(mod);
 
     mod->name = name;
 
@@ -22,6 +25,7 @@ void fe_destroy_module(FeModule* m) {
     // destroy symbol table.
     arena_delete(&m->symtab.alloca);
     da_destroy(&m->symtab);
+    fe_free(m->symtab.index);
 
     // destroy typegraph
     arena_delete(&m->typegraph.alloca);
@@ -53,24 +57,75 @@ void fe_destroy_basic_block(FeBasicBlock* bb) {
     *bb = (FeBasicBlock){0};
 }
 
+static void* default_malloc(void* ctx, size_t size) {
+    return malloc(size);
+}
+
+static void* default_realloc(void* ctx, void* ptr, size_t size) {
+    return realloc(ptr, size);
+}
+
+static void default_free(void* ctx, void* ptr) {
+    free(ptr);
+}
+
 static FeAllocator fe_global_allocator = {
-    .malloc = malloc,
-    .realloc = realloc,
-    .free = free,
+    .malloc = default_malloc,
+    .realloc = default_realloc,
+    .free = default_free,
 };
 
 void fe_set_allocator(FeAllocator alloc) {
     fe_global_allocator = alloc;
 }
 
+// sits in front of every allocation, so it can be taken back off
+// the right module when it's freed. 16 bytes keeps the alignment
+typedef struct FeAllocHeader {
+    size_t size;
+    FeModule* owner;
+} FeAllocHeader;
+
+static _Thread_local FeModule* charged_module;
+
+void fe_charge_module(FeModule* m) {
+    charged_module = m;
+}
+
+static void charge(FeModule* m, size_t freed, size_t allocated) {
+    if (m == NULL) return;
+    m->memory.live = m->memory.live - freed + allocated;
+    if (m->memory.live > m->memory.peak) m->memory.peak = m->memory.live;
+}
+
 void* fe_malloc(size_t size) {
-    return memset(fe_global_allocator.malloc(size), 0, size);
+    FeAllocHeader* header = fe_global_allocator.malloc(fe_global_allocator.ctx, sizeof(FeAllocHeader) + size);
+    if (header == NULL) CRASH("out of memory");
+    header->size = size;
+    header->owner = charged_module;
+    charge(header->owner, 0, size);
+    return memset(header + 1, 0, size);
 }
 
 void* fe_realloc(void* ptr, size_t size) {
-    return fe_global_allocator.realloc(ptr, size);
+    if (ptr == NULL) return fe_malloc(size);
+    FeAllocHeader* header = (FeAllocHeader*)ptr - 1;
+    size_t old_size = header->size;
+    header = fe_global_allocator.realloc(fe_global_allocator.ctx, header, sizeof(FeAllocHeader) + size);
+    if (header == NULL) CRASH("out of memory");
+    header->size = size;
+    charge(header->owner, old_size, size);
+    return header + 1;
 }
 
 void fe_free(void* ptr) {
-    fe_global_allocator.free(ptr);
-}
\ No newline at end of file
+    if (ptr == NULL) return;
+    FeAllocHeader* header = (FeAllocHeader*)ptr - 1;
+    charge(header->owner, header->size, 0);
+    fe_global_allocator.free(fe_global_allocator.ctx, header);
+}
+
+// arena blocks are charged like anything else
+Arena fe_arena_make(size_t block_size) {
+    return arena_make_using(block_size, fe_malloc, fe_free);
+}
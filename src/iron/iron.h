@@ -1,6 +1,13 @@
 #pragma once
 
 #define DONT_USE_MARS_ALLOC
+// iron's dynamic arrays go through the iron allocator too. this only
+// takes if orbit wasn't already included, like in all of iron's own files
+#ifndef ORBIT_H
+#    define da_malloc fe_malloc
+#    define da_realloc fe_realloc
+#    define da_free fe_free
+#endif
 #include "common/orbit.h"
 #include "common/alloc.h"
 #include "common/arena.h"
@@ -48,6 +55,14 @@ void fe_sched_module_pass_at(FeModule* m, FePass* p, u64 index);
 void fe_run_next_pass(FeModule* m);
 void fe_run_all_passes(FeModule* m, bool printout);
 
+// run iron's own tests, crashing on the first failure.
+void fe_selftest();
+
+// per-thread scratch memory for passes and codegen. everything allocated
+// from it is released when the pass that asked for it returns, so nothing
+// in it needs to be freed. it isn't zeroed.
+Arena* fe_scratch();
+
 enum {
     FE_TYPE_VOID,
 
@@ -99,6 +114,11 @@ bool fe_type_is_float(FeType t);
 // returns null for non-aggregate types
 FeAggregateType* fe_type_get_structure(FeModule* m, FeType t);
 
+// natural (C-like) layout of types
+u64 fe_type_size(FeModule* m, FeType t);
+u64 fe_type_align(FeModule* m, FeType t);
+u64 fe_type_field_offset(FeModule* m, FeType record, u32 index);
+
 enum {
     FE_BIND_EXPORT,
     FE_BIND_EXPORT_WEAK,
@@ -230,6 +250,8 @@ typedef struct FeBasicBlock {
 
     FeCFGNode* cfg_node;
 
+    u32 index; // in function->blocks, see fe_bb_index
+
     u64 flags; // for misc use
 } FeBasicBlock;
 
@@ -404,6 +426,7 @@ typedef struct FeIrFieldPtr {
     FeIr base;
 
     FeIr* source;
+    FeType record; // type being pointed to
     u32 index;
 } FeIrFieldPtr;
 
@@ -428,6 +451,7 @@ typedef struct FeIrIndexPtr {
 
     FeIr* source;
     FeIr* index;
+    FeType array; // type being pointed to
 } FeIrIndexPtr;
 
 typedef struct FeIrSetIndex {
@@ -642,6 +666,7 @@ FeSymbol* fe_find_or_new_symbol(FeModule* mod, string name, u8 binding);
 void fe_destroy_module(FeModule* m);
 void fe_destroy_function(FeFunction* f);
 void fe_destroy_basic_block(FeBasicBlock* bb);
+void fe_remove_basic_block(FeBasicBlock* bb);
 
 FeStackObject* fe_new_stackobject(FeFunction* f, FeType t);
 void fe_init_func_params(FeFunction* f, u16 count);
@@ -666,8 +691,8 @@ FeIr* fe_ir(FeFunction* f, u16 type);
 FeIr* fe_ir_binop(FeFunction* f, u16 type, FeIr* lhs, FeIr* rhs);
 FeIr* fe_ir_unop(FeFunction* f, u16 type, FeIr* source);
 FeIr* fe_ir_stackaddr(FeFunction* f, FeStackObject* obj);
-FeIr* fe_ir_field_ptr(FeFunction* f, u32 index, FeIr* source);
-FeIr* fe_ir_index_ptr(FeFunction* f, FeIr* index, FeIr* source);
+FeIr* fe_ir_field_ptr(FeFunction* f, FeType record, u32 index, FeIr* source);
+FeIr* fe_ir_index_ptr(FeFunction* f, FeType array, FeIr* index, FeIr* source);
 FeIr* fe_ir_load(FeFunction* f, FeIr* ptr, FeType as, bool is_vol);
 FeIr* fe_ir_store(FeFunction* f, FeIr* ptr, FeIr* value, bool is_vol);
 FeIr* fe_ir_stack_load(FeFunction* f, FeStackObject* location);
@@ -742,10 +767,12 @@ enum {
 typedef struct FeMachBuffer FeMachBuffer;
 typedef struct FeDataBuffer FeDataBuffer;
 typedef struct FeMachInstTemplate FeMachInstTemplate;
+typedef struct FeMachInst FeMachInst;
 
 typedef struct FeArchRegclass {
     u8 id;
-    u8 len; // number of registers in this class
+    u8 len;        // number of registers in this class
+    u8 spill_size; // bytes of stack a spilled register takes up
 } FeArchRegclass;
 
 typedef struct FeArchInfo {
@@ -756,9 +783,15 @@ typedef struct FeArchInfo {
 
     FeMachBuffer (*cg)(FeModule*);
     void (*emit_text)(FeDataBuffer*, FeMachBuffer*);
+    void (*emit_bin)(FeDataBuffer*, FeMachBuffer*); // raw machine code, symbol references go in mb->relocs
     void (*emit_obj)(FeDataBuffer*, FeMachBuffer*);
     void (*emit_exe)(FeDataBuffer*, FeMachBuffer*);
 
+    // used by regalloc to move a vreg to and from its stack slot.
+    // these return a new instruction without appending it.
+    FeMachInst* (*spill)(FeMachBuffer*, u32 vreg, u32 slot);
+    FeMachInst* (*reload)(FeMachBuffer*, u32 vreg, u32 slot);
+
     struct {
         const FeMachInstTemplate* at;
         u32 len;
@@ -778,6 +811,8 @@ typedef struct FeModule {
 
     u32 functions_len;
     u32 datas_len;
+    u32 functions_cap;
+    u32 datas_cap;
 
     struct {
         FeSymbol** at;
@@ -785,6 +820,12 @@ typedef struct FeModule {
         size_t cap;
 
         Arena alloca;
+
+        // open addressing on the name, for fe_find_symbol.
+        // only the first symbol with a given name goes in
+        FeSymbol** index;
+        u32 index_cap; // always a power of two
+        u32 index_len;
     } symtab; // symbol table
 
     struct {
@@ -809,18 +850,34 @@ typedef struct FeModule {
     } target;
 
     FeReportQueue messages;
+
+    // bytes iron is holding for this module, see fe_charge_module
+    struct {
+        size_t live;
+        size_t peak;
+    } memory;
 } FeModule;
 
+// every allocation iron makes goes through here.
+// ctx is handed back on every call, and can be NULL.
 typedef struct FeAllocator {
-    void* (*malloc)(size_t);
-    void* (*realloc)(void*, size_t);
-    void (*free)(void*);
+    void* (*malloc)(void* ctx, size_t size);
+    void* (*realloc)(void* ctx, void* ptr, size_t size);
+    void (*free)(void* ctx, void* ptr);
+    void* ctx;
 } FeAllocator;
 
 void fe_set_allocator(FeAllocator alloc);
 void* fe_malloc(size_t size);
 void* fe_realloc(void* ptr, size_t size);
 void fe_free(void* ptr);
+Arena fe_arena_make(size_t block_size);
+
+// charge this thread's allocations to m from here on, NULL for nobody.
+// anything that takes an FeModule already does this, so it's only needed
+// when switching between modules through functions that don't.
+// scratch memory belongs to the thread and isn't charged to anyone.
+void fe_charge_module(FeModule* m);
 
 // like stringbuilder but epic
 typedef struct FeDataBuffer {
@@ -5,6 +5,15 @@
     passes act like a queue. when a pass is about to be run, it is taken off of the queue.
 */
 
+#define FE_SCRATCH_BLOCK_SIZE 0x10000
+
+static _Thread_local Arena scratch;
+
+Arena* fe_scratch() {
+    if (scratch.list.at == NULL) scratch = arena_make(FE_SCRATCH_BLOCK_SIZE);
+    return &scratch;
+}
+
 void fe_sched_func_pass(FeModule* m, FePass* p, FeFunction* fn) {
     FeSchedPass sp;
     sp.sched_kind = FE_SCHED_FUNCTION;
@@ -60,6 +69,8 @@ void fe_run_next_pass(FeModule* m) {
 
     printf("running pass '%s'...\n", sp.pass->name);
 
+    fe_charge_module(m);
+    ArenaMark mark = arena_mark(fe_scratch());
     switch (sp.sched_kind) {
     case FE_SCHED_FUNCTION:
         sp.pass->function(sp.bind.fn);
@@ -69,4 +80,5 @@ void fe_run_next_pass(FeModule* m) {
     default:
         break;
     }
+    arena_release(fe_scratch(), mark);
 }
\ No newline at end of file
@@ -307,8 +307,9 @@ static void compute_domfront(FeFunction* fn, FeCFGNode* N) {
 static void function_cfg(FeFunction* fn) {
     if (fn->cfg_up_to_date) return;
 
-    if (fn->cfg.list.at != NULL) arena_delete(&fn->cfg);
-    fn->cfg = arena_make(sizeof(FeCFGNode) * (fn->blocks.len) + 10000);
+    // the old cfg is thrown away whole, so keep its memory around for the new one
+    if (fn->cfg.list.at != NULL) arena_reset(&fn->cfg);
+    else fn->cfg = fe_arena_make(sizeof(FeCFGNode) * (fn->blocks.len) + 10000);
 
     init_cfg_nodes(fn);
 
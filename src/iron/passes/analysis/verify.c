@@ -6,9 +6,12 @@
                                                .severity = FE_REP_SEVERITY_FATAL, \
                                            })
 
-static FeBasicBlock* entry_block;
-
-static da(FeIrPTR) active_defs;
+// definitions on the current control path. never longer than the function,
+// so it's sized up front out of scratch memory
+static _Thread_local struct {
+    FeIr** at;
+    usize len;
+} active_defs;
 
 // checks that all uses of inst are defined and 
 // non-self-referencial (with the exception of phis)
@@ -22,7 +25,7 @@ static bool is_defined(FeIr* inst) {
 
 #define fatal_if_not_def(inst) if (!is_defined(inst)) FE_FATAL(m, "argument not defined yet in this control path")
 static void check_defined(FeModule* m, FeIr* inst) {
-    if (inst->kind == FE_IR_PHI) da_append(&active_defs, inst);
+    if (inst->kind == FE_IR_PHI) active_defs.at[active_defs.len++] = inst;
 
     switch (inst->kind) {
     case FE_IR_ADD:
@@ -76,6 +79,26 @@ static void check_defined(FeModule* m, FeIr* inst) {
         }
         break;
     }
+    case FE_IR_PTR_CALL: {
+        FeIrPtrCall* call = (FeIrPtrCall*)inst;
+        fatal_if_not_def(call->source);
+        for_range(i, 0, call->len) {
+            fatal_if_not_def(call->params[i]);
+        }
+        break;
+    }
+    case FE_IR_CALL: {
+        FeIrCall* call = (FeIrCall*)inst;
+        for_range(i, 0, call->len) {
+            fatal_if_not_def(call->params[i]);
+        }
+        break;
+    }
+    case FE_IR_RETRIEVE: {
+        FeIrRetrieve* retrieve = (FeIrRetrieve*)inst;
+        fatal_if_not_def(retrieve->call);
+        break;
+    }
     case FE_IR_PARAM:
     case FE_IR_STACK_ADDR:
     case FE_IR_STACK_LOAD:
@@ -87,12 +110,10 @@ static void check_defined(FeModule* m, FeIr* inst) {
         CRASH("unhandled in check_defined");
         break;
     }
-    if (inst->kind != FE_IR_PHI) da_append(&active_defs, inst);
+    if (inst->kind != FE_IR_PHI) active_defs.at[active_defs.len++] = inst;
 }
 
 static void verify_basic_block(FeModule* m, FeFunction* fn, FeBasicBlock* bb, bool entry) {
-    if (entry) entry_block = bb;
-
     // active def save point for rewinding
     usize savepoint = active_defs.len;
 
@@ -138,21 +159,28 @@ static void verify_basic_block(FeModule* m, FeFunction* fn, FeBasicBlock* bb, bo
     active_defs.len = savepoint;
 }
 
-static void reset_flags(FeFunction* f) {
+// returns the number of instructions in f
+static usize reset_flags(FeFunction* f) {
+    usize count = 0;
     for_urange(i, 0, f->blocks.len) {
         for_fe_ir(inst, *f->blocks.at[i]) {
             inst->flags = 0;
+            count++;
         }
     }
+    return count;
 }
 
 static void verify_function(FeFunction* f) {
-    da_init(&active_defs, 128);
     if (f->blocks.len == 0) {
         FE_FATAL(f->mod, "functions must have at least one basic block");
     }
-    reset_flags(f);
+    ArenaMark mark = arena_mark(fe_scratch());
+    usize count = reset_flags(f);
+    active_defs.at = arena_alloc(fe_scratch(), sizeof(FeIr*) * count, alignof(FeIr*));
+    active_defs.len = 0;
     verify_basic_block(f->mod, f, f->blocks.at[0], true);
+    arena_release(fe_scratch(), mark);
 }
 
 static void verify_module(FeModule* m) {
@@ -13,11 +13,13 @@ static void function_moviphi(FeFunction* fn) {
 
         FeIrPhi* phi = (FeIrPhi*)bb->start;
         while (phi->base.kind == FE_IR_PHI) {
-            // insert movs at the end of each sources' basic block
+            // insert movs at the end of each sources' basic block.
+            // every phi gets its own movs, even if the source already is one,
+            // since codegen writes them to a register that belongs to the phi.
             for_range(i, 0, phi->len) {
                 FeBasicBlock* source_bb = phi->source_BBs[i];
                 FeIr* source = phi->sources[i];
-                if (source->kind != FE_IR_MOV) phi->sources[i] = fe_insert_ir_before(fe_ir_mov(fn, source), source_bb->end);
+                phi->sources[i] = fe_insert_ir_before(fe_ir_mov(fn, source), source_bb->end);
             }
             phi = (FeIrPhi*)phi->base.next;
         }
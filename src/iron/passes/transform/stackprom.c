@@ -1,11 +1,11 @@
 #include "iron/iron.h"
-#include "common/ptrmap.h"
 
 /* pass "stackprom" - promote stack objects to registers
 
-*/
+    objects are promoted one at a time. while an object is being promoted,
+    the cfg node of every block that got a phi for it holds that phi in its flags.
 
-PtrMap phi2obj = {0};
+*/
 
 static bool candidate_for_stackprom(FeStackObject* obj, FeFunction* f) {
 
@@ -54,13 +54,15 @@ static void mark_and_place_phis(FeFunction* f, FeStackObject* obj) {
                 FeIr* phi = fe_ir_phi(f, domfront_node->in_len, obj->t);
                 fe_insert_ir_before(phi, domfront_block->start);
                 domfront_block->flags = (u64)obj;
-                ptrmap_put(&phi2obj, phi, obj);
+                domfront_node->flags = (u64)phi;
             }
         }
     }
 }
 
-struct {
+// the definition stack can't get deeper than one entry per block,
+// so it's sized up front out of scratch memory
+static _Thread_local struct {
     FeStackObject* obj;
 
     struct {
@@ -68,7 +70,6 @@ struct {
         FeBasicBlock* block;
     }* at;
     u32 len;
-    u32 cap;
 } def_stack;
 
 static FeIr* def_current_inst() {
@@ -88,11 +89,6 @@ static void def_set_current_block(FeBasicBlock* block) {
 }
 
 static void def_push(FeBasicBlock* block, FeIr* inst) {
-    if (def_stack.len == def_stack.cap) {
-        def_stack.cap *= 2;
-        def_stack.at = fe_realloc(def_stack.at, def_stack.cap);
-    }
-
     def_stack.at[def_stack.len].block = block;
     def_stack.at[def_stack.len].inst = inst;
     def_stack.len++;
@@ -112,15 +108,12 @@ static void def_pop() {
 static void rename_defs(FeBasicBlock* block) {
 
     // find phi and add sources
-    for (FeIrPhi* phi = (FeIrPhi*)block->start; phi->base.kind == FE_IR_PHI; phi = (FeIrPhi*)phi->base.next) {
-        if (ptrmap_get(&phi2obj, phi) != def_stack.obj) {
-            continue;
-        }
+    FeIrPhi* phi = (FeIrPhi*)block->cfg_node->flags;
+    if (phi != NULL) {
         // get the current values
         fe_add_phi_source(block->function, phi, def_current_inst(), def_current_block());
         def_set_current_block(block);
         def_set_current_inst((FeIr*)phi);
-        break;
     }
 
     if (block->flags == DFS_VISITED) {
@@ -175,13 +168,11 @@ static void function_stackprom(FeFunction* f) {
 
     fe_pass_cfg.function(f);
 
-    if (def_stack.at == NULL) {
-        def_stack.cap = 16;
-        def_stack.at = fe_malloc(sizeof(def_stack.at[0]) * def_stack.cap);
-    }
+    ArenaMark mark = arena_mark(fe_scratch());
+    def_stack.at = arena_alloc(fe_scratch(), sizeof(def_stack.at[0]) * (f->blocks.len + 1), alignof(def_stack.at[0]));
 
-    if (phi2obj.keys == NULL) {
-        ptrmap_init(&phi2obj, f->blocks.len);
+    foreach (FeBasicBlock* bb, f->blocks) {
+        bb->cfg_node->flags = 0;
     }
 
     // foreach(FeStackObject* obj, f->stack) {
@@ -190,8 +181,6 @@ static void function_stackprom(FeFunction* f) {
         bool can_stackprom = candidate_for_stackprom(obj, f);
         if (!can_stackprom) continue;
 
-        ptrmap_reset(&phi2obj);
-
         mark_and_place_phis(f, obj);
 
         def_stack.len = 0;
@@ -202,11 +191,13 @@ static void function_stackprom(FeFunction* f) {
 
         foreach (FeBasicBlock* bb, f->blocks) {
             bb->flags = 0;
+            bb->cfg_node->flags = 0;
         }
 
         da_remove_at(&f->stack, obji);
         obji--;
     }
+    arena_release(fe_scratch(), mark);
 }
 
 static void module_stackprom(FeModule* m) {
@@ -14,7 +14,8 @@ static bool has_side_effects(FeIr* ir) {
     return !(_FE_IR_NO_SIDE_EFFECTS_BEGIN < ir->kind && ir->kind < _FE_IR_NO_SIDE_EFFECTS_END);
 }
 
-static void register_uses(FeIr* ir) {
+// call f on every instruction that ir uses as an input
+static void for_each_input(FeIr* ir, void (*f)(FeIr*)) {
     switch (ir->kind) {
     case FE_IR_ADD:
     case FE_IR_SUB:
@@ -22,6 +23,23 @@ static void register_uses(FeIr* ir) {
     case FE_IR_IMUL:
     case FE_IR_UDIV:
     case FE_IR_IDIV:
+    case FE_IR_UMOD:
+    case FE_IR_IMOD:
+    case FE_IR_FADD:
+    case FE_IR_FSUB:
+    case FE_IR_FMUL:
+    case FE_IR_FDIV:
+    case FE_IR_FMOD:
+    case FE_IR_ULT:
+    case FE_IR_UGT:
+    case FE_IR_ULE:
+    case FE_IR_UGE:
+    case FE_IR_ILT:
+    case FE_IR_IGT:
+    case FE_IR_ILE:
+    case FE_IR_IGE:
+    case FE_IR_EQ:
+    case FE_IR_NE:
     case FE_IR_ASR:
     case FE_IR_LSR:
     case FE_IR_SHL:
@@ -29,46 +47,128 @@ static void register_uses(FeIr* ir) {
     case FE_IR_OR:
     case FE_IR_AND: {
         FeIrBinop* binop = (FeIrBinop*)ir;
-        binop->lhs->flags++;
-        binop->rhs->flags++;
+        f(binop->lhs);
+        f(binop->rhs);
+        break;
+    }
+    case FE_IR_NOT:
+    case FE_IR_NEG:
+    case FE_IR_BITCAST:
+    case FE_IR_SIGNEXT:
+    case FE_IR_ZEROEXT:
+    case FE_IR_TRUNC: {
+        FeIrUnop* unop = (FeIrUnop*)ir;
+        if (unop->source) f(unop->source);
         break;
     }
-    case FE_IR_LOAD: {
+    case FE_IR_FIELD_PTR: {
+        FeIrFieldPtr* field_ptr = (FeIrFieldPtr*)ir;
+        f(field_ptr->source);
+        break;
+    }
+    case FE_IR_INDEX_PTR: {
+        FeIrIndexPtr* index_ptr = (FeIrIndexPtr*)ir;
+        f(index_ptr->source);
+        f(index_ptr->index);
+        break;
+    }
+    case FE_IR_GET_FIELD: {
+        FeIrGetField* get_field = (FeIrGetField*)ir;
+        f(get_field->record);
+        break;
+    }
+    case FE_IR_SET_FIELD: {
+        FeIrSetField* set_field = (FeIrSetField*)ir;
+        f(set_field->record);
+        f(set_field->source);
+        break;
+    }
+    case FE_IR_GET_INDEX: {
+        FeIrGetIndex* get_index = (FeIrGetIndex*)ir;
+        f(get_index->array);
+        break;
+    }
+    case FE_IR_SET_INDEX: {
+        FeIrSetIndex* set_index = (FeIrSetIndex*)ir;
+        f(set_index->record);
+        break;
+    }
+    case FE_IR_LOAD:
+    case FE_IR_VOL_LOAD: {
         FeIrLoad* load = (FeIrLoad*)ir;
-        load->location->flags++;
+        f(load->location);
         break;
     }
-    case FE_IR_STORE: {
+    case FE_IR_STORE:
+    case FE_IR_VOL_STORE: {
         FeIrStore* store = (FeIrStore*)ir;
-        store->location->flags++;
-        store->value->flags++;
+        f(store->location);
+        f(store->value);
+        break;
+    }
+    case FE_IR_STACK_STORE: {
+        FeIrStackStore* store = (FeIrStackStore*)ir;
+        f(store->value);
         break;
     }
     case FE_IR_RETURN: {
         FeIrReturn* ret = (FeIrReturn*)ir;
         for_range(i, 0, ret->len) {
-            ret->sources[i]->flags++;
+            f(ret->sources[i]);
         }
         break;
     }
     case FE_IR_MOV: {
         FeIrMov* mov = (FeIrMov*)ir;
-        if (mov->source) mov->source->flags++;
+        if (mov->source) f(mov->source);
         break;
     }
-    case FE_IR_NOT:
-    case FE_IR_NEG:
-    case FE_IR_SIGNEXT:
-    case FE_IR_ZEROEXT:
-    case FE_IR_TRUNC: {
-        FeIrUnop* unop = (FeIrUnop*)ir;
-        if (unop->source) unop->source->flags++;
+    case FE_IR_PHI: {
+        FeIrPhi* phi = (FeIrPhi*)ir;
+        for_range(i, 0, phi->len) {
+            f(phi->sources[i]);
+        }
+        break;
+    }
+    case FE_IR_BRANCH: {
+        FeIrBranch* branch = (FeIrBranch*)ir;
+        f(branch->cond);
+        break;
+    }
+    case FE_IR_CALL: {
+        FeIrCall* call = (FeIrCall*)ir;
+        for_range(i, 0, call->len) {
+            f(call->params[i]);
+        }
+        break;
+    }
+    case FE_IR_PTR_CALL: {
+        FeIrPtrCall* call = (FeIrPtrCall*)ir;
+        f(call->source);
+        for_range(i, 0, call->len) {
+            f(call->params[i]);
+        }
+        break;
+    }
+    case FE_IR_RETRIEVE: {
+        FeIrRetrieve* retrieve = (FeIrRetrieve*)ir;
+        f(retrieve->call);
+        break;
+    }
+    case FE_IR_ASM_BLOCK: {
+        FeIrAsmBlock* asm_block = (FeIrAsmBlock*)ir;
+        for_range(i, 0, asm_block->params_len) {
+            f(asm_block->params[i]);
+        }
         break;
     }
     case FE_IR_INVALID:
     case FE_IR_CONST:
     case FE_IR_PARAM:
     case FE_IR_STACK_ADDR:
+    case FE_IR_STACK_LOAD:
+    case FE_IR_LOAD_SYMBOL:
+    case FE_IR_JUMP:
         break;
     default:
         CRASH("unhandled inst type %d", ir->kind);
@@ -76,6 +176,14 @@ static void register_uses(FeIr* ir) {
     }
 }
 
+static void register_use(FeIr* ir) {
+    ir->flags++;
+}
+
+static void register_uses(FeIr* ir) {
+    for_each_input(ir, register_use);
+}
+
 static void reset_flags(FeFunction* f) {
     for_urange(i, 0, f->blocks.len) {
         for_fe_ir(inst, *f->blocks.at[i]) {
@@ -92,69 +200,22 @@ static void count_uses_func(FeFunction* f) {
     }
 }
 
+static void try_eliminate(FeIr* ir);
+
+static void release_use(FeIr* ir) {
+    ir->flags--;
+    try_eliminate(ir);
+}
+
 static void try_eliminate(FeIr* ir) {
     // recursively attempt to eliminate dead code
     if (ir == NULL || ir->flags != 0 || has_side_effects(ir)) return;
 
-    switch (ir->kind) {
-    case FE_IR_ADD:
-    case FE_IR_SUB:
-    case FE_IR_UMUL:
-    case FE_IR_IMUL:
-    case FE_IR_UDIV:
-    case FE_IR_IDIV:
-    case FE_IR_ASR:
-    case FE_IR_LSR:
-    case FE_IR_SHL:
-    case FE_IR_XOR:
-    case FE_IR_OR:
-    case FE_IR_AND: {
-        FeIrBinop* binop = (FeIrBinop*)ir;
-        binop->lhs->flags--;
-        binop->rhs->flags--;
-        try_eliminate(binop->lhs);
-        try_eliminate(binop->rhs);
-        break;
-    }
-    case FE_IR_STORE: {
-        FeIrStore* store = (FeIrStore*)ir;
-        store->location->flags--;
-        store->value->flags--;
-        try_eliminate(store->location);
-        try_eliminate(store->value);
-        break;
-    }
-    case FE_IR_RETURN: {
-        FeIrReturn* ret = (FeIrReturn*)ir;
-        for_range(i, 0, ret->len) {
-            ret->sources[i]->flags--;
-            try_eliminate(ret->sources[i]);
-        }
-        break;
-    }
-    case FE_IR_MOV: {
-        FeIrMov* mov = (FeIrMov*)ir;
-        if (mov->source) mov->source->flags--;
-        try_eliminate(mov->source);
-        break;
-    }
-    case FE_IR_NEG:
-    case FE_IR_NOT: {
-        FeIrUnop* unop = (FeIrUnop*)ir;
-        if (unop->source) unop->source->flags--;
-        try_eliminate(unop->source);
-        break;
-    }
-    case FE_IR_INVALID:
-    case FE_IR_CONST:
-    case FE_IR_PARAM:
-        break;
-    default:
-        CRASH("unhandled inst type %d", ir->kind);
-        break;
-    }
-    // ir->kind = FE_IR_ELIMINATED;
+    // phis can be their own inputs through a loop,
+    // so take this out of the block before walking them
     fe_remove_ir(ir);
+    ir->flags = UINT16_MAX;
+    for_each_input(ir, release_use);
 }
 
 static void tdce_on_function(FeFunction* f) {
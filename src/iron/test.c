@@ -1,5 +1,13 @@
 #include "iron/iron.h"
 #include "passes/passes.h"
+#include "iron/codegen/x64/x64.h"
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#    include <sys/mman.h>
+#    include <unistd.h>
+#    include <math.h>
+#    define X64_CAN_EXECUTE
+#endif
 
 void test_algsimp_reassoc() {
     printf("\n");
@@ -114,8 +122,731 @@ void test_c_gen() {
     fe_destroy_module(m);
 }
 
+void test_tdce_dead_head() {
+    printf("\n");
+
+    FeModule* m = fe_new_module(str("test"));
+
+    FeSymbol* sym = fe_new_symbol(m, str("tdce_test"), FE_BIND_LOCAL);
+    FeFunction* f = fe_new_function(m, sym, FE_CCONV_MARS);
+    fe_init_func_params(f, 1);
+    fe_add_func_param(f, FE_TYPE_I64);
+    fe_init_func_returns(f, 1);
+    fe_add_func_return(f, FE_TYPE_I64);
+
+    FeBasicBlock* bb1 = fe_new_basic_block(f, str("block1"));
+    FeBasicBlock* bb2 = fe_new_basic_block(f, str("block2"));
+
+    FeIrParam* p = (FeIrParam*)fe_append_ir(bb1, fe_ir_param(f, 0));
+    fe_append_ir(bb1, fe_ir_jump(f, bb2));
+
+    // dead phi as the first instruction of block2, tdce has to move bb2->start off of it
+    FeIrPhi* phi = (FeIrPhi*)fe_append_ir(bb2, fe_ir_phi(f, 1, FE_TYPE_I64));
+    fe_add_phi_source(f, phi, (FeIr*)p, bb1);
+
+    FeIrReturn* ret = (FeIrReturn*)fe_append_ir(bb2, fe_ir_return(f));
+    ret->sources[0] = (FeIr*)p;
+
+    // run it twice, the second run walks whatever the first one left behind
+    fe_sched_module_pass(m, &fe_pass_tdce);
+    fe_sched_module_pass(m, &fe_pass_tdce);
+    fe_run_all_passes(m, true);
+
+    if (bb2->start != (FeIr*)ret || bb2->end != (FeIr*)ret) {
+        CRASH("tdce left a stale start/end on block2");
+    }
+
+    string s = fe_emit_ir(m);
+    printf(str_fmt, str_arg(s));
+
+    fe_destroy_module(m);
+}
+
+
+// x64 backend tests. the text tests compare the final assembly against what
+// it's supposed to look like, the execution tests load the machine code and
+// call it.
+
+static FeX64Config x64_config;
+
+static FeFunction* x64_function(FeModule* m, char* name, u8 cconv, FeType* params, u16 params_len, FeType* returns, u16 returns_len) {
+    FeSymbol* sym = fe_new_symbol(m, str(name), FE_BIND_EXPORT);
+    FeFunction* f = fe_new_function(m, sym, cconv);
+    fe_init_func_params(f, params_len);
+    for_range(i, 0, params_len) fe_add_func_param(f, params[i]);
+    fe_init_func_returns(f, returns_len);
+    for_range(i, 0, returns_len) fe_add_func_return(f, returns[i]);
+    return f;
+}
+
+static FeIr* x64_const(FeBasicBlock* bb, FeType t, i64 value) {
+    FeIrConst* c = (FeIrConst*)fe_append_ir(bb, fe_ir_const(bb->function, t));
+    c->i64 = value;
+    return (FeIr*)c;
+}
+
+static FeIr* x64_fconst(FeBasicBlock* bb, FeType t, f64 value) {
+    FeIrConst* c = (FeIrConst*)fe_append_ir(bb, fe_ir_const(bb->function, t));
+    if (t == FE_TYPE_F32) c->f32 = (f32)value;
+    else c->f64 = value;
+    return (FeIr*)c;
+}
+
+static FeIr* x64_binop(FeBasicBlock* bb, u16 kind, FeIr* lhs, FeIr* rhs) {
+    return fe_append_ir(bb, fe_ir_binop(bb->function, kind, lhs, rhs));
+}
+
+static FeIr* x64_unop(FeBasicBlock* bb, u16 kind, FeIr* source, FeType t) {
+    FeIr* ir = fe_append_ir(bb, fe_ir_unop(bb->function, kind, source));
+    ir->type = t;
+    return ir;
+}
+
+static void x64_return(FeBasicBlock* bb, FeIr* value) {
+    FeIrReturn* ret = (FeIrReturn*)fe_append_ir(bb, fe_ir_return(bb->function));
+    ret->sources[0] = value;
+}
+
+static FeMachBuffer x64_codegen(FeModule* m) {
+    m->target.arch = &fe_arch_x64;
+    m->target.arch_config = &x64_config;
+    m->target.system = FE_SYSTEM_LINUX;
+    return fe_mach_codegen(m);
+}
+
+static void expect_x64_text(FeModule* m, char* expected) {
+    FeMachBuffer mb = x64_codegen(m);
+    FeDataBuffer db = fe_db_new(256);
+    fe_mach_emit_text(&db, &mb);
+    char* text = fe_db_clone_to_cstring(&db);
+    if (strcmp(text, expected) != 0) {
+        printf("expected:\n%s\ngot:\n%s\n", expected, text);
+        CRASH("x64 text for module '" str_fmt "' changed", str_arg(m->name));
+    }
+    fe_destroy_module(m);
+}
+
+// add, sub, and, or, xor, with registers and immediates
+void test_x64_text_alu() {
+    FeModule* m = fe_new_module(str("alu"));
+    FeFunction* f = x64_function(m, "alu", FE_CCONV_SYSV, (FeType[]){FE_TYPE_I64, FE_TYPE_I64}, 2, (FeType[]){FE_TYPE_I64}, 1);
+    FeBasicBlock* bb = fe_new_basic_block(f, str("entry"));
+    FeIr* a = fe_append_ir(bb, fe_ir_param(f, 0));
+    FeIr* b = fe_append_ir(bb, fe_ir_param(f, 1));
+    FeIr* sum = x64_binop(bb, FE_IR_SUB, x64_binop(bb, FE_IR_ADD, a, b), x64_const(bb, FE_TYPE_I64, 7));
+    FeIr* mask = x64_binop(bb, FE_IR_OR, a, x64_const(bb, FE_TYPE_I64, 255));
+    x64_return(bb, x64_binop(bb, FE_IR_XOR, x64_binop(bb, FE_IR_AND, sum, mask), b));
+    expect_x64_text(m,
+        "alu:\n"
+        ".entry:\n"
+        "   lea rax, [rdi + rsi]\n"
+        "   sub rax, 7\n"
+        "   mov rcx, rdi\n"
+        "   or rcx, 255\n"
+        "   and rax, rcx\n"
+        "   xor rax, rsi\n"
+        "   ret\n"
+    );
+}
+
+// imul, and the rax:rdx dance for division and remainder
+void test_x64_text_muldiv() {
+    FeModule* m = fe_new_module(str("muldiv"));
+    FeFunction* f = x64_function(m, "muldiv", FE_CCONV_SYSV, (FeType[]){FE_TYPE_I64, FE_TYPE_I64}, 2, (FeType[]){FE_TYPE_I64}, 1);
+    FeBasicBlock* bb = fe_new_basic_block(f, str("entry"));
+    FeIr* a = fe_append_ir(bb, fe_ir_param(f, 0));
+    FeIr* b = fe_append_ir(bb, fe_ir_param(f, 1));
+    FeIr* product = x64_binop(bb, FE_IR_IMUL, a, b);
+    FeIr* quotient = x64_binop(bb, FE_IR_IDIV, a, b);
+    FeIr* remainder = x64_binop(bb, FE_IR_UMOD, a, b);
+    x64_return(bb, x64_binop(bb, FE_IR_ADD, x64_binop(bb, FE_IR_ADD, product, quotient), remainder));
+    expect_x64_text(m,
+        "muldiv:\n"
+        ".entry:\n"
+        "   mov rcx, rdi\n"
+        "   imul rcx, rsi\n"
+        "   mov rax, rdi\n"
+        "   cqo\n"
+        "   idiv rsi\n"
+        "   mov r8, rax\n"
+        "   mov rax, rdi\n"
+        "   xor edx, edx\n"
+        "   div rsi\n"
+        "   mov rax, rdx\n"
+        "   add rcx, r8\n"
+        "   add rcx, rax\n"
+        "   mov rax, rcx\n"
+        "   ret\n"
+    );
+}
+
+// shifts by a register go through cl
+void test_x64_text_shifts() {
+    FeModule* m = fe_new_module(str("shifts"));
+    FeFunction* f = x64_function(m, "shifts", FE_CCONV_SYSV, (FeType[]){FE_TYPE_I64, FE_TYPE_I64}, 2, (FeType[]){FE_TYPE_I64}, 1);
+    FeBasicBlock* bb = fe_new_basic_block(f, str("entry"));
+    FeIr* a = fe_append_ir(bb, fe_ir_param(f, 0));
+    FeIr* b = fe_append_ir(bb, fe_ir_param(f, 1));
+    FeIr* left = x64_binop(bb, FE_IR_SHL, a, b);
+    FeIr* arith = x64_binop(bb, FE_IR_ASR, a, x64_const(bb, FE_TYPE_I64, 3));
+    FeIr* logical = x64_binop(bb, FE_IR_LSR, a, b);
+    x64_return(bb, x64_binop(bb, FE_IR_ADD, x64_binop(bb, FE_IR_ADD, left, arith), logical));
+    expect_x64_text(m,
+        "shifts:\n"
+        ".entry:\n"
+        "   mov rax, rdi\n"
+        "   mov ecx, esi\n"
+        "   shl rax, cl\n"
+        "   mov rdx, rdi\n"
+        "   sar rdx, 3\n"
+        "   mov ecx, esi\n"
+        "   shr rdi, cl\n"
+        "   add rax, rdx\n"
+        "   add rax, rdi\n"
+        "   ret\n"
+    );
+}
+
+// a compare that only feeds a branch, and one that's materialized with setcc
+void test_x64_text_compare() {
+    FeModule* m = fe_new_module(str("compare"));
+    FeFunction* f = x64_function(m, "compare", FE_CCONV_SYSV, (FeType[]){FE_TYPE_I64, FE_TYPE_I64}, 2, (FeType[]){FE_TYPE_BOOL}, 1);
+    FeBasicBlock* entry = fe_new_basic_block(f, str("entry"));
+    FeBasicBlock* less = fe_new_basic_block(f, str("less"));
+    FeBasicBlock* more = fe_new_basic_block(f, str("more"));
+    FeIr* a = fe_append_ir(entry, fe_ir_param(f, 0));
+    FeIr* b = fe_append_ir(entry, fe_ir_param(f, 1));
+    fe_append_ir(entry, fe_ir_branch(f, x64_binop(entry, FE_IR_ILT, a, b), less, more));
+    x64_return(less, x64_binop(less, FE_IR_EQ, a, x64_const(less, FE_TYPE_I64, 5)));
+    x64_return(more, x64_binop(more, FE_IR_UGE, a, b));
+    expect_x64_text(m,
+        "compare:\n"
+        ".entry:\n"
+        "   cmp rdi, rsi\n"
+        "   jge .more\n"
+        ".less:\n"
+        "   cmp rdi, 5\n"
+        "   sete al\n"
+        "   ret\n"
+        ".more:\n"
+        "   cmp rdi, rsi\n"
+        "   setae al\n"
+        "   ret\n"
+    );
+}
+
+// loads and stores through a pointer, and through a stack slot
+void test_x64_text_memory() {
+    FeModule* m = fe_new_module(str("memory"));
+    FeFunction* f = x64_function(m, "memory", FE_CCONV_SYSV, (FeType[]){FE_TYPE_PTR, FE_TYPE_I64}, 2, (FeType[]){FE_TYPE_I64}, 1);
+    FeBasicBlock* bb = fe_new_basic_block(f, str("entry"));
+    FeIr* p = fe_append_ir(bb, fe_ir_param(f, 0));
+    FeIr* x = fe_append_ir(bb, fe_ir_param(f, 1));
+    FeType array = fe_type_array(m, FE_TYPE_I32, 16);
+    FeIr* elem = fe_append_ir(bb, fe_ir_index_ptr(f, array, x, p));
+    FeIr* loaded = fe_append_ir(bb, fe_ir_load(f, elem, FE_TYPE_I32, false));
+    FeIr* second = fe_append_ir(bb, fe_ir_index_ptr(f, array, x64_const(bb, FE_TYPE_I64, 2), p));
+    fe_append_ir(bb, fe_ir_store(f, second, loaded, false));
+    FeStackObject* slot = fe_new_stackobject(f, FE_TYPE_I64);
+    fe_append_ir(bb, fe_ir_stack_store(f, slot, x));
+    fe_append_ir(bb, fe_ir_store(f, fe_append_ir(bb, fe_ir_stackaddr(f, slot)), x64_const(bb, FE_TYPE_I64, 9), true));
+    x64_return(bb, fe_append_ir(bb, fe_ir_stack_load(f, slot)));
+    expect_x64_text(m,
+        "memory:\n"
+        ".entry:\n"
+        "   mov eax, [rdi + rsi*4]\n"
+        "   mov [rdi + 8], eax\n"
+        "   mov qword [rsp - 8], 9\n"
+        "   mov rax, [rsp - 8]\n"
+        "   ret\n"
+    );
+}
+
+// integer truncation and extension
+void test_x64_text_convert() {
+    FeModule* m = fe_new_module(str("convert"));
+    FeFunction* f = x64_function(m, "convert", FE_CCONV_SYSV, (FeType[]){FE_TYPE_I64}, 1, (FeType[]){FE_TYPE_I64}, 1);
+    FeBasicBlock* bb = fe_new_basic_block(f, str("entry"));
+    FeIr* a = fe_append_ir(bb, fe_ir_param(f, 0));
+    FeIr* low = x64_unop(bb, FE_IR_SIGNEXT, x64_unop(bb, FE_IR_TRUNC, a, FE_TYPE_I8), FE_TYPE_I64);
+    FeIr* half = x64_unop(bb, FE_IR_ZEROEXT, x64_unop(bb, FE_IR_TRUNC, a, FE_TYPE_I16), FE_TYPE_I64);
+    FeIr* word = x64_unop(bb, FE_IR_ZEROEXT, x64_unop(bb, FE_IR_TRUNC, a, FE_TYPE_I32), FE_TYPE_I64);
+    x64_return(bb, x64_binop(bb, FE_IR_ADD, x64_binop(bb, FE_IR_ADD, low, half), word));
+    expect_x64_text(m,
+        "convert:\n"
+        ".entry:\n"
+        "   mov eax, edi\n"
+        "   movsx rax, al\n"
+        "   mov ecx, edi\n"
+        "   movzx ecx, cx\n"
+        "   mov edx, edi\n"
+        "   mov edx, edx\n"
+        "   add rax, rcx\n"
+        "   add rax, rdx\n"
+        "   ret\n"
+    );
+}
+
+// a direct call to a function in the same module
+void test_x64_text_call() {
+    FeModule* m = fe_new_module(str("call"));
+    FeFunction* callee = x64_function(m, "callee", FE_CCONV_SYSV, (FeType[]){FE_TYPE_I64, FE_TYPE_I64}, 2, (FeType[]){FE_TYPE_I64}, 1);
+    FeBasicBlock* bb = fe_new_basic_block(callee, str("entry"));
+    FeIr* a = fe_append_ir(bb, fe_ir_param(callee, 0));
+    FeIr* b = fe_append_ir(bb, fe_ir_param(callee, 1));
+    x64_return(bb, x64_binop(bb, FE_IR_SUB, a, b));
+
+    FeFunction* f = x64_function(m, "caller", FE_CCONV_SYSV, (FeType[]){FE_TYPE_I64}, 1, (FeType[]){FE_TYPE_I64}, 1);
+    bb = fe_new_basic_block(f, str("entry"));
+    FeIr* x = fe_append_ir(bb, fe_ir_param(f, 0));
+    FeIr* call = fe_append_ir(bb, fe_ir_call(f, callee));
+    fe_add_call_param(call, x64_const(bb, FE_TYPE_I64, 40));
+    fe_add_call_param(call, x);
+    FeIr* result = fe_append_ir(bb, fe_ir_retrieve(f, call, FE_TYPE_I64, 0));
+    x64_return(bb, x64_binop(bb, FE_IR_ADD, result, x));
+    expect_x64_text(m,
+        "callee:\n"
+        ".entry:\n"
+        "   sub rdi, rsi\n"
+        "   mov rax, rdi\n"
+        "   ret\n"
+        "caller:\n"
+        "   sub rsp, 8\n"
+        "   mov [rsp], r15\n"
+        "   mov r15, rdi\n"
+        ".entry:\n"
+        "   mov rax, 40\n"
+        "   mov rdi, rax\n"
+        "   mov rsi, r15\n"
+        "   call callee\n"
+        "   add rax, r15\n"
+        "   mov r15, [rsp]\n"
+        "   add rsp, 8\n"
+        "   ret\n"
+    );
+}
+
+// sse arithmetic, a float constant, and conversions both ways
+void test_x64_text_float() {
+    FeModule* m = fe_new_module(str("float"));
+    FeFunction* f = x64_function(m, "float", FE_CCONV_SYSV, (FeType[]){FE_TYPE_F64, FE_TYPE_F32, FE_TYPE_I32}, 3, (FeType[]){FE_TYPE_I64}, 1);
+    FeBasicBlock* bb = fe_new_basic_block(f, str("entry"));
+    FeIr* a = fe_append_ir(bb, fe_ir_param(f, 0));
+    FeIr* b = x64_unop(bb, FE_IR_SIGNEXT, fe_append_ir(bb, fe_ir_param(f, 1)), FE_TYPE_F64);
+    FeIr* c = x64_unop(bb, FE_IR_SIGNEXT, fe_append_ir(bb, fe_ir_param(f, 2)), FE_TYPE_F64);
+    FeIr* sum = x64_binop(bb, FE_IR_FADD, x64_binop(bb, FE_IR_FMUL, a, b), x64_fconst(bb, FE_TYPE_F64, 0.5));
+    x64_return(bb, x64_unop(bb, FE_IR_TRUNC, x64_binop(bb, FE_IR_FDIV, sum, c), FE_TYPE_I64));
+    expect_x64_text(m,
+        "float:\n"
+        ".entry:\n"
+        "   cvtss2sd xmm1, xmm1\n"
+        "   cvtsi2sd xmm2, edi\n"
+        "   mulsd xmm0, xmm1\n"
+        "   mov rax, 4602678819172646912\n"
+        "   movq xmm1, rax\n"
+        "   addsd xmm0, xmm1\n"
+        "   divsd xmm0, xmm2\n"
+        "   cvttsd2si rax, xmm0\n"
+        "   ret\n"
+    );
+}
+
+// mov 0 becomes xor, cmp with 0 becomes test, mov+add becomes lea,
+// and the jump to the next block goes away
+void test_x64_text_peephole() {
+    FeModule* m = fe_new_module(str("peephole"));
+    FeFunction* f = x64_function(m, "peephole", FE_CCONV_SYSV, (FeType[]){FE_TYPE_I64, FE_TYPE_I64}, 2, (FeType[]){FE_TYPE_I64}, 1);
+    FeBasicBlock* entry = fe_new_basic_block(f, str("entry"));
+    FeBasicBlock* zero = fe_new_basic_block(f, str("zero"));
+    FeBasicBlock* other = fe_new_basic_block(f, str("other"));
+    FeIr* a = fe_append_ir(entry, fe_ir_param(f, 0));
+    FeIr* b = fe_append_ir(entry, fe_ir_param(f, 1));
+    fe_append_ir(entry, fe_ir_branch(f, x64_binop(entry, FE_IR_EQ, a, x64_const(entry, FE_TYPE_I64, 0)), zero, other));
+    x64_return(zero, x64_const(zero, FE_TYPE_I64, 0));
+    x64_return(other, x64_binop(other, FE_IR_ADD, a, b));
+    expect_x64_text(m,
+        "peephole:\n"
+        ".entry:\n"
+        "   test rdi, rdi\n"
+        "   jne .other\n"
+        ".zero:\n"
+        "   xor eax, eax\n"
+        "   ret\n"
+        ".other:\n"
+        "   lea rax, [rdi + rsi]\n"
+        "   ret\n"
+    );
+}
+
+#ifdef X64_CAN_EXECUTE
+
+typedef struct X64Import {
+    char* name;
+    void* addr;
+} X64Import;
+
+// load the module's code into executable memory and return its first function.
+// imports are reached through a stub at the end of the code, since they're
+// probably further away than a rel32 can reach.
+static void* x64_load(FeModule* m, X64Import* imports, usize imports_len) {
+    FeMachBuffer mb = x64_codegen(m);
+    FeDataBuffer db = fe_db_new(256);
+    fe_mach_emit_bin(&db, &mb);
+
+    usize stubs = align_forward(db.len, 16);
+    usize page = sysconf(_SC_PAGESIZE);
+    usize size = align_forward(stubs + 16 * imports_len, page);
+    u8* code = NULL;
+    if (posix_memalign((void**)&code, page, size) != 0) CRASH("can't allocate code");
+    memcpy(code, db.at, db.len);
+    for_range(i, 0, imports_len) {
+        // mov r11, addr; jmp r11
+        u8* stub = code + stubs + 16 * i;
+        stub[0] = 0x49;
+        stub[1] = 0xBB;
+        memcpy(stub + 2, &imports[i].addr, 8);
+        stub[10] = 0x41;
+        stub[11] = 0xFF;
+        stub[12] = 0xE3;
+    }
+
+    foreach (FeMachReloc reloc, mb.relocs) {
+        FeMachSymbol* sym = &mb.symtab.at[reloc.symbol_index];
+        usize import = 0;
+        while (import < imports_len && (strlen(imports[import].name) != sym->name_len || strncmp(imports[import].name, sym->name, sym->name_len) != 0)) import++;
+        if (import == imports_len) CRASH("no address for symbol '%.*s'", sym->name_len, sym->name);
+        i32 rel = (i32)((i64)(stubs + 16 * import) - (i64)(reloc.offset + 4));
+        memcpy(code + reloc.offset, &rel, sizeof(rel));
+    }
+    if (mprotect(code, size, PROT_READ | PROT_EXEC) != 0) CRASH("can't make code executable");
+    fe_destroy_module(m);
+    return code;
+}
+
+#define expect_eq(got, want, fmt) do {                                     \
+    if ((got) != (want)) CRASH("%s is " fmt ", should be " fmt, #got, (got), (want)); \
+} while (0)
+
+// acc = phi [0, next]; next = acc + 1; loop while next < n; return acc.
+// acc is still live after the loop, so writing next's value into it early is wrong.
+void test_x64_phi_loop() {
+    FeModule* m = fe_new_module(str("phi_loop"));
+    FeFunction* f = x64_function(m, "count", FE_CCONV_SYSV, (FeType[]){FE_TYPE_I64}, 1, (FeType[]){FE_TYPE_I64}, 1);
+    FeBasicBlock* entry = fe_new_basic_block(f, str("entry"));
+    FeBasicBlock* loop = fe_new_basic_block(f, str("loop"));
+    FeBasicBlock* done = fe_new_basic_block(f, str("done"));
+
+    FeIr* n = fe_append_ir(entry, fe_ir_param(f, 0));
+    FeIr* zero = x64_const(entry, FE_TYPE_I64, 0);
+    fe_append_ir(entry, fe_ir_jump(f, loop));
+
+    FeIrPhi* acc = (FeIrPhi*)fe_append_ir(loop, fe_ir_phi(f, 2, FE_TYPE_I64));
+    FeIr* next = x64_binop(loop, FE_IR_ADD, (FeIr*)acc, x64_const(loop, FE_TYPE_I64, 1));
+    fe_add_phi_source(f, acc, zero, entry);
+    fe_add_phi_source(f, acc, next, loop);
+    fe_append_ir(loop, fe_ir_branch(f, x64_binop(loop, FE_IR_ULT, next, n), loop, done));
+
+    x64_return(done, (FeIr*)acc);
+
+    i64 (*count)(i64) = x64_load(m, NULL, 0);
+    expect_eq(count(100), 99ll, "%lld");
+    expect_eq(count(1), 0ll, "%lld");
+}
+
+// x and y swap places every time around the loop. their movs read each other,
+// so neither can be written before both are read.
+void test_x64_phi_swap() {
+    FeModule* m = fe_new_module(str("phi_swap"));
+    FeFunction* f = x64_function(m, "swap", FE_CCONV_SYSV, (FeType[]){FE_TYPE_I64, FE_TYPE_I64, FE_TYPE_I64}, 3, (FeType[]){FE_TYPE_I64}, 1);
+    FeBasicBlock* entry = fe_new_basic_block(f, str("entry"));
+    FeBasicBlock* loop = fe_new_basic_block(f, str("loop"));
+    FeBasicBlock* done = fe_new_basic_block(f, str("done"));
+
+    FeIr* a = fe_append_ir(entry, fe_ir_param(f, 0));
+    FeIr* b = fe_append_ir(entry, fe_ir_param(f, 1));
+    FeIr* n = fe_append_ir(entry, fe_ir_param(f, 2));
+    FeIr* zero = x64_const(entry, FE_TYPE_I64, 0);
+    fe_append_ir(entry, fe_ir_jump(f, loop));
+
+    FeIrPhi* x = (FeIrPhi*)fe_append_ir(loop, fe_ir_phi(f, 2, FE_TYPE_I64));
+    FeIrPhi* y = (FeIrPhi*)fe_append_ir(loop, fe_ir_phi(f, 2, FE_TYPE_I64));
+    FeIrPhi* i = (FeIrPhi*)fe_append_ir(loop, fe_ir_phi(f, 2, FE_TYPE_I64));
+    FeIr* next = x64_binop(loop, FE_IR_ADD, (FeIr*)i, x64_const(loop, FE_TYPE_I64, 1));
+    fe_add_phi_source(f, x, a, entry);
+    fe_add_phi_source(f, x, (FeIr*)y, loop);
+    fe_add_phi_source(f, y, b, entry);
+    fe_add_phi_source(f, y, (FeIr*)x, loop);
+    fe_add_phi_source(f, i, zero, entry);
+    fe_add_phi_source(f, i, next, loop);
+    fe_append_ir(loop, fe_ir_branch(f, x64_binop(loop, FE_IR_ULT, next, n), loop, done));
+
+    FeIr* ten_x = x64_binop(done, FE_IR_IMUL, (FeIr*)x, x64_const(done, FE_TYPE_I64, 10));
+    x64_return(done, x64_binop(done, FE_IR_ADD, ten_x, (FeIr*)y));
+
+    i64 (*swap)(i64, i64, i64) = x64_load(m, NULL, 0);
+    expect_eq(swap(1, 2, 1), 12ll, "%lld");
+    expect_eq(swap(1, 2, 2), 21ll, "%lld");
+    expect_eq(swap(1, 2, 5), 12ll, "%lld");
+}
+
+static i64 x64_weigh8(i64 a, i64 b, i64 c, i64 d, i64 e, i64 f, i64 g, i64 h) {
+    return a + 2 * b + 3 * c + 4 * d + 5 * e + 6 * f + 7 * g + 8 * h;
+}
+
+// eight arguments, the last two on the stack. x has to survive the call
+// in a callee-saved register.
+void test_x64_call_stack_args() {
+    FeModule* m = fe_new_module(str("call_stack_args"));
+    FeFunction* f = x64_function(m, "caller", FE_CCONV_SYSV, (FeType[]){FE_TYPE_PTR, FE_TYPE_I64}, 2, (FeType[]){FE_TYPE_I64}, 1);
+    FeBasicBlock* bb = fe_new_basic_block(f, str("entry"));
+
+    FeIr* fn = fe_append_ir(bb, fe_ir_param(f, 0));
+    FeIr* x = fe_append_ir(bb, fe_ir_param(f, 1));
+    FeIr* args[8];
+    for_range(i, 0, 8) args[i] = x64_binop(bb, FE_IR_ADD, x, x64_const(bb, FE_TYPE_I64, i));
+    FeIr* call = fe_append_ir(bb, fe_ir_ptr_call(f, fn, FE_CCONV_SYSV, 8));
+    for_range(i, 0, 8) fe_add_call_param(call, args[i]);
+    FeIr* result = fe_append_ir(bb, fe_ir_retrieve(f, call, FE_TYPE_I64, 0));
+    x64_return(bb, x64_binop(bb, FE_IR_ADD, result, x));
+
+    i64 (*caller)(void*, i64) = x64_load(m, NULL, 0);
+    expect_eq(caller(x64_weigh8, 10), x64_weigh8(10, 11, 12, 13, 14, 15, 16, 17) + 10, "%lld");
+}
+
+// a * b + c - a / b, with c converted from a signed i32
+void test_x64_float_arith() {
+    FeModule* m = fe_new_module(str("float_arith"));
+    FeFunction* f = x64_function(m, "arith", FE_CCONV_SYSV, (FeType[]){FE_TYPE_F64, FE_TYPE_F64, FE_TYPE_I32}, 3, (FeType[]){FE_TYPE_F64}, 1);
+    FeBasicBlock* bb = fe_new_basic_block(f, str("entry"));
+
+    FeIr* a = fe_append_ir(bb, fe_ir_param(f, 0));
+    FeIr* b = fe_append_ir(bb, fe_ir_param(f, 1));
+    FeIr* c = x64_unop(bb, FE_IR_SIGNEXT, fe_append_ir(bb, fe_ir_param(f, 2)), FE_TYPE_F64);
+    FeIr* sum = x64_binop(bb, FE_IR_FADD, x64_binop(bb, FE_IR_FMUL, a, b), c);
+    x64_return(bb, x64_binop(bb, FE_IR_FSUB, sum, x64_binop(bb, FE_IR_FDIV, a, b)));
+
+    f64 (*arith)(f64, f64, i32) = x64_load(m, NULL, 0);
+    expect_eq(arith(1.5, 2.0, -3), 1.5 * 2.0 - 3 - 1.5 / 2.0, "%f");
+}
+
+// -(x / 2), in f32, then widened to f64
+void test_x64_float_neg() {
+    FeModule* m = fe_new_module(str("float_neg"));
+    FeFunction* f = x64_function(m, "neg_half", FE_CCONV_SYSV, (FeType[]){FE_TYPE_F32}, 1, (FeType[]){FE_TYPE_F64}, 1);
+    FeBasicBlock* bb = fe_new_basic_block(f, str("entry"));
+
+    FeIr* x = fe_append_ir(bb, fe_ir_param(f, 0));
+    FeIr* half = x64_binop(bb, FE_IR_FDIV, x, x64_fconst(bb, FE_TYPE_F32, 2.0));
+    x64_return(bb, x64_unop(bb, FE_IR_SIGNEXT, x64_unop(bb, FE_IR_NEG, half, FE_TYPE_F32), FE_TYPE_F64));
+
+    f64 (*neg_half)(f32) = x64_load(m, NULL, 0);
+    expect_eq(neg_half(5.0f), -2.5, "%f");
+}
+
+// every comparison against every pair of 1, 2 and NaN
+void test_x64_float_compare() {
+    u16 kinds[] = {FE_IR_ULT, FE_IR_ULE, FE_IR_UGT, FE_IR_UGE, FE_IR_EQ, FE_IR_NE};
+    f64 values[] = {1.0, 2.0, NAN};
+    for_range(k, 0, 6) {
+        FeModule* m = fe_new_module(str("float_compare"));
+        FeFunction* f = x64_function(m, "compare", FE_CCONV_SYSV, (FeType[]){FE_TYPE_F64, FE_TYPE_F64}, 2, (FeType[]){FE_TYPE_BOOL}, 1);
+        FeBasicBlock* bb = fe_new_basic_block(f, str("entry"));
+        FeIr* a = fe_append_ir(bb, fe_ir_param(f, 0));
+        FeIr* b = fe_append_ir(bb, fe_ir_param(f, 1));
+        x64_return(bb, x64_binop(bb, kinds[k], a, b));
+
+        bool (*compare)(f64, f64) = x64_load(m, NULL, 0);
+        for_range(i, 0, 3) for_range(j, 0, 3) {
+            f64 x = values[i];
+            f64 y = values[j];
+            bool want;
+            switch (kinds[k]) {
+            case FE_IR_ULT: want = x < y; break;
+            case FE_IR_ULE: want = x <= y; break;
+            case FE_IR_UGT: want = x > y; break;
+            case FE_IR_UGE: want = x >= y; break;
+            case FE_IR_EQ: want = x == y; break;
+            default: want = x != y; break;
+            }
+            if (compare(x, y) != want) CRASH("float compare %d of %f and %f is wrong", kinds[k], x, y);
+        }
+    }
+}
+
+// u64 -> f64 -> i64, with values on both sides of 2^63, and the raw bits
+void test_x64_float_convert() {
+    FeModule* m = fe_new_module(str("float_convert"));
+    FeFunction* f = x64_function(m, "to_f64", FE_CCONV_SYSV, (FeType[]){FE_TYPE_I64}, 1, (FeType[]){FE_TYPE_F64}, 1);
+    FeBasicBlock* bb = fe_new_basic_block(f, str("entry"));
+    x64_return(bb, x64_unop(bb, FE_IR_ZEROEXT, fe_append_ir(bb, fe_ir_param(f, 0)), FE_TYPE_F64));
+    f64 (*to_f64)(u64) = x64_load(m, NULL, 0);
+
+    m = fe_new_module(str("float_convert"));
+    f = x64_function(m, "to_f32", FE_CCONV_SYSV, (FeType[]){FE_TYPE_I64}, 1, (FeType[]){FE_TYPE_F32}, 1);
+    bb = fe_new_basic_block(f, str("entry"));
+    x64_return(bb, x64_unop(bb, FE_IR_ZEROEXT, fe_append_ir(bb, fe_ir_param(f, 0)), FE_TYPE_F32));
+    f32 (*to_f32)(u64) = x64_load(m, NULL, 0);
+
+    u64 values[] = {0, 1, 12345, 1ull << 53 | 1, 1ull << 63, (1ull << 63) + 1025, UINT64_MAX};
+    for_range(i, 0, sizeof(values) / sizeof(values[0])) {
+        expect_eq(to_f64(values[i]), (f64)values[i], "%f");
+        expect_eq(to_f32(values[i]), (f32)values[i], "%f");
+    }
+
+    m = fe_new_module(str("float_convert"));
+    f = x64_function(m, "bits", FE_CCONV_SYSV, (FeType[]){FE_TYPE_F64, FE_TYPE_I32}, 2, (FeType[]){FE_TYPE_I64}, 1);
+    bb = fe_new_basic_block(f, str("entry"));
+    FeIr* x = fe_append_ir(bb, fe_ir_param(f, 0));
+    FeIr* u = x64_unop(bb, FE_IR_ZEROEXT, fe_append_ir(bb, fe_ir_param(f, 1)), FE_TYPE_F64);
+    FeIr* truncated = x64_unop(bb, FE_IR_TRUNC, x64_binop(bb, FE_IR_FADD, x, u), FE_TYPE_I64);
+    x64_return(bb, x64_binop(bb, FE_IR_XOR, truncated, x64_unop(bb, FE_IR_BITCAST, x, FE_TYPE_I64)));
+    i64 (*bits)(f64, u32) = x64_load(m, NULL, 0);
+
+    f64 d = -7.75;
+    i64 d_bits;
+    memcpy(&d_bits, &d, sizeof(d));
+    expect_eq(bits(d, 4000000000u), (i64)(d + 4000000000.0) ^ d_bits, "%lld");
+}
+
+// sse has no remainder, fmod turns into a call to libm
+void test_x64_float_remainder() {
+    FeModule* m = fe_new_module(str("float_remainder"));
+    FeFunction* f = x64_function(m, "rem", FE_CCONV_SYSV, (FeType[]){FE_TYPE_F64, FE_TYPE_F64}, 2, (FeType[]){FE_TYPE_F64}, 1);
+    FeBasicBlock* bb = fe_new_basic_block(f, str("entry"));
+    FeIr* a = fe_append_ir(bb, fe_ir_param(f, 0));
+    FeIr* b = fe_append_ir(bb, fe_ir_param(f, 1));
+    // a is needed after the call, in a callee-saved place
+    x64_return(bb, x64_binop(bb, FE_IR_FADD, x64_binop(bb, FE_IR_FMOD, a, b), a));
+
+    X64Import imports[] = {{"fmod", (void*)fmod}};
+    f64 (*rem)(f64, f64) = x64_load(m, imports, 1);
+    expect_eq(rem(7.5, 2.0), fmod(7.5, 2.0) + 7.5, "%f");
+}
+
+// twenty values live at once, more than there are registers
+void test_x64_spill() {
+    FeModule* m = fe_new_module(str("spill"));
+    FeFunction* f = x64_function(m, "pressure", FE_CCONV_SYSV, (FeType[]){FE_TYPE_I64, FE_TYPE_I64}, 2, (FeType[]){FE_TYPE_I64}, 1);
+    FeBasicBlock* bb = fe_new_basic_block(f, str("entry"));
+    FeIr* a = fe_append_ir(bb, fe_ir_param(f, 0));
+    FeIr* b = fe_append_ir(bb, fe_ir_param(f, 1));
+
+    FeIr* v[20];
+    for_range(i, 0, 20) v[i] = x64_binop(bb, i % 2 ? FE_IR_SUB : FE_IR_XOR, i ? v[i - 1] : a, b);
+    FeIr* sum = v[0];
+    for_range(i, 1, 20) sum = x64_binop(bb, FE_IR_ADD, sum, v[i]);
+    x64_return(bb, sum);
+
+    i64 (*pressure)(i64, i64) = x64_load(m, NULL, 0);
+    i64 x = 1234567;
+    i64 y = 89;
+    i64 want = 0;
+    i64 value = x;
+    for_range(i, 0, 20) {
+        value = i % 2 ? value - y : value ^ y;
+        want += value;
+    }
+    expect_eq(pressure(x, y), want, "%lld");
+}
+
+// the same, with floats
+void test_x64_spill_floats() {
+    FeModule* m = fe_new_module(str("spill_floats"));
+    FeFunction* f = x64_function(m, "pressure", FE_CCONV_SYSV, (FeType[]){FE_TYPE_F64, FE_TYPE_F64}, 2, (FeType[]){FE_TYPE_F64}, 1);
+    FeBasicBlock* bb = fe_new_basic_block(f, str("entry"));
+    FeIr* a = fe_append_ir(bb, fe_ir_param(f, 0));
+    FeIr* b = fe_append_ir(bb, fe_ir_param(f, 1));
+
+    FeIr* v[20];
+    for_range(i, 0, 20) v[i] = x64_binop(bb, i % 2 ? FE_IR_FSUB : FE_IR_FMUL, i ? v[i - 1] : a, b);
+    FeIr* sum = v[0];
+    for_range(i, 1, 20) sum = x64_binop(bb, FE_IR_FADD, sum, v[i]);
+    x64_return(bb, sum);
+
+    f64 (*pressure)(f64, f64) = x64_load(m, NULL, 0);
+    f64 want = 0;
+    f64 value = 1.25;
+    for_range(i, 0, 20) {
+        value = i % 2 ? value - 0.5 : value * 0.5;
+        want += value;
+    }
+    expect_eq(pressure(1.25, 0.5), want, "%f");
+}
+
+// a callee with two returns, one of them a float, called through a pointer.
+// the retrieves come in the normal order.
+void test_x64_ptrcall_returns() {
+    FeModule* m = fe_new_module(str("ptrcall_callee"));
+    FeFunction* f = x64_function(m, "pair", FE_CCONV_MARS, (FeType[]){FE_TYPE_I64}, 1, (FeType[]){FE_TYPE_I64, FE_TYPE_F64}, 2);
+    FeBasicBlock* bb = fe_new_basic_block(f, str("entry"));
+    FeIr* x = fe_append_ir(bb, fe_ir_param(f, 0));
+    FeIr* product = x64_binop(bb, FE_IR_IMUL, x, x64_const(bb, FE_TYPE_I64, 3));
+    FeIr* quarter = x64_binop(bb, FE_IR_FDIV, x64_unop(bb, FE_IR_SIGNEXT, x, FE_TYPE_F64), x64_fconst(bb, FE_TYPE_F64, 4.0));
+    FeIrReturn* ret = (FeIrReturn*)fe_append_ir(bb, fe_ir_return(f));
+    ret->sources[0] = product;
+    ret->sources[1] = quarter;
+    void* pair = x64_load(m, NULL, 0);
+
+    m = fe_new_module(str("ptrcall_caller"));
+    f = x64_function(m, "caller", FE_CCONV_SYSV, (FeType[]){FE_TYPE_PTR, FE_TYPE_I64}, 2, (FeType[]){FE_TYPE_F64}, 1);
+    bb = fe_new_basic_block(f, str("entry"));
+    FeIr* fn = fe_append_ir(bb, fe_ir_param(f, 0));
+    x = fe_append_ir(bb, fe_ir_param(f, 1));
+    FeIr* call = fe_append_ir(bb, fe_ir_ptr_call(f, fn, FE_CCONV_MARS, 1));
+    fe_add_call_param(call, x);
+    product = fe_append_ir(bb, fe_ir_retrieve(f, call, FE_TYPE_I64, 0));
+    quarter = fe_append_ir(bb, fe_ir_retrieve(f, call, FE_TYPE_F64, 1));
+    x64_return(bb, x64_binop(bb, FE_IR_FADD, x64_unop(bb, FE_IR_SIGNEXT, product, FE_TYPE_F64), quarter));
+
+    f64 (*caller)(void*, i64) = x64_load(m, NULL, 0);
+    expect_eq(caller(pair, 10), 30.0 + 2.5, "%f");
+}
+
+// a constant index that puts the displacement past 2GB
+void test_x64_far_displacement() {
+    FeModule* m = fe_new_module(str("far_displacement"));
+    FeFunction* f = x64_function(m, "far", FE_CCONV_SYSV, (FeType[]){FE_TYPE_PTR}, 1, (FeType[]){FE_TYPE_I64}, 1);
+    FeBasicBlock* bb = fe_new_basic_block(f, str("entry"));
+    FeIr* p = fe_append_ir(bb, fe_ir_param(f, 0));
+    FeType array = fe_type_array(m, FE_TYPE_I64, 1ull << 40);
+    FeIr* elem = fe_append_ir(bb, fe_ir_index_ptr(f, array, x64_const(bb, FE_TYPE_I64, 1ll << 29), p));
+    x64_return(bb, fe_append_ir(bb, fe_ir_load(f, elem, FE_TYPE_I64, false)));
+
+    i64 (*far)(void*) = x64_load(m, NULL, 0);
+    i64 value = 0x1234;
+    expect_eq(far((u8*)&value - (8ll << 29)), value, "%lld");
+}
+
+#endif
+
 // conduct a full self-test. bugs that impede functionality should be caught here.
 void fe_selftest() {
+    test_x64_text_alu();
+    test_x64_text_muldiv();
+    test_x64_text_shifts();
+    test_x64_text_compare();
+    test_x64_text_memory();
+    test_x64_text_convert();
+    test_x64_text_call();
+    test_x64_text_float();
+    test_x64_text_peephole();
+
+#ifdef X64_CAN_EXECUTE
+    test_x64_phi_loop();
+    test_x64_phi_swap();
+    test_x64_call_stack_args();
+    test_x64_float_arith();
+    test_x64_float_neg();
+    test_x64_float_compare();
+    test_x64_float_convert();
+    test_x64_float_remainder();
+    test_x64_spill();
+    test_x64_spill_floats();
+    test_x64_ptrcall_returns();
+    test_x64_far_displacement();
+#endif
+
+    test_tdce_dead_head();
     test_c_gen();
 }
 
@@ -3,7 +3,7 @@
 void fe_typegraph_init(FeModule* m) {
 
     da_init(&m->typegraph, 16);
-    m->typegraph.alloca = arena_make(0x1000);
+    m->typegraph.alloca = fe_arena_make(0x1000);
 
     return;
 }
@@ -109,4 +109,81 @@ FeType fe_type_record(FeModule* m, u64 len) {
 FeAggregateType* fe_type_get_structure(FeModule* m, FeType t) {
     if (t < _FE_TYPE_SIMPLE_END) return NULL;
     return m->typegraph.at[t - _FE_TYPE_SIMPLE_END];
+}
+
+u64 fe_type_align(FeModule* m, FeType t) {
+    switch (t) {
+    case FE_TYPE_VOID: return 1;
+    case FE_TYPE_BOOL:
+    case FE_TYPE_I8: return 1;
+    case FE_TYPE_I16:
+    case FE_TYPE_F16: return 2;
+    case FE_TYPE_I32:
+    case FE_TYPE_F32: return 4;
+    case FE_TYPE_PTR:
+    case FE_TYPE_I64:
+    case FE_TYPE_F64: return 8;
+    }
+
+    FeAggregateType* agg = fe_type_get_structure(m, t);
+    switch (agg->kind) {
+    case FE_TYPE_ARRAY:
+        return fe_type_align(m, agg->array.sub);
+    case FE_TYPE_RECORD: {
+        u64 align = 1;
+        for_range(i, 0, agg->record.len) {
+            u64 field_align = fe_type_align(m, agg->record.fields[i]);
+            if (field_align > align) align = field_align;
+        }
+        return align;
+    }
+    }
+    CRASH("unknown type %d", t);
+}
+
+u64 fe_type_size(FeModule* m, FeType t) {
+    switch (t) {
+    case FE_TYPE_VOID: return 0;
+    case FE_TYPE_BOOL:
+    case FE_TYPE_I8: return 1;
+    case FE_TYPE_I16:
+    case FE_TYPE_F16: return 2;
+    case FE_TYPE_I32:
+    case FE_TYPE_F32: return 4;
+    case FE_TYPE_PTR:
+    case FE_TYPE_I64:
+    case FE_TYPE_F64: return 8;
+    }
+
+    FeAggregateType* agg = fe_type_get_structure(m, t);
+    switch (agg->kind) {
+    case FE_TYPE_ARRAY:
+        return fe_type_size(m, agg->array.sub) * agg->array.len;
+    case FE_TYPE_RECORD: {
+        // offset of the one-past-the-end field, padded out to the record's alignment
+        u64 size = fe_type_field_offset(m, t, agg->record.len);
+        u64 align = fe_type_align(m, t);
+        return (size + align - 1) & ~(align - 1);
+    }
+    }
+    CRASH("unknown type %d", t);
+}
+
+// index may be equal to the field count, giving the end of the last field
+u64 fe_type_field_offset(FeModule* m, FeType record, u32 index) {
+    FeAggregateType* agg = fe_type_get_structure(m, record);
+    if (agg == NULL || agg->kind != FE_TYPE_RECORD) CRASH("type %d is not a record", record);
+
+    u64 offset = 0;
+    for_range(i, 0, index) {
+        FeType field = agg->record.fields[i];
+        u64 align = fe_type_align(m, field);
+        offset = (offset + align - 1) & ~(align - 1);
+        offset += fe_type_size(m, field);
+    }
+    if (index < agg->record.len) {
+        u64 align = fe_type_align(m, agg->record.fields[index]);
+        offset = (offset + align - 1) & ~(align - 1);
+    }
+    return offset;
 }
\ No newline at end of file
@@ -69,7 +69,7 @@ void irgen_global_decl(IrBuilder* builder, ast_decl_stmt* global_decl) {
     // assume lhs.len == 1, since multiple lhs requires function calls
     // which are illegal at the global scope
     // cause globals must be initialized to comptime constant vals
-    string mars_identifier = global_decl->lhs.at[0].as_identifier->tok->text;
+    string mars_identifier = token_text(global_decl->lhs.at[0].as_identifier->tok);
     string global_sym_str = irgen_mangle_identifer(builder, mars_identifier);
 
     FeSymbol* global_sym = fe_new_symbol(builder->mod, global_sym_str, FE_BIND_EXPORT);
@@ -88,7 +88,7 @@ void irgen_global_decl(IrBuilder* builder, ast_decl_stmt* global_decl) {
 }
 
 void irgen_global_fn_decl(IrBuilder* builder, ast_func_literal_expr* fn) {
-    string mars_identifier = fn->ident.base->start->text;
+    string mars_identifier = token_text(fn->ident.base->start);
     string global_sym_str = irgen_mangle_identifer(builder, mars_identifier);
 
     FeSymbol* global_sym = fe_new_symbol(builder->mod, global_sym_str, FE_BIND_EXPORT);
@@ -10,6 +10,8 @@
 #include "phobos/dot.h"
 #include "phobos/parse/parse.h"
 #include "phobos/analysis/sema.h"
+#include "phobos/cache.h"
+#include "server.h"
 
 #include "common/crash.h"
 
@@ -29,34 +31,96 @@ void apply_current_arch(mars_module* mod) {
     }
 }
 
+// lexing and parsing time themselves in phobos, the rest of the stages are timed here
+static struct timeval stage_begin;
+
+static void begin_stage() {
+    if (mars_flags.print_timings) gettimeofday(&stage_begin, 0);
+}
+
+static void end_stage(char* name) {
+    if (!mars_flags.print_timings) return;
+    struct timeval stage_end;
+    gettimeofday(&stage_end, 0);
+    long seconds = stage_end.tv_sec - stage_begin.tv_sec;
+    long microseconds = stage_end.tv_usec - stage_begin.tv_usec;
+    double elapsed = (double)seconds + (double)microseconds * 1e-6;
+    printf(STYLE_FG_Green STYLE_Bold "%s" STYLE_Reset, name);
+    printf("\t  time      : %fs\n", elapsed);
+}
+
 int main(int argc, char** argv) {
 #ifndef _WIN32
     init_signal_handler();
 #endif
 
+    // load_arguments splits flags up in place, a compile server needs them whole
+    char** raw_argv = mars_alloc(sizeof(char*) * argc);
+    for_range(i, 0, argc) raw_argv[i] = strdup(argv[i]);
+
     load_arguments(argc, argv, &mars_flags);
 
+    if (!is_null_str(mars_flags.serve_path)) return serve(mars_flags.serve_path);
+    if (!is_null_str(mars_flags.connect_path)) return connect_to_server(mars_flags.connect_path, argc, raw_argv);
+
+    mars_module* main_mod = mars_frontend();
+    if (main_mod == NULL) return 0;
+    return mars_backend(main_mod);
+}
+
+mars_module* mars_frontend() {
     mars_module* main_mod = parse_module(mars_flags.input_path);
+    if (mars_flags.output_dot || mars_flags.dump_AST) {
+        compact_ast tree = compact_module(main_mod);
+        if (mars_flags.dump_AST) {
+            for_urange(i, 0, tree.roots_len) dump_tree(&tree, tree.extra[tree.roots + i], 0);
+            printf("%u nodes, %zu bytes (%zu as pointer nodes)\n", tree.len - 1, compact_bytes(&tree), tree.pointer_bytes);
+        }
+        if (mars_flags.output_dot) emit_dot(str("test"), &tree);
+        compact_destroy(&tree);
+    }
+    if (mars_flags.stop_after == STAGE_PARSE) return NULL;
+
+    // the main module is the one that gets lowered, so it always needs its bodies checked
+    main_mod->cached = false;
 
     main_mod->current_architecture = mars_arch_to_fe(mars_flags.target_arch);
     apply_current_arch(main_mod);
 
-    if (mars_flags.output_dot == true) {
-        emit_dot(str("test"), main_mod->program_tree);
+    // recursive check. the compile server might have checked it already
+    begin_stage();
+    if (!main_mod->checked) check_module(main_mod);
+    end_stage("CHECKING");
+    if (mars_flags.print_timings) {
+        size_t cached = 0;
+        foreach (mars_module* mod, active_modules) cached += mod->cached;
+        printf("\t  cached    : %zu/%zu modules\n", cached, (size_t)active_modules.len);
+        printf("\t  types     : %zu\n", (size_t)typegraph.len);
     }
-    // recursive check
-    check_module(main_mod);
+    // everything checked clean if we got here
+    cache_store_modules(&active_modules);
+    if (mars_flags.stop_after == STAGE_CHECK) return NULL;
+
+    return main_mod;
+}
 
+int mars_backend(mars_module* main_mod) {
     printf("attempt IR generation\n");
 
+    begin_stage();
     FeModule* iron_module = irgen_module(main_mod);
+    end_stage("IRGEN");
+    if (mars_flags.stop_after == STAGE_IR) return 0;
 
     printf("IR generated\n");
     printf("attempt passes\n");
 
+    begin_stage();
     MARS_STANDARD_PASSES(iron_module);
 
     fe_run_all_passes(iron_module, true);
+    end_stage("PASSES");
+    if (mars_flags.stop_after == STAGE_PASSES) return 0;
 
     printf("passes done\n");
 
@@ -65,7 +129,9 @@ int main(int argc, char** argv) {
     iron_module->target.arch = main_mod->current_architecture;
     iron_module->target.system = mars_sys_to_fe(mars_flags.target_system);
 
+    begin_stage();
     FeMachBuffer mb = fe_mach_codegen(iron_module);
+    end_stage("CODEGEN");
 
     FeDataBuffer db = fe_db_new(128);
 
@@ -85,6 +151,13 @@ void print_help() {
     printf("-target:(arch)-(system)-(product) specify the target triple you are using, e.g aphelion-unknown-asm\n");
     printf("\n");
     printf("-timings                          print stage timings\n");
+    printf("-stop:(stage)                     stop after a stage: parse, check, ir or passes\n");
+    printf("-cache:(path)                     where to keep the module cache (default ./.mars-cache)\n");
+    printf("-no-cache                         check every module from scratch, and don't record anything\n");
+    printf("-serve:(socket)                   run as a compile server on a unix socket, in place of (directory)\n");
+    printf("-connect:(socket)                 hand this build to a compile server\n");
+    printf("-jobs:(n)                         check up to n modules at once (default one per core)\n");
+    printf("-reorder-fields                   reorder struct fields to minimize padding\n");
     printf("-dump-AST                         print readable AST\n");
     printf("-dot                              convert the AST to a graphviz .dot file\n");
 }
@@ -116,6 +189,11 @@ void load_arguments(int argc, char* argv[], flag_set* fl) {
         print_help();
         exit(EXIT_SUCCESS);
     }
+    if (string_eq(input_directory_arg.key, str("-serve"))) {
+        if (is_null_str(input_directory_arg.val)) general_error("-serve needs a socket path");
+        fl->serve_path = input_directory_arg.val;
+        return;
+    }
     if (!is_null_str(input_directory_arg.val)) {
         general_error("error: expected an input path, got \"%s\"", argv[1]);
     }
@@ -128,6 +206,9 @@ void load_arguments(int argc, char* argv[], flag_set* fl) {
 
     fl->input_path = string_clone(str(dumbass_shit_buffer));
 
+    char* cwd = getcwd(NULL, 0);
+    fl->cache_path = strprintf("%s/.mars-cache", cwd);
+
     int flag_start_index = 2;
     for_range(i, flag_start_index, argc) {
         cmd_arg a = make_argument(argv[i]);
@@ -148,6 +229,27 @@ void load_arguments(int argc, char* argv[], flag_set* fl) {
             fl->output_dot = true;
         } else if (string_eq(a.key, str("-timings"))) {
             fl->print_timings = true;
+        } else if (string_eq(a.key, str("-stop"))) {
+            if (string_eq(a.val, str("parse"))) fl->stop_after = STAGE_PARSE;
+            else if (string_eq(a.val, str("check"))) fl->stop_after = STAGE_CHECK;
+            else if (string_eq(a.val, str("ir"))) fl->stop_after = STAGE_IR;
+            else if (string_eq(a.val, str("passes"))) fl->stop_after = STAGE_PASSES;
+            else general_error("unknown stage \"" str_fmt "\"", str_arg(a.val));
+        } else if (string_eq(a.key, str("-cache"))) {
+            if (is_null_str(a.val)) general_error("-cache needs a path");
+            fl->cache_path = a.val.raw[0] == '/' ? a.val : strprintf("%s/" str_fmt, cwd, str_arg(a.val));
+        } else if (string_eq(a.key, str("-no-cache"))) {
+            fl->cache_path = NULL_STR;
+        } else if (string_eq(a.key, str("-connect"))) {
+            if (is_null_str(a.val)) general_error("-connect needs a socket path");
+            fl->connect_path = a.val;
+        } else if (string_eq(a.key, str("-jobs"))) {
+            char* end = NULL;
+            long jobs = is_null_str(a.val) ? 0 : strtol(a.val.raw, &end, 10);
+            if (jobs <= 0 || *end != '\0') general_error("-jobs needs a positive number");
+            fl->jobs = (int)jobs;
+        } else if (string_eq(a.key, str("-reorder-fields"))) {
+            fl->reorder_fields = true;
         } else if (string_eq(a.key, str("-dump-AST"))) {
             fl->dump_AST = true;
         } else if (string_eq(a.key, str("-target"))) {
@@ -12,12 +12,27 @@ typedef struct cmd_arg_s {
     string val;
 } cmd_arg;
 
+// compiler stages, for -stop
+enum {
+    STAGE_ALL,
+    STAGE_PARSE,
+    STAGE_CHECK,
+    STAGE_IR,
+    STAGE_PASSES,
+};
+
 typedef struct flag_set_s {
     string input_path;
     string output_path;
     bool output_dot;
     bool print_timings;
     bool dump_AST;
+    bool reorder_fields; // lay struct fields out to minimize padding
+    int jobs;            // threads checking modules at once, 0 for one per core
+    int stop_after; // STAGE_ALL to run everything
+    string cache_path; // NULL_STR when the module cache is off
+    string serve_path;   // -serve, run as a compile server
+    string connect_path; // -connect, hand the build to a compile server
 
     int target_arch;
     int target_system;
@@ -29,6 +44,13 @@ void load_arguments(int argc, char* argv[], flag_set* fl);
 
 void print_help();
 
+typedef struct mars_module mars_module;
+
+// parse and check the input module. NULL if -stop says that's all
+mars_module* mars_frontend();
+// lower the checked main module down to assembly and print it
+int mars_backend(mars_module* main_mod);
+
 extern flag_set mars_flags;
 
 #define MARS_PASS(module, name) \
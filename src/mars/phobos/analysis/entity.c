@@ -1,18 +1,6 @@
 #include "entity.h"
 
-entity_table_list entity_tables;
-
-u64 FNV_1a(string key) {
-    const u64 FNV_OFFSET = 14695981039346656037ull;
-    const u64 FNV_PRIME = 1099511628211ull;
-
-    u64 hash = FNV_OFFSET;
-    for_urange(i, 0, key.len) {
-        hash ^= (u64)(u8)(key.raw[i]);
-        hash *= FNV_PRIME;
-    }
-    return hash;
-}
+_Thread_local entity_table_list entity_tables;
 
 entity_table* new_entity_table(entity_table* parent) {
     if (entity_tables.at == NULL) da_init(&entity_tables, 1);
@@ -61,9 +61,9 @@ typedef struct entity_table {
     size_t cap;
 } entity_table;
 
-extern entity_table_list entity_tables;
+extern _Thread_local entity_table_list entity_tables; // per checker thread, see check_module()
 
-u64 FNV_1a(string key); // for implementing a hash table later
+u64 FNV_1a(string key); // defined in common/strmap.c, for implementing a hash table later
 
 entity_table* new_entity_table(entity_table* parent);
 
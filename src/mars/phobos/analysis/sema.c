@@ -2,18 +2,125 @@
 #include "../ast.h"
 #include "common/crash.h"
 #include "common/strmap.h"
+#include "mars/mars.h"
+#include <pthread.h>
+#include <stdatomic.h>
 //#define LOG(...) printf(__VA_ARGS__)
 #define LOG(...)
-StrMap name_to_type;
+_Thread_local StrMap name_to_type;
+
+/*
+    modules are checked in waves. a module's wave is one past the deepest of
+    its imports, so nothing in a wave imports anything else in it, and a
+    whole wave can be checked at once, one module per thread.
+
+    inside a module, checking is split in two. first everything at the top
+    level is checked in order: imports, types, globals and function
+    signatures. function bodies only get queued up. once all of that is
+    known the bodies don't depend on each other, so they're checked after,
+    split up between threads if there are enough of them.
+
+    workers make their types in a partition of the type graph and their
+    entity tables in a list of their own (both are thread local), and see
+    everything from before read only. once they're done they're merged back
+    in, in order, and the merged graph gets canonicalized and laid out
+    before the next wave starts.
+*/
+
+// a function body waiting for its module's top level to be checked
+typedef struct deferred_body {
+    AST func_literal;
+    entity_table* scope; // with the params and returns in it
+} deferred_body;
+
+da_typedef(deferred_body);
+
+static _Thread_local da(deferred_body) deferred_bodies;
+
+// modules with fewer bodies than this aren't worth starting threads for
+#define PARALLEL_BODIES_MIN 64
+
+// where checked values go. body workers get an arena each instead of
+// sharing the module's
+static _Thread_local Arena* value_arena;
+
+// body workers declare their own types in name_to_type, and find the
+// module's here
+static _Thread_local StrMap* module_types;
+
+// set on threads started by run_check_jobs(), which don't start any more
+static _Thread_local bool on_check_worker;
+
+typedef struct check_job {
+    mars_module* mod;
+    // a run of the module's deferred bodies, or the whole module if NULL
+    deferred_body* bodies;
+    size_t bodies_len;
+    StrMap* module_types;
+
+    TypeGraph types;
+    entity_table_list tables;
+    int status; // nonzero if checking it failed
+} check_job;
+
+typedef struct check_queue {
+    check_job* jobs;
+    size_t len;
+    atomic_size_t next;
+    atomic_bool failed;
+} check_queue;
+
+static Type* type_named(string name) {
+    Type* t = strmap_get(&name_to_type, name);
+    if (t == STRMAP_NOT_FOUND && module_types != NULL) t = strmap_get(module_types, name);
+    return t;
+}
 
-void check_module(mars_module* mod) {
+static void check_func_body(mars_module* mod, AST func_literal, entity_table* func_scope) {
+    foreach (AST stmt, func_literal.as_func_literal_expr->code_block.as_stmt_block->stmts) {
+        check_stmt(mod, stmt, func_scope);
+    }
+
+    // now, we look through the scope, seeing if a param or a return has been used!
+    foreach (entity* ent, *func_scope) {
+        if (ent->declaration.type != AST_identifier) continue;
+        if (ent->is_param && !ent->been_used) warning_at_node(mod, ent->declaration, "unused param: " str_fmt, str_arg(ent->identifier));
+        else if (ent->is_return && !ent->been_used) warning_at_node(mod, ent->declaration, "unused return: " str_fmt, str_arg(ent->identifier));
+    }
+}
+
+static void run_check_jobs(check_job* jobs, size_t len, size_t threads);
+static size_t check_threads();
+
+static void check_bodies(mars_module* mod) {
+    size_t threads = check_threads();
+    if (on_check_worker || threads <= 1 || deferred_bodies.len < PARALLEL_BODIES_MIN) {
+        foreach (deferred_body body, deferred_bodies) check_func_body(mod, body.func_literal, body.scope);
+        return;
+    }
+
+    // a few runs per thread, so one with slow bodies doesn't hold up the rest
+    size_t runs = threads * 4;
+    if (runs > deferred_bodies.len) runs = deferred_bodies.len;
+    check_job* jobs = mars_alloc(sizeof(check_job) * runs);
+    for_urange(i, 0, runs) {
+        size_t start = deferred_bodies.len * i / runs;
+        size_t end = deferred_bodies.len * (i + 1) / runs;
+        jobs[i] = (check_job){
+            .mod = mod,
+            .bodies = &deferred_bodies.at[start],
+            .bodies_len = end - start,
+            .module_types = &name_to_type,
+        };
+    }
+    run_check_jobs(jobs, runs, threads);
+    mars_free(jobs);
+}
+
+// checks the module on its own, its imports need to be checked already
+static void check_module_alone(mars_module* mod) {
     LOG("checking: " str_fmt "\n", str_arg(mod->module_name));
     general_warning("TODO: exprs that CAN be comp-time computed, should be.");
-    foreach (mars_module* module, mod->import_list) {
-        if (!module->checked) {
-            check_module(module);
-        }
-    }
 
     // TODO:
     /*
@@ -22,18 +129,20 @@ void check_module(mars_module* mod) {
     */
     if (mod->entities == NULL) mod->entities = new_entity_table(NULL);
     strmap_init(&name_to_type, 1);
+    if (deferred_bodies.at == NULL) da_init(&deferred_bodies, 64);
+    da_clear(&deferred_bodies);
 
     foreach (AST trunk, mod->program_tree) {
         //shallow scan, grab entities if they have decls.
         if (trunk.type == AST_decl_stmt) {
             foreach(AST lhs, trunk.as_decl_stmt->lhs) {
-                LOG("surface passing: "str_fmt"\n", str_arg(lhs.as_identifier->tok->text));
-                new_entity(mod->entities, lhs.as_identifier->tok->text, trunk);
+                LOG("surface passing: "str_fmt"\n", str_arg(token_text(lhs.as_identifier->tok)));
+                new_entity(mod->entities, token_text(lhs.as_identifier->tok), trunk);
             }
         }
         if (trunk.type == AST_func_literal_expr) {
-            LOG("surface passing: "str_fmt"\n", str_arg(trunk.as_func_literal_expr->ident.as_identifier->tok->text));
-            new_entity(mod->entities, trunk.as_func_literal_expr->ident.as_identifier->tok->text, trunk);
+            LOG("surface passing: "str_fmt"\n", str_arg(token_text(trunk.as_func_literal_expr->ident.as_identifier->tok)));
+            new_entity(mod->entities, token_text(trunk.as_func_literal_expr->ident.as_identifier->tok), trunk);
         }
     }
 
@@ -42,14 +151,144 @@ void check_module(mars_module* mod) {
     foreach (AST trunk, mod->program_tree) {
         check_stmt(mod, trunk, mod->entities);
     }
-    mod->checked = true;
+    check_bodies(mod);
+}
+
+static void* check_worker(void* arg) {
+    check_queue* queue = arg;
+    on_check_worker = true;
+    for (size_t i = atomic_fetch_add(&queue->next, 1); i < queue->len; i = atomic_fetch_add(&queue->next, 1)) {
+        // no use checking more once something has failed
+        if (atomic_load(&queue->failed)) break;
+
+        check_job* job = &queue->jobs[i];
+        type_partition_begin();
+        sigjmp_buf recovery;
+        int status = sigsetjmp(recovery, 1);
+        if (status == 0) {
+            crash_recovery = &recovery;
+            if (job->bodies == NULL) {
+                check_module_alone(job->mod);
+            } else {
+                // values live as long as the AST does, so the arena is never freed
+                value_arena = mars_alloc(sizeof(Arena));
+                *value_arena = arena_make(64 * sizeof(exact_value));
+                module_types = job->module_types;
+                strmap_init(&name_to_type, 1);
+                for_urange(b, 0, job->bodies_len) {
+                    check_func_body(job->mod, job->bodies[b].func_literal, job->bodies[b].scope);
+                }
+            }
+        } else {
+            job->status = status;
+            atomic_store(&queue->failed, true);
+        }
+        crash_recovery = NULL;
+        value_arena = NULL;
+        module_types = NULL;
+
+        job->types = type_partition_end();
+        job->tables = entity_tables;
+        entity_tables = (entity_table_list){0};
+    }
+    return NULL;
+}
+
+static size_t check_threads() {
+    if (mars_flags.jobs > 0) return mars_flags.jobs;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? cores : 1;
+}
+
+// runs the jobs on up to threads workers, then merges what they made back
+// in, in job order so the result doesn't depend on scheduling
+static void run_check_jobs(check_job* jobs, size_t len, size_t threads) {
+    if (threads > len) threads = len;
+    check_queue queue = {.jobs = jobs, .len = len};
+
+    pthread_t* workers = mars_alloc(sizeof(pthread_t) * threads);
+    for_urange(i, 0, threads) {
+        int err = pthread_create(&workers[i], NULL, check_worker, &queue);
+        if (err != 0) general_error("cannot start a checker thread: %s", strerror(err));
+    }
+    for_urange(i, 0, threads) pthread_join(workers[i], NULL);
+    mars_free(workers);
+
+    // the error's already been printed, hand it on from this thread
+    for_urange(i, 0, len) {
+        if (jobs[i].status != 0) crash_exit(jobs[i].status);
+    }
+
+    if (entity_tables.at == NULL) da_init(&entity_tables, 1);
+    for_urange(i, 0, len) {
+        type_partition_merge(&jobs[i].types);
+        foreach (entity_table* et, jobs[i].tables) da_append(&entity_tables, et);
+        if (jobs[i].tables.at != NULL) da_destroy(&jobs[i].tables);
+    }
+}
+
+static void check_modules_at_once(module_list* modules) {
+    size_t threads = check_threads();
+    if (threads <= 1 || modules->len == 1) {
+        // nothing to overlap, check them right on the shared graph
+        foreach (mars_module* mod, *modules) check_module_alone(mod);
+        return;
+    }
+
+    check_job* jobs = mars_alloc(sizeof(check_job) * modules->len);
+    for_urange(i, 0, modules->len) jobs[i] = (check_job){.mod = modules->at[i]};
+    run_check_jobs(jobs, modules->len, threads);
+    mars_free(jobs);
+}
+
+// numbers every unchecked module reachable from mod with its wave, and
+// collects them imports first
+static u32 assign_wave(mars_module* mod, module_list* unchecked) {
+    if (mod->checked) return 0;
+    if (mod->visited) return mod->wave; // 0 if we're still inside it, an import cycle
+    mod->visited = true;
+    mod->wave = 0;
+
+    u32 wave = 1;
+    foreach (mars_module* module, mod->import_list) {
+        u32 import_wave = assign_wave(module, unchecked);
+        if (import_wave + 1 > wave) wave = import_wave + 1;
+    }
+    mod->wave = wave;
+    da_append(unchecked, mod);
+    return wave;
+}
+
+void check_module(mars_module* mod) {
+    if (typegraph.at == NULL) make_type_graph();
+
+    module_list unchecked;
+    da_init(&unchecked, 8);
+    u32 waves = assign_wave(mod, &unchecked);
+    foreach (mars_module* module, unchecked) module->visited = false;
+
+    module_list wave;
+    da_init(&wave, unchecked.len);
+    for_urange(w, 1, waves + 1) {
+        da_clear(&wave);
+        foreach (mars_module* module, unchecked) {
+            if (module->wave == w) da_append(&wave, module);
+        }
+        check_modules_at_once(&wave);
+
+        type_canonicalize_graph();
+        type_layout_graph();
+        foreach (mars_module* module, wave) module->checked = true;
+    }
+    da_destroy(&wave);
+    da_destroy(&unchecked);
 }
 
 Type* check_stmt(mars_module* mod, AST node, entity_table* scope) {
     switch (node.type) {
     case AST_func_literal_expr: {
         ast_func_literal_expr* fn = node.as_func_literal_expr;
-        string ident = fn->ident.base->start->text;
+        string ident = token_text(fn->ident.base->start);
         entity* fn_ent = search_for_entity(scope, ident);
         if (fn_ent && fn_ent->checked) {
             error_at_node(mod, fn->ident, "identifier already exists in scope");
@@ -89,11 +328,11 @@ Type* check_stmt(mars_module* mod, AST node, entity_table* scope) {
             // we have a da of lhs, we can now type check each individually
             foreach (AST lhs, node.as_decl_stmt->lhs) {
                 if (lhs.type != AST_identifier) error_at_node(mod, lhs, "expected identifier, got %s", ast_type_str[lhs.type]);
-                LOG("decl: " str_fmt "\n", str_arg(lhs.as_identifier->tok->text));
+                LOG("decl: " str_fmt "\n", str_arg(token_text(lhs.as_identifier->tok)));
 
-                if (search_for_entity(scope, lhs.as_identifier->tok->text)) error_at_node(mod, lhs, "identifier already exists in scope");
+                if (search_for_entity(scope, token_text(lhs.as_identifier->tok))) error_at_node(mod, lhs, "identifier already exists in scope");
 
-                entity* lhs_entity = new_entity(scope, lhs.as_identifier->tok->text, node);
+                entity* lhs_entity = new_entity(scope, token_text(lhs.as_identifier->tok), node);
                 if (scope == mod->entities) lhs_entity->is_global = true;
                 lhs_entity->is_mutable = node.as_decl_stmt->is_mut;
                 lhs.as_identifier->entity = lhs_entity;
@@ -113,13 +352,17 @@ Type* check_stmt(mars_module* mod, AST node, entity_table* scope) {
             if (node.as_decl_stmt->lhs.len != 1) error_at_node(mod, node, "expected 1 lhs, got %d", node.as_decl_stmt->lhs.len);
             AST lhs = node.as_decl_stmt->lhs.at[0];
             if (lhs.type != AST_identifier) error_at_node(mod, lhs, "expected identifier, got %s", ast_type_str[lhs.type]);
-            LOG("decl: " str_fmt "\n", str_arg(lhs.as_identifier->tok->text));
+            LOG("decl: " str_fmt "\n", str_arg(token_text(lhs.as_identifier->tok)));
 
-            entity* potential_entity = search_for_entity(scope, lhs.as_identifier->tok->text);
+            entity* potential_entity = search_for_entity(scope, token_text(lhs.as_identifier->tok));
 
-            if (potential_entity && potential_entity->checked == true && potential_entity->been_used == false) error_at_node(mod, lhs, "identifier already exists in scope");
+            // only a declaration in this same scope clashes, shadowing an outer one is fine.
+            // bodies don't mark globals as used, so been_used can't decide that on its own.
+            bool same_scope = potential_entity && potential_entity->top == scope;
+            if (same_scope && potential_entity->checked == true && potential_entity->been_used == false) error_at_node(mod, lhs, "identifier already exists in scope");
 
-            entity* lhs_item_entity = potential_entity ? potential_entity : new_entity(scope, lhs.as_identifier->tok->text, node);
+            // reuse the entity the surface scan made, but don't take over one from an outer scope
+            entity* lhs_item_entity = same_scope ? potential_entity : new_entity(scope, token_text(lhs.as_identifier->tok), node);
             if (scope == mod->entities) lhs_item_entity->is_global = true;
             lhs_item_entity->is_mutable = node.as_decl_stmt->is_mut;
             lhs.as_identifier->entity = lhs_item_entity;
@@ -177,19 +420,19 @@ Type* check_stmt(mars_module* mod, AST node, entity_table* scope) {
             }
             da_append(&lhs_exprs, checked_assignee);
             if (rhs.expr.type == AST_call_expr) {
-                if (!check_assign_op(node.as_assign_stmt->op, checked_assignee.type, rhs.type->as_function.returns.at[count])) error_at_node(mod, node, "cannot do operation " str_fmt " to lhs with rhs as param", str_arg(node.as_assign_stmt->op->text));
+                if (!check_assign_op(node.as_assign_stmt->op, checked_assignee.type, rhs.type->as_function.returns.at[count])) error_at_node(mod, node, "cannot do operation " str_fmt " to lhs with rhs as param", str_arg(token_text(node.as_assign_stmt->op)));
             } 
-            else if (!check_assign_op(node.as_assign_stmt->op, checked_assignee.type, rhs.type)) error_at_node(mod, node, "cannot do operation " str_fmt " to lhs with rhs as param", str_arg(node.as_assign_stmt->op->text));
+            else if (!check_assign_op(node.as_assign_stmt->op, checked_assignee.type, rhs.type)) error_at_node(mod, node, "cannot do operation " str_fmt " to lhs with rhs as param", str_arg(token_text(node.as_assign_stmt->op)));
         }
 
         if (rhs.expr.type == AST_call_expr) {
             // the rhs return info will contain a function type for us to Wiggle with
-            if (lhs_exprs.len != rhs.type->as_function.returns.len) error_at_node(mod, node, "type mismatch: function " str_fmt " returns %d values, lhs only has space for %d values", rhs.expr.as_call_expr->lhs.as_identifier->tok->text, rhs.type->as_function.returns.len, lhs_exprs.len);
+            if (lhs_exprs.len != rhs.type->as_function.returns.len) error_at_node(mod, node, "type mismatch: function " str_fmt " returns %d values, lhs only has space for %d values", token_text(rhs.expr.as_call_expr->lhs.as_identifier->tok), rhs.type->as_function.returns.len, lhs_exprs.len);
 
             foreach (checked_expr cexpr, lhs_exprs) {
                 if (!check_type_cast_implicit(cexpr.type, rhs.type->as_function.returns.at[count]))
                     error_at_node(mod, cexpr.expr, "type mismatch: return %d cannot be cast to lhs", count);
-                if (!check_assign_op(node.as_assign_stmt->op, rhs.type->as_function.returns.at[count], cexpr.type)) error_at_node(mod, node, "cannot do operation " str_fmt " to lhs with rhs as param", str_arg(node.as_assign_stmt->op->text));
+                if (!check_assign_op(node.as_assign_stmt->op, rhs.type->as_function.returns.at[count], cexpr.type)) error_at_node(mod, node, "cannot do operation " str_fmt " to lhs with rhs as param", str_arg(token_text(node.as_assign_stmt->op)));
             }
 
             return NULL;
@@ -218,7 +461,7 @@ Type* check_stmt(mars_module* mod, AST node, entity_table* scope) {
             // HACK CENTRAL HERE: we're stealing the relpath analysis from phobos here
             string importpath = search_for_module(
                 module,
-                node.as_import_stmt->path.as_identifier->tok->text
+                token_text(node.as_import_stmt->path.as_identifier->tok)
             );
 
             if (string_eq(module->module_path, importpath)) imported_module = module;
@@ -227,7 +470,7 @@ Type* check_stmt(mars_module* mod, AST node, entity_table* scope) {
         string module_name = {0};
 
         if (is_null_AST(node.as_import_stmt->name)) module_name = imported_module->module_name;
-        else module_name = node.as_import_stmt->name.as_identifier->tok->text;
+        else module_name = token_text(node.as_import_stmt->name.as_identifier->tok);
 
         entity_table* global_scope = mod->entities;
         entity* import_ent = new_entity(global_scope, module_name, node);
@@ -242,7 +485,7 @@ Type* check_stmt(mars_module* mod, AST node, entity_table* scope) {
 
         Type* type_alias = make_type(TYPE_ALIAS);
 
-        strmap_put(&name_to_type, node.as_type_decl_stmt->lhs.as_identifier->tok->text, type_alias);
+        strmap_put(&name_to_type, token_text(node.as_type_decl_stmt->lhs.as_identifier->tok), type_alias);
 
         Type* rhs = ast_to_type(mod, node.as_type_decl_stmt->rhs);
         rhs = sema_type_unalias(rhs);
@@ -277,7 +520,7 @@ Type* check_stmt(mars_module* mod, AST node, entity_table* scope) {
         //we need to create a new scope for the for in loop, since we need an entity for indexvar
         entity_table* for_scope = new_entity_table(scope);
         //we now create a new entity
-        entity* indexvar = new_entity(for_scope, node.as_for_in_stmt->indexvar.as_identifier->tok->text, node.as_for_in_stmt->indexvar);
+        entity* indexvar = new_entity(for_scope, token_text(node.as_for_in_stmt->indexvar.as_identifier->tok), node.as_for_in_stmt->indexvar);
         indexvar->is_mutable = true;
         indexvar->checked = true;
         indexvar->declaration = node.as_for_in_stmt->indexvar;
@@ -347,21 +590,22 @@ checked_expr check_expr(mars_module* mod, AST node, entity_table* scope) {
         return (checked_expr){.expr = node, .type = ret_type};
     }
     case AST_identifier: {
-        entity* ident_ent = search_for_entity(scope, node.as_identifier->tok->text);
+        entity* ident_ent = search_for_entity(scope, token_text(node.as_identifier->tok));
 
         if (ident_ent == NULL) {
             // we need to see if this is a type identifier!
-            Type* type_ptr = strmap_get(&name_to_type, node.as_identifier->tok->text);
+            Type* type_ptr = type_named(token_text(node.as_identifier->tok));
             if (type_ptr != STRMAP_NOT_FOUND) {
                 return (checked_expr){.expr = node, .type = type_unalias(type_ptr)};
             }
-            error_at_node(mod, node, "undefined identifier: " str_fmt, str_arg(node.as_identifier->tok->text));
+            error_at_node(mod, node, "undefined identifier: " str_fmt, str_arg(token_text(node.as_identifier->tok)));
         }
         if (ident_ent->checked == false) {
-            LOG("ident "str_fmt" was only surface checked, stmt checking ast %s\n", str_arg(node.as_identifier->tok->text), ast_type_str[ident_ent->declaration.type]); 
+            LOG("ident "str_fmt" was only surface checked, stmt checking ast %s\n", str_arg(token_text(node.as_identifier->tok)), ast_type_str[ident_ent->declaration.type]); 
             check_stmt(mod, ident_ent->declaration, mod->entities);
         }
-        ident_ent->been_used = true;
+        // bodies can be checked in parallel, so they leave the module's globals alone
+        if (scope == mod->entities || ident_ent->top != mod->entities) ident_ent->been_used = true;
         node.as_identifier->entity = ident_ent;
 
         node.base->T = ident_ent->entity_type;
@@ -377,7 +621,7 @@ checked_expr check_expr(mars_module* mod, AST node, entity_table* scope) {
 
     case AST_unary_op_expr: {
         checked_expr subexpr = check_expr(mod, node.as_unary_op_expr->inside, scope);
-        LOG("verifying op: " str_fmt "\n", str_arg(node.as_unary_op_expr->op->text));
+        LOG("verifying op: " str_fmt "\n", str_arg(token_text(node.as_unary_op_expr->op)));
         subexpr.type = type_unalias(subexpr.type);
 
         switch (node.as_unary_op_expr->op->type) {
@@ -397,9 +641,7 @@ checked_expr check_expr(mars_module* mod, AST node, entity_table* scope) {
             return (checked_expr){.expr = node, .type = make_type(TYPE_UNTYPED_INT)};
         case TOK_AND: {
             //we need to create a "wrapped" type around THE type we received from the subexpr
-            Type* ptr_type = make_type(TYPE_POINTER);
-            ptr_type->as_reference.subtype = subexpr.type;
-            ptr_type->as_reference.mutable = false;
+            Type* ptr_type = type_make_pointer(subexpr.type, false);
             return (checked_expr){.expr = node, .type = ptr_type, .mutable = false};
         }
         case TOK_SUB: {
@@ -409,7 +651,7 @@ checked_expr check_expr(mars_module* mod, AST node, entity_table* scope) {
 
 
         default:
-            error_at_node(mod, node, "unexpected op: " str_fmt, str_arg(node.as_unary_op_expr->op->text));
+            error_at_node(mod, node, "unexpected op: " str_fmt, str_arg(token_text(node.as_unary_op_expr->op)));
         }
     }
 
@@ -445,23 +687,21 @@ checked_expr check_expr(mars_module* mod, AST node, entity_table* scope) {
                 if (node.as_selector_expr->lhs.type != AST_identifier) crash("LHS of selector expr was not identifier, parser has broken!");
 
                 foreach (TypeStructField field, lhs.type->as_aggregate.fields) {
-                    if (string_eq(field.name, node.as_selector_expr->rhs.as_identifier->tok->text)) field_type = field.subtype;
+                    if (string_eq(field.name, token_text(node.as_selector_expr->rhs.as_identifier->tok))) field_type = field.subtype;
                 }
                 if (lhs.type->tag == TYPE_SLICE) {
                     // we need to see if its len or raw, and if so we can check it correctly.
-                    if (string_eq(constr("len"), node.as_selector_expr->rhs.as_identifier->tok->text)) field_type = make_type(TYPE_U64);
-                    else if (string_eq(constr("raw"), node.as_selector_expr->rhs.as_identifier->tok->text)) {
-                        field_type = make_type(TYPE_POINTER);
-                        field_type->as_reference.mutable = lhs.type->as_reference.mutable;
-                        field_type->as_reference.subtype = lhs.type->as_reference.subtype;
+                    if (string_eq(constr("len"), token_text(node.as_selector_expr->rhs.as_identifier->tok))) field_type = make_type(TYPE_U64);
+                    else if (string_eq(constr("raw"), token_text(node.as_selector_expr->rhs.as_identifier->tok))) {
+                        field_type = type_make_pointer(lhs.type->as_reference.subtype, lhs.type->as_reference.mutable);
                     }
                 }
 
-                if (!field_type) error_at_node(mod, node.as_selector_expr->rhs, "field " str_fmt " is not a field contained in this struct", str_arg(node.as_selector_expr->rhs.as_identifier->tok->text));
+                if (!field_type) error_at_node(mod, node.as_selector_expr->rhs, "field " str_fmt " is not a field contained in this struct", str_arg(token_text(node.as_selector_expr->rhs.as_identifier->tok)));
                 // we can return raw or len here
                 node.base->T = field_type;
                 // get lhs entity
-                entity* lhs_ent = search_for_entity(scope, lhs.expr.as_identifier->tok->text);
+                entity* lhs_ent = search_for_entity(scope, token_text(lhs.expr.as_identifier->tok));
                 u8 mutability = lhs_ent->is_mutable;
                 return (checked_expr){.expr = node, .type = field_type, .mutable = mutability};
             }
@@ -473,17 +713,17 @@ checked_expr check_expr(mars_module* mod, AST node, entity_table* scope) {
             mars_module* selected_mod = NULL;
             foreach (entity* ent, *mod->entities) {
                 // we search the global scope looking for our special little scrunkly
-                if (ent->is_module == true && string_eq(lhs.as_identifier->tok->text, ent->identifier)) selected_mod = ent->module;
+                if (ent->is_module == true && string_eq(token_text(lhs.as_identifier->tok), ent->identifier)) selected_mod = ent->module;
             }
-            if (selected_mod == NULL) error_at_node(mod, lhs, "unknown module: " str_fmt, str_arg(lhs.as_identifier->tok->text));
+            if (selected_mod == NULL) error_at_node(mod, lhs, "unknown module: " str_fmt, str_arg(token_text(lhs.as_identifier->tok)));
             // we now have our module, does the thing we're trying to do stuff with exist?
 
             entity* selected_entity = NULL;
-            string rhs_identifier = node.as_selector_expr->rhs.as_identifier->tok->text;
+            string rhs_identifier = token_text(node.as_selector_expr->rhs.as_identifier->tok);
             foreach (entity* ent, *selected_mod->entities) {
                 if (string_eq(ent->identifier, rhs_identifier)) selected_entity = ent;
             }
-            if (!selected_entity) error_at_node(mod, node, "unknown object: " str_fmt "::" str_fmt, str_arg(lhs.as_identifier->tok->text), str_arg(rhs_identifier));
+            if (!selected_entity) error_at_node(mod, node, "unknown object: " str_fmt "::" str_fmt, str_arg(token_text(lhs.as_identifier->tok)), str_arg(rhs_identifier));
             return (checked_expr){.expr = node, .type = selected_entity->entity_type};
         }
         error_at_node(mod, node, "unhandled op: %s", token_type_str[node.as_selector_expr->op->type]);
@@ -508,7 +748,7 @@ checked_expr check_expr(mars_module* mod, AST node, entity_table* scope) {
         lhs.type = type_unalias(lhs.type);
         if (!is_integral(inside.type)) error_at_node(mod, node.as_index_expr->inside, "inside of array index is not an integral type");
         //we now need to grab the lhs's type and verify its an array or pointer or slice
-        if (lhs.type->tag != TYPE_ARRAY && lhs.type->tag != TYPE_SLICE) error_at_node(mod, node.as_index_expr->lhs, "identifier "str_fmt" is not an array or slice", str_arg(lhs.expr.as_identifier->tok->text));
+        if (lhs.type->tag != TYPE_ARRAY && lhs.type->tag != TYPE_SLICE) error_at_node(mod, node.as_index_expr->lhs, "identifier "str_fmt" is not an array or slice", str_arg(token_text(lhs.expr.as_identifier->tok)));
         if (inside.ev) warning_at_node(mod, node.as_index_expr->inside, "inside is not checked for constexpr bounds yet");
         //SUBTYPE IS NULL!
         return (checked_expr){.expr = node, .type = lhs.type->as_reference.subtype};
@@ -520,14 +760,13 @@ checked_expr check_expr(mars_module* mod, AST node, entity_table* scope) {
         checked_expr inside_right = check_expr(mod, node.as_slice_expr->inside_right, scope);
 
         lhs.type = type_unalias(lhs.type);
-        if (lhs.type->tag != TYPE_ARRAY && lhs.type->tag != TYPE_SLICE) error_at_node(mod, node.as_slice_expr->lhs, "identifier "str_fmt" is not an array or slice", str_arg(node.as_slice_expr->lhs.as_identifier->tok->text));
+        if (lhs.type->tag != TYPE_ARRAY && lhs.type->tag != TYPE_SLICE) error_at_node(mod, node.as_slice_expr->lhs, "identifier "str_fmt" is not an array or slice", str_arg(token_text(node.as_slice_expr->lhs.as_identifier->tok)));
 
         //we now know lhs is a slicable type OR an array
         warning_at_node(mod, node, "bounds checking not yet implemented! be careful not to break anything!");
 
         //we now make a slice type
-        Type* slice_type = make_type(TYPE_SLICE);
-        slice_type->as_reference.subtype = lhs.type->as_reference.subtype;
+        Type* slice_type = type_make_slice(lhs.type->as_reference.subtype, false);
 
         return (checked_expr) {.expr = node, .type = slice_type};
     }
@@ -540,46 +779,42 @@ checked_expr check_expr(mars_module* mod, AST node, entity_table* scope) {
 }
 
 checked_expr check_literal(mars_module* mod, AST literal) {
-    exact_value* ev = alloc_exact_value(0, &mod->AST_alloca);
+    exact_value* ev = alloc_exact_value(0, value_arena != NULL ? value_arena : &mod->AST_alloca);
     switch (literal.as_literal_expr->tok->type) {
     case TOK_LITERAL_NULL:
         ev->as_pointer = 0;
         ev->kind = EV_POINTER;
-        Type* pointer = make_type(TYPE_POINTER);
-        pointer->as_reference.subtype = make_type(TYPE_NONE);
-        pointer->as_reference.mutable = true;
+        Type* pointer = type_make_pointer(make_type(TYPE_NONE), true);
         literal.base->T = pointer;
         return (checked_expr){.expr = literal, .ev = ev, .type = pointer};
     case TOK_LITERAL_INT:
-        ev->as_untyped_int = string_strtol(literal.as_literal_expr->tok->text, 10);
+        ev->as_untyped_int = string_strtol(token_text(literal.as_literal_expr->tok), 10);
         ev->kind = EV_UNTYPED_INT;
         literal.base->T = make_type(TYPE_UNTYPED_INT);
         return (checked_expr){.expr = literal, .ev = ev, .type = literal.base->T};
     case TOK_LITERAL_BOOL:
-        ev->as_bool = string_cmp(constr("true"), literal.as_literal_expr->tok->text) != 0 ? 1 : 0;
+        ev->as_bool = string_cmp(constr("true"), token_text(literal.as_literal_expr->tok)) != 0 ? 1 : 0;
         ev->kind = EV_BOOL;
         literal.base->T = make_type(TYPE_BOOL);
         return (checked_expr){.expr = literal, .ev = ev, .type = literal.base->T};
     case TOK_LITERAL_FLOAT:
-        ev->as_untyped_float = string_strtof(literal.as_literal_expr->tok->text);
+        ev->as_untyped_float = string_strtof(token_text(literal.as_literal_expr->tok));
         ev->kind = EV_UNTYPED_FLOAT;
         literal.base->T = make_type(TYPE_UNTYPED_FLOAT);
         return (checked_expr){.expr = literal, .ev = ev, .type = literal.base->T};
     case TOK_LITERAL_CHAR:
-        ev->as_u8 = literal.as_literal_expr->tok->text.raw[0];
+        ev->as_u8 = token_text(literal.as_literal_expr->tok).raw[0];
         ev->kind = EV_U8;
         literal.base->T = make_type(TYPE_U8);
         return (checked_expr){.expr = literal, .ev = ev, .type = literal.base->T};
     case TOK_LITERAL_STRING:
-        ev->as_string = literal.as_literal_expr->tok->text;
+        ev->as_string = token_text(literal.as_literal_expr->tok);
         ev->kind = EV_STRING;
         //string literal's type is []let u8
-        literal.base->T = make_type(TYPE_SLICE);
-        literal.base->T->as_reference.subtype = make_type(TYPE_U8);
-        literal.base->T->as_reference.mutable = false;
+        literal.base->T = type_make_slice(make_type(TYPE_U8), false);
         return (checked_expr){.expr = literal, .ev = ev, .type = literal.base->T};
     default:
-        error_at_node(mod, literal, "[INTERNAL COMPILER ERROR] unable to check literal " str_fmt " with type %s", str_arg(literal.as_literal_expr->tok->text), token_type_str[literal.as_literal_expr->tok->type]);
+        error_at_node(mod, literal, "[INTERNAL COMPILER ERROR] unable to check literal " str_fmt " with type %s", str_arg(token_text(literal.as_literal_expr->tok)), token_type_str[literal.as_literal_expr->tok->type]);
     }
     return (checked_expr){0};
 }
@@ -592,7 +827,11 @@ Type* check_func_literal(mars_module* mod, AST func_literal, entity_table* scope
 
     entity_table* func_scope = new_entity_table(scope);
 
-    Type* fn_type = make_type(TYPE_FUNCTION);
+    // the function type is built once its parts are known, so it can be hash-consed
+    da(TypePTR) param_types;
+    da(TypePTR) return_types;
+    da_init(&param_types, 4);
+    da_init(&return_types, 1);
 
     int invalid_count = 0;
     foreach (AST_typed_field param, func_literal.as_func_literal_expr->type.as_fn_type_expr->parameters) {
@@ -628,20 +867,20 @@ Type* check_func_literal(mars_module* mod, AST func_literal, entity_table* scope
     // now we create the entities inside the scope, and error if there is a duplicate
     foreach (AST_typed_field param, func_literal.as_func_literal_expr->type.as_fn_type_expr->parameters) {
         // this WILL be bad for perf.
-        entity* test_ent = search_for_entity(func_scope, param.field.as_identifier->tok->text);
+        entity* test_ent = search_for_entity(func_scope, token_text(param.field.as_identifier->tok));
         if (test_ent != NULL) {
-            error_at_node(mod, test_ent->declaration, "identifier " str_fmt " already defined here", str_arg(param.field.as_identifier->tok->text));
+            error_at_node(mod, test_ent->declaration, "identifier " str_fmt " already defined here", str_arg(token_text(param.field.as_identifier->tok)));
         }
 
         Type* param_type = ast_to_type(mod, param.type);
-        entity* param_entity = new_entity(func_scope, param.field.as_identifier->tok->text, param.field);
+        entity* param_entity = new_entity(func_scope, token_text(param.field.as_identifier->tok), param.field);
         param.field.as_identifier->entity = param_entity;
         param_entity->is_mutable = true;
         param_entity->is_param = true;
         param_entity->entity_type = param_type;
         param_entity->param_idx = count;
         param_entity->checked = true;
-        type_add_param(fn_type, param_type);
+        da_append(&param_types, param_type);
 
         // (sandwich): add the entities to the function definition
         func_literal.as_func_literal_expr->params[count] = param_entity;
@@ -653,16 +892,16 @@ Type* check_func_literal(mars_module* mod, AST func_literal, entity_table* scope
 
     foreach (AST_typed_field returns, func_literal.as_func_literal_expr->type.as_fn_type_expr->returns) {
         // this WILL be bad for perf.
-        entity* test_ent = search_for_entity(func_scope, returns.field.as_identifier->tok->text);
+        entity* test_ent = search_for_entity(func_scope, token_text(returns.field.as_identifier->tok));
         if (test_ent != NULL) {
-            error_at_node(mod, test_ent->declaration, "identifier " str_fmt " already defined here", str_arg(returns.field.as_identifier->tok->text));
+            error_at_node(mod, test_ent->declaration, "identifier " str_fmt " already defined here", str_arg(token_text(returns.field.as_identifier->tok)));
         }
 
         Type* return_type = ast_to_type(mod, returns.type);
 
         //not all returns have identifiers attached to them, e.g fn a(...) -> T {}
         if (returns.field.type == AST_identifier) {
-            entity* return_entity = new_entity(func_scope, returns.field.as_identifier->tok->text, returns.field);
+            entity* return_entity = new_entity(func_scope, token_text(returns.field.as_identifier->tok), returns.field);
             returns.field.as_identifier->entity = return_entity;
             return_entity->is_mutable = true;
             return_entity->is_return = true;
@@ -682,22 +921,21 @@ Type* check_func_literal(mars_module* mod, AST func_literal, entity_table* scope
             func_literal.as_func_literal_expr->returns[count] = return_entity;    
         
         }
-        type_add_return(fn_type, return_type);
+        da_append(&return_types, return_type);
 
     }
+    Type* fn_type = type_make_function(param_types, return_types);
     // type_canonicalize_graph();
-    // the func literal has been parsed, now we continue down
-    foreach (AST stmt, func_literal.as_func_literal_expr->code_block.as_stmt_block->stmts) {
-        check_stmt(mod, stmt, func_scope);
+    // a cached module checked clean last time, and nobody lowers its bodies,
+    // so the signature is all anyone needs from it
+    if (mod->cached) return fn_type;
+
+    // bodies of functions at the top level wait until the rest of it is checked
+    if (scope == mod->entities) {
+        da_append(&deferred_bodies, ((deferred_body){func_literal, func_scope}));
+        return fn_type;
     }
-
-    // now, we look through the scope, seeing if a param or a return has been used!
-    foreach (entity* ent, *func_scope) {
-        if (ent->declaration.type != AST_identifier) continue;
-        if (ent->is_param && !ent->been_used) warning_at_node(mod, ent->declaration, "unused param: " str_fmt, str_arg(ent->identifier));
-        else if (ent->is_return && !ent->been_used) warning_at_node(mod, ent->declaration, "unused return: " str_fmt, str_arg(ent->identifier));
-    }
-
+    check_func_body(mod, func_literal, func_scope);
     return fn_type;
 }
 
@@ -747,25 +985,21 @@ Type* ast_to_type(mars_module* mod, AST node) {
         default: error_at_node(mod, node, "[INTERNAL COMPILER ERROR] unknown token type \"%s\" found when converting AST_basic_type_expr to integral type", token_type_str[node.as_basic_type_expr->lit->type]);
         }
     case AST_pointer_type_expr: {
-        Type* pointer = make_type(TYPE_POINTER);
-        pointer->as_reference.mutable = node.as_pointer_type_expr->mutable;
-        if (is_null_AST(node.as_pointer_type_expr->subexpr)) pointer->as_reference.subtype = make_type(TYPE_NONE);
-        else pointer->as_reference.subtype = ast_to_type(mod, node.as_pointer_type_expr->subexpr);
-        return pointer;
+        Type* subtype = make_type(TYPE_NONE);
+        if (!is_null_AST(node.as_pointer_type_expr->subexpr)) subtype = ast_to_type(mod, node.as_pointer_type_expr->subexpr);
+        return type_make_pointer(subtype, node.as_pointer_type_expr->mutable);
     }
     case AST_slice_type_expr: {
-        Type* slice = make_type(TYPE_SLICE);
-        slice->as_reference.mutable = node.as_slice_type_expr->mutable;
-        if (is_null_AST(node.as_slice_type_expr->subexpr)) slice->as_reference.subtype = make_type(TYPE_NONE);
-        else slice->as_reference.subtype = ast_to_type(mod, node.as_slice_type_expr->subexpr);
-        return slice;
+        Type* subtype = make_type(TYPE_NONE);
+        if (!is_null_AST(node.as_slice_type_expr->subexpr)) subtype = ast_to_type(mod, node.as_slice_type_expr->subexpr);
+        return type_make_slice(subtype, node.as_slice_type_expr->mutable);
     }
     case AST_struct_type_expr: {
         // we create the type, and add it to the strmap.
         Type* aggregate = make_type((node.as_struct_type_expr->is_union == true) ? TYPE_UNION : TYPE_STRUCT);
 
         foreach (AST_typed_field field, node.as_struct_type_expr->fields) {
-            type_add_field(aggregate, field.field.as_identifier->tok->text, ast_to_type(mod, field.type));
+            type_add_field(aggregate, token_text(field.field.as_identifier->tok), ast_to_type(mod, field.type));
         }
         return aggregate;
     }
@@ -775,8 +1009,8 @@ Type* ast_to_type(mars_module* mod, AST node) {
         return distinct;
     }
     case AST_identifier: {
-        Type* T = strmap_get(&name_to_type, node.as_identifier->tok->text);
-        if (T == STRMAP_NOT_FOUND) error_at_node(mod, node, "Unknown type " str_fmt "\n", str_arg(node.as_identifier->tok->text));
+        Type* T = type_named(token_text(node.as_identifier->tok));
+        if (T == STRMAP_NOT_FOUND) error_at_node(mod, node, "Unknown type " str_fmt "\n", str_arg(token_text(node.as_identifier->tok)));
         return T;
     }
     default:
@@ -811,7 +1045,7 @@ Type* operation_to_type(token* tok) {
     case TOK_GREATER_THAN:
     case TOK_GREATER_EQUAL: return make_type(TYPE_BOOL);
     default:
-        general_error("[INTERNAL COMPILER ERROR] unknown token %s found when converting operation " str_fmt " to type", token_type_str[tok->type], str_arg(tok->text));
+        general_error("[INTERNAL COMPILER ERROR] unknown token %s found when converting operation " str_fmt " to type", token_type_str[tok->type], str_arg(token_text(tok)));
     }
     return NULL;
 }
@@ -16,7 +16,7 @@
         string ast_str = str_from_tokens(*((node).base->start), *((node).base->end));                  \
         mars_file* source_file = find_source_file((module), ast_str);                                  \
         if (source_file == NULL) CRASH("source file not found for AST node");                          \
-        error_at_string(source_file->path, source_file->src, ast_str, msg __VA_OPT__(, ) __VA_ARGS__); \
+        error_at_string(source_file->path, source_file->src, &source_file->lines, ast_str, msg __VA_OPT__(, ) __VA_ARGS__); \
     } while (0)
 
 // emit a warning that highlights an AST node
@@ -25,7 +25,7 @@
         string ast_str = str_from_tokens(*((node).base->start), *((node).base->end));                    \
         mars_file* source_file = find_source_file((module), ast_str);                                    \
         if (source_file == NULL) CRASH("source file not found for AST node");                            \
-        warning_at_string(source_file->path, source_file->src, ast_str, msg __VA_OPT__(, ) __VA_ARGS__); \
+        warning_at_string(source_file->path, source_file->src, &source_file->lines, ast_str, msg __VA_OPT__(, ) __VA_ARGS__); \
     } while (0)
 
 typedef struct checked_expr {
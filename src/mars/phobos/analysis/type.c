@@ -1,8 +1,12 @@
 #include "type.h"
+#include "mars/mars.h"
+#include "common/ptrmap.h"
 
 // type engine
 
-TypeGraph typegraph;
+// while a wave of modules is checked in parallel, every worker thread has its
+// own graph to add types to, see type_partition_begin()
+_Thread_local TypeGraph typegraph;
 
 // #define LOG(...) printf(__VA_ARGS__)
 #define LOG(...)
@@ -14,12 +18,36 @@ typedef struct {
 
 da_typedef(type_pair);
 
-// align a number (n) up to a power of two (align)
+// align a number (n) up to a power of two (align). 0 doesn't align at all
 static u64 forceinline align_forward(u64 n, u64 align) {
+    if (align == 0) return n;
     return (n + align - 1) & ~(align - 1);
 }
 
+// hash-consing table for pointers, slices, arrays and functions.
+// the canonicalizer swaps children out from under it and turns merged types
+// into aliases, so it gets rebuilt after every canonicalization
+typedef struct {
+    Type** at;
+    u32 cap;
+    u32 len;
+} InternTable;
+
+static _Thread_local InternTable interned;
+
+// the graph everything gets merged into, and its table. workers only ever
+// read these while they fill in their own partitions
+static TypeGraph* shared_graph;
+static InternTable* shared_interned;
+
+static void intern_rebuild(u32 cap);
+
+// graph size after the last canonicalization. the checker only ever fills in
+// types it just made, so if nothing was added there's nothing new to merge
+static _Thread_local size_t canonical_len = 0;
+
 void type_canonicalize_graph() {
+    if (typegraph.len == canonical_len) return;
 
     LOG("preliminary normalization\n");
 
@@ -63,10 +91,12 @@ void type_canonicalize_graph() {
             if (typegraph.at[i]->tag == TYPE_ALIAS) continue;
             if (typegraph.at[i]->tag == TYPE_DISTINCT) continue;
             if (typegraph.at[i]->moved) continue;
+            bool i_hashed = typegraph.at[i]->hashed;
             for_urange(j, i + 1, typegraph.len) {
                 if (typegraph.at[j]->tag == TYPE_ALIAS) continue;
                 if (typegraph.at[j]->tag == TYPE_DISTINCT) continue;
                 if (typegraph.at[j]->moved) continue;
+                if (i_hashed && typegraph.at[j]->hashed) continue;
                 // if (!(typegraph.at[i]->dirty || typegraph.at[j]->dirty)) continue;
                 bool executed_TSA = false;
                 LOG("are %d and %d equivalent?\n", i, j);
@@ -122,11 +152,32 @@ void type_canonicalize_graph() {
 
                 t->tag = TYPE_ALIAS;
                 t->as_reference.subtype = dest;
+                t->size = UINT32_MAX;
+                t->align = UINT32_MAX;
             }
         }
     }
 
     da_destroy(&equalities);
+    canonical_len = typegraph.len;
+    if (interned.cap != 0) intern_rebuild(interned.cap);
+}
+
+// numbers handed out by type_locally_number(), one set for each side of a
+// comparison. they're kept off to the side instead of on the types, so
+// workers checking different modules can number types they both refer to
+typedef struct {
+    PtrMap nums;       // Type* -> number
+    da(TypePTR) order; // order.at[n - 1] was numbered n
+} TypeNumbering;
+
+static _Thread_local TypeNumbering numberings[2];
+
+// 0 if t hasn't been numbered
+static u16 type_num(Type* t, int num_set) {
+    if (numberings[num_set].order.len == 0) return 0;
+    void* num = ptrmap_get(&numberings[num_set].nums, t);
+    return num == PTRMAP_NOT_FOUND ? 0 : (u16)(u64)num;
 }
 
 bool type_equivalent(Type* a, Type* b, bool* executed_TSA) {
@@ -138,6 +189,7 @@ bool type_equivalent(Type* a, Type* b, bool* executed_TSA) {
     if (a == b) return true;
     if (a->tag != b->tag) return false;
     if (a->tag < TYPE_META_INTEGRAL) return true;
+    if (a->hashed && b->hashed) return false; // would've been the same type
 
     // a little more complex
     switch (a->tag) {
@@ -234,7 +286,7 @@ bool type_element_equivalent(Type* a, Type* b, int num_set_a, int num_set_b) {
     case TYPE_F32:
     case TYPE_F64:
         return true;
-        // if (a->type_nums[num_set_a] == b->type_nums[num_set_b]) return true;
+        // if (type_num(a, num_set_a) == type_num(b, num_set_b)) return true;
         break;
 
     case TYPE_ALIAS:
@@ -268,7 +320,7 @@ bool type_element_equivalent(Type* a, Type* b, int num_set_a, int num_set_b) {
             if (!string_eq(type_get_field(a, i)->name, type_get_field(b, i)->name)) {
                 return false;
             }
-            if (type_get_field(a, i)->subtype->type_nums[num_set_a] != type_get_field(b, i)->subtype->type_nums[num_set_b]) {
+            if (type_num(type_get_field(a, i)->subtype, num_set_a) != type_num(type_get_field(b, i)->subtype, num_set_b)) {
                 return false;
             }
         }
@@ -281,12 +333,12 @@ bool type_element_equivalent(Type* a, Type* b, int num_set_a, int num_set_b) {
             return false;
         }
         for_urange(i, 0, a->as_function.params.len) {
-            if (a->as_function.params.at[i]->type_nums[num_set_a] != b->as_function.params.at[i]->type_nums[num_set_b]) {
+            if (type_num(a->as_function.params.at[i], num_set_a) != type_num(b->as_function.params.at[i], num_set_b)) {
                 return false;
             }
         }
         for_urange(i, 0, a->as_function.returns.len) {
-            if (a->as_function.returns.at[i]->type_nums[num_set_a] != b->as_function.returns.at[i]->type_nums[num_set_b]) {
+            if (type_num(a->as_function.returns.at[i], num_set_a) != type_num(b->as_function.returns.at[i], num_set_b)) {
                 return false;
             }
         }
@@ -295,14 +347,14 @@ bool type_element_equivalent(Type* a, Type* b, int num_set_a, int num_set_b) {
         if (a->as_array.len != b->as_array.len) {
             return false;
         }
-        if (a->as_array.subtype->type_nums[num_set_a] != b->as_array.subtype->type_nums[num_set_b]) {
+        if (type_num(a->as_array.subtype, num_set_a) != type_num(b->as_array.subtype, num_set_b)) {
             return false;
         }
         break;
     case TYPE_POINTER:
     case TYPE_SLICE:
         if (a->as_reference.mutable != b->as_reference.mutable) return false;
-        if (type_get_target(a)->type_nums[num_set_a] != type_get_target(b)->type_nums[num_set_b]) {
+        if (type_num(type_get_target(a), num_set_a) != type_num(type_get_target(b), num_set_b)) {
             return false;
         }
         break;
@@ -375,9 +427,10 @@ void merge_type_references(Type* dest, Type* src, bool disable) {
 
 void type_locally_number(Type* t, u64* number, int num_set) {
     t = type_unalias(t);
-    if (t->type_nums[num_set] != 0) return;
+    if (type_num(t, num_set) != 0) return;
 
-    t->type_nums[num_set] = (*number)++;
+    ptrmap_put(&numberings[num_set].nums, t, (void*)(*number)++);
+    da_append(&numberings[num_set].order, t);
 
     switch (t->tag) {
     case TYPE_STRUCT:
@@ -409,16 +462,20 @@ void type_locally_number(Type* t, u64* number, int num_set) {
 }
 
 void type_reset_numbers(int num_set) {
-    for_urange(i, 0, typegraph.len) {
-        typegraph.at[i]->type_nums[num_set] = 0;
+    TypeNumbering* n = &numberings[num_set];
+    if (n->order.at == NULL) {
+        ptrmap_init(&n->nums, 64);
+        da_init(&n->order, 64);
+        return;
     }
+    if (n->order.len == 0) return;
+    ptrmap_reset(&n->nums);
+    da_clear(&n->order);
 }
 
 Type* type_get_from_num(u16 num, int num_set) {
-    for_urange(i, 0, typegraph.len) {
-        if (typegraph.at[i]->type_nums[num_set] == num) return typegraph.at[i];
-    }
-    return NULL;
+    if (num == 0 || num > numberings[num_set].order.len) return NULL;
+    return numberings[num_set].order.at[num - 1];
 }
 
 Type* make_type(u8 tag) {
@@ -460,10 +517,250 @@ Type* make_type(u8 tag) {
 void make_type_graph() {
     typegraph = (TypeGraph){0};
     da_init(&typegraph, 3);
+    shared_graph = &typegraph;
+    shared_interned = &interned;
 
     for_range(i, 0, TYPE_META_INTEGRAL) {
-        make_type(i);
+        make_type(i)->hashed = true; // there's only ever one of each
+    }
+}
+
+static u64 mix(u64 h, u64 x) {
+    h ^= x;
+    h *= 0x100000001b3ull;
+    return h ^ (h >> 29);
+}
+
+static u64 hash_type(Type* t) {
+    u64 h = mix(0xcbf29ce484222325ull, t->tag);
+    switch (t->tag) {
+    case TYPE_POINTER:
+    case TYPE_SLICE:
+        h = mix(h, t->as_reference.mutable);
+        h = mix(h, (u64)t->as_reference.subtype);
+        break;
+    case TYPE_ARRAY:
+        h = mix(h, t->as_array.len);
+        h = mix(h, (u64)t->as_array.subtype);
+        break;
+    case TYPE_FUNCTION:
+        h = mix(h, t->as_function.params.len);
+        for_urange(i, 0, t->as_function.params.len) h = mix(h, (u64)t->as_function.params.at[i]);
+        h = mix(h, t->as_function.returns.len);
+        for_urange(i, 0, t->as_function.returns.len) h = mix(h, (u64)t->as_function.returns.at[i]);
+        break;
+    default: break;
+    }
+    return h;
+}
+
+static bool same_shape(Type* a, Type* b) {
+    if (a->tag != b->tag) return false;
+    switch (a->tag) {
+    case TYPE_POINTER:
+    case TYPE_SLICE:
+        return a->as_reference.mutable == b->as_reference.mutable && a->as_reference.subtype == b->as_reference.subtype;
+    case TYPE_ARRAY:
+        return a->as_array.len == b->as_array.len && a->as_array.subtype == b->as_array.subtype;
+    case TYPE_FUNCTION:
+        if (a->as_function.params.len != b->as_function.params.len) return false;
+        if (a->as_function.returns.len != b->as_function.returns.len) return false;
+        for_urange(i, 0, a->as_function.params.len) {
+            if (a->as_function.params.at[i] != b->as_function.params.at[i]) return false;
+        }
+        for_urange(i, 0, a->as_function.returns.len) {
+            if (a->as_function.returns.at[i] != b->as_function.returns.at[i]) return false;
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void intern_insert(Type* t) {
+    u32 slot = hash_type(t) & (interned.cap - 1);
+    while (interned.at[slot] != NULL) slot = (slot + 1) & (interned.cap - 1);
+    interned.at[slot] = t;
+    interned.len++;
+}
+
+static void intern_rebuild(u32 cap) {
+    Type** old = interned.at;
+    u32 old_cap = interned.cap;
+    interned.cap = cap;
+    interned.at = mars_alloc(sizeof(Type*) * interned.cap);
+    memset(interned.at, 0, sizeof(Type*) * interned.cap);
+    interned.len = 0;
+    for_urange(i, 0, old_cap) {
+        if (old[i] != NULL && old[i]->tag != TYPE_ALIAS) intern_insert(old[i]);
     }
+    if (old != NULL) mars_free(old);
+}
+
+static void intern_grow() {
+    intern_rebuild(interned.cap == 0 ? 256 : interned.cap * 2);
+}
+
+static Type* intern_find_in(InternTable* table, Type* key) {
+    if (table->cap == 0) return NULL;
+    u32 slot = hash_type(key) & (table->cap - 1);
+    while (table->at[slot] != NULL) {
+        if (same_shape(table->at[slot], key)) return table->at[slot];
+        slot = (slot + 1) & (table->cap - 1);
+    }
+    return NULL;
+}
+
+// the type shaped like key, or NULL. a worker looks in the shared graph too,
+// so it never makes its own copy of a type an earlier wave already has
+static Type* intern_find(Type* key) {
+    Type* found = intern_find_in(&interned, key);
+    if (found == NULL && shared_interned != &interned) found = intern_find_in(shared_interned, key);
+    return found;
+}
+
+// the type shaped like key, made if there isn't one yet. sharing by child
+// identity is always safe, but only types made entirely of hashed types are
+// marked hashed themselves
+static Type* intern(Type* key, bool children_hashed) {
+    Type* existing = intern_find(key);
+    if (existing != NULL) return existing;
+
+    Type* t = make_type(key->tag);
+    switch (key->tag) {
+    case TYPE_FUNCTION:
+        da_destroy(&t->as_function.params);
+        da_destroy(&t->as_function.returns);
+        t->as_function = key->as_function;
+        break;
+    case TYPE_ARRAY:
+        t->as_array = key->as_array;
+        break;
+    default:
+        t->as_reference = key->as_reference;
+        break;
+    }
+    t->hashed = children_hashed;
+    if ((interned.len + 1) * 2 > interned.cap) intern_grow();
+    intern_insert(t);
+    return t;
+}
+
+// aliases that already point somewhere are looked through, so ^A and ^T
+// come out as the same type. the canonicalizer would retarget them anyway
+static Type* resolve_child(Type* t) {
+    Type* target = t;
+    while (target->tag == TYPE_ALIAS) {
+        if (target->as_reference.subtype == NULL) return t; // still being declared
+        target = target->as_reference.subtype;
+    }
+    return target;
+}
+
+Type* type_make_pointer(Type* sub, bool mutable) {
+    if (typegraph.at == NULL) make_type_graph();
+    Type key = {.tag = TYPE_POINTER};
+    key.as_reference.subtype = resolve_child(sub);
+    key.as_reference.mutable = mutable;
+    return intern(&key, key.as_reference.subtype->hashed);
+}
+
+Type* type_make_slice(Type* sub, bool mutable) {
+    if (typegraph.at == NULL) make_type_graph();
+    Type key = {.tag = TYPE_SLICE};
+    key.as_reference.subtype = resolve_child(sub);
+    key.as_reference.mutable = mutable;
+    return intern(&key, key.as_reference.subtype->hashed);
+}
+
+Type* type_make_array(Type* sub, u64 len) {
+    if (typegraph.at == NULL) make_type_graph();
+    Type key = {.tag = TYPE_ARRAY};
+    key.as_array.subtype = resolve_child(sub);
+    key.as_array.len = len;
+    return intern(&key, key.as_array.subtype->hashed);
+}
+
+Type* type_make_function(da(TypePTR) params, da(TypePTR) returns) {
+    if (typegraph.at == NULL) make_type_graph();
+    bool children_hashed = true;
+    for_urange(i, 0, params.len) {
+        params.at[i] = resolve_child(params.at[i]);
+        children_hashed &= params.at[i]->hashed;
+    }
+    for_urange(i, 0, returns.len) {
+        returns.at[i] = resolve_child(returns.at[i]);
+        children_hashed &= returns.at[i]->hashed;
+    }
+
+    Type key = {.tag = TYPE_FUNCTION};
+    key.as_function.params = params;
+    key.as_function.returns = returns;
+    Type* t = intern(&key, children_hashed);
+    if (t->as_function.params.at != params.at) {
+        // an existing one was handed back
+        da_destroy(&params);
+        da_destroy(&returns);
+    }
+    return t;
+}
+
+void type_partition_begin() {
+    if (shared_graph == NULL) CRASH("no type graph to partition");
+    typegraph = (TypeGraph){0};
+    da_init(&typegraph, 64);
+    // primitives are never copied, every partition starts out with the shared ones
+    for_range(i, 0, TYPE_META_INTEGRAL) da_append(&typegraph, shared_graph->at[i]);
+    interned = (InternTable){0};
+    canonical_len = typegraph.len;
+}
+
+TypeGraph type_partition_end() {
+    TypeGraph partition = typegraph;
+    if (interned.at != NULL) mars_free(interned.at);
+    interned = (InternTable){0};
+    typegraph = (TypeGraph){0};
+    canonical_len = 0;
+    return partition;
+}
+
+void type_partition_merge(TypeGraph* partition) {
+    for_urange(i, TYPE_META_INTEGRAL, partition->len) {
+        Type* t = partition->at[i];
+        da_append(&typegraph, t);
+        if (!t->hashed) continue;
+
+        // another worker might have made the same type. children of a hashed
+        // type are hashed too and come before it, so they're merged already
+        switch (t->tag) {
+        case TYPE_POINTER:
+        case TYPE_SLICE:
+            t->as_reference.subtype = resolve_child(t->as_reference.subtype);
+            break;
+        case TYPE_ARRAY:
+            t->as_array.subtype = resolve_child(t->as_array.subtype);
+            break;
+        case TYPE_FUNCTION:
+            for_urange(j, 0, t->as_function.params.len) t->as_function.params.at[j] = resolve_child(t->as_function.params.at[j]);
+            for_urange(j, 0, t->as_function.returns.len) t->as_function.returns.at[j] = resolve_child(t->as_function.returns.at[j]);
+            break;
+        default: break;
+        }
+
+        Type* existing = intern_find(t);
+        if (existing != NULL) {
+            // same as the canonicalizer does with merged types
+            *t = (Type){0};
+            t->tag = TYPE_ALIAS;
+            t->as_reference.subtype = existing;
+            t->size = UINT32_MAX;
+            t->align = UINT32_MAX;
+            continue;
+        }
+        if ((interned.len + 1) * 2 > interned.cap) intern_grow();
+        intern_insert(t);
+    }
+    da_destroy(partition);
 }
 
 forceinline void type_add_param(Type* s, Type* sub) {
@@ -586,165 +883,161 @@ void print_type_graph() {
     }
 }
 
-// is type unboundedly recursive (have infinite size)?
-bool type_is_infinite(Type* t) {
-    if (t->visited) return true;
+// order the fields of a struct get placed in, by index into its field list
+static void field_order(Type* t, u32* order) {
+    u64 len = t->as_aggregate.fields.len;
+    for_urange(i, 0, len) order[i] = i;
+    if (!mars_flags.reorder_fields) return;
+
+    // biggest alignment first never needs padding between fields, since
+    // every alignment is a power of two. stable, so equal fields keep their order
+    for_urange(i, 1, len) {
+        u64 j = i;
+        while (j > 0 && type_get_field(t, order[j])->subtype->align > type_get_field(t, order[j - 1])->subtype->align) {
+            u32 temp = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = temp;
+            j--;
+        }
+    }
+}
 
-    t->visited = true;
-    bool is_inf = false;
+static bool layout(Type* t);
 
-    switch (t->tag) {
-    case TYPE_STRUCT:
-    case TYPE_UNION:
-        for_urange(i, 0, t->as_aggregate.fields.len) {
-            if (type_is_infinite(type_get_field(t, i)->subtype)) {
-                is_inf = true;
-                break;
-            }
-        }
-        break;
-    case TYPE_FUNCTION:
-        for_urange(i, 0, t->as_function.params.len) {
-            if (type_is_infinite(t->as_function.params.at[i])) {
-                is_inf = true;
-                break;
-            }
+// fields are already laid out by the time this runs
+static void layout_aggregate(Type* t) {
+    u64 len = t->as_aggregate.fields.len;
+    u64 align = 1;
+    for_urange(i, 0, len) {
+        u64 field_align = type_get_field(t, i)->subtype->align;
+        if (field_align > align) align = field_align;
+    }
+
+    u64 size = 0;
+    if (t->tag == TYPE_UNION) {
+        for_urange(i, 0, len) {
+            TypeStructField* field = type_get_field(t, i);
+            field->offset = 0;
+            if (field->subtype->size > size) size = field->subtype->size;
         }
-        for_urange(i, 0, t->as_function.returns.len) {
-            if (type_is_infinite(t->as_function.returns.at[i])) {
-                is_inf = true;
-                break;
-            }
+    } else {
+        u32 small_order[16];
+        u32* order = len <= 16 ? small_order : mars_alloc(sizeof(u32) * len);
+        field_order(t, order);
+        for_urange(i, 0, len) {
+            TypeStructField* field = type_get_field(t, order[i]);
+            size = align_forward(size, field->subtype->align);
+            field->offset = size;
+            size += field->subtype->size;
         }
-        break;
-    case TYPE_ARRAY:
-        is_inf = type_is_infinite(t->as_array.subtype);
-        break;
-    case TYPE_POINTER:
-    case TYPE_SLICE:
-        break;
-
-    case TYPE_DISTINCT:
-    case TYPE_ALIAS:
-        type_is_infinite(type_get_target(t));
-        break;
-    default:
-        break;
+        if (order != small_order) mars_free(order);
     }
 
-    t->visited = false;
-    return is_inf;
+    t->size = align_forward(size, align);
+    t->align = align;
 }
 
-u32 static size_of_internal(Type* t) {
-    if (t->size != UINT32_MAX) return t->size;
+// lays out t and everything it holds by value, children first. results stay
+// on the type, so every type is only ever laid out once. returns false if t
+// holds itself by value somewhere, and so has no size
+static bool layout(Type* t) {
+    if (t->infinite) return false;
+    if (t->size != UINT32_MAX) return true;
+    if (t->visited) return false; // we're already inside it
+
+    t->visited = true;
+    bool finite = true;
 
     switch (t->tag) {
     case TYPE_NONE:
-        return t->size = 0;
+        t->size = 0;
+        t->align = 0;
+        break;
     case TYPE_I8:
     case TYPE_U8:
     case TYPE_BOOL:
-        return t->size = 1;
+        t->size = t->align = 1;
+        break;
     case TYPE_I16:
     case TYPE_U16:
     case TYPE_F16:
-        return t->size = 2;
+        t->size = t->align = 2;
+        break;
     case TYPE_I32:
     case TYPE_U32:
     case TYPE_F32:
-        return t->size = 4;
+        t->size = t->align = 4;
+        break;
     case TYPE_I64:
     case TYPE_U64:
     case TYPE_F64:
     case TYPE_POINTER:
     case TYPE_FUNCTION: // remember, its a function POINTER!
-        return t->size = 8;
+        t->size = t->align = 8;
+        break;
     case TYPE_SLICE:
-        return t->size = 16;
+        t->size = 16;
+        t->align = 8;
+        break;
     case TYPE_ENUM:
-        return t->size = size_of_internal(t->as_enum.backing_type);
+        finite = layout(t->as_enum.backing_type);
+        t->size = t->as_enum.backing_type->size;
+        t->align = t->as_enum.backing_type->align;
+        break;
     case TYPE_ALIAS:
     case TYPE_DISTINCT:
-        return t->size = size_of_internal(t->as_reference.subtype);
+        finite = layout(t->as_reference.subtype);
+        t->size = t->as_reference.subtype->size;
+        t->align = t->as_reference.subtype->align;
+        break;
     case TYPE_ARRAY:
-        return t->size = size_of_internal(t->as_array.subtype) * t->as_array.len;
-    case TYPE_UNION: {
-        u64 max_size = 0;
-        for_urange(i, 0, t->as_aggregate.fields.len) {
-            u64 size = size_of_internal(type_get_field(t, i)->subtype);
-            if (size > max_size) max_size = size;
-        }
-        return align_forward(max_size, type_real_align_of(t));
-    } break;
-    case TYPE_STRUCT: {
-        u64 full_size = 0;
+        finite = layout(t->as_array.subtype);
+        t->size = t->as_array.subtype->size * t->as_array.len;
+        t->align = t->as_array.subtype->align;
+        break;
+    case TYPE_STRUCT:
+    case TYPE_UNION:
         for_urange(i, 0, t->as_aggregate.fields.len) {
-            type_get_field(t, i)->offset = full_size;
-            u64 elem_size = size_of_internal(type_get_field(t, i)->subtype);
-            full_size += elem_size;
+            if (!layout(type_get_field(t, i)->subtype)) {
+                finite = false;
+                break;
+            }
         }
-        return align_forward(full_size, type_real_align_of(t));
-    } break;
+        if (finite) layout_aggregate(t);
+        break;
     default:
         CRASH("unreachable");
     }
-}
 
-u32 type_real_size_of(Type* t) {
-    if (type_is_infinite(t)) return UINT32_MAX;
-    return size_of_internal(t);
+    t->visited = false;
+    if (!finite) {
+        t->infinite = true;
+        t->size = UINT32_MAX;
+        t->align = UINT32_MAX;
+    }
+    return finite;
 }
 
-u32 static align_of_internal(Type* t) {
-    if (t->align != UINT32_MAX) return t->align;
+void type_layout_graph() {
+    for_urange(i, 0, typegraph.len) {
+        Type* t = typegraph.at[i];
+        if (t->moved || t->tag == TYPE_UNTYPED_INT || t->tag == TYPE_UNTYPED_FLOAT || t->tag == TYPE_META_INTEGRAL) continue;
+        if (t->tag == TYPE_UNTYPED_AGGREGATE) continue;
+        layout(t);
+    }
+}
 
-    switch (t->tag) {
-    case TYPE_NONE:
-        return t->align = 0;
-    case TYPE_I8:
-    case TYPE_U8:
-        return t->align = 1;
-    case TYPE_I16:
-    case TYPE_U16:
-    case TYPE_F16:
-        return t->align = 2;
-    case TYPE_I32:
-    case TYPE_U32:
-    case TYPE_F32:
-        return t->align = 4;
-    case TYPE_I64:
-    case TYPE_U64:
-    case TYPE_F64:
-    case TYPE_POINTER:
-    case TYPE_FUNCTION: // remember, its a function POINTER!
-    case TYPE_SLICE:
-        return t->align = 8;
-    case TYPE_ENUM:
-        return t->align = align_of_internal(t->as_enum.backing_type);
-    case TYPE_ALIAS:
-    case TYPE_DISTINCT:
-        return t->align = align_of_internal(t->as_reference.subtype);
-    case TYPE_ARRAY:
-        return t->align = align_of_internal(t->as_array.subtype);
+// is type unboundedly recursive (have infinite size)?
+bool type_is_infinite(Type* t) {
+    return !layout(t);
+}
 
-    case TYPE_UNION:
-    case TYPE_STRUCT: {
-        u64 max_align = 0;
-        for_urange(i, 0, t->as_aggregate.fields.len) {
-            u64 align = align_of_internal(type_get_field(t, i)->subtype);
-            if (align > max_align) max_align = align;
-        }
-        return t->align = max_align;
-    } break;
-    default:
-        CRASH("unreachable");
-    }
+u32 type_real_size_of(Type* t) {
+    return layout(t) ? t->size : UINT32_MAX;
 }
 
 u32 type_real_align_of(Type* t) {
-    if (type_is_infinite(t)) return UINT32_MAX;
-    return align_of_internal(t);
+    return layout(t) ? t->align : UINT32_MAX;
 }
 
 forceinline bool is_raw_pointer(Type* p) {
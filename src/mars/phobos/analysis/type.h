@@ -107,9 +107,10 @@ typedef struct Type {
     Type* moved;
     u8 tag;
     bool visited : 1;
-    u16 type_nums[2];
+    bool hashed : 1; // hash-consed, see type_make_pointer()
+    bool infinite : 1; // holds itself by value, has no size
 
-    u32 size; // NOTE: types dont have size OR alignment until you call the type_real_(size/align)_of(T) function
+    u32 size; // NOTE: types dont have size OR alignment until they're laid out, see type_layout_graph()
     u32 align;
 } Type;
 
@@ -119,11 +120,29 @@ typedef struct {
     size_t cap;
 } TypeGraph;
 
-extern TypeGraph typegraph;
+extern _Thread_local TypeGraph typegraph;
 
 void make_type_graph();
 Type* make_type(u8 tag);
 
+// pointers, slices, arrays and functions are hash-consed on their children.
+// the ones made only out of primitives and other hashed types get marked
+// hashed, and two hashed types are equivalent only if they're the same Type*,
+// so the canonicalizer only has to compare everything else (aggregates,
+// aliases, and whatever refers to them)
+Type* type_make_pointer(Type* sub, bool mutable);
+Type* type_make_slice(Type* sub, bool mutable);
+Type* type_make_array(Type* sub, u64 len);
+// takes ownership of params and returns
+Type* type_make_function(da(TypePTR) params, da(TypePTR) returns);
+
+// modules that don't import each other are checked on separate threads. a
+// worker makes its types in a partition of its own, seeing the shared graph
+// read only, and the partitions are merged back into it between waves
+void type_partition_begin();
+TypeGraph type_partition_end();
+void type_partition_merge(TypeGraph* partition);
+
 void type_add_param(Type* s, Type* sub);
 Type* type_get_param(Type* s, size_t i);
 void type_add_return(Type* s, Type* sub);
@@ -150,6 +169,9 @@ void print_type_graph();
 // a < b
 bool type_enum_variant_less(TypeEnumVariant* a, TypeEnumVariant* b);
 
+// lay out every type in the graph: sizes, alignments and field offsets.
+// with -reorder-fields, struct fields are placed biggest alignment first
+void type_layout_graph();
 u32 type_real_size_of(Type* t);
 u32 type_real_align_of(Type* t);
 
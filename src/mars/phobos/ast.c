@@ -5,6 +5,7 @@
 #include "common/arena.h"
 #include "ast.h"
 #include "parse/parse.h"
+#include "compact.h"
 
 const size_t ast_type_size[] = {
     0,
@@ -52,174 +53,60 @@ void print_indent(int n) {
     for_range(i, 0, n) printf("|    ");
 }
 
-// FOR DEBUGGING PURPOSES!! THIS IS NOT GOING TO BE MEMORY SAFE LMFAO
-/*
-void dump_tree(AST node, int n) {
+static void print_flags(ast_flags flags) {
+    if (flags & AST_FLAG_MUT) printf(" mut");
+    if (flags & AST_FLAG_UNINIT) printf(" uninit");
+    if (flags & AST_FLAG_BITCAST) printf(" bitcast");
+    if (flags & AST_FLAG_UNION) printf(" union");
+    if (flags & AST_FLAG_FN_LITERAL) printf(" literal");
+    if (flags & AST_FLAG_SIMPLE_RETURN) printf(" simple-return");
+    if (flags & AST_FLAG_INCLUSIVE) printf(" inclusive");
+    if (flags & AST_FLAG_DISCARD) printf(" discard");
+}
 
+// prints the node, its tokens and flags, then its children one level deeper
+void dump_tree(compact_ast* c, ast_index node, int n) {
     print_indent(n);
 
-    if (is_null_AST(node)) {
+    if (node == 0) {
         printf("[null AST]\n");
         return;
     }
 
-    switch (node.type) {
-    case AST_invalid:
-        printf("[invalid]\n");
-        break;
-    case AST_identifier:
-        printf("ident '%s'\n", clone_to_cstring(node.as_identifier->tok->text));
-        break;
-    case AST_literal_expr:
-        switch (node.as_literal_expr->value.kind) {
-        case EV_BOOL: printf("bool literal\n"); break;
-        case EV_UNTYPED_FLOAT: printf("float literal\n"); break;
-        case EV_UNTYPED_INT: printf("int literal\n"); break;
-        case EV_POINTER: printf("pointer literal\n"); break;
-        case EV_STRING: printf("string literal\n"); break;
-        default: printf("[invalid] literal\n"); break;
-        }
-        break;
-    case AST_comp_literal_expr:
-        printf("compound literal\n");
-        dump_tree(node.as_comp_literal_expr->type, n+1);
-        for_urange(i, 0, node.as_comp_literal_expr->elems.len) {
-            dump_tree(node.as_comp_literal_expr->elems.at[i], n+1);
-        }
-        break;
-    case AST_paren_expr:
-        printf("()\n");
-        dump_tree(node.as_paren_expr->subexpr, n+1);
-        break;
-    case AST_cast_expr:
-        if (node.as_cast_expr->is_bitcast) printf("bitcast\n");
-        else printf("cast\n");
-        dump_tree(node.as_cast_expr->type, n+1);
-        dump_tree(node.as_cast_expr->rhs, n+1);
-        break;
-    case AST_unary_op_expr:
-        printf("unary %s\n", token_type_str[node.as_unary_op_expr->op->type]);
-        dump_tree(node.as_unary_op_expr->inside, n+1);
-        break;
-    case AST_binary_op_expr:
-        printf("binary %s\n", token_type_str[node.as_binary_op_expr->op->type]);
-        dump_tree(node.as_binary_op_expr->lhs, n+1);
-        dump_tree(node.as_binary_op_expr->rhs, n+1);
-        break;
-    case AST_entity_selector_expr:
-        printf("entity selector\n");
-        dump_tree(node.as_entity_selector_expr->lhs, n+1);
-        dump_tree(node.as_entity_selector_expr->rhs, n+1);
-        break;
-    case AST_selector_expr:
-        printf("selector\n");
-        dump_tree(node.as_selector_expr->lhs, n+1);
-        dump_tree(node.as_selector_expr->rhs, n+1);
-        break;
-    case AST_impl_selector_expr:
-        printf("implicit selector\n");
-        dump_tree(node.as_impl_selector_expr->rhs, n+1);
-        break;
-    case AST_index_expr:
-        printf("index\n");
-        dump_tree(node.as_index_expr->lhs, n+1);
-        dump_tree(node.as_index_expr->inside, n+1);
-        break;
-    case AST_slice_expr:
-        printf("slice\n");
-        dump_tree(node.as_slice_expr->lhs, n+1);
-        dump_tree(node.as_slice_expr->inside_left, n+1);
-        dump_tree(node.as_slice_expr->inside_right, n+1);
-        break;
-    case AST_call_expr:
-        printf("function call\n");
-        dump_tree(node.as_call_expr->lhs, n+1);
-        for_urange(i, 0, node.as_call_expr->params.len) {
-            dump_tree(node.as_call_expr->params.at[i], n+1);
-        }
-        break;
-    case AST_return_stmt:
-        printf("return stmt\n");
-        for_urange(i, 0, node.as_return_stmt->returns.len) {
-            dump_tree(node.as_return_stmt->returns.at[i], n+1);
-        }
-        break;
-    case AST_module_decl:
-        printf("module %s\n", clone_to_cstring(node.as_module_decl->name->text));
-        break;
-    case AST_import_stmt:
-        printf("import\n");
-        dump_tree(node.as_import_stmt->name, n+1);
-        dump_tree(node.as_import_stmt->path, n+1);
-        break;
-    case AST_block_stmt:
-        printf("block stmt\n");
-        for_urange(i, 0, node.as_block_stmt->stmts.len) {
-            dump_tree(node.as_block_stmt->stmts.at[i], n+1);
-        }
-        break;
-    case AST_decl_stmt:
-        if (node.as_decl_stmt->is_mut)
-            printf("mut decl\n");
-        else
-            printf("let decl\n");
+    printf("%s", ast_type_str[c->kind[node]]);
+    u32* record = compact_record(c, node);
+    for (const ast_field* f = ast_fields(c->kind[node]); f->kind != AST_FIELD_END; f++) {
+        if (f->kind == AST_FIELD_TOKEN && *record != 0) printf(" '" str_fmt "'", str_arg(compact_token_text(c, *record)));
+        record += ast_field_words(f->kind);
+    }
+    print_flags(c->flags[node]);
+    printf("\n");
 
-        for_urange(i, 0, node.as_decl_stmt->lhs.len) {
-            dump_tree(node.as_decl_stmt->lhs.at[i], n+1);
+    record = compact_record(c, node);
+    for (const ast_field* f = ast_fields(c->kind[node]); f->kind != AST_FIELD_END; f++) {
+        switch (f->kind) {
+        case AST_FIELD_NODE:
+            if (record[0] != 0) dump_tree(c, record[0], n + 1);
+            break;
+        case AST_FIELD_LIST:
+        case AST_FIELD_FIELDS:
+        case AST_FIELD_VARIANTS: {
+            u32 stride = ast_field_stride(f->kind);
+            for_urange(i, 0, record[1]) {
+                u32* elem = &c->extra[record[0] + i * stride];
+                // variants carry a token in the middle
+                if (f->kind == AST_FIELD_VARIANTS) {
+                    dump_tree(c, elem[0], n + 1);
+                    if (elem[2] != 0) dump_tree(c, elem[2], n + 2);
+                    continue;
+                }
+                for_urange(j, 0, stride) dump_tree(c, elem[j], n + 1);
+            }
+            break;
         }
-        dump_tree(node.as_decl_stmt->type, n+1);
-        dump_tree(node.as_decl_stmt->rhs, n+1);
-        break;
-    case AST_type_decl_stmt:
-        printf("type decl\n");
-        dump_tree(node.as_type_decl_stmt->lhs, n+1);
-        dump_tree(node.as_type_decl_stmt->rhs, n+1);
-        break;
-    case AST_struct_type_expr:
-        printf("struct type expr\n");
-        for_urange(i, 0, node.as_struct_type_expr->fields.len) {
-            dump_tree(node.as_struct_type_expr->fields.at[i].field, n+1);
-            dump_tree(node.as_struct_type_expr->fields.at[i].type, n+1);
+        default:
+            break;
         }
-        break;
-    case AST_union_type_expr:
-        printf("union type expr\n");
-        for_urange(i, 0, node.as_struct_type_expr->fields.len) {
-            dump_tree(node.as_struct_type_expr->fields.at[i].field, n+1);
-            dump_tree(node.as_struct_type_expr->fields.at[i].type, n+1);
-        }
-        break;
-    case AST_enum_type_expr:
-        printf("enum type expr\n");
-        dump_tree(node.as_enum_type_expr->backing_type, n+1);
-        for_urange(i, 0, node.as_enum_type_expr->variants.len) {
-            print_indent(n+1);
-            printstr((node.as_enum_type_expr->variants.at[i].ident.as_identifier_expr->tok->text));
-
-            printf(" = %ld\n", node.as_enum_type_expr->variants.at[i].value);
-        }
-        break;
-    case AST_pointer_type_expr:
-        printf("^ type expr\n");
-        dump_tree(node.as_pointer_type_expr->subexpr, n+1);
-        break;
-    case AST_slice_type_expr:
-        printf("[] type expr\n");
-        dump_tree(node.as_slice_type_expr->subexpr, n+1);
-        break;
-    case AST_basic_type_expr:
-        printstr(node.as_basic_type_expr->lit->text);
-        printf("\n");
-        break;
-
-    case AST_func_literal_expr:
-        printf("function literal\n");
-        dump_tree(node.as_func_literal_expr->type, n+1);
-        dump_tree(node.as_func_literal_expr->code_block, n+1);
-        break;
-
-    default:
-        printf("unimplemented %d '%s'\n", node.type, ast_type_str[node.type]);
-        break;
+        record += ast_field_words(f->kind);
     }
-}*/
\ No newline at end of file
+}
@@ -0,0 +1,107 @@
+#include "common/orbit.h"
+#include "mars/mars.h"
+#include "mars/term.h"
+
+#include "phobos.h"
+#include "cache.h"
+
+u64 FNV_1a(string key); // defined in common/strmap.c
+
+static u64 hash_combine(u64 seed, u64 value) {
+    // boost's hash_combine, widened to 64 bits
+    return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 12) + (seed >> 4));
+}
+
+// the file name without the directory, so moving a tree around keeps its keys
+static string file_name(string path) {
+    for (isize i = (isize)path.len - 1; i >= 0; i--) {
+        if (path.raw[i] == '/') return substring_len(path, i + 1, path.len - i - 1);
+    }
+    return path;
+}
+
+// a rebuilt compiler can check the same sources differently, so the compiler
+// is an input too. hash the binary that's running, read once per process.
+static u64 compiler_identity() {
+    static u64 identity = 0;
+    if (identity != 0) return identity;
+
+#ifdef __linux__
+    FILE* f = fopen("/proc/self/exe", "rb");
+    if (f != NULL) {
+        fseek(f, 0, SEEK_END);
+        long len = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        if (len > 0) {
+            string contents = string_alloc(len);
+            if (fread(contents.raw, 1, len, f) == (size_t)len) identity = FNV_1a(contents);
+            string_free(contents);
+        }
+        fclose(f);
+    }
+#endif
+    // no way to read ourselves, settle for when this file was compiled
+    if (identity == 0) identity = FNV_1a(str(__DATE__ " " __TIME__));
+    return identity;
+}
+
+u64 cache_module_key(mars_module* mod) {
+    // files come in whatever order the directory lists them,
+    // so sum their hashes instead of chaining them
+    u64 files = 0;
+    for_urange(i, 0, mod->files.len) {
+        u64 h = hash_combine(FNV_1a(file_name(mod->files.at[i].path)), FNV_1a(mod->files.at[i].src));
+        files += h * 0xbf58476d1ce4e5b9ull;
+    }
+
+    u64 key = hash_combine(MARS_CACHE_VERSION, files);
+    // only worth reading the binary if there's a cache to look in
+    if (!is_null_str(mars_flags.cache_path)) key = hash_combine(key, compiler_identity());
+    key = hash_combine(key, mod->files.len);
+    key = hash_combine(key, (u64)mars_flags.target_arch);
+    key = hash_combine(key, (u64)mars_flags.target_system);
+    foreach (mars_module* import, mod->import_list) {
+        key = hash_combine(key, import->cache_key);
+    }
+    return key;
+}
+
+static void entry_path(char* buf, size_t len, u64 key) {
+    snprintf(buf, len, str_fmt "/%016llx", str_arg(mars_flags.cache_path), (unsigned long long)key);
+}
+
+bool cache_lookup(mars_module* mod) {
+    if (is_null_str(mars_flags.cache_path)) return false;
+
+    char path[PATH_MAX];
+    entry_path(path, sizeof(path), mod->cache_key);
+    FILE* f = fopen(path, "r");
+    if (f == NULL) return false;
+
+    int version = 0;
+    bool hit = fscanf(f, "mars cache %d", &version) == 1 && version == MARS_CACHE_VERSION;
+    fclose(f);
+    return hit;
+}
+
+void cache_store_modules(module_list* modules) {
+    if (is_null_str(mars_flags.cache_path)) return;
+
+    char* dir = clone_to_cstring(mars_flags.cache_path);
+    fs_mkdir(dir, S_IRWXU | S_IRWXG | S_IRWXO); // fine if it exists already
+    mars_free(dir);
+
+    foreach (mars_module* mod, *modules) {
+        if (!mod->checked || mod->cached) continue;
+
+        char path[PATH_MAX];
+        entry_path(path, sizeof(path), mod->cache_key);
+        FILE* f = fopen(path, "w");
+        if (f == NULL) {
+            general_warning("cannot write cache entry \"%s\"", path);
+            return;
+        }
+        fprintf(f, "mars cache %d\n" str_fmt "\n" str_fmt "\n", MARS_CACHE_VERSION, str_arg(mod->module_name), str_arg(mod->module_path));
+        fclose(f);
+    }
+}
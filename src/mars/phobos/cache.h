@@ -0,0 +1,30 @@
+#pragma once
+#define PHOBOS_CACHE_H
+
+#include "common/orbit.h"
+#include "phobos.h"
+
+/*
+    on-disk cache of modules that have already checked clean.
+
+    a module's key hashes every .mars file in it, the keys of everything it
+    imports, the target and the compiler binary itself, so touching anything
+    upstream (or rebuilding mars) changes every key downstream of it. if the key has an entry, the module was checked with
+    exactly these inputs before, and the checker only has to rebuild its
+    interface (global entities and their types) and can skip function bodies.
+
+    only the main module gets lowered to iron, so there's no IR to keep for
+    imported modules yet.
+*/
+
+// the format of an entry. the key already changes with every build of mars
+#define MARS_CACHE_VERSION 1
+
+// hash the module's files and its imports. imports must be hashed already
+u64 cache_module_key(mars_module* mod);
+
+// does the cache have an entry for mod->cache_key?
+bool cache_lookup(mars_module* mod);
+
+// record every module that got fully checked and isn't in the cache yet
+void cache_store_modules(module_list* modules);
@@ -0,0 +1,336 @@
+#include "common/orbit.h"
+#include "common/crash.h"
+#include "compact.h"
+
+#define NODE(k, f)     {AST_FIELD_NODE, offsetof(ast_##k, f), #f}
+#define TOKEN(k, f)    {AST_FIELD_TOKEN, offsetof(ast_##k, f), #f}
+#define LIST(k, f)     {AST_FIELD_LIST, offsetof(ast_##k, f), #f}
+#define FIELDS(k, f)   {AST_FIELD_FIELDS, offsetof(ast_##k, f), #f}
+#define VARIANTS(k, f) {AST_FIELD_VARIANTS, offsetof(ast_##k, f), #f}
+
+// only what the parser fills in. the checker's annotations (entities,
+// literal values, field indices) stay on the pointer AST for now
+static const ast_field schema[AST_COUNT][6] = {
+    [AST_identifier] = {TOKEN(identifier, tok)},
+    [AST_literal_expr] = {TOKEN(literal_expr, tok)},
+    [AST_comp_literal_expr] = {NODE(comp_literal_expr, type), LIST(comp_literal_expr, elems)},
+    [AST_func_literal_expr] = {NODE(func_literal_expr, ident), NODE(func_literal_expr, type), NODE(func_literal_expr, code_block)},
+    [AST_cast_expr] = {NODE(cast_expr, type), NODE(cast_expr, rhs)},
+    [AST_unary_op_expr] = {TOKEN(unary_op_expr, op), NODE(unary_op_expr, inside)},
+    [AST_binary_op_expr] = {TOKEN(binary_op_expr, op), NODE(binary_op_expr, lhs), NODE(binary_op_expr, rhs)},
+    [AST_selector_expr] = {NODE(selector_expr, lhs), TOKEN(selector_expr, op), NODE(selector_expr, rhs)},
+    [AST_index_expr] = {NODE(index_expr, lhs), NODE(index_expr, inside)},
+    [AST_slice_expr] = {NODE(slice_expr, lhs), NODE(slice_expr, inside_left), NODE(slice_expr, inside_right)},
+    [AST_call_expr] = {NODE(call_expr, lhs), LIST(call_expr, params)},
+
+    [AST_module_decl] = {TOKEN(module_decl, name)},
+    [AST_import_stmt] = {NODE(import_stmt, name), NODE(import_stmt, path)},
+    [AST_stmt_block] = {LIST(stmt_block, stmts)},
+    [AST_decl_stmt] = {LIST(decl_stmt, lhs), NODE(decl_stmt, type), TOKEN(decl_stmt, type_presema), NODE(decl_stmt, rhs)},
+    [AST_type_decl_stmt] = {NODE(type_decl_stmt, lhs), NODE(type_decl_stmt, rhs)},
+    [AST_assign_stmt] = {LIST(assign_stmt, lhs), TOKEN(assign_stmt, op), NODE(assign_stmt, rhs)},
+    [AST_asm_stmt] = {LIST(asm_stmt, params), LIST(asm_stmt, strs)},
+    [AST_asm_param] = {NODE(asm_param, ident), TOKEN(asm_param, op), NODE(asm_param, reg)},
+    [AST_if_stmt] = {NODE(if_stmt, condition), NODE(if_stmt, if_branch)},
+    [AST_else_stmt] = {NODE(else_stmt, inside)},
+    [AST_switch_stmt] = {NODE(switch_stmt, expr), LIST(switch_stmt, cases)},
+    [AST_case] = {LIST(case, matches), NODE(case, block)},
+    [AST_while_stmt] = {NODE(while_stmt, condition), NODE(while_stmt, block)},
+    [AST_for_stmt] = {NODE(for_stmt, prelude), NODE(for_stmt, condition), LIST(for_stmt, update), NODE(for_stmt, block)},
+    [AST_for_in_stmt] = {NODE(for_in_stmt, indexvar), NODE(for_in_stmt, type), NODE(for_in_stmt, from), NODE(for_in_stmt, to), NODE(for_in_stmt, block)},
+    [AST_extern_stmt] = {NODE(extern_stmt, stmt)},
+    [AST_defer_stmt] = {NODE(defer_stmt, stmt)},
+    [AST_expr_stmt] = {NODE(expr_stmt, expression)},
+    [AST_return_stmt] = {LIST(return_stmt, returns)},
+    [AST_break_stmt] = {NODE(break_stmt, label)},
+    [AST_continue_stmt] = {NODE(continue_stmt, label)},
+    [AST_label_stmt] = {NODE(label_stmt, label)},
+
+    [AST_basic_type_expr] = {TOKEN(basic_type_expr, lit)},
+    [AST_struct_type_expr] = {FIELDS(struct_type_expr, fields)},
+    [AST_fn_type_expr] = {FIELDS(fn_type_expr, parameters), FIELDS(fn_type_expr, returns)},
+    [AST_enum_type_expr] = {NODE(enum_type_expr, backing_type), VARIANTS(enum_type_expr, variants)},
+    [AST_array_type_expr] = {NODE(array_type_expr, length), NODE(array_type_expr, type)},
+    [AST_slice_type_expr] = {NODE(slice_type_expr, subexpr)},
+    [AST_pointer_type_expr] = {NODE(pointer_type_expr, subexpr)},
+    [AST_distinct_type_expr] = {NODE(distinct_type_expr, subexpr)},
+};
+
+const ast_field* ast_fields(ast_type kind) {
+    if (kind >= AST_COUNT) CRASH("ast_fields() on invalid node kind");
+    return schema[kind];
+}
+
+u32 ast_field_words(ast_field_kind kind) {
+    switch (kind) {
+    case AST_FIELD_NODE:
+    case AST_FIELD_TOKEN: return 1;
+    case AST_FIELD_LIST:
+    case AST_FIELD_FIELDS:
+    case AST_FIELD_VARIANTS: return 2;
+    default: return 0;
+    }
+}
+
+u32 ast_field_stride(ast_field_kind kind) {
+    switch (kind) {
+    case AST_FIELD_LIST: return 1;
+    case AST_FIELD_FIELDS: return 2;
+    case AST_FIELD_VARIANTS: return 3;
+    default: return 0;
+    }
+}
+
+static u32 record_words(ast_type kind) {
+    u32 words = 0;
+    for (const ast_field* f = schema[kind]; f->kind != AST_FIELD_END; f++) {
+        words += ast_field_words(f->kind);
+    }
+    return words;
+}
+
+// filled in on first use, AST_COUNT is small
+static u8 record_len[AST_COUNT];
+static bool record_len_ready = false;
+
+static void init_record_len() {
+    for_range(kind, 0, AST_COUNT) record_len[kind] = record_words(kind);
+    record_len_ready = true;
+}
+
+u32* compact_record(compact_ast* c, ast_index node) {
+    if (record_len[c->kind[node]] <= 1) return &c->data[node];
+    return &c->extra[c->data[node]];
+}
+
+static ast_flags node_flags(AST node) {
+    switch (node.type) {
+    case AST_identifier:
+        return node.as_identifier->is_discard ? AST_FLAG_DISCARD : 0;
+    case AST_cast_expr:
+        return node.as_cast_expr->is_bitcast ? AST_FLAG_BITCAST : 0;
+    case AST_decl_stmt:
+        return (node.as_decl_stmt->is_mut ? AST_FLAG_MUT : 0) | (node.as_decl_stmt->is_uninit ? AST_FLAG_UNINIT : 0);
+    case AST_for_in_stmt:
+        return node.as_for_in_stmt->is_inclusive ? AST_FLAG_INCLUSIVE : 0;
+    case AST_struct_type_expr:
+        return node.as_struct_type_expr->is_union ? AST_FLAG_UNION : 0;
+    case AST_fn_type_expr:
+        return (node.as_fn_type_expr->is_literal ? AST_FLAG_FN_LITERAL : 0) | (node.as_fn_type_expr->simple_return ? AST_FLAG_SIMPLE_RETURN : 0);
+    case AST_slice_type_expr:
+        return node.as_slice_type_expr->mutable ? AST_FLAG_MUT : 0;
+    case AST_pointer_type_expr:
+        return node.as_pointer_type_expr->mutable ? AST_FLAG_MUT : 0;
+    default:
+        return 0;
+    }
+}
+
+static u32 token_index(compact_ast* c, token* tok) {
+    if (tok == NULL) return 0;
+    da(mars_file)* files = &c->mod->files;
+
+    // nodes come in file order, so the last file almost always has it
+    for_urange(i, 0, files->len) {
+        u32 file = (c->last_file + i) % files->len;
+        da(token)* tokens = &files->at[file].tokens;
+        if (tok >= tokens->at && tok < tokens->at + tokens->len) {
+            c->last_file = file;
+            return c->token_base[file] + (u32)(tok - tokens->at) + 1;
+        }
+    }
+    return 0; // not from this module's files
+}
+
+token* compact_token(compact_ast* c, u32 tok) {
+    if (tok == 0) return NULL;
+    tok--;
+    // last file whose first token is at or before tok
+    size_t lo = 0;
+    size_t hi = c->mod->files.len;
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (c->token_base[mid] <= tok) lo = mid;
+        else hi = mid;
+    }
+    return &c->mod->files.at[lo].tokens.at[tok - c->token_base[lo]];
+}
+
+string compact_token_text(compact_ast* c, u32 tok) {
+    if (tok == 0) return NULL_STR;
+    return token_text(compact_token(c, tok));
+}
+
+static ast_index new_node(compact_ast* c, ast_type kind) {
+    if (c->len == c->cap) {
+        c->cap *= 2;
+        c->kind = mars_realloc(c->kind, sizeof(*c->kind) * c->cap);
+        c->flags = mars_realloc(c->flags, sizeof(*c->flags) * c->cap);
+        c->start = mars_realloc(c->start, sizeof(*c->start) * c->cap);
+        c->end = mars_realloc(c->end, sizeof(*c->end) * c->cap);
+        c->data = mars_realloc(c->data, sizeof(*c->data) * c->cap);
+        c->types = mars_realloc(c->types, sizeof(*c->types) * c->cap);
+    }
+    ast_index node = c->len++;
+    c->kind[node] = kind;
+    c->flags[node] = 0;
+    c->start[node] = 0;
+    c->end[node] = 0;
+    c->data[node] = 0;
+    c->types[node] = NULL;
+    return node;
+}
+
+// returns the offset of the new words, which may move extra
+static u32 reserve_extra(compact_ast* c, u32 words) {
+    if (c->extra_len + words > c->extra_cap) {
+        while (c->extra_len + words > c->extra_cap) c->extra_cap *= 2;
+        c->extra = mars_realloc(c->extra, sizeof(*c->extra) * c->extra_cap);
+    }
+    u32 at = c->extra_len;
+    c->extra_len += words;
+    return at;
+}
+
+// parents get lower indices than their children, so a walk over the
+// arrays in order is a pre-order walk of the tree
+static ast_index flatten(compact_ast* c, AST node) {
+    if (is_null_AST(node)) return 0;
+    if (node.type >= AST_COUNT) CRASH("flatten() on invalid node kind");
+
+    ast_index n = new_node(c, node.type);
+    c->flags[n] = node_flags(node);
+    c->start[n] = token_index(c, node.base->start);
+    c->end[n] = token_index(c, node.base->end);
+    c->types[n] = node.base->T;
+    c->pointer_bytes += ast_type_size[node.type];
+
+    // single word records go straight in data
+    if (record_len[node.type] <= 1) {
+        const ast_field* f = &schema[node.type][0];
+        void* field = (u8*)node.rawptr + f->offset;
+        if (f->kind == AST_FIELD_NODE) {
+            ast_index child = flatten(c, *(AST*)field);
+            c->data[n] = child;
+        } else if (f->kind == AST_FIELD_TOKEN) {
+            c->data[n] = token_index(c, *(token**)field);
+        }
+        return n;
+    }
+
+    u32 slot = reserve_extra(c, record_len[node.type]);
+    c->data[n] = slot;
+
+    for (const ast_field* f = schema[node.type]; f->kind != AST_FIELD_END; f++) {
+        void* field = (u8*)node.rawptr + f->offset;
+        switch (f->kind) {
+        case AST_FIELD_NODE: {
+            ast_index child = flatten(c, *(AST*)field);
+            c->extra[slot] = child;
+            break;
+        }
+        case AST_FIELD_TOKEN:
+            c->extra[slot] = token_index(c, *(token**)field);
+            break;
+        case AST_FIELD_LIST: {
+            da(AST)* list = field;
+            u32 elems = reserve_extra(c, list->len);
+            c->extra[slot] = elems;
+            c->extra[slot + 1] = list->len;
+            c->pointer_bytes += list->cap * sizeof(AST);
+            for_urange(i, 0, list->len) {
+                ast_index child = flatten(c, list->at[i]);
+                c->extra[elems + i] = child;
+            }
+            break;
+        }
+        case AST_FIELD_FIELDS: {
+            da(AST_typed_field)* list = field;
+            u32 elems = reserve_extra(c, list->len * 2);
+            c->extra[slot] = elems;
+            c->extra[slot + 1] = list->len;
+            c->pointer_bytes += list->cap * sizeof(AST_typed_field);
+            for_urange(i, 0, list->len) {
+                ast_index name = flatten(c, list->at[i].field);
+                c->extra[elems + i * 2] = name;
+                ast_index type = flatten(c, list->at[i].type);
+                c->extra[elems + i * 2 + 1] = type;
+            }
+            break;
+        }
+        case AST_FIELD_VARIANTS: {
+            da(AST_enum_variant)* list = field;
+            u32 elems = reserve_extra(c, list->len * 3);
+            c->extra[slot] = elems;
+            c->extra[slot + 1] = list->len;
+            c->pointer_bytes += list->cap * sizeof(AST_enum_variant);
+            for_urange(i, 0, list->len) {
+                ast_index ident = flatten(c, list->at[i].ident);
+                c->extra[elems + i * 3] = ident;
+                c->extra[elems + i * 3 + 1] = token_index(c, list->at[i].tok);
+                ast_index expr = flatten(c, list->at[i].expr);
+                c->extra[elems + i * 3 + 2] = expr;
+            }
+            break;
+        }
+        default:
+            CRASH("unhandled ast field kind");
+        }
+        slot += ast_field_words(f->kind);
+    }
+    return n;
+}
+
+compact_ast compact_module(mars_module* mod) {
+    if (!record_len_ready) init_record_len();
+
+    compact_ast c = {0};
+    c.mod = mod;
+
+    c.token_base = mars_alloc(sizeof(u32) * (mod->files.len + 1));
+    u32 tokens = 0;
+    for_urange(i, 0, mod->files.len) {
+        c.token_base[i] = tokens;
+        tokens += mod->files.at[i].tokens.len;
+    }
+    c.token_base[mod->files.len] = tokens;
+
+    // most nodes are a token or two, so the token count is a decent guess
+    c.cap = tokens / 2 + 16;
+    c.kind = mars_alloc(sizeof(*c.kind) * c.cap);
+    c.flags = mars_alloc(sizeof(*c.flags) * c.cap);
+    c.start = mars_alloc(sizeof(*c.start) * c.cap);
+    c.end = mars_alloc(sizeof(*c.end) * c.cap);
+    c.data = mars_alloc(sizeof(*c.data) * c.cap);
+    c.types = mars_alloc(sizeof(*c.types) * c.cap);
+    c.extra_cap = c.cap + 16;
+    c.extra = mars_alloc(sizeof(*c.extra) * c.extra_cap);
+
+    new_node(&c, AST_invalid); // the null node
+
+    c.roots_len = mod->program_tree.len;
+    c.roots = reserve_extra(&c, c.roots_len);
+    c.pointer_bytes += mod->program_tree.cap * sizeof(AST);
+    for_urange(i, 0, mod->program_tree.len) {
+        ast_index root = flatten(&c, mod->program_tree.at[i]);
+        c.extra[c.roots + i] = root;
+    }
+    return c;
+}
+
+void compact_destroy(compact_ast* c) {
+    mars_free(c->token_base);
+    mars_free(c->kind);
+    mars_free(c->flags);
+    mars_free(c->start);
+    mars_free(c->end);
+    mars_free(c->data);
+    mars_free(c->types);
+    mars_free(c->extra);
+    *c = (compact_ast){0};
+}
+
+size_t compact_bytes(compact_ast* c) {
+    size_t per_node = sizeof(*c->kind) + sizeof(*c->flags) + sizeof(*c->start) + sizeof(*c->end) + sizeof(*c->data) + sizeof(*c->types);
+    return c->len * per_node + c->extra_len * sizeof(*c->extra);
+}
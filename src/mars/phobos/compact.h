@@ -0,0 +1,96 @@
+#pragma once
+#define PHOBOS_COMPACT_H
+
+#include "common/orbit.h"
+#include "phobos.h"
+
+/*
+    index based encoding of a module's AST.
+
+    every node is a u32 index into a set of parallel arrays, index 0 is the
+    null node. a node's children live in one shared extra array: each kind
+    has a fixed record, described by its schema (see ast_fields()), and
+    the node's data is the offset of that record. list fields take two words
+    in the record, the offset of their elements in extra and their count.
+    records of a single word (identifiers, literals, most type and statement
+    wrappers) are kept in data itself.
+
+    tokens are stored as module wide indices, 0 is the null token.
+    types are a side table indexed by node, so the checker can fill it in
+    without touching the rest.
+*/
+
+typedef u32 ast_index;
+
+typedef u8 ast_field_kind;
+enum {
+    AST_FIELD_END,
+    AST_FIELD_NODE,     // AST, one word
+    AST_FIELD_TOKEN,    // token*, one word
+    AST_FIELD_LIST,     // da(AST), elements are nodes
+    AST_FIELD_FIELDS,   // da(AST_typed_field), elements are (field, type) pairs
+    AST_FIELD_VARIANTS, // da(AST_enum_variant), elements are (ident, tok, expr) triples
+};
+
+typedef struct {
+    ast_field_kind kind;
+    u8 offset; // into the pointer AST node
+    char* name;
+} ast_field;
+
+// bools that live in bitfields of the pointer AST
+typedef u16 ast_flags;
+enum {
+    AST_FLAG_MUT = 1 << 0, // decl is_mut, pointer/slice mutable
+    AST_FLAG_UNINIT = 1 << 1,
+    AST_FLAG_BITCAST = 1 << 2,
+    AST_FLAG_UNION = 1 << 3,
+    AST_FLAG_FN_LITERAL = 1 << 4,
+    AST_FLAG_SIMPLE_RETURN = 1 << 5,
+    AST_FLAG_INCLUSIVE = 1 << 6,
+    AST_FLAG_DISCARD = 1 << 7,
+};
+
+typedef struct {
+    mars_module* mod;
+    u32* token_base; // first token index of each file, files.len + 1 entries
+    u32 last_file;   // file of the last token looked up
+
+    // one entry per node
+    ast_type* kind;
+    ast_flags* flags;
+    u32* start; // token indices
+    u32* end;
+    u32* data; // offset of the record in extra, or the record itself
+    Type** types;
+    u32 len;
+    u32 cap;
+
+    u32* extra;
+    u32 extra_len;
+    u32 extra_cap;
+
+    // top level statements, in extra
+    u32 roots;
+    u32 roots_len;
+
+    size_t pointer_bytes; // what the same tree takes as pointer AST nodes
+} compact_ast;
+
+// field schema of a node kind, terminated by AST_FIELD_END
+const ast_field* ast_fields(ast_type kind);
+// words a field takes up in a record, and words per element for list fields
+u32 ast_field_words(ast_field_kind kind);
+u32 ast_field_stride(ast_field_kind kind);
+
+compact_ast compact_module(mars_module* mod);
+void compact_destroy(compact_ast* c);
+size_t compact_bytes(compact_ast* c);
+
+token* compact_token(compact_ast* c, u32 tok);
+string compact_token_text(compact_ast* c, u32 tok);
+
+// fields of a node, laid out as ast_fields() describes
+u32* compact_record(compact_ast* c, ast_index node);
+
+void dump_tree(compact_ast* c, ast_index node, int n);
@@ -1,11 +1,144 @@
 #include "common/orbit.h"
 #include "mars/term.h"
 #include "ast.h"
+#include "compact.h"
 #include "dot.h"
 
-int dot_uID();
+// nodes are named after their index in the compact AST, so every name is unique
+// without having to hand out ids as we go
 
-void emit_dot(string path, da(AST) nodes) {
+static void write_tabs(fs_file* file, int n) {
+    for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
+}
+
+static char* node_color(ast_type kind) {
+    switch (kind) {
+    case AST_identifier:
+        return "\".7 .3 1.0\"";
+    case AST_func_literal_expr:
+    case AST_fn_type_expr:
+        return "green";
+    case AST_basic_type_expr:
+    case AST_struct_type_expr:
+    case AST_enum_type_expr:
+    case AST_array_type_expr:
+    case AST_slice_type_expr:
+    case AST_pointer_type_expr:
+    case AST_distinct_type_expr:
+        return "pink";
+    default:
+        return "lightblue";
+    }
+}
+
+// append a token to a label, escaped for a dot string and capped so string literals stay readable
+static size_t append_label(char* buffer, size_t len, string text) {
+    buffer[len++] = '\\';
+    buffer[len++] = 'n';
+    for_urange(i, 0, text.len) {
+        if (i == 64) {
+            memcpy(&buffer[len], "...", 3);
+            len += 3;
+            break;
+        }
+        char c = text.raw[i];
+        if (c == '"' || c == '\\') buffer[len++] = '\\';
+        if (c == '\n' || c == '\r' || c == '\t') c = ' ';
+        buffer[len++] = c;
+    }
+    return len;
+}
+
+static void write_node(compact_ast* c, fs_file* file, ast_index node, int n);
+
+static void write_edge(compact_ast* c, fs_file* file, ast_index from, ast_index to, char* label, u32 null_id, int n) {
+    char buffer[256];
+    write_tabs(file, n);
+    if (to == 0) {
+        sprintf(buffer, "\"null_%u_%u\" [fontcolor=white,shape=diamond,style=filled,label=\"NULL\\nAST\",color=\"1.0 .7 .7\"]\n", from, null_id);
+        fs_write(file, buffer, strlen(buffer));
+        write_tabs(file, n);
+        sprintf(buffer, "\"n%u\" -> \"null_%u_%u\" [label=\"%s\"]\n", from, from, null_id, label);
+        fs_write(file, buffer, strlen(buffer));
+        return;
+    }
+    sprintf(buffer, "\"n%u\" -> \"n%u\" [label=\"%s\"]\n", from, to, label);
+    fs_write(file, buffer, strlen(buffer));
+    write_node(c, file, to, n + 1);
+}
+
+static void write_node(compact_ast* c, fs_file* file, ast_index node, int n) {
+    // every token of a node goes in its label, 64 characters each at most
+    char buffer[1024];
+    ast_type kind = c->kind[node];
+
+    size_t len = sprintf(buffer, "\"n%u\" [shape=box,style=filled,color=%s,label=\"%s", node, node_color(kind), ast_type_str[kind]);
+    u32* record = compact_record(c, node);
+    for (const ast_field* f = ast_fields(kind); f->kind != AST_FIELD_END; f++) {
+        if (f->kind == AST_FIELD_TOKEN && *record != 0) len = append_label(buffer, len, compact_token_text(c, *record));
+        record += ast_field_words(f->kind);
+    }
+    if (c->flags[node] & AST_FLAG_MUT) len += sprintf(&buffer[len], "\\nmut");
+    len += sprintf(&buffer[len], "\"]\n");
+    write_tabs(file, n);
+    fs_write(file, buffer, len);
+
+    u32 slot = 0;
+    record = compact_record(c, node);
+    for (const ast_field* f = ast_fields(kind); f->kind != AST_FIELD_END; f++) {
+        switch (f->kind) {
+        case AST_FIELD_NODE:
+            write_edge(c, file, node, record[0], f->name, slot, n);
+            break;
+        case AST_FIELD_LIST:
+        case AST_FIELD_FIELDS:
+        case AST_FIELD_VARIANTS: {
+            if (record[1] == 0) break;
+            // lists get boxed in so their order is easy to see
+            write_tabs(file, n);
+            len = sprintf(buffer, "subgraph cluster_%u_%u {\n", node, slot);
+            fs_write(file, buffer, len);
+            write_tabs(file, n + 1);
+            len = sprintf(buffer, "color=red\n");
+            fs_write(file, buffer, len);
+            write_tabs(file, n + 1);
+            len = sprintf(buffer, "label=%s\n", f->name);
+            fs_write(file, buffer, len);
+
+            u32 stride = ast_field_stride(f->kind);
+            for_urange(i, 0, record[1]) {
+                u32* elem = &c->extra[record[0] + i * stride];
+                u32 id = (slot << 16) + i * stride;
+                switch (f->kind) {
+                case AST_FIELD_FIELDS:
+                    write_edge(c, file, node, elem[0], "field", id, n + 1);
+                    write_edge(c, file, node, elem[1], "type", id + 1, n + 1);
+                    break;
+                case AST_FIELD_VARIANTS:
+                    write_edge(c, file, node, elem[0], "variant", id, n + 1);
+                    if (elem[2] != 0) write_edge(c, file, node, elem[2], "value", id + 2, n + 1);
+                    break;
+                default: {
+                    char index[16];
+                    sprintf(index, "%zu", (size_t)i);
+                    write_edge(c, file, node, elem[0], index, id, n + 1);
+                    break;
+                }
+                }
+            }
+            write_tabs(file, n);
+            fs_write(file, "}\n", 2);
+            break;
+        }
+        default:
+            break;
+        }
+        record += ast_field_words(f->kind);
+        slot++;
+    }
+}
+
+void emit_dot(string path, compact_ast* c) {
     char* path_cstr = clone_to_cstring(path);
     char buffer[1050];
     sprintf(buffer, "%.1024s.dot", path_cstr); // capped at 1024 characters for file name
@@ -24,11 +157,11 @@ void emit_dot(string path, da(AST) nodes) {
     fs_open(&file, "w");
     printf("emitting dot file: \"%s\"\n", filename.raw);
 
-    sprintf(buffer, "digraph \"%d\" {\n\trankdir=\"LR\"\n\tnodesep=0.4\n", dot_uID());
+    sprintf(buffer, "digraph \"" str_fmt "\" {\n\trankdir=\"LR\"\n\tnodesep=0.4\n", str_arg(c->mod->module_name));
     fs_write(&file, buffer, strlen(buffer));
 
-    for_urange(i, 0, nodes.len) {
-        recurse_dot(nodes.at[i], &file, 1, dot_uID());
+    for_urange(i, 0, c->roots_len) {
+        write_node(c, &file, c->extra[c->roots + i], 1);
     }
 
     fs_write(&file, "}\n", 2);
@@ -36,801 +169,3 @@ void emit_dot(string path, da(AST) nodes) {
     fs_close(&file);
     fs_drop(&file);
 }
-
-int _dot_uID = 0;
-
-int dot_uID() {
-    return ++_dot_uID;
-}
-
-void recurse_dot(AST node, fs_file* file, int n, int uid) {
-    // this code keeps track of depth with n, in which case it prints that many tabs.
-    // all nodes have label sugar to allow them to change names to un-mutated names.
-    for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-    char buffer[4096];
-
-    if (is_null_AST(node)) {
-        printf("encountered null node at uid %d\n", uid);
-        sprintf(buffer, "\"%s_%d\" [fontcolor=white,shape=diamond, style=filled, label=\"%s\", color=\"1.0 .7 .7\"]\n", ast_type_str[node.type], uid,
-                "NULL\\nAST"); // invalid sugar
-        fs_write(file, buffer, strlen(buffer));
-        return;
-    }
-
-    switch (node.type) {
-    case AST_invalid:
-        return;
-    case AST_identifier: {
-
-        int int_uid = dot_uID();
-
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=\".7 .3 1.0\", label=\"%s\"]\n", clone_to_cstring(node.as_identifier->tok->text), int_uid,
-                clone_to_cstring(node.as_identifier->tok->text)); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        sprintf(buffer, "\"%s_%d\" [label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"", ast_type_str[node.type], uid, clone_to_cstring(node.as_identifier->tok->text), int_uid); // print node link
-        fs_write(file, buffer, strlen(buffer));
-        break;
-    }
-
-    case AST_decl_stmt: {
-        char* decl_type = "";
-        if (node.as_decl_stmt->is_mut)
-            decl_type = "mut decl";
-        else
-            decl_type = "let decl"; // determine name
-
-        sprintf(buffer, "\"%s_%d\" [label=\"%s\"]\n", "declaration", uid, decl_type); // decl sugar
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        for_urange(i, 0, node.as_decl_stmt->lhs.len) { // iterate over function itself
-            int int_uid = dot_uID();
-            sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", "declaration", uid, ast_type_str[node.as_decl_stmt->lhs.at[i].type], int_uid);
-            fs_write(file, buffer, strlen(buffer));
-            recurse_dot(node.as_decl_stmt->lhs.at[i], file, n + 1, int_uid);
-        }
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", "declaration", uid, ast_type_str[node.as_decl_stmt->type.type], _dot_uID + 1); // link
-        fs_write(file, buffer, strlen(buffer));
-        recurse_dot(node.as_decl_stmt->type, file, n + 1, dot_uID()); // print type info
-
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", "declaration", uid, ast_type_str[node.as_decl_stmt->rhs.type], _dot_uID + 1); // print links
-        fs_write(file, buffer, strlen(buffer));
-        recurse_dot(node.as_decl_stmt->rhs, file, n + 1, dot_uID());
-        break;
-    }
-
-    case AST_func_literal_expr: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=green, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_func_literal_expr->type.type], _dot_uID + 1);
-        fs_write(file, buffer, strlen(buffer));
-        recurse_dot(node.as_func_literal_expr->type, file, n + 1, dot_uID());
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_func_literal_expr->code_block.type], _dot_uID + 1);
-        fs_write(file, buffer, strlen(buffer));
-        recurse_dot(node.as_func_literal_expr->code_block, file, n + 1, dot_uID());
-        break;
-    }
-
-    case AST_fn_type_expr: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=green, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        sprintf(buffer, "subgraph cluster%d {\n", dot_uID());
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < (n + 1); i++) fs_write(file, "\t", 1); // fix tabs
-
-        sprintf(buffer, "color=red\n");
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < (n + 1); i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "label=parameters\n");
-        fs_write(file, buffer, strlen(buffer));
-
-        for_urange(i, 0, node.as_fn_type_expr->parameters.len) {
-            int int_uid = dot_uID();
-            for (int i = 0; i < (n + 1); i++) fs_write(file, "\t", 1);
-            sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_fn_type_expr->parameters.at[i].type.type], int_uid);
-            fs_write(file, buffer, strlen(buffer));
-            recurse_dot(node.as_fn_type_expr->parameters.at[i].type, file, n + 2, int_uid);
-        }
-
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-        fs_write(file, "}\n", 2);
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-        sprintf(buffer, "subgraph cluster%d {\n", dot_uID());
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < (n + 1); i++) fs_write(file, "\t", 1); // fix tabs
-
-        sprintf(buffer, "color=red\n");
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < (n + 1); i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "label=returns\n");
-        fs_write(file, buffer, strlen(buffer));
-
-        for_urange(i, 0, node.as_fn_type_expr->returns.len) {
-            int int_uid = dot_uID();
-            for (int i = 0; i < (n + 1); i++) fs_write(file, "\t", 1);
-            sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_fn_type_expr->returns.at[i].type.type], int_uid);
-            fs_write(file, buffer, strlen(buffer));
-            recurse_dot(node.as_fn_type_expr->returns.at[i].type, file, n + 2, int_uid);
-        }
-
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-        fs_write(file, "}", 1);
-        break;
-    }
-
-    case AST_basic_type_expr: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=pink, label=\"%s\"]", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"", ast_type_str[node.type], uid, clone_to_cstring(node.as_basic_type_expr->lit->text), _dot_uID + 1);
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "\"%s_%d\" [shape=house,label=\"%s\"]", clone_to_cstring(node.as_basic_type_expr->lit->text), _dot_uID + 1, clone_to_cstring(node.as_basic_type_expr->lit->text));
-        fs_write(file, buffer, strlen(buffer));
-
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-        break;
-    }
-
-    case AST_stmt_block: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=lightblue, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        // for (int i = 0; i < n; i++) fs_write(file, "\t", 1); //fix tabs
-
-        for_urange(i, 0, node.as_stmt_block->stmts.len) {
-            int int_uid = dot_uID();
-            for (int i = 0; i < (n); i++) fs_write(file, "\t", 1);
-            sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_stmt_block->stmts.at[i].type], int_uid);
-            fs_write(file, buffer, strlen(buffer));
-            recurse_dot(node.as_stmt_block->stmts.at[i], file, n + 1, int_uid);
-        }
-        break;
-    }
-
-    case AST_cast_expr: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=lightblue, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        int int_uid = dot_uID();
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_cast_expr->type.type], int_uid);
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_cast_expr->rhs.type], int_uid + 1);
-        fs_write(file, buffer, strlen(buffer));
-        // for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        recurse_dot(node.as_cast_expr->type, file, n + 1, int_uid);
-        recurse_dot(node.as_cast_expr->rhs, file, n + 1, int_uid + 1);
-
-        break;
-    }
-
-    case AST_pointer_type_expr: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=pink, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        int int_uid = dot_uID();
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_pointer_type_expr->subexpr.type], int_uid);
-        fs_write(file, buffer, strlen(buffer));
-        // for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        recurse_dot(node.as_pointer_type_expr->subexpr, file, n + 1, int_uid);
-
-        break;
-    }
-
-    case AST_binary_op_expr: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=lightblue, label=\"binary op %s\"]\n", ast_type_str[node.type], uid,
-                clone_to_cstring(node.as_binary_op_expr->op->text)); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        int int_uid = dot_uID();
-        _dot_uID += 1;
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_binary_op_expr->lhs.type], int_uid);
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_binary_op_expr->rhs.type], int_uid + 1);
-        fs_write(file, buffer, strlen(buffer));
-        // for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        recurse_dot(node.as_binary_op_expr->lhs, file, n + 1, int_uid);
-        recurse_dot(node.as_binary_op_expr->rhs, file, n + 1, int_uid + 1);
-
-        break;
-    }
-
-    case AST_while_stmt: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=lightblue, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        int int_uid = dot_uID();
-
-        _dot_uID += 1;
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_while_stmt->condition.type], int_uid);
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_while_stmt->block.type], int_uid + 1);
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "subgraph cluster%d {\n", dot_uID());
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "label=condition\n");
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "color=red\n");
-        fs_write(file, buffer, strlen(buffer));
-
-        recurse_dot(node.as_while_stmt->condition, file, n + 1, int_uid);
-
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-        fs_write(file, "}\n", 2);
-
-        recurse_dot(node.as_while_stmt->block, file, n + 1, int_uid + 1);
-
-        break;
-    }
-
-    case AST_assign_stmt: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=lightblue, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        for_urange(i, 0, node.as_assign_stmt->lhs.len) {
-            int int_uid = dot_uID();
-            for (int i = 0; i < (n); i++) fs_write(file, "\t", 1);
-            sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_assign_stmt->lhs.at[i].type], int_uid);
-            fs_write(file, buffer, strlen(buffer));
-            recurse_dot(node.as_assign_stmt->lhs.at[i], file, n + 1, int_uid);
-        }
-
-        int int_uid = dot_uID();
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_assign_stmt->rhs.type], int_uid);
-        fs_write(file, buffer, strlen(buffer));
-
-        recurse_dot(node.as_assign_stmt->rhs, file, n + 1, int_uid);
-
-        break;
-    }
-
-    case AST_unary_op_expr: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=lightblue, label=\"unary op %s\"]\n", ast_type_str[node.type], uid,
-                clone_to_cstring(node.as_unary_op_expr->op->text)); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        int int_uid = dot_uID();
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_unary_op_expr->inside.type], int_uid);
-        fs_write(file, buffer, strlen(buffer));
-        // for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        recurse_dot(node.as_unary_op_expr->inside, file, n + 1, int_uid);
-
-        break;
-    }
-
-    case AST_literal_expr: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=lightblue, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        char* literal_name = "invalid literal type";
-
-        char literal_buffer[2048];
-
-        // determine what type of literal, and then emit the correct node.
-        switch (node.as_literal_expr->value.kind) {
-        case EV_BOOL: {
-            literal_name = "bool";
-            sprintf(literal_buffer, "%s", node.as_literal_expr->value.as_bool == true ? "true" : "false");
-            break;
-        }
-        case EV_STRING: {
-            literal_name = "string";
-            sprintf(literal_buffer, "%.1024s", clone_to_cstring(node.as_literal_expr->value.as_string));
-            break;
-        }
-        case EV_UNTYPED_INT: {
-            literal_name = "int";
-            sprintf(literal_buffer, "%d", node.as_literal_expr->value.as_untyped_int);
-            break;
-        }
-        case EV_UNTYPED_FLOAT: {
-            literal_name = "float";
-            sprintf(literal_buffer, "%lf", node.as_literal_expr->value.as_untyped_float);
-            break;
-        }
-        case EV_POINTER: {
-            literal_name = "pointer";
-            sprintf(literal_buffer, "null");
-            break;
-        }
-        default:
-        }
-
-        int int_uid = dot_uID();
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, literal_name, int_uid);
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < (n + 1); i++) fs_write(file, "\t", 1);
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=lightblue,label=\"%s\\n%s\"]\n", literal_name, int_uid, literal_name, literal_buffer);
-        fs_write(file, buffer, strlen(buffer));
-
-        break;
-    }
-
-    case AST_selector_expr: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=lightblue, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        int int_uid = dot_uID();
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_selector_expr->lhs.type], int_uid);
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_selector_expr->rhs.type], int_uid + 1);
-        fs_write(file, buffer, strlen(buffer));
-        // for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        recurse_dot(node.as_selector_expr->lhs, file, n + 1, int_uid);
-        recurse_dot(node.as_selector_expr->rhs, file, n + 1, int_uid + 1);
-        break;
-    }
-
-    case AST_import_stmt: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=lightblue, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        int int_uid = dot_uID();
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_import_stmt->name.type], int_uid);
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_import_stmt->path.type], int_uid + 1);
-        fs_write(file, buffer, strlen(buffer));
-        // for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        recurse_dot(node.as_import_stmt->name, file, n + 1, int_uid);
-        recurse_dot(node.as_import_stmt->path, file, n + 1, int_uid + 1);
-        break;
-    }
-
-    case AST_if_stmt: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=lightblue, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        int int_uid = dot_uID();
-
-        _dot_uID += 3;
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_if_stmt->condition.type], int_uid);
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_if_stmt->if_branch.type], int_uid + 1);
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "subgraph cluster%d {\n", dot_uID());
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "label=condition\n");
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "color=red\n");
-        fs_write(file, buffer, strlen(buffer));
-
-        recurse_dot(node.as_if_stmt->condition, file, n + 1, int_uid);
-
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-        fs_write(file, "}\n", 2);
-
-        sprintf(buffer, "subgraph cluster%d {\n", dot_uID());
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "label=\"if branch\"\n");
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "color=red\n");
-        fs_write(file, buffer, strlen(buffer));
-
-        recurse_dot(node.as_if_stmt->if_branch, file, n + 1, int_uid + 1);
-
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-        fs_write(file, "}\n", 2);
-
-        sprintf(buffer, "subgraph cluster%d {\n", dot_uID());
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "label=\"else branch\"\n");
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "color=red\n");
-        fs_write(file, buffer, strlen(buffer));
-
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-        fs_write(file, "}\n", 2);
-
-        break;
-    }
-
-    case AST_call_expr: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=lightblue, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        int int_uid = dot_uID();
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_call_expr->lhs.type], int_uid);
-        fs_write(file, buffer, strlen(buffer));
-        // for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        recurse_dot(node.as_call_expr->lhs, file, n + 1, int_uid);
-
-        sprintf(buffer, "subgraph cluster%d {\n", dot_uID());
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "label=params\n");
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "color=red\n");
-        fs_write(file, buffer, strlen(buffer));
-
-        for_urange(i, 0, node.as_call_expr->params.len) {
-            int_uid = dot_uID() + 1;
-            for (int i = 0; i < (n); i++) fs_write(file, "\t", 1);
-            sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_call_expr->params.at[i].type], int_uid);
-            fs_write(file, buffer, strlen(buffer));
-            recurse_dot(node.as_call_expr->params.at[i], file, n + 1, int_uid);
-        }
-
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-        fs_write(file, "}\n", 2);
-
-        break;
-    }
-
-    case AST_expr_stmt: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=lightblue, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_expr_stmt->expression.type], _dot_uID + 1);
-        fs_write(file, buffer, strlen(buffer));
-        recurse_dot(node.as_expr_stmt->expression, file, n + 1, dot_uID());
-
-        break;
-    }
-
-    case AST_for_stmt: {
-        general_warning("fuck! shit arse");
-        /*
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=lightblue, label=\"%s\"]\n",
-                ast_type_str[node.type], uid,
-                ast_type_str[node.type]); //write out identifier_expr with sugared name
-fs_write(file, buffer, strlen(buffer));
-for (int i = 0; i < n; i++) fs_write(file, "\t", 1); //fix tabs
-
-        int int_uid = dot_uID();
-        _dot_uID += 4;
-
-sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n",
-                ast_type_str[node.type], uid,
-                ast_type_str[node.as_for_stmt->prelude.type], int_uid);
-fs_write(file, buffer, strlen(buffer));
-for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n",
-                ast_type_str[node.type], uid,
-                ast_type_str[node.as_for_stmt->condition.type], int_uid + 1);
-fs_write(file, buffer, strlen(buffer));
-for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n",
-                ast_type_str[node.type], uid,
-                ast_type_str[node.as_for_stmt->update.type], int_uid + 2);
-fs_write(file, buffer, strlen(buffer));
-for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n",
-                ast_type_str[node.type], uid,
-                ast_type_str[node.as_for_stmt->block.type], int_uid + 3);
-fs_write(file, buffer, strlen(buffer));
-for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-recurse_dot(node.as_for_stmt->prelude, file, n+1, int_uid);
-recurse_dot(node.as_for_stmt->condition, file, n+1, int_uid + 1);
-        recurse_dot(node.as_for_stmt->update, file, n+1, int_uid + 2);
-recurse_dot(node.as_for_stmt->block, file, n+1, int_uid + 3);
-        */
-        break;
-    }
-
-    case AST_comp_literal_expr: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=lightblue, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        // for (int i = 0; i < n; i++) fs_write(file, "\t", 1); //fix tabs
-
-        for_urange(i, 0, node.as_comp_literal_expr->elems.len) {
-            int int_uid = dot_uID();
-            for (int i = 0; i < (n); i++) fs_write(file, "\t", 1);
-            sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_comp_literal_expr->elems.at[i].type], int_uid);
-            fs_write(file, buffer, strlen(buffer));
-            recurse_dot(node.as_comp_literal_expr->elems.at[i], file, n + 1, int_uid);
-        }
-
-        int int_uid = dot_uID();
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_comp_literal_expr->type.type], int_uid);
-        fs_write(file, buffer, strlen(buffer));
-        // for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        recurse_dot(node.as_comp_literal_expr->type, file, n + 1, int_uid);
-
-        break;
-    }
-
-    case AST_for_in_stmt: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=lightblue, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        int int_uid = dot_uID();
-        _dot_uID += 5;
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_for_in_stmt->indexvar.type], int_uid);
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_for_in_stmt->type.type], int_uid + 1);
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_for_in_stmt->to.type], int_uid + 2);
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_for_in_stmt->from.type], int_uid + 3);
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_for_in_stmt->block.type], int_uid + 4);
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        recurse_dot(node.as_for_in_stmt->indexvar, file, n + 1, int_uid);
-        recurse_dot(node.as_for_in_stmt->type, file, n + 1, int_uid + 1);
-        recurse_dot(node.as_for_in_stmt->to, file, n + 1, int_uid + 2);
-        recurse_dot(node.as_for_in_stmt->from, file, n + 1, int_uid + 3);
-        recurse_dot(node.as_for_in_stmt->block, file, n + 1, int_uid + 4);
-
-        break;
-    }
-
-    case AST_slice_type_expr: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=pink, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        int int_uid = dot_uID();
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_slice_type_expr->subexpr.type], int_uid);
-        fs_write(file, buffer, strlen(buffer));
-        // for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        recurse_dot(node.as_slice_type_expr->subexpr, file, n + 1, int_uid);
-
-        break;
-    }
-
-    case AST_slice_expr: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=lightblue, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        int int_uid = dot_uID();
-        _dot_uID += 3;
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_slice_expr->lhs.type], int_uid);
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_slice_expr->inside_left.type], int_uid + 1);
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_slice_expr->inside_right.type], int_uid + 2);
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        recurse_dot(node.as_slice_expr->lhs, file, n + 1, int_uid);
-        recurse_dot(node.as_slice_expr->inside_left, file, n + 1, int_uid + 1);
-        recurse_dot(node.as_slice_expr->inside_right, file, n + 1, int_uid + 2);
-
-        break;
-    }
-
-    case AST_type_decl_stmt: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=lightblue, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        int int_uid = dot_uID();
-        _dot_uID += 1;
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_type_decl_stmt->lhs.type], int_uid);
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_type_decl_stmt->rhs.type], int_uid + 1);
-        fs_write(file, buffer, strlen(buffer));
-        // for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-
-        recurse_dot(node.as_type_decl_stmt->lhs, file, n + 1, int_uid);
-        recurse_dot(node.as_type_decl_stmt->rhs, file, n + 1, int_uid + 1);
-        break;
-    }
-
-    case AST_struct_type_expr: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=pink, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        sprintf(buffer, "subgraph cluster%d {\n", dot_uID());
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < (n + 1); i++) fs_write(file, "\t", 1); // fix tabs
-
-        sprintf(buffer, "color=red\n");
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < (n + 1); i++) fs_write(file, "\t", 1);
-
-        sprintf(buffer, "label=fields\n");
-        fs_write(file, buffer, strlen(buffer));
-
-        for_urange(i, 0, node.as_struct_type_expr->fields.len) {
-            int int_uid = dot_uID();
-            for (int i = 0; i < (n + 1); i++) fs_write(file, "\t", 1);
-            sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_struct_type_expr->fields.at[i].type.type], int_uid);
-            fs_write(file, buffer, strlen(buffer));
-            recurse_dot(node.as_struct_type_expr->fields.at[i].type, file, n + 2, int_uid);
-        }
-
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1);
-        fs_write(file, "}\n", 2);
-
-        break;
-    }
-
-    case AST_distinct_type_expr: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=pink, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_distinct_type_expr->subexpr.type], _dot_uID + 1);
-        fs_write(file, buffer, strlen(buffer));
-        recurse_dot(node.as_distinct_type_expr->subexpr, file, n + 1, dot_uID());
-
-        break;
-    }
-
-    case AST_return_stmt: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=lightblue, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-
-        for_urange(i, 0, node.as_return_stmt->returns.len) {
-            int int_uid = dot_uID();
-            for (int i = 0; i < (n + 1); i++) fs_write(file, "\t", 1);
-            sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_return_stmt->returns.at[i].type], int_uid);
-            fs_write(file, buffer, strlen(buffer));
-            recurse_dot(node.as_return_stmt->returns.at[i], file, n + 1, int_uid);
-        }
-        break;
-    }
-
-    case AST_array_type_expr: {
-        sprintf(buffer, "\"%s_%d\" [shape=box,style=filled,color=lightblue, label=\"%s\"]\n", ast_type_str[node.type], uid,
-                ast_type_str[node.type]); // write out identifier_expr with sugared name
-        fs_write(file, buffer, strlen(buffer));
-        for (int i = 0; i < n; i++) fs_write(file, "\t", 1); // fix tabs
-        int int_uid = dot_uID();
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_array_type_expr->length.type], int_uid);
-
-        fs_write(file, buffer, strlen(buffer));
-        recurse_dot(node.as_array_type_expr->length, file, n + 1, int_uid);
-        int_uid = dot_uID();
-        sprintf(buffer, "\"%s_%d\" -> \"%s_%d\"\n", ast_type_str[node.type], uid, ast_type_str[node.as_array_type_expr->type.type], int_uid);
-
-        fs_write(file, buffer, strlen(buffer));
-        recurse_dot(node.as_array_type_expr->type, file, n + 1, int_uid);
-        break;
-    }
-
-    default: {
-        sprintf(buffer, "\"unimpl_%d\"->\"unimpl_%d\" unimpl_%d [shape=star,style=filled,color=yellow]", uid, uid, uid);
-        fs_write(file, buffer, strlen(buffer));
-
-        if (node.type < AST_COUNT) {
-            printf("encountered unimplemented node: %s\n", ast_type_str[node.type]);
-        } else {
-            printf("unimpl: %d\n", node.type);
-        }
-
-        break;
-    }
-    }
-
-    fs_write(file, "\n", 1);
-}
\ No newline at end of file
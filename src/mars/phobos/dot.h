@@ -2,7 +2,6 @@
 #define PHOBOS_DOT_H
 
 #include "common/orbit.h"
-#include "ast.h"
+#include "compact.h"
 
-void emit_dot(string path, da(AST) nodes);
-void recurse_dot(AST node, fs_file* file, int n, int uID);
\ No newline at end of file
+void emit_dot(string path, compact_ast* c);
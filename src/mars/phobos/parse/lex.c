@@ -1,11 +1,37 @@
 #include "common/orbit.h"
 #include "mars/term.h"
+#include "common/crash.h"
 #include "lex.h"
 
-#define can_start_identifier(ch) ((ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') || ch == '_')
-#define can_be_in_identifier(ch) ((ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') || (ch >= '0' && ch <= '9') || ch == '_')
-#define can_start_number(ch) ((ch >= '0' && ch <= '9'))
-#define valid_digit(ch) ((ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch == '_'))
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+enum {
+    CHAR_SPACE = 1 << 0,
+    CHAR_IDENT_START = 1 << 1,
+    CHAR_IDENT = 1 << 2,
+    CHAR_DIGIT = 1 << 3,
+};
+
+static const u8 char_class[256] = {
+    [' '] = CHAR_SPACE,
+    ['\t'] = CHAR_SPACE,
+    ['\n'] = CHAR_SPACE,
+    ['\r'] = CHAR_SPACE,
+    ['\v'] = CHAR_SPACE,
+    ['a' ... 'z'] = CHAR_IDENT_START | CHAR_IDENT,
+    ['A' ... 'Z'] = CHAR_IDENT_START | CHAR_IDENT,
+    ['_'] = CHAR_IDENT_START | CHAR_IDENT,
+    ['0' ... '9'] = CHAR_IDENT | CHAR_DIGIT,
+};
+
+#define char_is(ch, class) ((char_class[(u8)(ch)] & (class)) != 0)
+
+#define can_start_identifier(ch) char_is(ch, CHAR_IDENT_START)
+#define can_be_in_identifier(ch) char_is(ch, CHAR_IDENT)
+#define can_start_number(ch) char_is(ch, CHAR_DIGIT)
+#define valid_digit(ch) char_is(ch, CHAR_IDENT)
 
 #define valid_0x(ch) ((ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'f') || (ch >= 'A' && ch <= 'F') || (ch == '_'))
 #define valid_0d(ch) ((ch >= '0' && ch <= '9') || (ch == '_'))
@@ -28,10 +54,102 @@ int skip_block_comment(lexer* lex);
 void skip_until_char(lexer* lex, char c);
 void skip_whitespace(lexer* lex);
 
+// move the cursor straight to position, past the end means EOF like advance_char
+static inline void jump_to(lexer* lex, u64 position) {
+    if (position >= lex->src.len) {
+        lex->cursor = lex->src.len;
+        lex->current_char = '\0';
+        return;
+    }
+    lex->cursor = position;
+    lex->current_char = lex->src.raw[position];
+}
+
+/*
+    the scans below all return the position of the first byte at or after i
+    that stops them, or src.len. with sse2 they go 16 bytes at a time while
+    there are 16 bytes left, and finish byte by byte.
+*/
+
+#if defined(__SSE2__)
+#define for_each_chunk(src, i, chunk) for (__m128i chunk; (i) + 16 <= (src).len && ((chunk = _mm_loadu_si128((__m128i*)&(src).raw[i])), true); (i) += 16)
+#define byte_mask(v) ((u32)_mm_movemask_epi8(v))
+#define bytes_eq(chunk, c) _mm_cmpeq_epi8(chunk, _mm_set1_epi8(c))
+// lo <= byte <= hi, for ascii ranges. anything >= 0x80 is negative and never matches
+#define bytes_in(chunk, lo, hi) _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8((lo) - 1)), _mm_cmplt_epi8(chunk, _mm_set1_epi8((hi) + 1)))
+#endif
+
+static u64 span_whitespace(string src, u64 i) {
+    // most runs are nothing or a single space, don't bother loading a chunk for those
+    if (i < src.len && !char_is(src.raw[i], CHAR_SPACE)) return i;
+    if (i + 1 < src.len && !char_is(src.raw[i + 1], CHAR_SPACE)) return i + 1;
+#if defined(__SSE2__)
+    for_each_chunk(src, i, chunk) {
+        __m128i space = _mm_or_si128(bytes_eq(chunk, ' '), bytes_in(chunk, '\t', '\r')); // \t \n \v \f \r
+        space = _mm_andnot_si128(bytes_eq(chunk, '\f'), space);
+        u32 stop = ~byte_mask(space) & 0xFFFF;
+        if (stop != 0) return i + __builtin_ctz(stop);
+    }
+#endif
+    while (i < src.len && char_is(src.raw[i], CHAR_SPACE)) i++;
+    return i;
+}
+
+static u64 span_identifier(string src, u64 i) {
+#if defined(__SSE2__)
+    for_each_chunk(src, i, chunk) {
+        __m128i lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+        __m128i ident = _mm_or_si128(bytes_in(lower, 'a', 'z'), bytes_in(chunk, '0', '9'));
+        ident = _mm_or_si128(ident, bytes_eq(chunk, '_'));
+        u32 stop = ~byte_mask(ident) & 0xFFFF;
+        if (stop != 0) return i + __builtin_ctz(stop);
+    }
+#endif
+    while (i < src.len && char_is(src.raw[i], CHAR_IDENT)) i++;
+    return i;
+}
+
+static u64 find_char(string src, u64 i, char c) {
+#if defined(__SSE2__)
+    for_each_chunk(src, i, chunk) {
+        u32 stop = byte_mask(bytes_eq(chunk, c));
+        if (stop != 0) return i + __builtin_ctz(stop);
+    }
+#endif
+    while (i < src.len && src.raw[i] != c) i++;
+    return i;
+}
+
+// either character
+static u64 find_char2(string src, u64 i, char a, char b) {
+#if defined(__SSE2__)
+    for_each_chunk(src, i, chunk) {
+        u32 stop = byte_mask(_mm_or_si128(bytes_eq(chunk, a), bytes_eq(chunk, b)));
+        if (stop != 0) return i + __builtin_ctz(stop);
+    }
+#endif
+    while (i < src.len && src.raw[i] != a && src.raw[i] != b) i++;
+    return i;
+}
+
+// the end of a string literal body, an escape, or a newline
+static u64 find_string_stop(string src, u64 i, char quote) {
+#if defined(__SSE2__)
+    for_each_chunk(src, i, chunk) {
+        __m128i stop_bytes = _mm_or_si128(bytes_eq(chunk, quote), bytes_eq(chunk, '\\'));
+        u32 stop = byte_mask(_mm_or_si128(stop_bytes, bytes_eq(chunk, '\n')));
+        if (stop != 0) return i + __builtin_ctz(stop);
+    }
+#endif
+    while (i < src.len && src.raw[i] != quote && src.raw[i] != '\\' && src.raw[i] != '\n') i++;
+    return i;
+}
+
 token_type scan_ident_or_keyword(lexer* lex);
 token_type scan_number(lexer* lex);
 token_type scan_string_or_char(lexer* lex);
 token_type scan_operator(lexer* lex);
+static void fill_keyword_slots();
 
 char* token_type_str[] = {
 #define TOKEN(enum, str) str,
@@ -39,7 +157,60 @@ char* token_type_str[] = {
 #undef TOKEN
 };
 
+// every finished token buffer and the file it came from, sorted by address
+typedef struct token_owner {
+    token* start;
+    token* end;
+    string src;
+} token_owner;
+
+da_typedef(token_owner);
+
+static da(token_owner) token_owners;
+static _Thread_local token_owner last_owner;
+
+static void add_token_owner(token* start, token* end, string src) {
+    if (token_owners.at == NULL) da_init(&token_owners, 16);
+
+    size_t i = token_owners.len;
+    da_append(&token_owners, ((token_owner){0}));
+    for (; i > 0 && token_owners.at[i - 1].start > start; i--) {
+        token_owners.at[i] = token_owners.at[i - 1];
+    }
+    token_owners.at[i] = (token_owner){start, end, src};
+}
+
+string token_source(token* tok) {
+    if (last_owner.start <= tok && tok < last_owner.end) return last_owner.src;
+
+    size_t lo = 0;
+    size_t hi = token_owners.len;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (tok < token_owners.at[mid].start) hi = mid;
+        else if (tok >= token_owners.at[mid].end) lo = mid + 1;
+        else {
+            last_owner = token_owners.at[mid];
+            return last_owner.src;
+        }
+    }
+    CRASH("token does not belong to any lexed file");
+}
+
+string token_text(token* tok) {
+    return token_text_in(token_source(tok), *tok);
+}
+
 lexer new_lexer(string path, string src) {
+    // tokens only have 32 bits of offset
+    if (src.len > UINT32_MAX) general_error("\"" str_fmt "\" is too big", str_arg(path));
+
+    static bool keywords_ready = false;
+    if (!keywords_ready) {
+        fill_keyword_slots();
+        keywords_ready = true;
+    }
+
     lexer lex = {0};
     lex.path = path;
     lex.src = src;
@@ -58,6 +229,7 @@ void construct_token_buffer(lexer* lex) {
     } while (lex->buffer.at[lex->buffer.len - 1].type != TOK_EOF);
 
     da_shrink(&lex->buffer);
+    add_token_owner(lex->buffer.at, lex->buffer.at + lex->buffer.len, lex->src);
 }
 
 void append_next_token(lexer* lex) {
@@ -69,36 +241,25 @@ void append_next_token(lexer* lex) {
 
     // advance to next significant char
     while (true) {
-        if (lex->cursor >= lex->src.len) goto skip_insignificant_end;
-        switch (current_char(lex)) {
-        case ' ':
-        case '\t':
-        case '\n':
-        case '\r':
-        case '\v':
-            advance_char(lex);
-            continue;
-        case '/':
-            if (peek_char(lex, 1) == '/') {
-                skip_until_char(lex, '\n');
-            } else if (peek_char(lex, 1) == '*') {
-                advance_char_n(lex, 2);
-                int final_level = skip_block_comment(lex);
-                if (final_level != 0) {
-                    error_at_string(lex->path, lex->src, string_make(&lex->src.raw[lex->cursor], 1), "unclosed block comment");
-                }
-            } else goto skip_insignificant_end;
-            continue;
-        default:
-            goto skip_insignificant_end;
-        }
+        jump_to(lex, span_whitespace(lex->src, lex->cursor));
+        if (lex->cursor >= lex->src.len) break;
+        if (current_char(lex) != '/') break;
+
+        if (peek_char(lex, 1) == '/') {
+            skip_until_char(lex, '\n');
+        } else if (peek_char(lex, 1) == '*') {
+            jump_to(lex, lex->cursor + 2);
+            int final_level = skip_block_comment(lex);
+            if (final_level != 0) {
+                error_at_string(lex->path, lex->src, NULL, string_make(&lex->src.raw[lex->cursor], 1), "unclosed block comment");
+            }
+        } else break;
     }
-skip_insignificant_end:
 
     if (lex->cursor >= lex->src.len) {
         da_append(
             &lex->buffer,
-            ((token){substring_len(lex->src, lex->cursor, 1), TOK_EOF})
+            ((token){.offset = lex->cursor, .len = 0, .type = TOK_EOF})
         );
         return;
     }
@@ -115,81 +276,122 @@ skip_insignificant_end:
         this_type = scan_operator(lex);
     }
 
+    if (lex->cursor - beginning_cursor > TOKEN_MAX_LEN) {
+        error_at_string(lex->path, lex->src, NULL, substring(lex->src, beginning_cursor, lex->cursor), "token is longer than %d characters", TOKEN_MAX_LEN);
+    }
+
     da_append(&lex->buffer, ((token){
-                                .text = substring(lex->src, beginning_cursor, lex->cursor),
+                                .offset = beginning_cursor,
+                                .len = lex->cursor - beginning_cursor,
                                 .type = this_type,
                             }));
 }
 
+typedef struct keyword {
+    string text;
+    token_type type;
+} keyword;
+
+#define KEYWORD(text, type) {{(char*)(text), sizeof(text) - 1}, type}
+
+static const keyword keywords[] = {
+    KEYWORD("_", TOK_IDENTIFIER_DISCARD),
+
+    KEYWORD("int", TOK_TYPE_KEYWORD_INT),
+    KEYWORD("i8", TOK_TYPE_KEYWORD_I8),
+    KEYWORD("i16", TOK_TYPE_KEYWORD_I16),
+    KEYWORD("i32", TOK_TYPE_KEYWORD_I32),
+    KEYWORD("i64", TOK_TYPE_KEYWORD_I64),
+    KEYWORD("uint", TOK_TYPE_KEYWORD_UINT),
+    KEYWORD("u8", TOK_TYPE_KEYWORD_U8),
+    KEYWORD("u16", TOK_TYPE_KEYWORD_U16),
+    KEYWORD("u32", TOK_TYPE_KEYWORD_U32),
+    KEYWORD("u64", TOK_TYPE_KEYWORD_U64),
+    KEYWORD("bool", TOK_TYPE_KEYWORD_BOOL),
+    KEYWORD("float", TOK_TYPE_KEYWORD_FLOAT),
+    KEYWORD("f16", TOK_TYPE_KEYWORD_F16),
+    KEYWORD("f32", TOK_TYPE_KEYWORD_F32),
+    KEYWORD("f64", TOK_TYPE_KEYWORD_F64),
+
+    KEYWORD("true", TOK_LITERAL_BOOL),
+    KEYWORD("false", TOK_LITERAL_BOOL),
+    KEYWORD("null", TOK_LITERAL_NULL),
+
+    KEYWORD("let", TOK_KEYWORD_LET),
+    KEYWORD("mut", TOK_KEYWORD_MUT),
+    KEYWORD("def", TOK_KEYWORD_DEF),
+    KEYWORD("type", TOK_KEYWORD_TYPE),
+    KEYWORD("if", TOK_KEYWORD_IF),
+    KEYWORD("in", TOK_KEYWORD_IN),
+    KEYWORD("elif", TOK_KEYWORD_ELIF),
+    KEYWORD("else", TOK_KEYWORD_ELSE),
+    KEYWORD("for", TOK_KEYWORD_FOR),
+    KEYWORD("fn", TOK_KEYWORD_FN),
+    KEYWORD("break", TOK_KEYWORD_BREAK),
+    KEYWORD("continue", TOK_KEYWORD_CONTINUE),
+    KEYWORD("case", TOK_KEYWORD_CASE),
+    KEYWORD("cast", TOK_KEYWORD_CAST),
+    KEYWORD("defer", TOK_KEYWORD_DEFER),
+    KEYWORD("distinct", TOK_KEYWORD_DISTINCT),
+    KEYWORD("do", TOK_KEYWORD_DO),
+    KEYWORD("enum", TOK_KEYWORD_ENUM),
+    KEYWORD("extern", TOK_KEYWORD_EXTERN),
+    KEYWORD("asm", TOK_KEYWORD_ASM),
+    KEYWORD("bitcast", TOK_KEYWORD_BITCAST),
+    KEYWORD("import", TOK_KEYWORD_IMPORT),
+    KEYWORD("fallthrough", TOK_KEYWORD_FALLTHROUGH),
+    KEYWORD("module", TOK_KEYWORD_MODULE),
+    KEYWORD("return", TOK_KEYWORD_RETURN),
+    KEYWORD("struct", TOK_KEYWORD_STRUCT),
+    KEYWORD("switch", TOK_KEYWORD_SWITCH),
+    KEYWORD("union", TOK_KEYWORD_UNION),
+    KEYWORD("while", TOK_KEYWORD_WHILE),
+    KEYWORD("inline", TOK_KEYWORD_INLINE),
+    KEYWORD("sizeof", TOK_KEYWORD_SIZEOF),
+    KEYWORD("alignof", TOK_KEYWORD_ALIGNOF),
+    KEYWORD("offsetof", TOK_KEYWORD_OFFSETOF),
+};
+
+#undef KEYWORD
+
+#define KEYWORD_MAX_LEN 11 // fallthrough
+#define KEYWORD_SLOTS   256
+
+// open addressing on the length and the first and last characters
+static const keyword* keyword_slots[KEYWORD_SLOTS];
+
+static inline u32 keyword_hash(string word) {
+    return ((u32)(u8)word.raw[0] * 31 + (u32)(u8)word.raw[word.len - 1] * 7 + (u32)word.len) & (KEYWORD_SLOTS - 1);
+}
+
+static void fill_keyword_slots() {
+    for_urange(i, 0, sizeof(keywords) / sizeof(keywords[0])) {
+        u32 slot = keyword_hash(keywords[i].text);
+        while (keyword_slots[slot] != NULL) slot = (slot + 1) & (KEYWORD_SLOTS - 1);
+        keyword_slots[slot] = &keywords[i];
+    }
+}
+
 token_type scan_ident_or_keyword(lexer* lex) {
     u64 beginning = lex->cursor;
 
-    advance_char(lex);
-    while (can_be_in_identifier(current_char(lex))) advance_char(lex);
+    jump_to(lex, span_identifier(lex->src, beginning + 1));
 
     string word = substring(lex->src, beginning, lex->cursor);
 
-    if (string_eq(word, constr("_"))) return TOK_IDENTIFIER_DISCARD;
-
-    if (string_eq(word, constr("int"))) return TOK_TYPE_KEYWORD_INT;
-    if (string_eq(word, constr("i8"))) return TOK_TYPE_KEYWORD_I8;
-    if (string_eq(word, constr("i16"))) return TOK_TYPE_KEYWORD_I16;
-    if (string_eq(word, constr("i32"))) return TOK_TYPE_KEYWORD_I32;
-    if (string_eq(word, constr("i64"))) return TOK_TYPE_KEYWORD_I64;
-    if (string_eq(word, constr("uint"))) return TOK_TYPE_KEYWORD_UINT;
-    if (string_eq(word, constr("u8"))) return TOK_TYPE_KEYWORD_U8;
-    if (string_eq(word, constr("u16"))) return TOK_TYPE_KEYWORD_U16;
-    if (string_eq(word, constr("u32"))) return TOK_TYPE_KEYWORD_U32;
-    if (string_eq(word, constr("u64"))) return TOK_TYPE_KEYWORD_U64;
-    if (string_eq(word, constr("bool"))) return TOK_TYPE_KEYWORD_BOOL;
-    if (string_eq(word, constr("float"))) return TOK_TYPE_KEYWORD_FLOAT;
-    if (string_eq(word, constr("f16"))) return TOK_TYPE_KEYWORD_F16;
-    if (string_eq(word, constr("f32"))) return TOK_TYPE_KEYWORD_F32;
-    if (string_eq(word, constr("f64"))) return TOK_TYPE_KEYWORD_F64;
-
-    if (string_eq(word, constr("true"))) return TOK_LITERAL_BOOL;
-    if (string_eq(word, constr("false"))) return TOK_LITERAL_BOOL;
-    if (string_eq(word, constr("null"))) return TOK_LITERAL_NULL;
-
-    if (string_eq(word, constr("let"))) return TOK_KEYWORD_LET;
-    if (string_eq(word, constr("mut"))) return TOK_KEYWORD_MUT;
-    if (string_eq(word, constr("def"))) return TOK_KEYWORD_DEF;
-    if (string_eq(word, constr("type"))) return TOK_KEYWORD_TYPE;
-    if (string_eq(word, constr("if"))) return TOK_KEYWORD_IF;
-    if (string_eq(word, constr("in"))) return TOK_KEYWORD_IN;
-    if (string_eq(word, constr("elif"))) return TOK_KEYWORD_ELIF;
-    if (string_eq(word, constr("else"))) return TOK_KEYWORD_ELSE;
-    if (string_eq(word, constr("for"))) return TOK_KEYWORD_FOR;
-    if (string_eq(word, constr("fn"))) return TOK_KEYWORD_FN;
-    if (string_eq(word, constr("break"))) return TOK_KEYWORD_BREAK;
-    if (string_eq(word, constr("continue"))) return TOK_KEYWORD_CONTINUE;
-    if (string_eq(word, constr("case"))) return TOK_KEYWORD_CASE;
-    if (string_eq(word, constr("cast"))) return TOK_KEYWORD_CAST;
-    if (string_eq(word, constr("defer"))) return TOK_KEYWORD_DEFER;
-    if (string_eq(word, constr("distinct"))) return TOK_KEYWORD_DISTINCT;
-    if (string_eq(word, constr("do"))) return TOK_KEYWORD_DO;
-    if (string_eq(word, constr("enum"))) return TOK_KEYWORD_ENUM;
-    if (string_eq(word, constr("extern"))) return TOK_KEYWORD_EXTERN;
-    if (string_eq(word, constr("asm"))) return TOK_KEYWORD_ASM;
-    if (string_eq(word, constr("bitcast"))) return TOK_KEYWORD_BITCAST;
-    if (string_eq(word, constr("import"))) return TOK_KEYWORD_IMPORT;
-    if (string_eq(word, constr("fallthrough"))) return TOK_KEYWORD_FALLTHROUGH;
-    if (string_eq(word, constr("module"))) return TOK_KEYWORD_MODULE;
-    if (string_eq(word, constr("return"))) return TOK_KEYWORD_RETURN;
-    if (string_eq(word, constr("struct"))) return TOK_KEYWORD_STRUCT;
-    if (string_eq(word, constr("switch"))) return TOK_KEYWORD_SWITCH;
-    if (string_eq(word, constr("union"))) return TOK_KEYWORD_UNION;
-    if (string_eq(word, constr("while"))) return TOK_KEYWORD_WHILE;
-    if (string_eq(word, constr("inline"))) return TOK_KEYWORD_INLINE;
-    if (string_eq(word, constr("sizeof"))) return TOK_KEYWORD_SIZEOF;
-    if (string_eq(word, constr("alignof"))) return TOK_KEYWORD_ALIGNOF;
-    if (string_eq(word, constr("offsetof"))) return TOK_KEYWORD_OFFSETOF;
+    if (word.len > KEYWORD_MAX_LEN) return TOK_IDENTIFIER;
+    for (u32 slot = keyword_hash(word);; slot = (slot + 1) & (KEYWORD_SLOTS - 1)) {
+        const keyword* kw = keyword_slots[slot];
+        if (kw == NULL) break;
+        if (string_eq(kw->text, word)) return kw->type;
+    }
 
     return TOK_IDENTIFIER;
 }
 
 token_type scan_number(lexer* lex) {
-    advance_char(lex);
+    // digits, and the letters of hex literals and suffixes, are all identifier characters
+    jump_to(lex, span_identifier(lex->src, lex->cursor + 1));
     while (true) {
         if (current_char(lex) == '.') {
 
@@ -221,16 +423,17 @@ token_type scan_string_or_char(lexer* lex) {
 
     advance_char(lex);
     while (true) {
-        if (current_char(lex) == '\\') {
-            advance_char(lex);
-        } else if (current_char(lex) == quote_char) {
+        jump_to(lex, find_string_stop(lex->src, lex->cursor, quote_char));
+        if (lex->cursor >= lex->src.len || current_char(lex) == '\n') {
+            if (quote_char == '\"') error_at_string(lex->path, lex->src, NULL, substring(lex->src, start_cursor, lex->cursor), "unclosed string literal");
+            if (quote_char == '\'') error_at_string(lex->path, lex->src, NULL, substring(lex->src, start_cursor, lex->cursor), "unclosed char literal");
+        }
+        if (current_char(lex) == quote_char) {
             advance_char(lex);
             return quote_char == '\"' ? TOK_LITERAL_STRING : TOK_LITERAL_CHAR;
-        } else if (current_char(lex) == '\n') {
-            if (quote_char == '\"') error_at_string(lex->path, lex->src, substring(lex->src, start_cursor, lex->cursor), "unclosed string literal");
-            if (quote_char == '\'') error_at_string(lex->path, lex->src, substring(lex->src, start_cursor, lex->cursor), "unclosed char literal");
         }
-        advance_char(lex);
+        // skip the escape and whatever it escapes
+        jump_to(lex, lex->cursor + 2);
     }
 }
 token_type scan_operator(lexer* lex) {
@@ -408,7 +611,7 @@ token_type scan_operator(lexer* lex) {
     case '}': advance_char(lex); return TOK_CLOSE_BRACE;
 
     default:
-        error_at_string(lex->path, lex->src, substring_len(lex->src, lex->cursor, 1), "unrecognized character");
+        error_at_string(lex->path, lex->src, NULL, substring_len(lex->src, lex->cursor, 1), "unrecognized character");
         break;
     }
     return TOK_INVALID;
@@ -417,11 +620,12 @@ token_type scan_operator(lexer* lex) {
 int skip_block_comment(lexer* lex) {
     int level = 1;
     while (level != 0) {
+        jump_to(lex, find_char2(lex->src, lex->cursor, '/', '*'));
         if (lex->cursor >= lex->src.len) {
             break;
         }
         if (current_char(lex) == '/' && peek_char(lex, 1) == '*') {
-            advance_char_n(lex, 2);
+            jump_to(lex, lex->cursor + 2);
             level++;
         } else if (current_char(lex) == '*' && peek_char(lex, 1) == '/') {
             advance_char(lex);
@@ -434,17 +638,9 @@ int skip_block_comment(lexer* lex) {
 }
 
 void skip_until_char(lexer* lex, char c) {
-    while (current_char(lex) != c && lex->cursor < lex->src.len) {
-        advance_char(lex);
-    }
+    jump_to(lex, find_char(lex->src, lex->cursor, c));
 }
 
 void skip_whitespace(lexer* lex) {
-    while (true) {
-        char r = current_char(lex);
-        if ((r != ' ' && r != '\t' && r != '\n' && r != '\r' && r != '\v') || lex->cursor >= lex->src.len) {
-            return;
-        }
-        advance_char(lex);
-    }
+    jump_to(lex, span_whitespace(lex->src, lex->cursor));
 }
@@ -147,13 +147,24 @@ enum {
 
 extern char* token_type_str[];
 
+// packed into 8 bytes, the text stays in the source file.
+// use token_text() for tokens in a lexed buffer, token_text_in() for copies
 typedef struct token_s {
-    string text;
+    u32 offset; // into the source file
+    u16 len;
     token_type type;
 } token;
 
 da_typedef(token);
 
+#define TOKEN_MAX_LEN UINT16_MAX
+
+#define token_text_in(src, tok) ((string){(src).raw + (tok).offset, (tok).len})
+
+// source of the file a token buffer was lexed from, tok must point into one
+string token_source(token* tok);
+string token_text(token* tok);
+
 typedef struct lexer_s {
     string src;
     string path;
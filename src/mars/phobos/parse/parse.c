@@ -15,7 +15,7 @@
 
 //TODO: fix string and char literals so we handle escape sequences
 
-// #define debug_trace(p) printf("stack -> %s @ %zu '" str_fmt "'\n", __func__, (p)->current_tok, str_arg((p)->tokens.at[(p)->current_tok].text))
+// #define debug_trace(p) printf("stack -> %s @ %zu '" str_fmt "'\n", __func__, (p)->current_tok, str_arg(token_text_in((p)->src, (p)->tokens.at[(p)->current_tok])))
 #define debug_trace(p)
 
 // construct a parser struct from a lexer and an arena allocator
@@ -709,8 +709,8 @@ AST parse_atomic_expr_term(parser* p) {
         n.as_literal_expr->base.start = &current_token(p);
         // if TOK_LITERAL_STRING, we trim out ""
         if (current_token(p).type == TOK_LITERAL_STRING) {
-            current_token(p).text.raw += 1;
-            current_token(p).text.len -= 2; // FIXME: is this correct? i think so, but it feels bad.
+            current_token(p).offset += 1;
+            current_token(p).len -= 2; // FIXME: is this correct? i think so, but it feels bad.
         }
         n.as_literal_expr->tok = &current_token(p);
         n.as_literal_expr->base.end = &current_token(p);
@@ -49,16 +49,17 @@ void parse_file(parser* p);
 #define advance_token(p) (((p)->current_tok + 1 < (p)->tokens.len) ? ((p)->current_tok)++ : 0)
 #define advance_n_tok(p, n) (((p)->current_tok + n < (p)->tokens.len) ? ((p)->current_tok) += n : 0)
 
-#define str_from_tokens(start, end) ((string){(start).text.raw, (end).text.raw - (start).text.raw + (end).text.len})
+// start and end must be in a lexed token buffer
+#define str_from_tokens(start, end) ((string){token_source(&(start)).raw + (start).offset, (end).offset - (start).offset + (end).len})
 
 #define error_at_parser(p, message, ...) \
-    error_at_string((p)->path, (p)->src, current_token(p).text, message __VA_OPT__(, ) __VA_ARGS__)
+    error_at_string((p)->path, (p)->src, NULL, token_text_in((p)->src, current_token(p)), message __VA_OPT__(, ) __VA_ARGS__)
 
 #define error_at_token_index(p, index, message, ...) \
-    error_at_string((p)->path, (p)->src, (p)->tokens.at[index].text, message __VA_OPT__(, ) __VA_ARGS__)
+    error_at_string((p)->path, (p)->src, NULL, token_text_in((p)->src, (p)->tokens.at[index]), message __VA_OPT__(, ) __VA_ARGS__)
 
 #define error_at_token(p, token, message, ...) \
-    error_at_string((p)->path, (p)->src, (token).text, message __VA_OPT__(, ) __VA_ARGS__)
+    error_at_string((p)->path, (p)->src, NULL, token_text_in((p)->src, token), message __VA_OPT__(, ) __VA_ARGS__)
 
 #define error_at_AST(p, node, message, ...) \
-    error_at_string((p)->path, (p)->src, str_from_tokens(*((node).base->start), *((node).base->end)), message __VA_OPT__(, ) __VA_ARGS__)
+    error_at_string((p)->path, (p)->src, NULL, str_from_tokens(*((node).base->start), *((node).base->end)), message __VA_OPT__(, ) __VA_ARGS__)
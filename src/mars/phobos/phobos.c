@@ -8,116 +8,152 @@
 #include "parse/parse.h"
 #include "analysis/sema.h"
 #include "ast.h"
+#include "cache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
 
 module_list active_modules;
 
-da(cstring) cwd_stack;
+/*tune this probably*/
+#define PARSER_ARENA_SIZE 0x100000
 
-void restore_cwd() {
-    if (cwd_stack.len == 0) {
-        CRASH("cwd_stack popped at len == 0");
+string search_for_module(mars_module* mod, string relpath) {
+    // search locally first, then next to the importing module, then from the cwd
+    string candidates[3] = {
+        strprintf(str_fmt "/" str_fmt, str_arg(mod->module_path), str_arg(relpath)),
+        strprintf(str_fmt "/../" str_fmt, str_arg(mod->module_path), str_arg(relpath)),
+        relpath,
+    };
+    for_range(i, 0, 3) {
+        if (!fs_exists(candidates[i])) continue;
+        string mod_realpath = string_alloc(PATH_MAX);
+        realpath(clone_to_cstring(candidates[i]), mod_realpath.raw);
+        mod_realpath.len = strlen(mod_realpath.raw);
+        return mod_realpath;
     }
 
-    char* cwd = cwd_stack.at[cwd_stack.len - 1];
-
-    chdir(cwd);
-    da_pop(&cwd_stack);
+    return NULL_STR;
 }
 
-void change_cwd(char* dir) {
-    if (cwd_stack.at == NULL) {
-        da_init(&cwd_stack, 1);
+// hashes the name, size and mtime of every .mars file in an open directory
+static u64 stamp_dir(int dir_fd) {
+    // the dup shares its position with dir_fd, so start from the top
+    DIR* dir = fdopendir(dup(dir_fd));
+    if (dir == NULL) return 0;
+    rewinddir(dir);
+
+    u64 stamp = 0;
+    for (struct dirent* entry = readdir(dir); entry != NULL; entry = readdir(dir)) {
+        string name = str(entry->d_name);
+        if (!string_ends_with(name, str(".mars"))) continue;
+
+        struct stat statbuf;
+        if (fstatat(dir_fd, entry->d_name, &statbuf, 0) != 0) continue;
+
+        // files come in directory order, so sum instead of chaining
+        u64 h = FNV_1a(name);
+        h ^= (u64)statbuf.st_size * 0x9e3779b97f4a7c15ull;
+        h ^= (u64)statbuf.st_mtim.tv_sec * 0xbf58476d1ce4e5b9ull;
+        h ^= (u64)statbuf.st_mtim.tv_nsec * 0x94d049bb133111ebull;
+        stamp += h;
     }
+    closedir(dir);
+    return stamp == 0 ? 1 : stamp; // 0 means gone
+}
 
-    // relying on gnu behavior, this may cause a problem
-    char* cwd = getcwd(NULL, 0);
-    da_append(&cwd_stack, cwd);
+// so the compile server can tell when a module needs parsing again
+u64 module_stamp(string path) {
+    char* dir_cstr = clone_to_cstring(path);
+    int dir_fd = open(dir_cstr, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    mars_free(dir_cstr);
+    if (dir_fd < 0) return 0;
 
-    chdir(dir);
+    u64 stamp = stamp_dir(dir_fd);
+    close(dir_fd);
+    return stamp;
 }
 
-/*tune this probably*/
-#define PARSER_ARENA_SIZE 0x100000
+// maps a source file read only, the lexer works on it in place.
+// the mapping lives as long as the module, so it's never unmapped
+static string map_source(int dir_fd, char* name) {
+    int fd = openat(dir_fd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL_STR;
 
-string search_for_module(mars_module* mod, string relpath) {
-    // search locally first
-    change_cwd(clone_to_cstring(mod->module_path));
-    if (fs_exists(relpath)) {
-        string mod_realpath = string_alloc(PATH_MAX);
-        realpath(clone_to_cstring(relpath), mod_realpath.raw);
-        restore_cwd();
-        return mod_realpath;
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) != 0) {
+        close(fd);
+        return NULL_STR;
     }
-    restore_cwd();
 
-    // look in cwd
-    if (fs_exists(relpath)) {
-        string mod_realpath = string_alloc(PATH_MAX);
-        realpath(clone_to_cstring(relpath), mod_realpath.raw);
-        return mod_realpath;
+    // mmap won't map nothing
+    if (statbuf.st_size == 0) {
+        close(fd);
+        return constr("");
     }
 
-    return NULL_STR;
+    void* map = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL_STR;
+    posix_madvise(map, statbuf.st_size, POSIX_MADV_SEQUENTIAL);
+    return (string){map, statbuf.st_size};
 }
 
 mars_module* parse_module(string input_path) {
 
-    // path checks
-    if (!fs_exists(input_path))
-        general_error("module \"" str_fmt "\" does not exist", str_arg(input_path));
-
-    fs_file input_dir = {0};
-    fs_get(input_path, &input_dir);
-    if (!fs_is_directory(&input_dir)) {
-        general_error("path \"" str_fmt "\" is not a directory", str_arg(input_path));
+    // the compile server keeps modules around between builds
+    foreach (mars_module* mod, active_modules) {
+        if (string_eq(mod->module_path, input_path)) return mod;
     }
 
-    int subfile_count = fs_subfile_count(&input_dir);
-    if (subfile_count == 0) {
-        general_error("path \"" str_fmt "\" has no files", str_arg(input_path));
+    char* input_cstr = clone_to_cstring(input_path);
+    int dir_fd = open(input_cstr, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) {
+        if (errno == ENOTDIR) general_error("path \"" str_fmt "\" is not a directory", str_arg(input_path));
+        general_error("module \"" str_fmt "\" does not exist", str_arg(input_path));
     }
+    char dir_realpath[PATH_MAX];
+    realpath(input_cstr, dir_realpath);
+    mars_free(input_cstr);
 
-    fs_file* subfiles = mars_alloc(sizeof(fs_file) * subfile_count);
-    fs_get_subfiles(&input_dir, subfiles);
+    // before reading anything, so an edit mid-read still looks stale
+    u64 stamp = stamp_dir(dir_fd);
 
-    change_cwd(clone_to_cstring(input_path));
+    DIR* dir = fdopendir(dup(dir_fd));
+    if (dir == NULL) {
+        close(dir_fd);
+        general_error("cannot read directory \"" str_fmt "\"", str_arg(input_path));
+    }
+    rewinddir(dir);
 
     da(lexer) lexers;
-    da_init(&lexers, subfile_count);
+    da_init(&lexers, 8);
 
     int mars_file_count = 0;
-    for_range(i, 0, subfile_count) {
+    for (struct dirent* entry = readdir(dir); entry != NULL; entry = readdir(dir)) {
 
         // filter out non-files and non-mars files.
-        if (!fs_is_regular(&subfiles[i])) continue;
-        if (!string_ends_with(subfiles[i].path, str(".mars"))) continue;
+        if (!string_ends_with(str(entry->d_name), str(".mars"))) continue;
+        struct stat statbuf;
+        if (fstatat(dir_fd, entry->d_name, &statbuf, 0) != 0 || !S_ISREG(statbuf.st_mode)) continue;
 
         mars_file_count++;
 
-        string loaded_file;
-
-        // stop the lexer from shitting itself
-        if (subfiles[i].size == 0)
-            loaded_file = string_clone(str(" \n "));
-        else
-            loaded_file = string_alloc(subfiles[i].size);
-
-        fs_open(&subfiles[i], "rb");
-
-        bool read_success = true;
-        if (subfiles[i].size != 0) {
-            read_success = fs_read(&subfiles[i], loaded_file.raw, subfiles[i].size);
+        string path = strprintf("%s/%s", dir_realpath, entry->d_name);
+        string loaded_file = map_source(dir_fd, entry->d_name);
+        if (is_null_str(loaded_file)) {
+            closedir(dir);
+            close(dir_fd);
+            general_error("cannot read from \"" str_fmt "\"", str_arg(path));
         }
 
-        fs_close(&subfiles[i]);
-
-        if (read_success == false)
-            general_error("cannot read from \"" str_fmt "\"", str_arg(subfiles[i].path));
-
-        lexer this_lexer = new_lexer(subfiles[i].path, loaded_file);
+        lexer this_lexer = new_lexer(path, loaded_file);
 
         da_append(&lexers, this_lexer);
     }
+    closedir(dir);
+    close(dir_fd);
+
     if (mars_file_count == 0)
         general_error("path \"" str_fmt "\" has no \".mars\" files", str_arg(input_path));
 
@@ -142,8 +178,6 @@ mars_module* parse_module(string input_path) {
         printf("\t  tok/s     : %.3f\n", (double)tokens_lexed / elapsed);
     }
 
-    restore_cwd();
-
     da(parser) parsers;
     da_init(&parsers, lexers.len);
 
@@ -168,6 +202,7 @@ mars_module* parse_module(string input_path) {
 
     mars_module* module = create_module(&parsers, alloca);
     module->module_path = input_path;
+    module->stamp = stamp;
     module->visited = true;
 
     if (active_modules.at == NULL) {
@@ -192,7 +227,7 @@ mars_module* parse_module(string input_path) {
         if (module->program_tree.at[i].type == AST_import_stmt) {
             string importpath = search_for_module(
                 module,
-                module->program_tree.at[i].as_import_stmt->path.as_literal_expr->tok->text
+                token_text(module->program_tree.at[i].as_import_stmt->path.as_literal_expr->tok)
             );
 
             // does module exist?
@@ -210,7 +245,7 @@ mars_module* parse_module(string input_path) {
             module->program_tree.at[i].as_import_stmt->realpath = importpath;
             // we need to setup module identifiers carefully, since sometimes they'll be the blank _.
             /*            if (module->program_tree.at[i].as_import_stmt->name.type == AST_identifier) {
-                            module->module_identifier = module->program_tree.at[i].as_import_stmt->name.as_identifier->tok->text;
+                            module->module_identifier = token_text(module->program_tree.at[i].as_import_stmt->name.as_identifier->tok);
                         } else {
                             //no name, so they get _ as a name
                             module->module_identifier = string_clone(constr("_"));
@@ -239,10 +274,8 @@ mars_module* parse_module(string input_path) {
 
     module->visited = false;
 
-    // cleanup
-    // for_range(i, 0, subfile_count) fs_drop(&subfiles[i]);
-    // mars_free(subfiles);
-    // fs_drop(&input_dir);
+    module->cache_key = cache_module_key(module);
+    module->cached = cache_lookup(module);
 
     return module;
 }
@@ -256,21 +289,21 @@ mars_module* create_module(da(parser) * pl, Arena alloca) {
 
     mod->AST_alloca = alloca;
 
-    mod->module_name = pl->at[0].module_decl.as_module_decl->name->text;
+    mod->module_name = token_text(pl->at[0].module_decl.as_module_decl->name);
 
     da_init(&mod->import_list, 1);
 
     da_init(&mod->files, pl->len);
     for_urange(i, 0, pl->len) {
-        if (!string_eq(pl->at[i].module_decl.as_module_decl->name->text, mod->module_name)) {
-            error_at_string(pl->at[i].path, pl->at[i].src, pl->at[i].module_decl.as_module_decl->name->text, "mismatched module name, expected '" str_fmt "'", str_arg(mod->module_name));
+        if (!string_eq(token_text(pl->at[i].module_decl.as_module_decl->name), mod->module_name)) {
+            error_at_string(pl->at[i].path, pl->at[i].src, NULL, token_text(pl->at[i].module_decl.as_module_decl->name), "mismatched module name, expected '" str_fmt "'", str_arg(mod->module_name));
         }
 
-        da_append(&mod->files, ((mars_file){pl->at[i].path, pl->at[i].src}));
+        da_append(&mod->files, ((mars_file){pl->at[i].path, pl->at[i].src, pl->at[i].tokens}));
     }
 
     if (string_eq(mod->module_name, str("mars")))
-        error_at_string(pl->at[0].path, pl->at[0].src, pl->at[0].module_decl.as_module_decl->name->text, "module name 'mars' is reserved");
+        error_at_string(pl->at[0].path, pl->at[0].src, NULL, token_text(pl->at[0].module_decl.as_module_decl->name), "module name 'mars' is reserved");
 
     // stitch ASTs together
     da_init(&mod->program_tree, pl->len);
@@ -284,8 +317,14 @@ mars_module* create_module(da(parser) * pl, Arena alloca) {
 }
 
 mars_file* find_source_file(mars_module* cu, string snippet) {
+    // diagnostics tend to come in runs from the same file
+    u32 last = cu->last_source_file;
+    if (last < cu->files.len && is_within(cu->files.at[last].src, snippet)) {
+        return &cu->files.at[last];
+    }
     for_urange(i, 0, cu->files.len) {
         if (is_within(cu->files.at[i].src, snippet)) {
+            cu->last_source_file = i;
             return &cu->files.at[i];
         }
     }
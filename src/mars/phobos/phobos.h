@@ -7,6 +7,7 @@
 #include "parse/parse.h"
 #include "ast.h"
 #include "iron/iron.h"
+#include "mars/term.h"
 
 da_typedef(lexer);
 da_typedef(parser);
@@ -14,6 +15,8 @@ da_typedef(parser);
 typedef struct {
     string path;
     string src;
+    da(token) tokens;
+    line_table lines; // built by the first diagnostic in this file
 } mars_file;
 
 da_typedef(mars_file);
@@ -40,15 +43,27 @@ typedef struct mars_module {
 
     const FeArchInfo* current_architecture;
 
+    u64 cache_key; // see cache.h
+    u64 stamp;     // see module_stamp()
+
+    _Atomic u32 last_source_file; // find_source_file checks this one first, body checking threads share it
+
+    u32 wave; // see check_module()
+
     bool visited : 1; // checking shit
     bool checked : 1; // has been FULLY CHECKED by the checker
+    bool cached : 1;  // checked clean before with the same cache_key, bodies can be skipped
 } mars_module;
 
+// every module parsed so far, in the order they were found
+extern module_list active_modules;
+
 typedef char* cstring;
 
 da_typedef(cstring);
 
 mars_module* parse_module(string input_path);
+u64 module_stamp(string path);
 
 // creates a compilation unit from a list of parsers.
 // stitches the unchecked ASTs together and such
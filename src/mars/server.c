@@ -0,0 +1,248 @@
+#include "common/orbit.h"
+#include "common/crash.h"
+#include "common/ptrmap.h"
+#include "mars/mars.h"
+#include "mars/term.h"
+
+#include "phobos/phobos.h"
+#include "server.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+da_typedef(char);
+
+static struct sockaddr_un socket_address(string path) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (path.len >= sizeof(addr.sun_path)) general_error("socket path \"" str_fmt "\" is too long", str_arg(path));
+    memcpy(addr.sun_path, path.raw, path.len);
+    return addr;
+}
+
+static bool write_all(int fd, char* buf, size_t len) {
+    while (len != 0) {
+        ssize_t written = write(fd, buf, len);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        buf += written;
+        len -= written;
+    }
+    return true;
+}
+
+static void drop_modules(PtrMap* dropped) {
+    size_t kept = 0;
+    for_urange(i, 0, active_modules.len) {
+        if (ptrmap_get(dropped, active_modules.at[i]) != PTRMAP_NOT_FOUND) continue;
+        active_modules.at[kept++] = active_modules.at[i];
+    }
+    // nothing gets freed. the type graph is global and still points into them
+    active_modules.len = kept;
+}
+
+// drop every module whose files changed, and everything that imports one of them
+static void refresh_modules() {
+    static int last_arch = -1, last_system = -1;
+    if (mars_flags.target_arch != last_arch || mars_flags.target_system != last_system) {
+        // checking depends on the target, so nothing carries over
+        active_modules.len = 0;
+        last_arch = mars_flags.target_arch;
+        last_system = mars_flags.target_system;
+        return;
+    }
+
+    PtrMap stale;
+    ptrmap_init(&stale, 16);
+    foreach (mars_module* mod, active_modules) {
+        if (module_stamp(mod->module_path) != mod->stamp) ptrmap_put(&stale, mod, mod);
+    }
+    for (bool spread = true; spread;) {
+        spread = false;
+        foreach (mars_module* mod, active_modules) {
+            if (ptrmap_get(&stale, mod) != PTRMAP_NOT_FOUND) continue;
+            foreach (mars_module* import, mod->import_list) {
+                if (ptrmap_get(&stale, import) == PTRMAP_NOT_FOUND) continue;
+                ptrmap_put(&stale, mod, mod);
+                spread = true;
+                break;
+            }
+        }
+    }
+
+    size_t resident = active_modules.len;
+    drop_modules(&stale);
+    if (mars_flags.print_timings) {
+        printf(STYLE_FG_Blue STYLE_Bold "SERVER" STYLE_Reset);
+        printf("\t  reused    : %zu/%zu modules\n", (size_t)active_modules.len, resident);
+    }
+    ptrmap_destroy(&stale);
+}
+
+// a failed build can leave a module half checked, with some of its entities
+// already made. anything unchecked gets parsed again from scratch next time
+static void drop_unchecked_modules() {
+    PtrMap unchecked;
+    ptrmap_init(&unchecked, 16);
+    foreach (mars_module* mod, active_modules) {
+        if (!mod->checked) ptrmap_put(&unchecked, mod, mod);
+    }
+    drop_modules(&unchecked);
+    ptrmap_destroy(&unchecked);
+}
+
+static int build(int argc, char** argv) {
+    sigjmp_buf recovery;
+    int status = sigsetjmp(recovery, 1);
+    if (status != 0) {
+        crash_recovery = NULL;
+        drop_unchecked_modules();
+        return status;
+    }
+    crash_recovery = &recovery;
+
+    load_arguments(argc, argv, &mars_flags);
+    refresh_modules();
+    mars_module* main_mod = mars_frontend();
+    crash_recovery = NULL;
+    if (main_mod == NULL) return EXIT_SUCCESS;
+
+    // the backend has no state worth keeping, and it's where the crashes are
+    fflush(stdout);
+    pid_t child = fork();
+    if (child < 0) {
+        printf("mars: fork failed: %s\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (child == 0) exit(mars_backend(main_mod));
+
+    int child_status;
+    while (waitpid(child, &child_status, 0) < 0 && errno == EINTR);
+    if (WIFEXITED(child_status)) return WEXITSTATUS(child_status);
+    printf("mars: backend killed by signal %d\n", WTERMSIG(child_status));
+    return EXIT_FAILURE;
+}
+
+// fills args with pointers into the returned buffer.
+// .at is NULL if the client hung up before finishing the request
+static da(char) read_request(int client, da(cstring)* args) {
+    da(char) buf;
+    da_init(&buf, 256);
+    char chunk[4096];
+    while (buf.len < 2 || buf.at[buf.len - 1] != '\0' || buf.at[buf.len - 2] != '\0') {
+        ssize_t got = read(client, chunk, sizeof(chunk));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) {
+            da_destroy(&buf);
+            return (da(char)){0};
+        }
+        for_range(i, 0, got) da_append(&buf, chunk[i]);
+    }
+
+    da_append(args, "mars");
+    for (char* arg = buf.at; *arg != '\0'; arg += strlen(arg) + 1) {
+        da_append(args, arg);
+    }
+    return buf;
+}
+
+static void handle_request(int client) {
+    da(cstring) args;
+    da_init(&args, 8);
+    da(char) request = read_request(client, &args);
+    if (request.at == NULL || args.len < 2) {
+        if (request.at != NULL) da_destroy(&request);
+        da_destroy(&args);
+        return;
+    }
+
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    dup2(client, STDOUT_FILENO);
+
+    int status = build(args.len, args.at);
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+
+    char trailer[32];
+    int len = snprintf(trailer, sizeof(trailer), "%c%d", '\0', status);
+    write_all(client, trailer, len);
+
+    da_destroy(&request);
+    da_destroy(&args);
+}
+
+int serve(string socket_path) {
+    struct sockaddr_un addr = socket_address(socket_path);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) general_error("cannot make a socket: %s", strerror(errno));
+    unlink(addr.sun_path); // left over from a server that didn't shut down cleanly
+    if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+        general_error("cannot bind to \"%s\": %s", addr.sun_path, strerror(errno));
+    if (listen(listener, 16) < 0) general_error("cannot listen on \"%s\": %s", addr.sun_path, strerror(errno));
+
+    // a client that hangs up early shouldn't kill the server
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("mars: serving on %s\n", addr.sun_path);
+    fflush(stdout);
+
+    while (true) {
+        int client = accept(listener, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            general_error("accept failed: %s", strerror(errno));
+        }
+        handle_request(client);
+        close(client);
+    }
+    return 0;
+}
+
+int connect_to_server(string socket_path, int argc, char** argv) {
+    struct sockaddr_un addr = socket_address(socket_path);
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) general_error("cannot make a socket: %s", strerror(errno));
+    if (connect(server, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+        general_error("cannot connect to a compile server at \"%s\": %s", addr.sun_path, strerror(errno));
+
+    // the server has its own working directory, so send the resolved input path
+    char* input_path = clone_to_cstring(mars_flags.input_path);
+    bool sent = write_all(server, input_path, strlen(input_path) + 1);
+    mars_free(input_path);
+    for_range(i, 2, argc) {
+        if (strncmp(argv[i], "-connect", strlen("-connect")) == 0) continue;
+        sent = sent && write_all(server, argv[i], strlen(argv[i]) + 1);
+    }
+    sent = sent && write_all(server, "", 1);
+    if (!sent) general_error("lost the compile server while sending the request");
+
+    // everything up to the null is output, after it is the exit status
+    bool in_status = false;
+    bool negative = false;
+    int status = 0;
+    char chunk[4096];
+    while (true) {
+        ssize_t got = read(server, chunk, sizeof(chunk));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) break;
+        for_range(i, 0, got) {
+            if (in_status) {
+                if (chunk[i] == '-') negative = true;
+                else status = status * 10 + (chunk[i] - '0');
+            } else if (chunk[i] == '\0') {
+                fwrite(chunk, 1, i, stdout);
+                in_status = true;
+            }
+        }
+        if (!in_status) fwrite(chunk, 1, got, stdout);
+    }
+    close(server);
+
+    if (!in_status) general_error("the compile server hung up mid build");
+    return negative ? -status : status;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#define MARS_SERVER_H
+
+#include "common/orbit.h"
+#include "mars/mars.h"
+
+/*
+    compile server. `mars -serve:(socket)` listens on a unix socket and keeps
+    every parsed and checked module resident between builds. `mars (dir) ...
+    -connect:(socket)` sends its arguments over and prints whatever comes back.
+
+    before each build, modules whose .mars files changed (see module_stamp())
+    get dropped, along with everything that imports them, and get parsed and
+    checked again. lowering and codegen run in a forked child, so a crash
+    there can't take the resident modules down with it. errors in parsing and
+    checking jump back through crash_recovery instead of exiting.
+
+    a request is the arguments, each null terminated, then an empty one.
+    the reply is the build's output, a null, and the exit status in decimal.
+
+    flags that take a path, apart from (directory), are resolved against the
+    directory the server was started in.
+*/
+
+int serve(string socket_path);
+int connect_to_server(string socket_path, int argc, char** argv);
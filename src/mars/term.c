@@ -1,5 +1,10 @@
 #include "common/orbit.h"
 #include "term.h"
+#include "common/crash.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 noreturn void general_error(char* message, ...) {
     char ERROR_MSG_BUFFER[500] = {0};
@@ -8,11 +13,13 @@ noreturn void general_error(char* message, ...) {
     vsprintf(ERROR_MSG_BUFFER, message, args);
     va_end(args);
 
+    flockfile(stdout);
     printf(STYLE_FG_Red STYLE_Bold "ERROR" STYLE_Reset);
     printf(STYLE_Dim " | " STYLE_Reset "%s", ERROR_MSG_BUFFER);
 
     printf("\n");
-    exit(EXIT_FAILURE);
+    funlockfile(stdout);
+    crash_exit(EXIT_FAILURE);
 }
 
 void general_warning(char* message, ...) {
@@ -22,17 +29,19 @@ void general_warning(char* message, ...) {
     vsprintf(ERROR_MSG_BUFFER, message, args);
     va_end(args);
 
+    flockfile(stdout);
     printf(STYLE_FG_Yellow STYLE_Bold "WARNING" STYLE_Reset);
     printf(STYLE_Dim " | " STYLE_Reset "%s", ERROR_MSG_BUFFER);
 
     printf("\n");
+    funlockfile(stdout);
 }
 
 bool is_whitespace(char c) {
     return (c == ' ') || (c == '\t');
 }
 
-noreturn void error_at_string(string path, string text, string pos, char* message, ...) {
+noreturn void error_at_string(string path, string text, line_table* lines, string pos, char* message, ...) {
 
     char ERROR_MSG_BUFFER[500] = {0};
     va_list args;
@@ -40,16 +49,18 @@ noreturn void error_at_string(string path, string text, string pos, char* messag
     vsprintf(ERROR_MSG_BUFFER, message, args);
     va_end(args);
 
+    // checker threads can report at the same time, keep the pieces together
+    flockfile(stdout);
     printf(STYLE_FG_Red STYLE_Bold "ERROR" STYLE_Reset);
 
     printf(STYLE_Dim " | " STYLE_Reset);
 
     int line = 1;
     int column = 1;
-    char* line_ptr = text.raw - 1;
+    char* line_ptr = text.raw;
     int line_len = 0;
-    line_and_col(text, pos.raw - text.raw, &line_ptr, &line_len, &line, &column);
-    if (line_ptr[line_len - 1] == '\r') line_len--; // stupid windows line breaks
+    line_and_col(text, lines, pos.raw - text.raw, &line_ptr, &line_len, &line, &column);
+    if (line_len > 0 && line_ptr[line_len - 1] == '\r') line_len--; // stupid windows line breaks
 
     printf(STYLE_Italic STYLE_Bold);
     printstr(path);
@@ -100,10 +111,11 @@ noreturn void error_at_string(string path, string text, string pos, char* messag
     }
     printf(STYLE_Reset);
     printf("\n");
-    exit(EXIT_FAILURE);
+    funlockfile(stdout);
+    crash_exit(EXIT_FAILURE);
 }
 
-void warning_at_string(string path, string text, string pos, char* message, ...) {
+void warning_at_string(string path, string text, line_table* lines, string pos, char* message, ...) {
 
     /*printf("---\n");
 
@@ -117,6 +129,7 @@ void warning_at_string(string path, string text, string pos, char* message, ...)
     vsprintf(ERROR_MSG_BUFFER, message, args);
     va_end(args);
 
+    flockfile(stdout);
     printf(STYLE_FG_Yellow STYLE_Bold "WARNING" STYLE_Reset);
 
     printf(STYLE_Dim " | " STYLE_Reset);
@@ -125,7 +138,7 @@ void warning_at_string(string path, string text, string pos, char* message, ...)
     int column = 1;
     char* line_ptr = text.raw;
     int line_len = 0;
-    line_and_col(text, pos.raw - text.raw, &line_ptr, &line_len, &line, &column);
+    line_and_col(text, lines, pos.raw - text.raw, &line_ptr, &line_len, &line, &column);
 
     printstr(path);
     printf(" @ %d:%d ", line, column);
@@ -179,34 +192,79 @@ void warning_at_string(string path, string text, string pos, char* message, ...)
     // printf(" %s\n", ERROR_MSG_BUFFER);
     // printf(STYLE_Reset);
     printf("\n");
+    funlockfile(stdout);
 }
 
-void line_and_col(string text, size_t position, char** last_newline, int* restrict line_len, int* restrict line, int* restrict col) {
+static void push_line(line_table* lines, u32* cap, u32 start) {
+    if (lines->len == *cap) {
+        *cap *= 2;
+        lines->at = realloc(lines->at, sizeof(u32) * *cap);
+    }
+    lines->at[lines->len++] = start;
+}
 
-    int l = 0;
-    int c = 0;
+void line_table_build(line_table* lines, string text) {
+    u32 cap = 64;
+    lines->at = malloc(sizeof(u32) * cap);
+    lines->len = 0;
+    push_line(lines, &cap, 0);
+
+    size_t i = 0;
+#if defined(__SSE2__)
+    // compare 16 bytes at a time and pull the newlines out of the mask
+    __m128i newlines = _mm_set1_epi8('\n');
+    for (; i + 16 <= text.len; i += 16) {
+        __m128i chunk = _mm_loadu_si128((__m128i*)&text.raw[i]);
+        u32 mask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newlines));
+        while (mask != 0) {
+            push_line(lines, &cap, (u32)(i + __builtin_ctz(mask) + 1));
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < text.len; i++) {
+        if (text.raw[i] == '\n') push_line(lines, &cap, (u32)(i + 1));
+    }
+}
 
-    for (size_t i = 0; i <= position; i++) {
-        if (text.raw[i] == '\n') {
-            *last_newline = &text.raw[i];
-            l++;
-            c = 0;
-            continue;
+void line_and_col(string text, line_table* lines, size_t position, char** last_newline, int* restrict line_len, int* restrict line, int* restrict col) {
+
+    // a newline at position counts, so position is on the last line starting at or before position + 1
+    size_t start = 0;
+    int l = 0;
+    if (lines != NULL) {
+        if (lines->at == NULL) line_table_build(lines, text);
+        u32 lo = 0;
+        u32 hi = lines->len;
+        while (hi - lo > 1) {
+            u32 mid = lo + (hi - lo) / 2;
+            if (lines->at[mid] <= position + 1) lo = mid;
+            else hi = mid;
         }
-        if (text.raw[i] == '\t') {
-            c += 4;
-            continue;
+        start = lines->at[lo];
+        l = (int)lo;
+    } else {
+        for (size_t i = 0; i <= position && i < text.len; i++) {
+            if (text.raw[i] == '\n') {
+                start = i + 1;
+                l++;
+            }
         }
-        c++;
     }
 
-    *last_newline += 1;
+    int c = 0;
+    // sources aren't nul terminated, and the EOF token sits just past the end
+    for (size_t i = start; i <= position; i++) {
+        c += i < text.len && text.raw[i] == '\t' ? 4 : 1;
+    }
+
+    *last_newline = &text.raw[start];
     *line = l + 1;
     *col = c;
 
     *line_len = 0;
-    while ((*last_newline)[*line_len] != '\0' && (*last_newline)[*line_len] != '\n') {
-        if (*line_len + *last_newline - text.raw >= text.len) break;
+    while (*line_len + *last_newline - text.raw < text.len) {
+        if ((*last_newline)[*line_len] == '\0' || (*last_newline)[*line_len] == '\n') break;
         *line_len += 1;
     }
-}
\ No newline at end of file
+}
@@ -60,10 +60,21 @@
 #define STYLE_BG_White "\x1b[47m"
 #define STYLE_BG_Default "\x1b[49m"
 
-void error_at_string(string path, string text, string pos, char* message, ...);
-void warning_at_string(string path, string text, string pos, char* message, ...);
+// byte offsets of the start of every line in a file, so turning a position
+// into a line and column is a binary search instead of a rescan.
+// zeroed means not built yet, the diagnostics build it the first time they need it
+typedef struct line_table {
+    u32* at;
+    u32 len;
+} line_table;
+
+void line_table_build(line_table* lines, string text);
+
+// lines can be NULL, then the position is found by scanning text
+void error_at_string(string path, string text, line_table* lines, string pos, char* message, ...);
+void warning_at_string(string path, string text, line_table* lines, string pos, char* message, ...);
 
 void general_error(char* message, ...);
 void general_warning(char* message, ...);
 
-void line_and_col(string text, size_t position, char** last_newline, int* restrict line_len, int* restrict line, int* restrict col);
\ No newline at end of file
+void line_and_col(string text, line_table* lines, size_t position, char** last_newline, int* restrict line_len, int* restrict line, int* restrict col);
\ No newline at end of file